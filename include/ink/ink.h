@@ -43,6 +43,28 @@ extern "C" {
  */
 typedef struct ink_story ink_story;
 
+/**
+ * @struct ink_program
+ *
+ * @brief Opaque type representing compiled story content.
+ *
+ * A program is immutable once loaded, and can be shared by any number of
+ * sessions, including sessions on different threads.
+ */
+typedef struct ink_program ink_program;
+
+/**
+ * A session is a story that borrows its content from a program.
+ */
+typedef struct ink_story ink_session;
+
+/**
+ * @struct ink_scheduler
+ *
+ * @brief Opaque type representing a pool of threads that run sessions.
+ */
+typedef struct ink_scheduler ink_scheduler;
+
 /**
  * @struct ink_object
  *
@@ -54,8 +76,31 @@ typedef struct ink_story ink_story;
  */
 typedef struct ink_object ink_object;
 
+/**
+ * Status codes.
+ *
+ * Functions that return an `int` status return `INK_E_OK` on success, or a
+ * negated status code on error, such as `-INK_E_INVALID_STATE`.
+ */
+enum ink_status {
+    INK_E_OK,
+    INK_E_FAIL,
+    INK_E_PANIC,
+    INK_E_OOM,
+    INK_E_OS,
+    INK_E_FILE,
+    INK_E_OVERWRITE,
+    INK_E_INVALID_OPTION,
+    INK_E_INVALID_INST,
+    INK_E_INVALID_ARG,
+    INK_E_STACK_OVERFLOW,
+    INK_E_INVALID_BUNDLE,
+    INK_E_INVALID_STATE,
+    INK_E_YIELD,
+};
+
 enum ink_flags {
-    INK_F_RESERVED_1 = (1 << 0),
+    INK_F_PARALLEL = (1 << 0),
     INK_F_RESERVED_2 = (1 << 1),
     INK_F_RESERVED_3 = (1 << 2),
     INK_F_CACHING = (1 << 3),
@@ -73,12 +118,177 @@ enum ink_flags {
     INK_F_RESERVED_8 = (1 << 15),
 };
 
+/**
+ * Choice presented by the story.
+ *
+ * The choice text is NUL-terminated and owned by the story. It remains valid
+ * until the next call to `ink_story_choose`.
+ */
 struct ink_choice {
     struct ink_object *id;
     uint8_t *bytes;
     size_t length;
 };
 
+/**
+ * Output of a single turn, up to the next set of choices.
+ *
+ * The line at index `i` spans from `lines[i]` to `lines[i + 1]`, relative to
+ * `bytes`. The `lines` array holds `line_count + 1` offsets. All memory is
+ * owned by the story and remains valid until the next call to
+ * `ink_story_continue_all`. When an output sink is installed, the turn holds
+ * no lines.
+ */
+struct ink_turn {
+    const uint8_t *bytes;
+    size_t length;
+    const size_t *lines;
+    size_t line_count;
+    const struct ink_choice *choices;
+    size_t choice_count;
+};
+
+/**
+ * Order in which `ink_program_explore` visits choice points.
+ */
+enum ink_explore_order {
+    INK_EXPLORE_BFS = 0,
+    INK_EXPLORE_DFS,
+};
+
+/**
+ * Options for `ink_program_explore`. Limits of zero are unbounded.
+ */
+struct ink_explore_opts {
+    enum ink_explore_order order;
+    /* Zero uses one thread per hardware thread. */
+    size_t thread_count;
+    /* Number of choices taken before a choice point is no longer expanded. */
+    size_t max_depth;
+    size_t max_states;
+    /* Instructions a single turn may execute before it is a dead end. */
+    size_t max_instructions;
+};
+
+/**
+ * Branch of a story that stopped without reaching its end.
+ */
+struct ink_explore_dead_end {
+    /* Error that stopped the branch, or zero if it ran out of content. */
+    int rc;
+    size_t depth;
+    /* Choices taken from the start of the story, as passed to
+     * `ink_story_choose`. */
+    size_t *choices;
+};
+
+/**
+ * Results of `ink_program_explore`.
+ */
+struct ink_explore_report {
+    /* Distinct choice points reached. */
+    size_t states;
+    /* Branches that led to a choice point that had already been reached. */
+    size_t duplicates;
+    /* Branches that reached the end of the story. */
+    size_t endings;
+    /* Choice points left unexpanded because of a limit. */
+    size_t truncated;
+    size_t max_depth;
+    size_t path_count;
+    /* Names of the knots and stitches that were never entered. These point
+     * into the program, and are valid until it is closed. */
+    const char **unvisited_paths;
+    size_t unvisited_path_count;
+    struct ink_explore_dead_end *dead_ends;
+    size_t dead_end_count;
+};
+
+/**
+ * Policy used by `ink_program_simulate` to pick choices.
+ */
+enum ink_simulate_policy {
+    INK_SIMULATE_RANDOM = 0,
+    INK_SIMULATE_WEIGHTED,
+};
+
+/**
+ * Weight of a choice for `INK_SIMULATE_WEIGHTED`. `index` is zero-based.
+ *
+ * Called concurrently from several threads.
+ */
+typedef double (*ink_choice_weight_fn)(const struct ink_choice *choice,
+                                       size_t index, void *userdata);
+
+/**
+ * Options for `ink_program_simulate`. Limits of zero are unbounded.
+ */
+struct ink_simulate_opts {
+    enum ink_simulate_policy policy;
+    /* Weight of each choice for `INK_SIMULATE_WEIGHTED`. When NULL, the
+     * choice at zero-based index `i` has a weight of 1 / (i + 1). */
+    ink_choice_weight_fn weight;
+    void *userdata;
+    size_t playthrough_count;
+    /* Zero uses one thread per hardware thread. */
+    size_t thread_count;
+    uint64_t seed;
+    /* Choices taken before a playthrough is cut short. */
+    size_t max_turns;
+    /* Instructions a single turn may execute before the playthrough is cut
+     * short. */
+    size_t max_instructions;
+};
+
+/**
+ * Number of playthroughs that entered a knot or stitch.
+ */
+struct ink_simulate_path {
+    const char *name;
+    size_t playthroughs;
+};
+
+/**
+ * Number of playthroughs that ended with a global set to a value.
+ */
+struct ink_simulate_bin {
+    char *value;
+    size_t count;
+};
+
+/**
+ * Final values of a global, over the playthroughs that defined it.
+ */
+struct ink_simulate_global {
+    const char *name;
+    /* Sorted by decreasing count. */
+    struct ink_simulate_bin *bins;
+    size_t bin_count;
+};
+
+/**
+ * Results of `ink_program_simulate`.
+ *
+ * Names point into the program, and are valid until it is closed.
+ */
+struct ink_simulate_report {
+    size_t playthroughs;
+    size_t endings;
+    size_t dead_ends;
+    size_t truncated;
+    uint64_t instructions;
+    /* Number of playthroughs by the number of choices taken, from zero to
+     * `turns_max`. */
+    size_t *turns;
+    size_t turns_max;
+    /* Sorted by decreasing number of playthroughs. */
+    struct ink_simulate_path *paths;
+    size_t path_count;
+    /* Sorted by name. */
+    struct ink_simulate_global *globals;
+    size_t global_count;
+};
+
 struct ink_load_opts {
     const uint8_t *filename;
     const uint8_t *source_bytes;
@@ -86,6 +296,41 @@ struct ink_load_opts {
     int flags;
 };
 
+enum ink_span_type {
+    INK_SPAN_TEXT,
+    INK_SPAN_LINE,
+    INK_SPAN_GLUE,
+    INK_SPAN_CHOICE,
+};
+
+/**
+ * Span of story output delivered to an output sink.
+ *
+ * The bytes are owned by the story and are only valid for the duration of
+ * the callback.
+ */
+struct ink_span {
+    enum ink_span_type type;
+    const uint8_t *bytes;
+    size_t length;
+};
+
+/**
+ * Output sink callback.
+ */
+typedef void (*ink_output_sink)(void *userdata, const struct ink_span *span);
+
+/**
+ * Completion callback for scheduled jobs.
+ *
+ * Called on a worker thread with the status of the job and, on success, the
+ * output of the turn. `rc` is `INK_E_OK` or a negated `enum ink_status`. A
+ * job that could not be queued behind the previous job of its session fails
+ * with `-INK_E_OOM`. The turn is only valid until the callback returns.
+ */
+typedef void (*ink_job_callback)(ink_session *session, int rc,
+                                 const struct ink_turn *turn, void *userdata);
+
 /**
  * @brief Open a story context.
  *
@@ -98,6 +343,126 @@ INK_API struct ink_story *ink_open(void);
  */
 INK_API void ink_close(struct ink_story *story);
 
+/**
+ * Compile an Ink story into a program that can be shared between sessions.
+ *
+ * The garbage collection flags in `opts` are ignored, since the content of a
+ * program lives as long as the program itself.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_program_load_opts(struct ink_program **program,
+                                  const struct ink_load_opts *opts);
+
+/**
+ * Close a program and free its content.
+ *
+ * All sessions opened for the program must be closed beforehand.
+ */
+INK_API void ink_program_close(struct ink_program *program);
+
+/**
+ * Open a session for a program.
+ *
+ * The session holds only its own stacks, globals and heap, and begins at the
+ * entry point of the program. It is closed with `ink_close`. Sessions cannot
+ * be loaded from other sources or recompiled.
+ *
+ * @returns a new session, or NULL on error.
+ */
+INK_API ink_session *ink_session_open(struct ink_program *program, int flags);
+
+/**
+ * Fork a session.
+ *
+ * The fork shares the program of the session and starts from a copy of its
+ * runtime state, along with its output sink. Only the values reachable from
+ * the stacks, globals and pending choices and output are copied, so the cost
+ * does not depend on the size of the program or of the heap.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_fork(ink_session *story, ink_session **fork);
+
+/**
+ * Open a scheduler that runs sessions on a pool of `thread_count` threads.
+ *
+ * A `thread_count` of zero uses one thread per hardware thread. Without
+ * thread support, jobs are run by `ink_scheduler_wait` instead. Long turns
+ * are run in slices of instructions, so that other sessions make progress.
+ *
+ * @returns a new scheduler, or NULL on error.
+ */
+INK_API struct ink_scheduler *ink_scheduler_open(size_t thread_count,
+                                                 ink_job_callback callback,
+                                                 void *userdata);
+
+/**
+ * Submit a job that selects a choice in a session and continues it until the
+ * next set of choices or the end of the story.
+ *
+ * `choice_index` is passed to `ink_story_choose`, or is zero to only continue
+ * the session. Jobs for the same session are run in submission order, and
+ * never on two threads at once. The session must not be used outside of the
+ * scheduler until its jobs have completed.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_scheduler_submit(struct ink_scheduler *scheduler,
+                                 ink_session *session, size_t choice_index);
+
+/**
+ * Wait for all submitted jobs to complete.
+ */
+INK_API void ink_scheduler_wait(struct ink_scheduler *scheduler);
+
+/**
+ * Wait for all submitted jobs to complete, then stop and free a scheduler.
+ */
+INK_API void ink_scheduler_close(struct ink_scheduler *scheduler);
+
+/**
+ * Visit every choice point reachable from the start of a program.
+ *
+ * Each choice point is saved once, and every choice is taken from it in a
+ * fork of the saved state. Choice points are deduplicated by their complete
+ * runtime state, so branches that rejoin are explored only once. Branches
+ * are run on a pool of `opts->thread_count` threads.
+ *
+ * The report must be released with `ink_explore_report_deinit`.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_program_explore(struct ink_program *program,
+                                const struct ink_explore_opts *opts,
+                                struct ink_explore_report *report);
+
+/**
+ * Release memory held by an exploration report.
+ */
+INK_API void ink_explore_report_deinit(struct ink_explore_report *report);
+
+/**
+ * Run independent playthroughs of a program, picking choices with a policy,
+ * and aggregate their statistics.
+ *
+ * Playthroughs are run on a pool of `opts->thread_count` threads. Each
+ * playthrough has its own random number generator derived from `opts->seed`,
+ * so the results do not depend on the number of threads.
+ *
+ * The report must be released with `ink_simulate_report_deinit`.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_program_simulate(struct ink_program *program,
+                                 const struct ink_simulate_opts *opts,
+                                 struct ink_simulate_report *report);
+
+/**
+ * Release memory held by a simulation report.
+ */
+INK_API void ink_simulate_report_deinit(struct ink_simulate_report *report);
+
 /**
  * Load an Ink story with extended options.
  *
@@ -120,6 +485,100 @@ INK_API int ink_story_load_string(struct ink_story *story, const char *text,
  */
 INK_API int ink_story_load_file(struct ink_story *story, const char *file_path,
                                 int flags);
+
+/**
+ * Recompile a loaded Ink story from updated source.
+ *
+ * Content paths of knots, stitches and functions whose source is unchanged
+ * are carried over from the previous compilation. The story restarts from
+ * its beginning. On error, the previously loaded story is left intact.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_recompile(struct ink_story *story,
+                                const struct ink_load_opts *opts);
+
+/**
+ * Restart a loaded story or session from its beginning, without recompiling.
+ *
+ * Globals, stacks, output and choices are restored to how they were once the
+ * story was loaded. Content paths are kept.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_reset(struct ink_story *story);
+
+/**
+ * Load a compiled Ink story bundle from the filesystem.
+ *
+ * The bytecode of each path is checked before the story is loaded, and a
+ * bundle with malformed code is rejected with -INK_E_INVALID_BUNDLE.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_load_bundle(struct ink_story *story,
+                                  const char *file_path, int flags);
+
+/**
+ * Save a loaded Ink story to the filesystem as a compiled bundle.
+ *
+ * An existing file at `file_path` is replaced in a single step, so stories
+ * that have it loaded are unaffected.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_save_bundle(struct ink_story *story,
+                                  const char *file_path);
+
+/**
+ * Save the runtime state of a story as a checkpoint.
+ *
+ * The state is written into a buffer owned by the story, which remains valid
+ * until the next call. Only mutable state is saved, so it can only be loaded
+ * into a story compiled from the same source.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_save_state(struct ink_story *story,
+                                 const uint8_t **bytes, size_t *length);
+
+/**
+ * Save the changes to the runtime state of a story since its last checkpoint.
+ *
+ * Only the globals stored since the last checkpoint are written, which makes
+ * the delta itself the next checkpoint. The story must have saved or loaded
+ * a checkpoint beforehand. The buffer is shared with `ink_story_save_state`.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_save_delta(struct ink_story *story,
+                                 const uint8_t **bytes, size_t *length);
+
+/**
+ * Restore the runtime state of a story from a saved state or delta.
+ *
+ * A delta can only be loaded on top of the checkpoint it was saved against,
+ * before the story stores any globals. The story is left unchanged if the
+ * state is invalid or cannot be loaded.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_load_state(struct ink_story *story,
+                                 const uint8_t *bytes, size_t length);
+
+/**
+ * Restore the runtime state of a story from a chain of checkpoints.
+ *
+ * The chain is usually a full state followed by the deltas saved after it.
+ * Loading stops at the first invalid checkpoint, leaving the story at the
+ * last one that was loaded.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_load_state_chain(struct ink_story *story,
+                                       const uint8_t *const *states,
+                                       const size_t *lengths, size_t count);
+
 /**
  * Dump a compiled Ink story.
  *
@@ -137,10 +596,63 @@ INK_API bool ink_story_can_continue(struct ink_story *story);
 /**
  * Advance the story and output content, if available.
  *
+ * A runtime error, such as a stack overflow or a call with too few
+ * arguments, stops the story and is returned as its status code.
+ *
  * @returns a non-zero value on error.
  */
 INK_API int ink_story_continue(struct ink_story *story, uint8_t **line,
                                size_t *linelen);
+/**
+ * Advance the story until the next set of choices or the end of the story.
+ *
+ * When an output sink is installed, lines are delivered to the sink instead
+ * and `turn` holds no lines, only the current choices.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_continue_all(struct ink_story *story,
+                                   struct ink_turn *turn);
+
+/**
+ * Advance the story like `ink_story_continue_all`, executing at most
+ * `max_instructions` instructions.
+ *
+ * When the budget is exhausted, returns `-INK_E_YIELD` without filling in
+ * `turn`. The next call to `ink_story_continue_budget`, `ink_story_continue`
+ * or `ink_story_continue_all` resumes exactly where execution stopped, and
+ * the turn it returns includes the output produced before the yield. States
+ * cannot be saved and sessions cannot be forked while a turn is yielded.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_continue_budget(struct ink_story *story,
+                                      size_t max_instructions,
+                                      struct ink_turn *turn);
+
+/**
+ * Get the number of instructions executed by a story since it was opened
+ * or last reset.
+ */
+INK_API uint64_t ink_story_instruction_count(struct ink_story *story);
+
+/**
+ * Install an output sink.
+ *
+ * Once installed, content is delivered to the sink as it is produced instead
+ * of being buffered for `ink_story_continue`, which will then advance the
+ * story without returning lines. Text is delivered as a sequence of
+ * `INK_SPAN_TEXT` spans terminated by an `INK_SPAN_LINE` span. Glue has been
+ * applied before delivery; `INK_SPAN_GLUE` spans are informational. Each
+ * choice is delivered as a single `INK_SPAN_CHOICE` span.
+ *
+ * Passing a NULL sink restores the default behavior.
+ *
+ * @returns a non-zero value on error.
+ */
+INK_API int ink_story_set_output_sink(struct ink_story *story,
+                                      ink_output_sink sink, void *userdata);
+
 /**
  * Select a choice by its index.
  *
@@ -58,48 +58,48 @@ static struct ink_arena_block *ink_arena_block_new(size_t size)
 }
 
 /**
- * Provision memory within a block.
+ * Obtain a block with room for at least `size` bytes.
  *
- * If the specified block does not contain an adequate capacity for an
- * allocation of the requested size, a new block will be created and chained to
- * the supplied block.
- *
- * The supplied block MUST not be NULL and MUST be the most recently allocated
- * allocated block; that is, a block with no `next` link.
+ * Blocks retained by a previous reset are reused where possible. Otherwise, a
+ * new block is created with the arena's next block size, which doubles with
+ * every block created.
  */
-static void *ink_arena_block_alloc(struct ink_arena_block *block, size_t size,
-                                   size_t alignment, size_t fallback_size)
+static struct ink_arena_block *ink_arena_block_acquire(struct ink_arena *arena,
+                                                       size_t size)
 {
-    struct ink_arena_block *new_block;
-    void *address;
-
-    assert(block != NULL);
-
-    size = ink_align_size(size, alignment);
+    struct ink_arena_block *block;
+    struct ink_arena_block **link = &arena->block_free;
+
+    for (block = arena->block_free; block != NULL; block = block->next) {
+        if (block->size >= size) {
+            *link = block->next;
+            block->next = NULL;
+            block->offset = 0;
+            return block;
+        }
 
-    if (block->offset + size > block->size) {
-        /*
-         * TODO(Brett): We may want to over-allocate here.
-         * Ask someone who knows a lot about allocators.
-         */
-        new_block =
-            ink_arena_block_new(size < fallback_size ? fallback_size : size);
-        if (new_block == NULL)
+        link = &block->next;
+    }
+    if (size > arena->next_block_size) {
+        block = ink_arena_block_new(size);
+        if (block == NULL) {
             return NULL;
+        }
 
-        assert(block->next == NULL);
-
-        block->next = new_block;
-        block = new_block;
+        arena->total_oversized_blocks++;
+    } else {
+        block = ink_arena_block_new(arena->next_block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        if (arena->next_block_size < INK_ARENA_BLOCK_SIZE_MAX) {
+            arena->next_block_size *= 2;
+        }
     }
 
-    /* SANITY: Detect heap-overflow. */
-    /* TODO(Brett): This may cause an integer overflow. Do we care? */
-    assert(block->offset + size <= block->size);
-
-    address = (uint8_t *)block->bytes + block->offset;
-    block->offset += size;
-    return address;
+    arena->total_blocks++;
+    arena->total_block_size += block->size;
+    return block;
 }
 
 /**
@@ -125,7 +125,9 @@ void ink_arena_init(struct ink_arena *arena, size_t block_size,
 
     arena->block_first = NULL;
     arena->block_current = NULL;
+    arena->block_free = NULL;
     arena->default_block_size = block_size;
+    arena->next_block_size = block_size;
     arena->alignment = alignment;
     arena->total_bytes = 0;
     arena->total_blocks = 0;
@@ -144,67 +146,82 @@ void ink_arena_init(struct ink_arena *arena, size_t block_size,
  *
  * Blocks are created lazily, with the allocator's initial state containing
  * no blocks. If an allocation larger than the remaining space in the current
- * block is requested, a new block will be created and the allocation will be
- * provisioned to the newly created block.
+ * block is requested, a new block will be acquired and the allocation will be
+ * provisioned to it.
  */
 void *ink_arena_allocate(struct ink_arena *arena, size_t size)
 {
     void *address;
-    struct ink_arena_block *block;
-
-    if (arena->block_first == NULL) {
-        // SANITY: First block initialization should only happen once.
-        assert(arena->total_blocks == 0 && arena->total_allocations == 0);
+    struct ink_arena_block *block = arena->block_current;
+    const size_t aligned_size = ink_align_size(size, arena->alignment);
 
-        block = ink_arena_block_new(arena->default_block_size);
+    if (block == NULL || block->offset + aligned_size > block->size) {
+        block = ink_arena_block_acquire(arena, aligned_size);
         if (block == NULL) {
             return NULL;
         }
+        if (arena->block_current == NULL) {
+            arena->block_first = block;
+        } else {
+            assert(arena->block_current->next == NULL);
+            arena->block_current->next = block;
+        }
 
-        arena->block_first = block;
         arena->block_current = block;
-        arena->total_blocks++;
-    } else {
-        block = arena->block_current;
     }
 
-    address = ink_arena_block_alloc(block, size, arena->alignment,
-                                    arena->default_block_size);
-    if (address == NULL) {
-        return NULL;
-    }
+    /* SANITY: Detect heap-overflow. */
+    assert(block->offset + aligned_size <= block->size);
 
+    address = (uint8_t *)block->bytes + block->offset;
+    block->offset += aligned_size;
     arena->total_allocations++;
     arena->total_bytes += size;
-
-    if (arena->block_current->next) {
-        arena->block_current = arena->block_current->next;
-        arena->total_blocks++;
-        arena->total_block_size += arena->block_current->size;
-
-        if (arena->block_current->size > arena->default_block_size) {
-            arena->total_oversized_blocks++;
-        }
-    }
     return address;
 }
 
 /**
- * Release any memory tracked by the arena.
- *
- * Allocation statistics will remain intact.
+ * Free every block in a chain.
  */
-void ink_arena_release(struct ink_arena *arena)
+static void ink_arena_block_free_all(struct ink_arena_block *head)
 {
     struct ink_arena_block *block;
-    struct ink_arena_block *head = arena->block_first;
 
     while (head != NULL) {
         block = head;
         head = head->next;
         ink_arena_block_free(block);
     }
+}
+
+/**
+ * Discard every allocation made from the arena, keeping its blocks for reuse.
+ *
+ * Allocation statistics will remain intact.
+ */
+void ink_arena_reset(struct ink_arena *arena)
+{
+    if (arena->block_first == NULL) {
+        return;
+    }
+
+    arena->block_current->next = arena->block_free;
+    arena->block_free = arena->block_first;
+    arena->block_first = NULL;
+    arena->block_current = NULL;
+}
+
+/**
+ * Release any memory tracked by the arena.
+ *
+ * Allocation statistics will remain intact.
+ */
+void ink_arena_release(struct ink_arena *arena)
+{
+    ink_arena_block_free_all(arena->block_first);
+    ink_arena_block_free_all(arena->block_free);
 
     arena->block_first = NULL;
     arena->block_current = NULL;
+    arena->block_free = NULL;
 }
@@ -7,22 +7,30 @@ extern "C" {
 
 #include <stddef.h>
 
+#define INK_ARENA_BLOCK_SIZE_MAX (64ul * 1024ul)
+
 struct ink_arena_block;
 
 /**
  * Memory arena.
  *
  * Maintains a singly-linked list for memory blocks, along with statistical
- * information on past allocations.
+ * information on past allocations. Blocks are kept on a free-list when the
+ * arena is reset, to be reused by later allocations.
+ *
+ * Each new block is twice the size of the last one, up to
+ * `INK_ARENA_BLOCK_SIZE_MAX`, so that arenas holding a lot of data need
+ * fewer blocks.
  *
- * TODO(Brett): Should we add a free-list block cache?
  * TODO(Brett): Should we add a panic handler?
  * TODO(Brett): Provide a platform abstraction for system allocators.
  */
 struct ink_arena {
     struct ink_arena_block *block_first;
     struct ink_arena_block *block_current;
+    struct ink_arena_block *block_free;
     size_t default_block_size;
+    size_t next_block_size;
     size_t alignment;
     size_t total_bytes;
     size_t total_blocks;
@@ -34,6 +42,7 @@ struct ink_arena {
 extern void ink_arena_init(struct ink_arena *arena, size_t block_size,
                            size_t alignment);
 extern void *ink_arena_allocate(struct ink_arena *arena, size_t size);
+extern void ink_arena_reset(struct ink_arena *arena);
 extern void ink_arena_release(struct ink_arena *arena);
 
 #ifdef __cplusplus
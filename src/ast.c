@@ -46,7 +46,7 @@ struct ink_error_info {
 };
 
 /* TODO: Rename `ink_node_buffer` to `ink_node_vec`. */
-INK_VEC_T(ink_node_buffer, struct ink_ast_node *)
+INK_VEC_T(ink_node_buffer, uint32_t)
 INK_VEC_T(ink_line_buffer, struct ink_source_range)
 
 #define T(name, description) description,
@@ -274,11 +274,11 @@ static size_t ink_calculate_line(const struct ink_line_buffer *lines,
     return lines->count - 1;
 }
 
-static void ink_ast_node_print_nocolors(const struct ink_ast_node *node,
+static void ink_ast_node_print_nocolors(enum ink_ast_node_type type,
                                         const struct ink_print_context *context,
                                         char *buffer, size_t length)
 {
-    switch (node->type) {
+    switch (type) {
     case INK_AST_FILE:
         snprintf(buffer, length, "%s \"%s\"", context->node_type_strz,
                  context->filename);
@@ -331,11 +331,11 @@ static void ink_ast_node_print_nocolors(const struct ink_ast_node *node,
     }
 }
 
-static void ink_ast_node_print_colors(const struct ink_ast_node *node,
+static void ink_ast_node_print_colors(enum ink_ast_node_type type,
                                       const struct ink_print_context *context,
                                       char *buffer, size_t length)
 {
-    switch (node->type) {
+    switch (type) {
     case INK_AST_FILE:
         snprintf(buffer, length,
                  ANSI_COLOR_BLUE ANSI_BOLD_ON
@@ -405,39 +405,51 @@ static void ink_ast_node_print_colors(const struct ink_ast_node *node,
 
 static void ink_ast_print_node(const struct ink_ast *tree,
                                const struct ink_line_buffer *lines,
-                               const struct ink_ast_node *node,
-                               const char *prefix, const char **pointers,
-                               bool colors)
+                               uint32_t node, const char *prefix,
+                               const char **pointers, bool colors)
 {
     char line[1024];
-    const size_t line_start = ink_calculate_line(lines, node->bytes_start);
-    const size_t line_end = ink_calculate_line(lines, node->bytes_end);
+    const enum ink_ast_node_type type = ink_ast_node_type(tree, node);
+    const size_t bytes_start = ink_ast_node_start(tree, node);
+    const size_t bytes_end = ink_ast_node_end(tree, node);
+    const size_t line_start = ink_calculate_line(lines, bytes_start);
+    const size_t line_end = ink_calculate_line(lines, bytes_end);
     const struct ink_source_range line_range = lines->entries[line_start];
     const struct ink_print_context context = {
         .filename = (char *)tree->filename,
-        .node_type_strz = ink_ast_node_type_strz(node->type),
-        .lexeme = tree->source_bytes + node->bytes_start,
-        .lexeme_length = node->bytes_end - node->bytes_start,
+        .node_type_strz = ink_ast_node_type_strz(type),
+        .lexeme = tree->source_bytes + bytes_start,
+        .lexeme_length = bytes_end - bytes_start,
         .line_start = line_start + 1,
         .line_end = line_end + 1,
-        .column_start = (node->bytes_start - line_range.bytes_start) + 1,
-        .column_end = (node->bytes_end - line_range.bytes_start) + 1,
+        .column_start = (bytes_start - line_range.bytes_start) + 1,
+        .column_end = (bytes_end - line_range.bytes_start) + 1,
     };
 
     if (colors) {
-        ink_ast_node_print_colors(node, &context, line, sizeof(line));
+        ink_ast_node_print_colors(type, &context, line, sizeof(line));
     } else {
-        ink_ast_node_print_nocolors(node, &context, line, sizeof(line));
+        ink_ast_node_print_nocolors(type, &context, line, sizeof(line));
     }
 
     printf("%s%s%s\n", prefix, pointers[0], line);
 }
 
+/**
+ * Collect the children of a node from a list.
+ */
+static void ink_ast_print_list(struct ink_node_buffer *nodes,
+                               struct ink_ast_node_list list)
+{
+    for (size_t i = 0; i < list.count; i++) {
+        ink_node_buffer_push(nodes, list.nodes[i]);
+    }
+}
+
 static void ink_ast_print_walk(const struct ink_ast *tree,
                                const struct ink_line_buffer *lines,
-                               const struct ink_ast_node *node,
-                               const char *prefix, const char **pointers,
-                               bool colors)
+                               uint32_t node, const char *prefix,
+                               const char **pointers, bool colors)
 {
     /**
      * TODO: Have this entire procedure write characters to a stream instead of
@@ -446,13 +458,12 @@ static void ink_ast_print_walk(const struct ink_ast *tree,
      * TODO: `new_prefix` needs bounds checking.
      */
     char new_prefix[1024];
-    struct ink_ast_node *lhs, *mhs, *rhs;
-    struct ink_ast_node_list *list;
+    uint32_t lhs, mhs, rhs;
     struct ink_node_buffer nodes;
 
     ink_node_buffer_init(&nodes);
 
-    switch (node->type) {
+    switch (ink_ast_node_type(tree, node)) {
     case INK_AST_ARG_LIST:
     case INK_AST_BLOCK:
     case INK_AST_CHOICE_STMT:
@@ -460,17 +471,12 @@ static void ink_ast_print_walk(const struct ink_ast *tree,
     case INK_AST_EMPTY_STRING:
     case INK_AST_FILE:
     case INK_AST_PARAM_LIST:
-        list = node->data.many.list;
-        if (list) {
-            for (size_t i = 0; i < list->count; i++) {
-                ink_node_buffer_push(&nodes, list->nodes[i]);
-            }
-        }
+        ink_ast_print_list(&nodes, ink_ast_node_list(tree, node));
         break;
     case INK_AST_CHOICE_EXPR:
-        lhs = node->data.choice_expr.start_expr;
-        mhs = node->data.choice_expr.option_expr;
-        rhs = node->data.choice_expr.inner_expr;
+        lhs = ink_ast_choice_child(tree, node, 0);
+        mhs = ink_ast_choice_child(tree, node, 1);
+        rhs = ink_ast_choice_child(tree, node, 2);
 
         if (lhs) {
             ink_node_buffer_push(&nodes, lhs);
@@ -485,35 +491,18 @@ static void ink_ast_print_walk(const struct ink_ast *tree,
     case INK_AST_IF_STMT:
     case INK_AST_MULTI_IF_STMT:
     case INK_AST_SWITCH_STMT:
-        lhs = node->data.switch_stmt.cond_expr;
-        list = node->data.switch_stmt.cases;
-
-        if (lhs) {
-            ink_node_buffer_push(&nodes, lhs);
-        }
-        if (list) {
-            for (size_t i = 0; i < list->count; i++) {
-                ink_node_buffer_push(&nodes, list->nodes[i]);
-            }
-        }
-
-        break;
     case INK_AST_KNOT_DECL:
-        lhs = node->data.knot_decl.proto;
-        list = node->data.knot_decl.children;
+        lhs = ink_ast_node_lhs(tree, node);
 
         if (lhs) {
             ink_node_buffer_push(&nodes, lhs);
         }
-        if (list) {
-            for (size_t i = 0; i < list->count; i++) {
-                ink_node_buffer_push(&nodes, list->nodes[i]);
-            }
-        }
+
+        ink_ast_print_list(&nodes, ink_ast_node_children(tree, node));
         break;
     default:
-        lhs = node->data.bin.lhs;
-        rhs = node->data.bin.rhs;
+        lhs = ink_ast_node_lhs(tree, node);
+        rhs = ink_ast_node_rhs(tree, node);
 
         if (lhs) {
             ink_node_buffer_push(&nodes, lhs);
@@ -559,107 +548,118 @@ void ink_ast_print(const struct ink_ast *tree, bool colors)
     ink_line_buffer_deinit(&lines);
 }
 
-static struct ink_ast_node *ink_ast_base_new(enum ink_ast_node_type type,
-                                             size_t bytes_start,
-                                             size_t bytes_end,
-                                             struct ink_arena *arena)
+static uint32_t ink_ast_base_new(struct ink_ast *tree,
+                                 enum ink_ast_node_type type,
+                                 size_t bytes_start, size_t bytes_end,
+                                 uint32_t lhs, uint32_t rhs)
 {
-    struct ink_ast_node *const n = ink_arena_allocate(arena, sizeof(*n));
+    const uint32_t node = (uint32_t)tree->types.count;
+    const struct ink_ast_span span = {
+        .bytes_start = (uint32_t)bytes_start,
+        .bytes_end = (uint32_t)bytes_end,
+    };
+    const struct ink_ast_data data = {
+        .lhs = lhs,
+        .rhs = rhs,
+    };
 
-    if (!n) {
-        return n;
+    if (ink_ast_type_vec_push(&tree->types, (uint8_t)type) < 0 ||
+        ink_ast_span_vec_push(&tree->spans, span) < 0 ||
+        ink_ast_data_vec_push(&tree->data, data) < 0) {
+        ink_ast_type_vec_shrink(&tree->types, node);
+        ink_ast_span_vec_shrink(&tree->spans, node);
+        ink_ast_data_vec_shrink(&tree->data, node);
+        return INK_AST_NULL;
     }
+    return node;
+}
 
-    memset(n, 0, sizeof(*n));
-
-    n->type = type;
-    n->bytes_start = bytes_start;
-    n->bytes_end = bytes_end;
-    return n;
+uint32_t ink_ast_leaf_new(struct ink_ast *tree, enum ink_ast_node_type type,
+                          size_t bytes_start, size_t bytes_end)
+{
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, INK_AST_NULL,
+                            INK_AST_NULL);
 }
 
-struct ink_ast_node *ink_ast_leaf_new(enum ink_ast_node_type type,
-                                      size_t bytes_start, size_t bytes_end,
-                                      struct ink_arena *arena)
+uint32_t ink_ast_binary_new(struct ink_ast *tree, enum ink_ast_node_type type,
+                            size_t bytes_start, size_t bytes_end, uint32_t lhs,
+                            uint32_t rhs)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, lhs, rhs);
+}
 
-    assert(n);
-    return n;
+uint32_t ink_ast_many_new(struct ink_ast *tree, enum ink_ast_node_type type,
+                          size_t bytes_start, size_t bytes_end, uint32_t list)
+{
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, list,
+                            INK_AST_NULL);
 }
 
-struct ink_ast_node *ink_ast_binary_new(enum ink_ast_node_type type,
-                                        size_t bytes_start, size_t bytes_end,
-                                        struct ink_ast_node *lhs,
-                                        struct ink_ast_node *rhs,
-                                        struct ink_arena *arena)
+uint32_t ink_ast_choice_expr_new(struct ink_ast *tree,
+                                 enum ink_ast_node_type type,
+                                 size_t bytes_start, size_t bytes_end,
+                                 uint32_t start_expr, uint32_t option_expr,
+                                 uint32_t inner_expr)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
+    const uint32_t extra = (uint32_t)tree->extra.count;
 
-    assert(n);
-    n->data.bin.lhs = lhs;
-    n->data.bin.rhs = rhs;
-    return n;
+    if (ink_ast_extra_vec_push(&tree->extra, start_expr) < 0 ||
+        ink_ast_extra_vec_push(&tree->extra, option_expr) < 0 ||
+        ink_ast_extra_vec_push(&tree->extra, inner_expr) < 0) {
+        ink_ast_extra_vec_shrink(&tree->extra, extra);
+        return INK_AST_NULL;
+    }
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, extra,
+                            INK_AST_NULL);
 }
 
-struct ink_ast_node *ink_ast_many_new(enum ink_ast_node_type type,
-                                      size_t bytes_start, size_t bytes_end,
-                                      struct ink_ast_node_list *list,
-                                      struct ink_arena *arena)
+uint32_t ink_ast_switch_stmt_new(struct ink_ast *tree,
+                                 enum ink_ast_node_type type,
+                                 size_t bytes_start, size_t bytes_end,
+                                 uint32_t cond_expr, uint32_t cases)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
-
-    n->data.many.list = list;
-    return n;
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, cond_expr,
+                            cases);
 }
 
-struct ink_ast_node *ink_ast_choice_expr_new(
-    enum ink_ast_node_type type, size_t bytes_start, size_t bytes_end,
-    struct ink_ast_node *start_expr, struct ink_ast_node *option_expr,
-    struct ink_ast_node *inner_expr, struct ink_arena *arena)
+uint32_t ink_ast_knot_decl_new(struct ink_ast *tree,
+                               enum ink_ast_node_type type, size_t bytes_start,
+                               size_t bytes_end, uint32_t proto,
+                               uint32_t children)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
-
-    assert(n);
-    n->data.choice_expr.start_expr = start_expr;
-    n->data.choice_expr.option_expr = option_expr;
-    n->data.choice_expr.inner_expr = inner_expr;
-    return n;
+    return ink_ast_base_new(tree, type, bytes_start, bytes_end, proto,
+                            children);
 }
 
-struct ink_ast_node *ink_ast_switch_stmt_new(enum ink_ast_node_type type,
-                                             size_t bytes_start,
-                                             size_t bytes_end,
-                                             struct ink_ast_node *cond_expr,
-                                             struct ink_ast_node_list *cases,
-                                             struct ink_arena *arena)
+uint32_t ink_ast_list_new(struct ink_ast *tree, const uint32_t *nodes,
+                          size_t count)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
+    const uint32_t list = (uint32_t)tree->extra.count;
 
-    assert(n);
-    n->data.switch_stmt.cond_expr = cond_expr;
-    n->data.switch_stmt.cases = cases;
-    return n;
+    if (count == 0) {
+        return INK_AST_NULL;
+    }
+    if (ink_ast_extra_vec_push(&tree->extra, (uint32_t)count) < 0) {
+        return INK_AST_NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (ink_ast_extra_vec_push(&tree->extra, nodes[i]) < 0) {
+            ink_ast_extra_vec_shrink(&tree->extra, list);
+            return INK_AST_NULL;
+        }
+    }
+    return list;
 }
 
-struct ink_ast_node *ink_ast_knot_decl_new(enum ink_ast_node_type type,
-                                           size_t bytes_start, size_t bytes_end,
-                                           struct ink_ast_node *proto,
-                                           struct ink_ast_node_list *children,
-                                           struct ink_arena *arena)
+void ink_ast_node_set_type(struct ink_ast *tree, uint32_t node,
+                           enum ink_ast_node_type type)
 {
-    struct ink_ast_node *const n =
-        ink_ast_base_new(type, bytes_start, bytes_end, arena);
+    tree->types.entries[node] = (uint8_t)type;
+}
 
-    assert(n);
-    n->data.knot_decl.proto = proto;
-    n->data.knot_decl.children = children;
-    return n;
+void ink_ast_node_set_rhs(struct ink_ast *tree, uint32_t node, uint32_t rhs)
+{
+    tree->data.entries[node].rhs = rhs;
 }
 
 void ink_ast_init(struct ink_ast *tree, const uint8_t *filename,
@@ -667,17 +667,26 @@ void ink_ast_init(struct ink_ast *tree, const uint8_t *filename,
 {
     tree->filename = filename;
     tree->source_bytes = source_bytes;
-    tree->root = NULL;
+    tree->root = INK_AST_NULL;
+    ink_ast_type_vec_init(&tree->types);
+    ink_ast_span_vec_init(&tree->spans);
+    ink_ast_data_vec_init(&tree->data);
+    ink_ast_extra_vec_init(&tree->extra);
     ink_ast_error_vec_init(&tree->errors);
+
+    /* Reserve the null node and the empty list. */
+    ink_ast_leaf_new(tree, INK_AST_INVALID, 0, 0);
+    ink_ast_extra_vec_push(&tree->extra, 0);
 }
 
 void ink_ast_deinit(struct ink_ast *tree)
 {
-    /**
-     * TODO: Maybe add the arena as a parameter?
-     */
     tree->filename = NULL;
     tree->source_bytes = NULL;
-    tree->root = NULL;
+    tree->root = INK_AST_NULL;
+    ink_ast_type_vec_deinit(&tree->types);
+    ink_ast_span_vec_deinit(&tree->spans);
+    ink_ast_data_vec_deinit(&tree->data);
+    ink_ast_extra_vec_deinit(&tree->extra);
     ink_ast_error_vec_deinit(&tree->errors);
 }
@@ -7,12 +7,10 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "vec.h"
 
-struct ink_arena;
-struct ink_ast_node;
-
 /*
  * TODO: Rename `AST_BLOCK` to `AST_BLOCK_STMT`.
  */
@@ -100,53 +98,59 @@ enum ink_ast_node_type {
 #undef T
 
 /**
- * Fixed-size list of tree nodes.
+ * Index of the null node.
  *
- * NOTE: For nodes with a variable number of children.
+ * Nodes are referenced by their index within the tree. The first slot is
+ * reserved so that a zero index can stand in for a missing node.
  */
-struct ink_ast_node_list {
-    size_t count;
-    struct ink_ast_node *nodes[1];
-};
+#define INK_AST_NULL (0u)
 
 /**
- * Abstract syntax tree node.
+ * Range of source bytes covered by a tree node.
  *
  * Nodes do not directly store tokens, instead opting to reference a range of
  * bytes within the source file.
  */
-struct ink_ast_node {
-    enum ink_ast_node_type type;
-    size_t bytes_start;
-    size_t bytes_end;
-    union {
-        struct {
-            struct ink_ast_node *lhs;
-            struct ink_ast_node *rhs;
-        } bin;
-
-        struct {
-            struct ink_ast_node_list *list;
-        } many;
-
-        struct {
-            struct ink_ast_node *start_expr;
-            struct ink_ast_node *option_expr;
-            struct ink_ast_node *inner_expr;
-        } choice_expr;
-
-        struct {
-            struct ink_ast_node *cond_expr;
-            struct ink_ast_node_list *cases;
-        } switch_stmt;
-
-        struct {
-            struct ink_ast_node *proto;
-            struct ink_ast_node_list *children;
-        } knot_decl;
-    } data;
+struct ink_ast_span {
+    uint32_t bytes_start;
+    uint32_t bytes_end;
+};
+
+/**
+ * Children of a tree node.
+ *
+ * Nodes with two or fewer children store them inline. Otherwise, one of the
+ * fields is an index into the extra data array of the tree:
+ *
+ * - Sequences store a child list in `lhs`.
+ * - Choice expressions store the indices of their start, option and inner
+ *   expressions in `lhs`.
+ * - Conditionals and knot declarations store their condition or prototype
+ *   in `lhs` and a child list in `rhs`.
+ *
+ * A child list is stored as its length followed by the child indices. Index
+ * zero refers to the empty list.
+ */
+struct ink_ast_data {
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+/**
+ * View of a list of tree nodes.
+ *
+ * NOTE: For nodes with a variable number of children.
+ */
+struct ink_ast_node_list {
+    size_t count;
+    const uint32_t *nodes;
 };
 
+INK_VEC_T(ink_ast_type_vec, uint8_t)
+INK_VEC_T(ink_ast_span_vec, struct ink_ast_span)
+INK_VEC_T(ink_ast_data_vec, struct ink_ast_data)
+INK_VEC_T(ink_ast_extra_vec, uint32_t)
+
 enum ink_ast_error_type {
     INK_AST_OK = 0,
     INK_AST_E_PANIC,
@@ -184,63 +188,157 @@ INK_VEC_T(ink_ast_error_vec, struct ink_ast_error)
 struct ink_ast {
     const uint8_t *filename;         /* Source filename. NULL-Terminated. */
     const uint8_t *source_bytes;     /* Source code bytes. NULL-Terminated. */
-    struct ink_ast_node *root;       /* Root node for the tree. */
+    struct ink_ast_type_vec types;   /* Node types. */
+    struct ink_ast_span_vec spans;   /* Node source ranges. */
+    struct ink_ast_data_vec data;    /* Node children. */
+    struct ink_ast_extra_vec extra;  /* Child lists and wide nodes. */
+    uint32_t root;                   /* Root node for the tree. */
     struct ink_ast_error_vec errors; /* Syntax errors. */
 };
 
 /* FIXME: Make private. */
 extern const char *ink_ast_node_type_strz(enum ink_ast_node_type type);
 
+static inline enum ink_ast_node_type
+ink_ast_node_type(const struct ink_ast *tree, uint32_t node)
+{
+    return (enum ink_ast_node_type)tree->types.entries[node];
+}
+
+static inline size_t ink_ast_node_start(const struct ink_ast *tree,
+                                        uint32_t node)
+{
+    return tree->spans.entries[node].bytes_start;
+}
+
+static inline size_t ink_ast_node_end(const struct ink_ast *tree, uint32_t node)
+{
+    return tree->spans.entries[node].bytes_end;
+}
+
+static inline uint32_t ink_ast_node_lhs(const struct ink_ast *tree,
+                                        uint32_t node)
+{
+    return tree->data.entries[node].lhs;
+}
+
+static inline uint32_t ink_ast_node_rhs(const struct ink_ast *tree,
+                                        uint32_t node)
+{
+    return tree->data.entries[node].rhs;
+}
+
+/**
+ * Retrieve a child list by its index within the extra data array.
+ */
+static inline struct ink_ast_node_list
+ink_ast_list(const struct ink_ast *tree, uint32_t list)
+{
+    const struct ink_ast_node_list l = {
+        .count = tree->extra.entries[list],
+        .nodes = &tree->extra.entries[list + 1],
+    };
+
+    return l;
+}
+
+/**
+ * Retrieve the children of a sequence node.
+ */
+static inline struct ink_ast_node_list
+ink_ast_node_list(const struct ink_ast *tree, uint32_t node)
+{
+    return ink_ast_list(tree, ink_ast_node_lhs(tree, node));
+}
+
+/**
+ * Retrieve the cases of a conditional or the children of a knot declaration.
+ */
+static inline struct ink_ast_node_list
+ink_ast_node_children(const struct ink_ast *tree, uint32_t node)
+{
+    return ink_ast_list(tree, ink_ast_node_rhs(tree, node));
+}
+
+/**
+ * Retrieve a child of a choice expression.
+ *
+ * Children are ordered as the start, option and inner expressions.
+ */
+static inline uint32_t ink_ast_choice_child(const struct ink_ast *tree,
+                                            uint32_t node, size_t index)
+{
+    return tree->extra.entries[ink_ast_node_lhs(tree, node) + index];
+}
+
 /**
  * Create an AST node with no children.
  */
-extern struct ink_ast_node *ink_ast_leaf_new(enum ink_ast_node_type type,
-                                             size_t source_start,
-                                             size_t source_end,
-                                             struct ink_arena *arena);
+extern uint32_t ink_ast_leaf_new(struct ink_ast *tree,
+                                 enum ink_ast_node_type type,
+                                 size_t bytes_start, size_t bytes_end);
 
 /**
  * Create an AST node for a binary expression.
  */
-extern struct ink_ast_node *
-ink_ast_binary_new(enum ink_ast_node_type type, size_t bytes_start,
-                   size_t bytes_end, struct ink_ast_node *lhs,
-                   struct ink_ast_node *rhs, struct ink_arena *arena);
+extern uint32_t ink_ast_binary_new(struct ink_ast *tree,
+                                   enum ink_ast_node_type type,
+                                   size_t bytes_start, size_t bytes_end,
+                                   uint32_t lhs, uint32_t rhs);
 
 /**
  * Create an AST node for a compound expression / statement.
  */
-extern struct ink_ast_node *ink_ast_many_new(enum ink_ast_node_type type,
-                                             size_t bytes_start,
-                                             size_t bytes_end,
-                                             struct ink_ast_node_list *list,
-                                             struct ink_arena *arena);
+extern uint32_t ink_ast_many_new(struct ink_ast *tree,
+                                 enum ink_ast_node_type type,
+                                 size_t bytes_start, size_t bytes_end,
+                                 uint32_t list);
 
 /**
  * Create an AST node for a choice expression.
  */
-extern struct ink_ast_node *ink_ast_choice_expr_new(
-    enum ink_ast_node_type type, size_t bytes_start, size_t bytes_end,
-    struct ink_ast_node *start_expr, struct ink_ast_node *option_expr,
-    struct ink_ast_node *inner_expr, struct ink_arena *arena);
+extern uint32_t ink_ast_choice_expr_new(struct ink_ast *tree,
+                                        enum ink_ast_node_type type,
+                                        size_t bytes_start, size_t bytes_end,
+                                        uint32_t start_expr,
+                                        uint32_t option_expr,
+                                        uint32_t inner_expr);
 
 /**
  * Create an AST node for switch statement.
  */
-extern struct ink_ast_node *
-ink_ast_switch_stmt_new(enum ink_ast_node_type type, size_t bytes_start,
-                        size_t bytes_end, struct ink_ast_node *cond_expr,
-                        struct ink_ast_node_list *cases,
-                        struct ink_arena *arena);
+extern uint32_t ink_ast_switch_stmt_new(struct ink_ast *tree,
+                                        enum ink_ast_node_type type,
+                                        size_t bytes_start, size_t bytes_end,
+                                        uint32_t cond_expr, uint32_t cases);
 
 /**
  * Create an AST node for a knot declaration.
  */
-extern struct ink_ast_node *
-ink_ast_knot_decl_new(enum ink_ast_node_type type, size_t bytes_start,
-                      size_t bytes_end, struct ink_ast_node *proto,
-                      struct ink_ast_node_list *children,
-                      struct ink_arena *arena);
+extern uint32_t ink_ast_knot_decl_new(struct ink_ast *tree,
+                                      enum ink_ast_node_type type,
+                                      size_t bytes_start, size_t bytes_end,
+                                      uint32_t proto, uint32_t children);
+
+/**
+ * Store a list of nodes in the extra data array.
+ *
+ * Returns the index of the list, or zero for an empty list.
+ */
+extern uint32_t ink_ast_list_new(struct ink_ast *tree, const uint32_t *nodes,
+                                 size_t count);
+
+/**
+ * Change the type of a node after creation.
+ */
+extern void ink_ast_node_set_type(struct ink_ast *tree, uint32_t node,
+                                  enum ink_ast_node_type type);
+
+/**
+ * Change the right-hand child of a binary node after creation.
+ */
+extern void ink_ast_node_set_rhs(struct ink_ast *tree, uint32_t node,
+                                 uint32_t rhs);
 
 /**
  * Initialize abstract syntax tree.
@@ -13,7 +13,9 @@
 #include "common.h"
 #include "object.h"
 #include "opcode.h"
+#include "story.h"
 #include "symtab.h"
+#include "thread.h"
 #include "vec.h"
 
 /**
@@ -31,10 +33,11 @@
         fprintf(stderr, "TODO(astgen): %s\n", (msg));                          \
     } while (0)
 
-#define INK_ASTGEN_BUG(node)                                                   \
+#define INK_ASTGEN_BUG(tree, node)                                             \
     do {                                                                       \
         fprintf(stderr, "BUG(astgen): %s in %s\n",                             \
-                ink_ast_node_type_strz((node)->type), __func__);               \
+                ink_ast_node_type_strz(ink_ast_node_type((tree), (node))),     \
+                __func__);                                                     \
     } while (0)
 
 /**
@@ -56,7 +59,7 @@ static uint32_t ink_stringset_hasher(const void *bytes, size_t length)
 {
     const struct ink_string_ref *const key = bytes;
 
-    return ink_fnv32a(key->bytes, key->length);
+    return ink_hash_bytes(key->bytes, key->length);
 }
 
 struct ink_astgen_jump {
@@ -70,37 +73,166 @@ struct ink_astgen_label {
 
 INK_VEC_T(ink_astgen_jump_vec, struct ink_astgen_jump)
 INK_VEC_T(ink_astgen_label_vec, struct ink_astgen_label)
-INK_HASHMAP_T(ink_stringset, struct ink_string_ref, size_t)
+INK_VEC_T(ink_astgen_decl_vec, uint32_t)
+INK_HASHMAP_T_EX(ink_stringset, struct ink_string_ref, size_t,
+                 ink_stringset_hasher, ink_stringset_cmp)
+
+/**
+ * Name of a knot, stitch or function scope, relative to its parent scope.
+ */
+struct ink_astgen_name_key {
+    uint32_t parent;
+    uint32_t local;
+};
+
+/**
+ * Key comparison operation for name map entries.
+ */
+static bool ink_astgen_name_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_astgen_name_key *const key_lhs = lhs;
+    const struct ink_astgen_name_key *const key_rhs = rhs;
+
+    return key_lhs->parent == key_rhs->parent &&
+           key_lhs->local == key_rhs->local;
+}
+
+/**
+ * Hasher for name map entries.
+ */
+static uint32_t ink_astgen_name_hasher(const void *bytes, size_t length)
+{
+    const struct ink_astgen_name_key *const key = bytes;
+
+    return (key->parent * 0x01000193u) ^ (key->local * 0x9e3779b1u);
+}
+
+/**
+ * Scope introduced by a knot, stitch or function.
+ *
+ * The qualified name of the scope, such as `knot.stitch`, is built once from
+ * the qualified name of its parent.
+ */
+struct ink_astgen_name {
+    uint32_t parent;
+    uint32_t local;
+    size_t str_index;
+    size_t length;
+    struct ink_object *path_name;
+    struct ink_symbol sym;
+};
+
+INK_VEC_T(ink_astgen_name_vec, struct ink_astgen_name)
+INK_HASHMAP_T_EX(ink_astgen_name_map, struct ink_astgen_name_key, uint32_t,
+                 ink_astgen_name_hasher, ink_astgen_name_cmp)
+
+/**
+ * Hierarchical name table.
+ *
+ * Every scope has an integer ID, with the file scope being zero. Local names
+ * are given integer IDs as well, so that a qualified name can be resolved by
+ * looking up a (parent ID, local name ID) pair.
+ */
+struct ink_astgen_names {
+    struct ink_stringset local_ids;
+    struct ink_astgen_name_map scopes;
+    struct ink_astgen_name_vec entries;
+};
+
+static void ink_astgen_names_init(struct ink_astgen_names *names)
+{
+    const struct ink_astgen_name root = {
+        .parent = 0,
+        .local = 0,
+        .str_index = 0,
+        .length = 0,
+        .path_name = NULL,
+    };
+
+    ink_stringset_init(&names->local_ids, INK_STRINGSET_LOAD_MAX);
+    ink_astgen_name_map_init(&names->scopes, INK_STRINGSET_LOAD_MAX);
+    ink_astgen_name_vec_init(&names->entries);
+    ink_astgen_name_vec_push(&names->entries, root);
+}
+
+static void ink_astgen_names_deinit(struct ink_astgen_names *names)
+{
+    ink_stringset_deinit(&names->local_ids);
+    ink_astgen_name_map_deinit(&names->scopes);
+    ink_astgen_name_vec_deinit(&names->entries);
+}
 
 /**
  * Global state for all Astgen contexts.
+ *
+ * In parallel mode, every worker owns an instance layered over the shared
+ * instance that interned the file's paths. String indices below
+ * `string_base` refer to the shared string bytes. Workers only read the
+ * shared name table.
  */
 struct ink_astgen_global {
     struct ink_ast *tree;
     struct ink_story *story;
+    const struct ink_astgen_global *shared;
+    struct ink_mutex *object_lock;
+    struct ink_ast_error_vec *errors;
     struct ink_content_path *current_path;
     struct ink_symtab_pool symtab_pool;
     struct ink_stringset string_table;
     struct ink_byte_vec string_bytes;
+    struct ink_astgen_names name_table;
+    struct ink_astgen_names *names;
     struct ink_astgen_label_vec labels;
     struct ink_astgen_jump_vec branches;
+    struct ink_object_vec paths;
+    size_t string_base;
+    uint32_t proto_hash;
+    uint32_t unit_hash;
+    int flags;
     jmp_buf jmpbuf;
 };
 
 static void ink_astgen_global_init(struct ink_astgen_global *g,
                                    struct ink_ast *tree,
-                                   struct ink_story *story)
+                                   struct ink_story *story, int flags)
 {
     g->tree = tree;
     g->story = story;
+    g->shared = NULL;
+    g->object_lock = NULL;
+    g->errors = &tree->errors;
     g->current_path = NULL;
+    g->names = &g->name_table;
+    g->string_base = 0;
+    g->proto_hash = 0;
+    g->unit_hash = 0;
+    g->flags = flags;
 
     ink_symtab_pool_init(&g->symtab_pool);
-    ink_stringset_init(&g->string_table, INK_STRINGSET_LOAD_MAX,
-                       ink_stringset_hasher, ink_stringset_cmp);
+    ink_stringset_init(&g->string_table, INK_STRINGSET_LOAD_MAX);
     ink_byte_vec_init(&g->string_bytes);
+    ink_astgen_names_init(&g->name_table);
     ink_astgen_label_vec_init(&g->labels);
     ink_astgen_jump_vec_init(&g->branches);
+    ink_object_vec_init(&g->paths);
+}
+
+/**
+ * Initialize the state of a worker, layered over a shared instance.
+ */
+static void
+ink_astgen_global_init_worker(struct ink_astgen_global *g,
+                              const struct ink_astgen_global *shared,
+                              struct ink_ast_error_vec *errors,
+                              struct ink_mutex *object_lock)
+{
+    ink_astgen_global_init(g, shared->tree, shared->story, shared->flags);
+
+    g->shared = shared;
+    g->object_lock = object_lock;
+    g->errors = errors;
+    g->names = shared->names;
+    g->string_base = shared->string_base + shared->string_bytes.count;
 }
 
 static void ink_astgen_global_deinit(struct ink_astgen_global *g)
@@ -108,8 +240,10 @@ static void ink_astgen_global_deinit(struct ink_astgen_global *g)
     ink_symtab_pool_deinit(&g->symtab_pool);
     ink_stringset_deinit(&g->string_table);
     ink_byte_vec_deinit(&g->string_bytes);
+    ink_astgen_names_deinit(&g->name_table);
     ink_astgen_label_vec_deinit(&g->labels);
     ink_astgen_jump_vec_deinit(&g->branches);
+    ink_object_vec_deinit(&g->paths);
 }
 
 struct ink_astgen {
@@ -119,7 +253,7 @@ struct ink_astgen {
     size_t jumps_top;
     size_t labels_top;
     size_t exit_label;
-    size_t namespace_index;
+    uint32_t scope_id;
 };
 
 static int ink_astgen_make(struct ink_astgen *scope,
@@ -144,7 +278,7 @@ static int ink_astgen_make(struct ink_astgen *scope,
     scope->jumps_top = g->branches.count;
     scope->labels_top = g->labels.count;
     scope->exit_label = parent_scope->exit_label;
-    scope->namespace_index = parent_scope->namespace_index;
+    scope->scope_id = parent_scope->scope_id;
     return INK_E_OK;
 }
 
@@ -163,17 +297,17 @@ static void ink_astgen_fail(struct ink_astgen *astgen, const char *filename,
 }
 
 static void ink_astgen_error(struct ink_astgen *astgen,
-                             enum ink_ast_error_type type,
-                             const struct ink_ast_node *node)
+                             enum ink_ast_error_type type, uint32_t node)
 {
     struct ink_astgen_global *const g = astgen->global;
+    const struct ink_ast *const tree = g->tree;
     const struct ink_ast_error err = {
         .type = type,
-        .source_start = node->bytes_start,
-        .source_end = node->bytes_end,
+        .source_start = ink_ast_node_start(tree, node),
+        .source_end = ink_ast_node_end(tree, node),
     };
 
-    ink_ast_error_vec_push(&g->tree->errors, err);
+    ink_ast_error_vec_push(g->errors, err);
 }
 
 static void ink_astgen_global_panic(struct ink_astgen_global *g)
@@ -187,35 +321,29 @@ static void ink_astgen_global_panic(struct ink_astgen_global *g)
  * The string reference is backed with memory from the source bytes.
  */
 static inline struct ink_string_ref
-ink_string_from_node(const struct ink_astgen *astgen,
-                     const struct ink_ast_node *node)
+ink_string_from_node(const struct ink_astgen *astgen, uint32_t node)
 {
     const struct ink_ast *const tree = astgen->global->tree;
     const struct ink_string_ref ref = {
-        .bytes = &tree->source_bytes[node->bytes_start],
-        .length = node->bytes_end - node->bytes_start,
+        .bytes = &tree->source_bytes[ink_ast_node_start(tree, node)],
+        .length = ink_ast_node_end(tree, node) - ink_ast_node_start(tree, node),
     };
 
     return ref;
 }
 
 /**
- * Retrieve a string reference by index.
- *
- * The string reference is backed with memory from the string table.
+ * Retrieve the bytes of an interned string by index.
  */
-static inline struct ink_string_ref
-ink_string_from_index(const struct ink_astgen *astgen, const size_t index)
+static const uint8_t *ink_astgen_str_bytes(const struct ink_astgen *astgen,
+                                           size_t str_index)
 {
-    struct ink_astgen_global *const g = astgen->global;
-    struct ink_byte_vec *const bv = &g->string_bytes;
-    const uint8_t *const bytes = &bv->entries[index];
-    const struct ink_string_ref ref = {
-        .bytes = bytes,
-        .length = strlen((char *)bytes),
-    };
+    const struct ink_astgen_global *const g = astgen->global;
 
-    return ref;
+    if (str_index < g->string_base) {
+        return &g->shared->string_bytes.entries[str_index];
+    }
+    return &g->string_bytes.entries[str_index - g->string_base];
 }
 
 /**
@@ -223,8 +351,7 @@ ink_string_from_index(const struct ink_astgen *astgen, const size_t index)
  *
  * Will fail if the name already exists or an internal error occurs.
  */
-static int ink_astgen_insert_name(struct ink_astgen *scope,
-                                  const struct ink_ast_node *node,
+static int ink_astgen_insert_name(struct ink_astgen *scope, uint32_t node,
                                   const struct ink_symbol *sym)
 {
     const struct ink_string_ref key = ink_string_from_node(scope, node);
@@ -238,8 +365,7 @@ static int ink_astgen_insert_name(struct ink_astgen *scope,
  * Lookup is performed relative to the current scope. The scope chain is
  * traversed recursively until a match is found or if the lookup fails.
  */
-static int ink_astgen_lookup_name(struct ink_astgen *scope,
-                                  const struct ink_ast_node *node,
+static int ink_astgen_lookup_name(struct ink_astgen *scope, uint32_t node,
                                   struct ink_symbol *sym)
 {
     int rc = INK_E_FAIL;
@@ -256,8 +382,7 @@ static int ink_astgen_lookup_name(struct ink_astgen *scope,
     return rc;
 }
 
-static int ink_astgen_update_name(struct ink_astgen *scope,
-                                  const struct ink_ast_node *node,
+static int ink_astgen_update_name(struct ink_astgen *scope, uint32_t node,
                                   const struct ink_symbol *sym)
 {
     int rc = ink_astgen_insert_name(scope, node, sym);
@@ -269,72 +394,69 @@ static int ink_astgen_update_name(struct ink_astgen *scope,
 }
 
 /**
- * Recursive function to perform a qualified lookup on two nodes.
+ * Retrieve a scope from the name table by ID.
  */
-static int ink_astgen_lookup_expr_r(struct ink_astgen *scope,
-                                    const struct ink_ast_node *lhs,
-                                    const struct ink_ast_node *rhs,
-                                    struct ink_symbol *sym)
-
+static inline struct ink_astgen_name *
+ink_astgen_name_get(const struct ink_astgen *astgen, uint32_t scope_id)
 {
-    int rc = INK_E_FAIL;
-
-    if (!lhs) {
-        return rc;
-    }
-    if (lhs->type == INK_AST_SELECTOR_EXPR) {
-        rc = ink_astgen_lookup_expr_r(scope, lhs->data.bin.lhs,
-                                      lhs->data.bin.rhs, sym);
-        if (rc < 0) {
-            return rc;
-        }
-
-        rc = ink_astgen_lookup_expr_r(scope, lhs->data.bin.rhs, rhs, sym);
-    } else if (lhs->type == INK_AST_IDENTIFIER) {
-        const struct ink_string_ref lhs_key = ink_string_from_node(scope, lhs);
-
-        rc = ink_symtab_lookup(scope->symbol_table, lhs_key, sym);
-        if (rc < 0) {
-            return rc;
-        }
-        if (sym->as.knot.local_names) {
-            const struct ink_string_ref rhs_key =
-                ink_string_from_node(scope, rhs);
-
-            return ink_symtab_lookup(sym->as.knot.local_names, rhs_key, sym);
-        }
-        rc = INK_E_FAIL;
-    }
-    return rc;
+    return &astgen->global->names->entries.entries[scope_id];
 }
 
 /**
  * Perform a qualified lookup for a selector expression node.
  *
- * Lookup is performed relative to the current scope. The scope chain is
- * traversed recursively until a match is found or if the lookup fails.
+ * The leftmost name is resolved relative to the current scope, traversing
+ * the scope chain until a match is found. Each name after it is resolved
+ * within the scope of the name before it.
  */
-static int ink_astgen_lookup_qualified(struct ink_astgen *scope,
-                                       const struct ink_ast_node *node,
+static int ink_astgen_lookup_qualified(struct ink_astgen *scope, uint32_t node,
                                        struct ink_symbol *sym)
 {
+    const struct ink_ast *const tree = scope->global->tree;
+    struct ink_astgen_names *const names = scope->global->names;
     int rc = INK_E_FAIL;
-    struct ink_ast_node *lhs = NULL;
-    struct ink_ast_node *rhs = NULL;
+    size_t local = 0;
+    uint32_t scope_id = 0;
+    const uint32_t lhs = ink_ast_node_lhs(tree, node);
+    const uint32_t rhs = ink_ast_node_rhs(tree, node);
 
-    if (!node) {
+    if (!lhs || !rhs) {
+        return -INK_E_FAIL;
+    }
+    switch (ink_ast_node_type(tree, lhs)) {
+    case INK_AST_SELECTOR_EXPR:
+        rc = ink_astgen_lookup_qualified(scope, lhs, sym);
+        break;
+    case INK_AST_IDENTIFIER:
+        rc = ink_astgen_lookup_name(scope, lhs, sym);
+        break;
+    default:
+        return -INK_E_FAIL;
+    }
+    if (rc < 0) {
         return rc;
     }
-    while (scope) {
-        lhs = node->data.bin.lhs;
-        rhs = node->data.bin.rhs;
-        rc = ink_astgen_lookup_expr_r(scope, lhs, rhs, sym);
-        if (rc < 0) {
-            scope = scope->parent;
-        } else {
-            return rc;
-        }
+    if (sym->type != INK_SYMBOL_KNOT && sym->type != INK_SYMBOL_FUNC) {
+        return -INK_E_FAIL;
+    }
+
+    rc = ink_stringset_lookup(&names->local_ids,
+                              ink_string_from_node(scope, rhs), &local);
+    if (rc < 0) {
+        return rc;
+    }
+
+    const struct ink_astgen_name_key key = {
+        .parent = sym->as.knot.scope_id,
+        .local = (uint32_t)local,
+    };
+
+    rc = ink_astgen_name_map_lookup(&names->scopes, key, &scope_id);
+    if (rc < 0) {
+        return rc;
     }
+
+    *sym = ink_astgen_name_get(scope, scope_id)->sym;
     return rc;
 }
 
@@ -446,7 +568,7 @@ static size_t ink_astgen_add_str(struct ink_astgen *astgen,
         .bytes = chars,
         .length = length,
     };
-    size_t str_index = bv->count;
+    size_t str_index = g->string_base + bv->count;
 
     rc = ink_stringset_lookup(s_tab, key, &str_index);
     if (rc < 0) {
@@ -460,62 +582,135 @@ static size_t ink_astgen_add_str(struct ink_astgen *astgen,
     return str_index;
 }
 
-/* TODO(Brett): Refactor this garbage. */
-static size_t ink_astgen_add_qualified_str_r(struct ink_astgen *astgen,
-                                             struct ink_string_ref *str,
-                                             size_t pos)
+/**
+ * Build the qualified name of a scope from the name of its parent.
+ *
+ * Only called while interning paths, before any workers have started.
+ */
+static size_t ink_astgen_add_qualified_str(struct ink_astgen *parent_scope,
+                                           struct ink_string_ref str,
+                                           size_t *length)
 {
-    struct ink_byte_vec *const bv = &astgen->global->string_bytes;
-
-    if (astgen->parent) {
-        const size_t str_index = astgen->namespace_index;
-        const size_t length = strlen((char *)&bv->entries[str_index]);
+    struct ink_astgen_global *const g = parent_scope->global;
+    struct ink_byte_vec *const bv = &g->string_bytes;
+    const struct ink_astgen_name *const parent =
+        ink_astgen_name_get(parent_scope, parent_scope->scope_id);
+    const size_t parent_index = parent->str_index;
+    const size_t parent_length = parent->length;
+    const size_t pos = bv->count;
 
-        for (size_t i = 0; i < length; i++) {
-            ink_byte_vec_push(bv, bv->entries[str_index + i]);
-        }
+    assert(!g->shared);
 
-        ink_byte_vec_push(bv, '.');
-        return ink_astgen_add_qualified_str_r(astgen->parent, str, pos);
+    if (parent_scope->scope_id == 0) {
+        *length = str.length;
+        return ink_astgen_add_str(parent_scope, str.bytes, str.length);
     }
-    for (size_t i = 0; i < str->length; i++) {
-        ink_byte_vec_push(bv, str->bytes[i]);
+    for (size_t i = 0; i < parent_length; i++) {
+        ink_byte_vec_push(bv, bv->entries[parent_index + i]);
+    }
+
+    ink_byte_vec_push(bv, '.');
+
+    for (size_t i = 0; i < str.length; i++) {
+        ink_byte_vec_push(bv, str.bytes[i]);
     }
 
     ink_byte_vec_push(bv, '\0');
+    *length = parent_length + 1 + str.length;
     return pos;
 }
 
-static size_t ink_astgen_add_qualified_str(struct ink_astgen *astgen,
-                                           struct ink_string_ref *str)
+/*
+ * Runtime objects are linked into the story's object list upon creation,
+ * so workers take turns creating them.
+ */
+static void ink_astgen_lock_objects(struct ink_astgen *astgen)
 {
-    struct ink_byte_vec *const sv = &astgen->global->string_bytes;
-    const size_t pos = sv->count;
+    struct ink_astgen_global *const g = astgen->global;
 
-    ink_astgen_add_qualified_str_r(astgen, str, pos);
-    return pos;
+    if (g->object_lock) {
+        ink_mutex_lock(g->object_lock);
+    }
 }
 
-static void ink_astgen_add_knot(struct ink_astgen *astgen, size_t str_index)
+static void ink_astgen_unlock_objects(struct ink_astgen *astgen)
+{
+    struct ink_astgen_global *const g = astgen->global;
+
+    if (g->object_lock) {
+        ink_mutex_unlock(g->object_lock);
+    }
+}
+
+static struct ink_object *ink_astgen_string_new(struct ink_astgen *astgen,
+                                                const uint8_t *bytes,
+                                                size_t length)
+{
+    struct ink_object *obj = NULL;
+
+    ink_astgen_lock_objects(astgen);
+    obj = ink_string_new(astgen->global->story, bytes, length);
+    ink_astgen_unlock_objects(astgen);
+    return obj;
+}
+
+static struct ink_object *ink_astgen_integer_new(struct ink_astgen *astgen,
+                                                 ink_integer value)
+{
+    struct ink_object *obj = NULL;
+
+    ink_astgen_lock_objects(astgen);
+    obj = ink_integer_new(astgen->global->story, value);
+    ink_astgen_unlock_objects(astgen);
+    return obj;
+}
+
+static struct ink_object *ink_astgen_float_new(struct ink_astgen *astgen,
+                                               ink_float value)
+{
+    struct ink_object *obj = NULL;
+
+    ink_astgen_lock_objects(astgen);
+    obj = ink_float_new(astgen->global->story, value);
+    ink_astgen_unlock_objects(astgen);
+    return obj;
+}
+
+/**
+ * Create a content path and make it the current chunk.
+ *
+ * Workers collect their paths, which are inserted into the story once all
+ * workers have finished.
+ */
+static void ink_astgen_add_knot(struct ink_astgen *astgen,
+                                struct ink_object *path_name)
 {
     struct ink_astgen_global *const g = astgen->global;
-    struct ink_byte_vec *const bv = &g->string_bytes;
-    uint8_t *const str = &bv->entries[str_index];
     struct ink_object *const paths_table = ink_story_get_paths(g->story);
-    struct ink_object *const path_name =
-        ink_string_new(g->story, str, strlen((char *)str));
 
     if (!path_name) {
         return;
     }
 
+    ink_astgen_lock_objects(astgen);
+
     struct ink_object *const path_obj =
         ink_content_path_new(g->story, path_name);
+
+    ink_astgen_unlock_objects(astgen);
+
     if (!path_obj) {
         return;
     }
 
-    ink_table_insert(g->story, paths_table, path_name, path_obj);
+    INK_OBJ_AS_CONTENT_PATH(path_obj)->source_hash = g->unit_hash;
+
+    if (g->shared) {
+        ink_object_vec_push(&g->paths, path_obj);
+    } else {
+        ink_table_insert(g->story, paths_table, path_name, path_obj);
+    }
+
     astgen->global->current_path = INK_OBJ_AS_CONTENT_PATH(path_obj);
 }
 
@@ -564,41 +759,35 @@ static void ink_astgen_backpatch(struct ink_astgen *scope, size_t start_offset,
     ink_astgen_label_vec_shrink(label_vec, 0);
 }
 
-static const uint8_t *ink_astgen_str_bytes(const struct ink_astgen *astgen,
-                                           size_t str_index)
-{
-    struct ink_astgen_global *const g = astgen->global;
-
-    return &g->string_bytes.entries[str_index];
-}
+static void ink_astgen_expr(struct ink_astgen *, uint32_t);
+static void ink_astgen_stmt(struct ink_astgen *, uint32_t);
+static void ink_astgen_content_expr(struct ink_astgen *, uint32_t);
 
-static void ink_astgen_expr(struct ink_astgen *, const struct ink_ast_node *);
-static void ink_astgen_stmt(struct ink_astgen *, const struct ink_ast_node *);
-static void ink_astgen_content_expr(struct ink_astgen *,
-                                    const struct ink_ast_node *);
-
-static void ink_astgen_unary_op(struct ink_astgen *scope,
-                                const struct ink_ast_node *n,
+static void ink_astgen_unary_op(struct ink_astgen *scope, uint32_t n,
                                 enum ink_vm_opcode op)
 {
-    ink_astgen_expr(scope, n->data.bin.lhs);
+    const struct ink_ast *const tree = scope->global->tree;
+
+    ink_astgen_expr(scope, ink_ast_node_lhs(tree, n));
     ink_astgen_emit_byte(scope, (uint8_t)op);
 }
 
-static void ink_astgen_binary_op(struct ink_astgen *scope,
-                                 const struct ink_ast_node *n,
+static void ink_astgen_binary_op(struct ink_astgen *scope, uint32_t n,
                                  enum ink_vm_opcode op)
 {
-    ink_astgen_expr(scope, n->data.bin.lhs);
-    ink_astgen_expr(scope, n->data.bin.rhs);
+    const struct ink_ast *const tree = scope->global->tree;
+
+    ink_astgen_expr(scope, ink_ast_node_lhs(tree, n));
+    ink_astgen_expr(scope, ink_ast_node_rhs(tree, n));
     ink_astgen_emit_byte(scope, (uint8_t)op);
 }
 
-static void ink_astgen_logical_op(struct ink_astgen *scope,
-                                  const struct ink_ast_node *n, bool binary_or)
+static void ink_astgen_logical_op(struct ink_astgen *scope, uint32_t n,
+                                  bool binary_or)
 {
-    struct ink_ast_node *const lhs = n->data.bin.lhs;
-    struct ink_ast_node *const rhs = n->data.bin.rhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, n);
+    const uint32_t rhs = ink_ast_node_rhs(tree, n);
 
     ink_astgen_expr(scope, lhs);
 
@@ -620,15 +809,14 @@ static void ink_astgen_false(struct ink_astgen *scope)
     ink_astgen_emit_byte(scope, INK_OP_FALSE);
 }
 
-static void ink_astgen_integer(struct ink_astgen *scope,
-                               const struct ink_ast_node *expr)
+static void ink_astgen_integer(struct ink_astgen *scope, uint32_t expr)
 {
     /* TODO: Error-handling. */
     const struct ink_string_ref str = ink_string_from_node(scope, expr);
     const size_t str_index = ink_astgen_add_str(scope, str.bytes, str.length);
     const uint8_t *const str_bytes = ink_astgen_str_bytes(scope, str_index);
     const ink_integer v = strtol((char *)str_bytes, NULL, 10);
-    struct ink_object *const obj = ink_integer_new(scope->global->story, v);
+    struct ink_object *const obj = ink_astgen_integer_new(scope, v);
 
     if (!obj) {
         ink_astgen_fail(scope, __FILE__, __LINE__,
@@ -640,15 +828,14 @@ static void ink_astgen_integer(struct ink_astgen *scope,
                           (uint8_t)ink_astgen_add_const(scope, obj));
 }
 
-static void ink_astgen_float(struct ink_astgen *scope,
-                             const struct ink_ast_node *expr)
+static void ink_astgen_float(struct ink_astgen *scope, uint32_t expr)
 {
     /* TODO: Error-handling. */
     const struct ink_string_ref str = ink_string_from_node(scope, expr);
     const size_t str_index = ink_astgen_add_str(scope, str.bytes, str.length);
     const uint8_t *const str_bytes = ink_astgen_str_bytes(scope, str_index);
     const ink_float v = strtod((char *)str_bytes, NULL);
-    struct ink_object *const obj = ink_float_new(scope->global->story, v);
+    struct ink_object *const obj = ink_astgen_float_new(scope, v);
 
     if (!obj) {
         ink_astgen_fail(scope, __FILE__, __LINE__,
@@ -660,13 +847,12 @@ static void ink_astgen_float(struct ink_astgen *scope,
                           (uint8_t)ink_astgen_add_const(scope, obj));
 }
 
-static void ink_astgen_string(struct ink_astgen *scope,
-                              const struct ink_ast_node *expr)
+static void ink_astgen_string(struct ink_astgen *scope, uint32_t expr)
 {
     const struct ink_string_ref str = ink_string_from_node(scope, expr);
     const size_t str_index = ink_astgen_add_str(scope, str.bytes, str.length);
     struct ink_object *const obj =
-        ink_string_new(scope->global->story, str.bytes, str.length);
+        ink_astgen_string_new(scope, str.bytes, str.length);
 
     (void)str_index;
 
@@ -680,16 +866,15 @@ static void ink_astgen_string(struct ink_astgen *scope,
                           (uint8_t)ink_astgen_add_const(scope, obj));
 }
 
-static void ink_astgen_string_expr(struct ink_astgen *scope,
-                                   const struct ink_ast_node *expr)
+static void ink_astgen_string_expr(struct ink_astgen *scope, uint32_t expr)
 {
-    struct ink_ast_node *const lhs = expr->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, expr);
 
     ink_astgen_string(scope, lhs);
 }
 
-static void ink_astgen_identifier(struct ink_astgen *scope,
-                                  const struct ink_ast_node *expr)
+static void ink_astgen_identifier(struct ink_astgen *scope, uint32_t expr)
 {
     struct ink_symbol sym;
 
@@ -713,15 +898,14 @@ static void ink_astgen_identifier(struct ink_astgen *scope,
     }
 }
 
-static int ink_astgen_check_args_count(struct ink_astgen *scope,
-                                       const struct ink_ast_node *node,
-                                       struct ink_ast_node_list *args,
+static int ink_astgen_check_args_count(struct ink_astgen *scope, uint32_t node,
+                                       struct ink_ast_node_list args,
                                        struct ink_symbol *symbol)
 {
     int rc = -1;
     const size_t knot_arity = symbol->as.knot.arity;
 
-    if (!args) {
+    if (!args.count) {
         if (knot_arity != 0) {
             ink_astgen_error(scope, INK_AST_E_TOO_FEW_ARGS, node);
             rc = -1;
@@ -729,8 +913,8 @@ static int ink_astgen_check_args_count(struct ink_astgen *scope,
             rc = 0;
         }
     } else {
-        if (args->count != knot_arity) {
-            if (args->count > knot_arity) {
+        if (args.count != knot_arity) {
+            if (args.count > knot_arity) {
                 ink_astgen_error(scope, INK_AST_E_TOO_MANY_ARGS, node);
             } else {
                 ink_astgen_error(scope, INK_AST_E_TOO_FEW_ARGS, node);
@@ -747,19 +931,18 @@ static int ink_astgen_check_args_count(struct ink_astgen *scope,
  * TODO(Brett): Check for divert params.
  * TODO(Brett): Check for ref params.
  */
-static void ink_astgen_call_expr(struct ink_astgen *scope,
-                                 const struct ink_ast_node *expr,
+static void ink_astgen_call_expr(struct ink_astgen *scope, uint32_t expr,
                                  enum ink_vm_opcode op)
 {
+    const struct ink_ast *const tree = scope->global->tree;
     int rc = INK_E_FAIL;
     struct ink_symbol sym;
-    struct ink_astgen_global *g = scope->global;
-    struct ink_ast_node *const lhs = expr->data.bin.lhs;
-    struct ink_ast_node *const rhs = expr->data.bin.rhs;
+    const uint32_t lhs = ink_ast_node_lhs(tree, expr);
+    const uint32_t rhs = ink_ast_node_rhs(tree, expr);
 
-    if (lhs->type == INK_AST_SELECTOR_EXPR) {
+    if (ink_ast_node_type(tree, lhs) == INK_AST_SELECTOR_EXPR) {
         rc = ink_astgen_lookup_qualified(scope, lhs, &sym);
-    } else if (lhs->type == INK_AST_IDENTIFIER) {
+    } else if (ink_ast_node_type(tree, lhs) == INK_AST_IDENTIFIER) {
         rc = ink_astgen_lookup_name(scope, lhs, &sym);
     } else {
         assert(false);
@@ -769,15 +952,15 @@ static void ink_astgen_call_expr(struct ink_astgen *scope,
         return;
     }
     if (rhs) {
-        struct ink_ast_node_list *const l = rhs->data.many.list;
+        const struct ink_ast_node_list l = ink_ast_node_list(tree, rhs);
 
         rc = ink_astgen_check_args_count(scope, lhs, l, &sym);
         if (rc < 0) {
             return;
         }
-        if (l) {
-            for (size_t i = 0; i < l->count; i++) {
-                struct ink_ast_node *const arg = l->nodes[i];
+        if (l.count) {
+            for (size_t i = 0; i < l.count; i++) {
+                const uint32_t arg = l.nodes[i];
 
                 ink_astgen_expr(scope, arg);
             }
@@ -786,18 +969,19 @@ static void ink_astgen_call_expr(struct ink_astgen *scope,
 
     const struct ink_string_ref str = ink_string_from_node(scope, lhs);
     struct ink_object *const obj =
-        ink_string_new(g->story, str.bytes, str.length);
+        ink_astgen_string_new(scope, str.bytes, str.length);
 
     ink_astgen_emit_const(scope, op, (uint8_t)ink_astgen_add_const(scope, obj));
 }
 
-static void ink_astgen_expr(struct ink_astgen *astgen,
-                            const struct ink_ast_node *node)
+static void ink_astgen_expr(struct ink_astgen *astgen, uint32_t node)
 {
+    const struct ink_ast *const tree = astgen->global->tree;
+
     if (!node) {
         return;
     }
-    switch (node->type) {
+    switch (ink_ast_node_type(tree, node)) {
     case INK_AST_TRUE:
         ink_astgen_true(astgen);
         break;
@@ -873,25 +1057,25 @@ static void ink_astgen_expr(struct ink_astgen *astgen,
         INK_ASTGEN_TODO("ContainsExpr");
         break;
     default:
-        INK_ASTGEN_BUG(node);
+        INK_ASTGEN_BUG(tree, node);
         break;
     }
 }
 
-static void ink_astgen_inline_logic(struct ink_astgen *scope,
-                                    const struct ink_ast_node *expr)
+static void ink_astgen_inline_logic(struct ink_astgen *scope, uint32_t expr)
 {
-    struct ink_ast_node *const lhs = expr->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, expr);
 
     ink_astgen_expr(scope, lhs);
 }
 
 /* TODO(Brett): There may be a bug here regarding fallthrough branches. */
-static void ink_astgen_if_expr(struct ink_astgen *scope,
-                               const struct ink_ast_node *expr)
+static void ink_astgen_if_expr(struct ink_astgen *scope, uint32_t expr)
 {
-    struct ink_ast_node *const cond_expr = expr->data.bin.lhs;
-    struct ink_ast_node *const body_stmt = expr->data.bin.rhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t cond_expr = ink_ast_node_lhs(tree, expr);
+    const uint32_t body_stmt = ink_ast_node_rhs(tree, expr);
 
     ink_astgen_expr(scope, cond_expr);
 
@@ -904,30 +1088,31 @@ static void ink_astgen_if_expr(struct ink_astgen *scope,
 }
 
 static void ink_astgen_block_stmt(struct ink_astgen *parent_scope,
-                                  const struct ink_ast_node *stmt)
+                                  uint32_t stmt)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_astgen scope;
-    struct ink_ast_node_list *l = NULL;
+    struct ink_ast_node_list l = {0, NULL};
 
     if (!stmt) {
         return;
     }
 
-    assert(stmt->type == INK_AST_BLOCK);
+    assert(ink_ast_node_type(tree, stmt) == INK_AST_BLOCK);
 
     ink_astgen_make(&scope, parent_scope, NULL);
-    l = stmt->data.many.list;
+    l = ink_ast_node_list(tree, stmt);
 
-    for (size_t i = 0; i < l->count; i++) {
-        ink_astgen_stmt(&scope, l->nodes[i]);
+    for (size_t i = 0; i < l.count; i++) {
+        ink_astgen_stmt(&scope, l.nodes[i]);
     }
 }
 
 static void ink_astgen_if_stmt(struct ink_astgen *parent_scope,
-                               const struct ink_ast_node *cond_expr,
-                               const struct ink_ast_node *then_stmt,
-                               const struct ink_ast_node *else_stmt)
+                               uint32_t cond_expr, uint32_t then_stmt,
+                               uint32_t else_stmt)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_astgen scope;
     size_t then_br = 0;
     size_t else_br = 0;
@@ -943,53 +1128,55 @@ static void ink_astgen_if_stmt(struct ink_astgen *parent_scope,
     ink_astgen_patch_jump(&scope, then_br);
     ink_astgen_emit_byte(&scope, INK_OP_POP);
 
-    if (else_stmt && else_stmt->type == INK_AST_ELSE_BRANCH) {
-        ink_astgen_block_stmt(&scope, else_stmt->data.bin.rhs);
+    if (else_stmt &&
+        ink_ast_node_type(tree, else_stmt) == INK_AST_ELSE_BRANCH) {
+        ink_astgen_block_stmt(&scope, ink_ast_node_rhs(tree, else_stmt));
     }
 
     ink_astgen_patch_jump(&scope, else_br);
 }
 
 static void ink_astgen_multi_if_block(struct ink_astgen *parent_scope,
-                                      struct ink_ast_node_list *cases)
+                                      struct ink_ast_node_list cases)
 {
-    struct ink_astgen scope;
     struct ink_astgen_global *const g = parent_scope->global;
+    const struct ink_ast *const tree = g->tree;
+    struct ink_astgen scope;
 
     ink_astgen_make(&scope, parent_scope, NULL);
     scope.exit_label = ink_astgen_add_label(&scope);
 
     const size_t label_top = g->labels.count;
 
-    for (size_t i = 0; i < cases->count; i++) {
-        struct ink_ast_node *const br = cases->nodes[i];
-        struct ink_ast_node *lhs = br->data.bin.lhs;
+    for (size_t i = 0; i < cases.count; i++) {
+        const uint32_t br = cases.nodes[i];
+        uint32_t lhs = ink_ast_node_lhs(tree, br);
         const size_t label_index = ink_astgen_add_label(&scope);
 
-        if (br->type == INK_AST_IF_BRANCH) {
+        if (ink_ast_node_type(tree, br) == INK_AST_IF_BRANCH) {
             /* TODO: Probably add some semantic checks for the expression type
              * here. */
-            lhs = br->data.bin.lhs;
+            lhs = ink_ast_node_lhs(tree, br);
 
             ink_astgen_expr(&scope, lhs);
             ink_astgen_add_jump(&scope, label_index,
                                 ink_astgen_emit_jump(&scope, INK_OP_JMP_T));
             ink_astgen_emit_byte(&scope, INK_OP_POP);
-        } else if (br->type == INK_AST_ELSE_BRANCH) {
+        } else if (ink_ast_node_type(tree, br) == INK_AST_ELSE_BRANCH) {
             ink_astgen_add_jump(&scope, label_index,
                                 ink_astgen_emit_jump(&scope, INK_OP_JMP));
         } else {
             assert(false);
         }
     }
-    for (size_t i = 0; i < cases->count; i++) {
-        struct ink_ast_node *const br = cases->nodes[i];
-        struct ink_ast_node *const rhs = br->data.bin.rhs;
+    for (size_t i = 0; i < cases.count; i++) {
+        const uint32_t br = cases.nodes[i];
+        const uint32_t rhs = ink_ast_node_rhs(tree, br);
 
-        if (br->type == INK_AST_IF_BRANCH) {
+        if (ink_ast_node_type(tree, br) == INK_AST_IF_BRANCH) {
             ink_astgen_set_label(&scope, label_top + i);
             ink_astgen_emit_byte(&scope, INK_OP_POP);
-        } else if (br->type == INK_AST_ELSE_BRANCH) {
+        } else if (ink_ast_node_type(tree, br) == INK_AST_ELSE_BRANCH) {
             ink_astgen_set_label(&scope, label_top + i);
         } else {
             assert(false);
@@ -1004,13 +1191,14 @@ static void ink_astgen_multi_if_block(struct ink_astgen *parent_scope,
 }
 
 static void ink_astgen_switch_stmt(struct ink_astgen *parent_scope,
-                                   const struct ink_ast_node *stmt)
+                                   uint32_t stmt)
 {
-    struct ink_astgen scope;
     struct ink_astgen_global *const g = parent_scope->global;
+    const struct ink_ast *const tree = g->tree;
+    struct ink_astgen scope;
     struct ink_content_path *const path = g->current_path;
-    struct ink_ast_node *const cond_expr = stmt->data.switch_stmt.cond_expr;
-    struct ink_ast_node_list *const cases = stmt->data.switch_stmt.cases;
+    const uint32_t cond_expr = ink_ast_node_lhs(tree, stmt);
+    const struct ink_ast_node_list cases = ink_ast_node_children(tree, stmt);
     const size_t stack_slot = path->arity + path->locals_count++;
 
     ink_astgen_make(&scope, parent_scope, NULL);
@@ -1022,15 +1210,15 @@ static void ink_astgen_switch_stmt(struct ink_astgen *parent_scope,
     ink_astgen_emit_const(&scope, INK_OP_STORE, (uint8_t)stack_slot);
     ink_astgen_emit_byte(&scope, INK_OP_POP);
 
-    for (size_t i = 0; i < cases->count; i++) {
-        struct ink_ast_node *const br = cases->nodes[i];
-        struct ink_ast_node *lhs = NULL;
+    for (size_t i = 0; i < cases.count; i++) {
+        const uint32_t br = cases.nodes[i];
+        uint32_t lhs = INK_AST_NULL;
         const size_t label_index = ink_astgen_add_label(&scope);
 
-        if (br->type == INK_AST_SWITCH_CASE) {
-            lhs = br->data.bin.lhs;
+        if (ink_ast_node_type(tree, br) == INK_AST_SWITCH_CASE) {
+            lhs = ink_ast_node_lhs(tree, br);
 
-            switch (lhs->type) {
+            switch (ink_ast_node_type(tree, lhs)) {
             case INK_AST_FLOAT:
             case INK_AST_INTEGER:
             case INK_AST_TRUE:
@@ -1047,21 +1235,21 @@ static void ink_astgen_switch_stmt(struct ink_astgen *parent_scope,
             ink_astgen_add_jump(&scope, label_index,
                                 ink_astgen_emit_jump(&scope, INK_OP_JMP_T));
             ink_astgen_emit_byte(&scope, INK_OP_POP);
-        } else if (br->type == INK_AST_ELSE_BRANCH) {
+        } else if (ink_ast_node_type(tree, br) == INK_AST_ELSE_BRANCH) {
             ink_astgen_add_jump(&scope, label_index,
                                 ink_astgen_emit_jump(&scope, INK_OP_JMP));
         } else {
             assert(false);
         }
     }
-    for (size_t i = 0; i < cases->count; i++) {
-        struct ink_ast_node *const br = cases->nodes[i];
-        struct ink_ast_node *const rhs = br->data.bin.rhs;
+    for (size_t i = 0; i < cases.count; i++) {
+        const uint32_t br = cases.nodes[i];
+        const uint32_t rhs = ink_ast_node_rhs(tree, br);
 
-        if (br->type == INK_AST_SWITCH_CASE) {
+        if (ink_ast_node_type(tree, br) == INK_AST_SWITCH_CASE) {
             ink_astgen_set_label(&scope, label_top + i);
             ink_astgen_emit_byte(&scope, INK_OP_POP);
-        } else if (br->type == INK_AST_ELSE_BRANCH) {
+        } else if (ink_ast_node_type(tree, br) == INK_AST_ELSE_BRANCH) {
             ink_astgen_set_label(&scope, label_top + i);
         } else {
             assert(false);
@@ -1075,27 +1263,27 @@ static void ink_astgen_switch_stmt(struct ink_astgen *parent_scope,
     ink_astgen_set_label(&scope, scope.exit_label);
 }
 
-static void ink_astgen_conditional(struct ink_astgen *scope,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_conditional(struct ink_astgen *scope, uint32_t stmt)
 
 {
+    const struct ink_ast *const tree = scope->global->tree;
     bool has_block = false;
     bool has_else = false;
-    struct ink_ast_node *const expr = stmt->data.switch_stmt.cond_expr;
-    struct ink_ast_node_list *const l = stmt->data.switch_stmt.cases;
+    const uint32_t expr = ink_ast_node_lhs(tree, stmt);
+    const struct ink_ast_node_list l = ink_ast_node_children(tree, stmt);
 
-    if (!l || l->count == 0) {
+    if (!l.count) {
         ink_astgen_error(scope, INK_AST_E_CONDITIONAL_EMPTY, stmt);
         return;
     }
 
-    struct ink_ast_node *const first = l->nodes[0];
-    struct ink_ast_node *const last = l->nodes[l->count - 1];
+    const uint32_t first = l.nodes[0];
+    const uint32_t last = l.nodes[l.count - 1];
 
-    for (size_t i = 0; i < l->count; i++) {
-        struct ink_ast_node *const child = l->nodes[i];
+    for (size_t i = 0; i < l.count; i++) {
+        const uint32_t child = l.nodes[i];
 
-        switch (child->type) {
+        switch (ink_ast_node_type(tree, child)) {
         case INK_AST_BLOCK:
             has_block = true;
             break;
@@ -1120,17 +1308,18 @@ static void ink_astgen_conditional(struct ink_astgen *scope,
             has_else = true;
             break;
         default:
-            INK_ASTGEN_BUG(child);
+            INK_ASTGEN_BUG(tree, child);
             break;
         }
     }
-    switch (stmt->type) {
+    switch (ink_ast_node_type(tree, stmt)) {
     case INK_AST_IF_STMT:
         if (!expr) {
             ink_astgen_error(scope, INK_AST_E_EXPECTED_EXPR, stmt);
             return;
         }
-        ink_astgen_if_stmt(scope, expr, first, first == last ? NULL : last);
+        ink_astgen_if_stmt(scope, expr, first,
+                           first == last ? INK_AST_NULL : last);
         break;
     case INK_AST_MULTI_IF_STMT:
         ink_astgen_multi_if_block(scope, l);
@@ -1143,19 +1332,19 @@ static void ink_astgen_conditional(struct ink_astgen *scope,
     }
 }
 
-static void ink_astgen_content_expr(struct ink_astgen *astgen,
-                                    const struct ink_ast_node *node)
+static void ink_astgen_content_expr(struct ink_astgen *astgen, uint32_t node)
 {
-    struct ink_ast_node_list *const l = node->data.many.list;
-    struct ink_ast_node *expr = NULL;
+    const struct ink_ast *const tree = astgen->global->tree;
+    const struct ink_ast_node_list l = ink_ast_node_list(tree, node);
+    uint32_t expr = INK_AST_NULL;
 
-    if (!l) {
+    if (!l.count) {
         return;
     }
-    for (size_t i = 0; i < l->count; i++) {
-        expr = l->nodes[i];
+    for (size_t i = 0; i < l.count; i++) {
+        expr = l.nodes[i];
 
-        switch (expr->type) {
+        switch (ink_ast_node_type(tree, expr)) {
         case INK_AST_STRING:
             ink_astgen_string(astgen, expr);
             ink_astgen_emit_byte(astgen, INK_OP_CONTENT);
@@ -1177,28 +1366,28 @@ static void ink_astgen_content_expr(struct ink_astgen *astgen,
             ink_astgen_emit_byte(astgen, INK_OP_GLUE);
             break;
         default:
-            INK_ASTGEN_BUG(expr);
+            INK_ASTGEN_BUG(tree, expr);
             break;
         }
     }
-    if (!expr || expr->type == INK_AST_STRING) {
+    if (!expr || ink_ast_node_type(tree, expr) == INK_AST_STRING) {
         ink_astgen_emit_byte(astgen, INK_OP_LINE);
     }
 }
 
-static void ink_astgen_var_decl(struct ink_astgen *scope,
-                                const struct ink_ast_node *decl)
+static void ink_astgen_var_decl(struct ink_astgen *scope, uint32_t decl)
 {
     struct ink_astgen_global *const g = scope->global;
+    const struct ink_ast *const tree = g->tree;
     struct ink_content_path *const path = g->current_path;
-    struct ink_ast_node *const lhs = decl->data.bin.lhs;
-    struct ink_ast_node *const rhs = decl->data.bin.rhs;
+    const uint32_t lhs = ink_ast_node_lhs(tree, decl);
+    const uint32_t rhs = ink_ast_node_rhs(tree, decl);
     const struct ink_string_ref str = ink_string_from_node(scope, lhs);
     const size_t str_index = ink_astgen_add_str(scope, str.bytes, str.length);
 
     ink_astgen_expr(scope, rhs);
 
-    if (lhs->type == INK_AST_TEMP_DECL) {
+    if (ink_ast_node_type(tree, lhs) == INK_AST_TEMP_DECL) {
         const size_t stack_slot = path->arity + path->locals_count++;
         const struct ink_symbol sym = {
             .type = INK_SYMBOL_VAR_LOCAL,
@@ -1215,12 +1404,13 @@ static void ink_astgen_var_decl(struct ink_astgen *scope,
         ink_astgen_emit_const(scope, INK_OP_STORE, (uint8_t)stack_slot);
     } else {
         struct ink_object *const name_obj =
-            ink_string_new(g->story, str.bytes, str.length);
+            ink_astgen_string_new(scope, str.bytes, str.length);
         const size_t const_index = ink_astgen_add_const(scope, name_obj);
         const struct ink_symbol sym = {
             .type = INK_SYMBOL_VAR_GLOBAL,
             .node = decl,
-            .as.var.is_const = decl->type == INK_AST_CONST_DECL,
+            .as.var.is_const =
+                ink_ast_node_type(tree, decl) == INK_AST_CONST_DECL,
             .as.var.const_slot = const_index,
             .as.var.str_index = str_index,
         };
@@ -1236,17 +1426,17 @@ static void ink_astgen_var_decl(struct ink_astgen *scope,
     ink_astgen_emit_byte(scope, INK_OP_POP);
 }
 
-static void ink_astgen_divert_expr(struct ink_astgen *scope,
-                                   const struct ink_ast_node *expr)
+static void ink_astgen_divert_expr(struct ink_astgen *scope, uint32_t expr)
 {
+    const struct ink_ast *const tree = scope->global->tree;
     struct ink_symbol sym;
     struct ink_string_ref str;
     struct ink_object *obj = NULL;
-    struct ink_ast_node *lhs = expr->data.bin.lhs;
+    uint32_t lhs = ink_ast_node_lhs(tree, expr);
 
-    assert(lhs != NULL);
+    assert(lhs != INK_AST_NULL);
 
-    switch (lhs->type) {
+    switch (ink_ast_node_type(tree, lhs)) {
     case INK_AST_SELECTOR_EXPR:
         if (ink_astgen_lookup_qualified(scope, lhs, &sym) < 0) {
             ink_astgen_error(scope, INK_AST_E_UNKNOWN_IDENTIFIER, lhs);
@@ -1282,48 +1472,47 @@ static void ink_astgen_divert_expr(struct ink_astgen *scope,
         return;
     }
     default:
-        INK_ASTGEN_BUG(lhs);
+        INK_ASTGEN_BUG(tree, lhs);
         return;
     }
 
-    str = ink_string_from_index(scope, sym.as.knot.str_index);
-    obj = ink_string_new(scope->global->story, str.bytes, str.length);
+    obj = ink_astgen_name_get(scope, sym.as.knot.scope_id)->path_name;
     ink_astgen_emit_const(scope, INK_OP_DIVERT,
                           (uint8_t)ink_astgen_add_const(scope, obj));
 }
 
-static void ink_astgen_content_stmt(struct ink_astgen *scope,
-                                    const struct ink_ast_node *stmt)
+static void ink_astgen_content_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
 
     ink_astgen_content_expr(scope, lhs);
 }
 
-static void ink_astgen_divert_stmt(struct ink_astgen *scope,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_divert_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
 
     ink_astgen_divert_expr(scope, lhs);
 }
 
-static void ink_astgen_expr_stmt(struct ink_astgen *scope,
-                                 const struct ink_ast_node *stmt)
+static void ink_astgen_expr_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
 
     ink_astgen_expr(scope, lhs);
     ink_astgen_emit_byte(scope, INK_OP_POP);
 }
 
-static void ink_astgen_assign_stmt(struct ink_astgen *scope,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_assign_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
+    const struct ink_ast *const tree = scope->global->tree;
     int rc = INK_E_FAIL;
     struct ink_symbol sym;
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
-    struct ink_ast_node *const rhs = stmt->data.bin.rhs;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
+    const uint32_t rhs = ink_ast_node_rhs(tree, stmt);
 
     rc = ink_astgen_lookup_name(scope, lhs, &sym);
     if (rc < 0) {
@@ -1355,10 +1544,10 @@ static void ink_astgen_assign_stmt(struct ink_astgen *scope,
     }
 }
 
-static void ink_astgen_return_stmt(struct ink_astgen *scope,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_return_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
+    const struct ink_ast *const tree = scope->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
 
     ink_astgen_expr(scope, lhs);
     ink_astgen_emit_byte(scope, INK_OP_RET);
@@ -1370,38 +1559,38 @@ struct ink_astgen_choice {
     struct ink_object *id;
 };
 
-static void ink_astgen_choice_stmt(struct ink_astgen *scope,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_choice_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
+    const struct ink_ast *const tree = scope->global->tree;
     struct ink_astgen_choice *data = NULL;
-    struct ink_ast_node_list *l = stmt->data.many.list;
+    const struct ink_ast_node_list l = ink_ast_node_list(tree, stmt);
 
-    assert(l != NULL);
+    assert(l.count != 0);
 
     /* FIXME: This leaks on panic. */
-    data = ink_malloc(l->count * sizeof(*data));
+    data = ink_malloc(l.count * sizeof(*data));
     if (!data) {
         return;
     }
 
     ink_astgen_emit_byte(scope, INK_OP_FLUSH);
 
-    for (size_t i = 0; i < l->count; i++) {
+    for (size_t i = 0; i < l.count; i++) {
         struct ink_astgen_choice *choice = &data[i];
-        struct ink_ast_node *br_stmt = l->nodes[i];
+        uint32_t br_stmt = l.nodes[i];
 
-        assert(br_stmt->type == INK_AST_CHOICE_STAR_STMT ||
-               br_stmt->type == INK_AST_CHOICE_PLUS_STMT);
+        assert(ink_ast_node_type(tree, br_stmt) == INK_AST_CHOICE_STAR_STMT ||
+               ink_ast_node_type(tree, br_stmt) == INK_AST_CHOICE_PLUS_STMT);
 
-        choice->id = ink_integer_new(scope->global->story, (ink_integer)i);
+        choice->id = ink_astgen_integer_new(scope, (ink_integer)i);
         if (!choice->id) {
             /* TODO: Probably panic and report an error here. */
             return;
         }
 
-        struct ink_ast_node *br_expr = br_stmt->data.bin.lhs;
-        struct ink_ast_node *lhs = br_expr->data.choice_expr.start_expr;
-        struct ink_ast_node *rhs = br_expr->data.choice_expr.option_expr;
+        uint32_t br_expr = ink_ast_node_lhs(tree, br_stmt);
+        uint32_t lhs = ink_ast_choice_child(tree, br_expr, 0);
+        uint32_t rhs = ink_ast_choice_child(tree, br_expr, 1);
 
         if (lhs) {
             ink_astgen_string(scope, lhs);
@@ -1419,7 +1608,7 @@ static void ink_astgen_choice_stmt(struct ink_astgen *scope,
 
     ink_astgen_emit_byte(scope, INK_OP_FLUSH);
 
-    for (size_t i = 0; i < l->count; i++) {
+    for (size_t i = 0; i < l.count; i++) {
         struct ink_astgen_choice *choice = &data[i];
 
         ink_astgen_emit_byte(scope, INK_OP_LOAD_CHOICE_ID);
@@ -1432,13 +1621,13 @@ static void ink_astgen_choice_stmt(struct ink_astgen *scope,
     /* TODO: Could possibly trap here instead. */
     ink_astgen_emit_byte(scope, INK_OP_EXIT);
 
-    for (size_t i = 0; i < l->count; i++) {
+    for (size_t i = 0; i < l.count; i++) {
         struct ink_astgen_choice *choice = &data[i];
-        struct ink_ast_node *br_stmt = l->nodes[i];
-        struct ink_ast_node *br_expr = br_stmt->data.bin.lhs;
-        struct ink_ast_node *br_body = br_stmt->data.bin.rhs;
-        struct ink_ast_node *lhs = br_expr->data.choice_expr.start_expr;
-        struct ink_ast_node *rhs = br_expr->data.choice_expr.inner_expr;
+        uint32_t br_stmt = l.nodes[i];
+        uint32_t br_expr = ink_ast_node_lhs(tree, br_stmt);
+        uint32_t br_body = ink_ast_node_rhs(tree, br_stmt);
+        uint32_t lhs = ink_ast_choice_child(tree, br_expr, 0);
+        uint32_t rhs = ink_ast_choice_child(tree, br_expr, 2);
 
         ink_astgen_patch_jump(scope, choice->label);
         ink_astgen_emit_byte(scope, INK_OP_POP);
@@ -1459,10 +1648,10 @@ static void ink_astgen_choice_stmt(struct ink_astgen *scope,
     ink_free(data);
 }
 
-static void ink_astgen_gather_stmt(struct ink_astgen *astgen,
-                                   const struct ink_ast_node *stmt)
+static void ink_astgen_gather_stmt(struct ink_astgen *astgen, uint32_t stmt)
 {
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
+    const struct ink_ast *const tree = astgen->global->tree;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
 
     if (lhs) {
         ink_astgen_stmt(astgen, lhs);
@@ -1470,11 +1659,12 @@ static void ink_astgen_gather_stmt(struct ink_astgen *astgen,
 }
 
 static void ink_astgen_gathered_stmt(struct ink_astgen *parent_scope,
-                                     const struct ink_ast_node *stmt)
+                                     uint32_t stmt)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_astgen scope;
-    struct ink_ast_node *const lhs = stmt->data.bin.lhs;
-    struct ink_ast_node *const rhs = stmt->data.bin.rhs;
+    const uint32_t lhs = ink_ast_node_lhs(tree, stmt);
+    const uint32_t rhs = ink_ast_node_rhs(tree, stmt);
 
     ink_astgen_make(&scope, parent_scope, NULL);
     scope.exit_label = ink_astgen_add_label(&scope);
@@ -1484,11 +1674,12 @@ static void ink_astgen_gathered_stmt(struct ink_astgen *parent_scope,
     ink_astgen_gather_stmt(&scope, rhs);
 }
 
-static void ink_astgen_stmt(struct ink_astgen *scope,
-                            const struct ink_ast_node *stmt)
+static void ink_astgen_stmt(struct ink_astgen *scope, uint32_t stmt)
 {
+    const struct ink_ast *const tree = scope->global->tree;
+
     assert(stmt);
-    switch (stmt->type) {
+    switch (ink_ast_node_type(tree, stmt)) {
     case INK_AST_VAR_DECL:
     case INK_AST_CONST_DECL:
     case INK_AST_TEMP_DECL:
@@ -1519,29 +1710,30 @@ static void ink_astgen_stmt(struct ink_astgen *scope,
         ink_astgen_gather_stmt(scope, stmt);
         break;
     default:
-        INK_ASTGEN_BUG(stmt);
+        INK_ASTGEN_BUG(tree, stmt);
         break;
     }
 }
 
 static void ink_astgen_knot_proto(struct ink_astgen *parent_scope,
-                                  const struct ink_ast_node *proto,
-                                  const struct ink_symbol *sym)
+                                  uint32_t proto, const struct ink_symbol *sym)
 {
+    struct ink_astgen_global *const g = parent_scope->global;
+    const struct ink_ast *const tree = g->tree;
     int rc = INK_E_FAIL;
     struct ink_symbol param_sym;
-    struct ink_astgen_global *const g = parent_scope->global;
-    struct ink_ast_node *const rhs = proto->data.bin.rhs;
-    const size_t str_index = sym->as.knot.str_index;
+    const uint32_t rhs = ink_ast_node_rhs(tree, proto);
+    const struct ink_astgen_name *const name =
+        ink_astgen_name_get(parent_scope, sym->as.knot.scope_id);
 
-    ink_astgen_add_knot(parent_scope, str_index);
+    ink_astgen_add_knot(parent_scope, name->path_name);
 
     if (rhs) {
-        struct ink_ast_node_list *const args = rhs->data.many.list;
+        const struct ink_ast_node_list args = ink_ast_node_list(tree, rhs);
 
-        if (args) {
-            for (size_t i = 0; i < args->count; i++) {
-                struct ink_ast_node *const param = args->nodes[i];
+        if (args.count) {
+            for (size_t i = 0; i < args.count; i++) {
+                const uint32_t param = args.nodes[i];
 
                 rc = ink_astgen_lookup_name(parent_scope, param, &param_sym);
                 if (rc < 0) {
@@ -1554,16 +1746,16 @@ static void ink_astgen_knot_proto(struct ink_astgen *parent_scope,
     }
 }
 
-static void ink_astgen_func_decl(struct ink_astgen *parent_scope,
-                                 const struct ink_ast_node *decl)
+static void ink_astgen_func_decl(struct ink_astgen *parent_scope, uint32_t decl)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_symbol sym;
     struct ink_astgen scope;
-    struct ink_ast_node *const proto = decl->data.bin.lhs;
-    struct ink_ast_node *const body = decl->data.bin.rhs;
-    struct ink_ast_node *const name = proto->data.bin.lhs;
+    const uint32_t proto = ink_ast_node_lhs(tree, decl);
+    const uint32_t body = ink_ast_node_rhs(tree, decl);
+    const uint32_t name = ink_ast_node_lhs(tree, proto);
 
-    assert(name != NULL);
+    assert(name != INK_AST_NULL);
 
     if (ink_astgen_lookup_name(parent_scope, name, &sym) < 0) {
         ink_astgen_error(parent_scope, INK_AST_E_UNKNOWN_IDENTIFIER, name);
@@ -1580,15 +1772,16 @@ static void ink_astgen_func_decl(struct ink_astgen *parent_scope,
 }
 
 static void ink_astgen_stitch_decl(struct ink_astgen *parent_scope,
-                                   const struct ink_ast_node *decl)
+                                   uint32_t decl)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_symbol sym;
     struct ink_astgen scope;
-    struct ink_ast_node *const proto = decl->data.bin.lhs;
-    struct ink_ast_node *const body = decl->data.bin.rhs;
-    struct ink_ast_node *const name = proto->data.bin.lhs;
+    const uint32_t proto = ink_ast_node_lhs(tree, decl);
+    const uint32_t body = ink_ast_node_rhs(tree, decl);
+    const uint32_t name = ink_ast_node_lhs(tree, proto);
 
-    assert(name != NULL);
+    assert(name != INK_AST_NULL);
 
     if (ink_astgen_lookup_name(parent_scope, name, &sym) < 0) {
         ink_astgen_error(parent_scope, INK_AST_E_UNKNOWN_IDENTIFIER, name);
@@ -1604,15 +1797,15 @@ static void ink_astgen_stitch_decl(struct ink_astgen *parent_scope,
     ink_astgen_backpatch(&scope, scope.jumps_top, scope.global->branches.count);
 }
 
-static void ink_astgen_knot_decl(struct ink_astgen *parent_scope,
-                                 const struct ink_ast_node *decl)
+static void ink_astgen_knot_decl(struct ink_astgen *parent_scope, uint32_t decl)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     size_t i = 0;
     struct ink_symbol sym;
     struct ink_astgen scope;
-    struct ink_ast_node *const proto = decl->data.knot_decl.proto;
-    struct ink_ast_node_list *const l = decl->data.knot_decl.children;
-    struct ink_ast_node *const name = proto->data.bin.lhs;
+    const uint32_t proto = ink_ast_node_lhs(tree, decl);
+    const struct ink_ast_node_list l = ink_ast_node_children(tree, decl);
+    const uint32_t name = ink_ast_node_lhs(tree, proto);
 
     if (ink_astgen_lookup_name(parent_scope, name, &sym) < 0) {
         ink_astgen_error(parent_scope, INK_AST_E_UNKNOWN_IDENTIFIER, name);
@@ -1623,15 +1816,15 @@ static void ink_astgen_knot_decl(struct ink_astgen *parent_scope,
     scope.exit_label = ink_astgen_add_label(&scope);
     ink_astgen_knot_proto(&scope, proto, &sym);
 
-    if (!l) {
+    if (!l.count) {
         ink_astgen_set_label(&scope, scope.exit_label);
         ink_astgen_emit_byte(&scope, INK_OP_EXIT);
         return;
     }
 
-    struct ink_ast_node *const first = l->nodes[0];
+    const uint32_t first = l.nodes[0];
 
-    if (first->type == INK_AST_BLOCK) {
+    if (ink_ast_node_type(tree, first) == INK_AST_BLOCK) {
         ink_astgen_block_stmt(&scope, first);
         i++;
     }
@@ -1640,56 +1833,111 @@ static void ink_astgen_knot_decl(struct ink_astgen *parent_scope,
     ink_astgen_emit_byte(&scope, INK_OP_EXIT);
     ink_astgen_backpatch(&scope, scope.jumps_top, scope.global->branches.count);
 
-    for (; i < l->count; i++) {
-        struct ink_ast_node *const child = l->nodes[i];
+    for (; i < l.count; i++) {
+        const uint32_t child = l.nodes[i];
 
-        assert(child && child->type == INK_AST_STITCH_DECL);
+        assert(child && ink_ast_node_type(tree, child) == INK_AST_STITCH_DECL);
         ink_astgen_stitch_decl(&scope, child);
     }
 }
 
 static void ink_astgen_default_body(struct ink_astgen *parent_scope,
-                                    const struct ink_ast_node *body)
+                                    uint32_t body)
 {
     const uint8_t *const b = (uint8_t *)INK_DEFAULT_PATH;
     const size_t bl = strlen(INK_DEFAULT_PATH);
-    const size_t i = ink_astgen_add_str(parent_scope, b, bl);
 
     parent_scope->exit_label = ink_astgen_add_label(parent_scope);
 
-    ink_astgen_add_knot(parent_scope, i);
+    ink_astgen_add_knot(parent_scope,
+                        ink_astgen_string_new(parent_scope, b, bl));
     ink_astgen_block_stmt(parent_scope, body);
     ink_astgen_set_label(parent_scope, parent_scope->exit_label);
     ink_astgen_emit_byte(parent_scope, INK_OP_EXIT);
 }
 
+/**
+ * Combine two hash values.
+ */
+static inline uint32_t ink_astgen_hash_fold(uint32_t hash, uint32_t value)
+{
+    return (hash ^ value) * 0x01000193u;
+}
+
+/**
+ * Hash the source text of a node.
+ */
+static uint32_t ink_astgen_hash_node(const struct ink_astgen *astgen,
+                                     uint32_t node)
+{
+    const struct ink_ast *const tree = astgen->global->tree;
+    const struct ink_string_ref str = ink_string_from_node(astgen, node);
+
+    return ink_astgen_hash_fold((uint32_t)ink_ast_node_type(tree, node),
+                                ink_hash_bytes(str.bytes, str.length));
+}
+
 static int ink_astgen_record_proto(struct ink_astgen *parent_scope,
-                                   const struct ink_ast_node *proto,
+                                   uint32_t proto,
                                    struct ink_astgen *child_scope)
 {
-    int rc = INK_E_FAIL;
     struct ink_astgen_global *const g = parent_scope->global;
+    const struct ink_ast *const tree = g->tree;
+    int rc = INK_E_FAIL;
     struct ink_symtab_pool *const st_pool = &g->symtab_pool;
-    struct ink_ast_node *const lhs = proto->data.bin.lhs;
-    struct ink_ast_node *const rhs = proto->data.bin.rhs;
-    struct ink_string_ref knot_str = ink_string_from_node(parent_scope, lhs);
+    struct ink_astgen_names *const names = g->names;
+    const uint32_t lhs = ink_ast_node_lhs(tree, proto);
+    const uint32_t rhs = ink_ast_node_rhs(tree, proto);
+    const struct ink_string_ref knot_str =
+        ink_string_from_node(parent_scope, lhs);
     struct ink_symtab *const local_symtab = ink_symtab_make(st_pool);
+    size_t local = names->local_ids.count;
+    struct ink_astgen_name name = {
+        .parent = parent_scope->scope_id,
+    };
 
     if (!local_symtab) {
         return rc;
     }
+    if (ink_stringset_lookup(&names->local_ids, knot_str, &local) < 0) {
+        ink_stringset_insert(&names->local_ids, knot_str, local);
+    }
 
     ink_astgen_make(child_scope, parent_scope, local_symtab);
 
-    child_scope->namespace_index =
-        ink_astgen_add_qualified_str(parent_scope, &knot_str);
+    name.local = (uint32_t)local;
+    name.str_index =
+        ink_astgen_add_qualified_str(parent_scope, knot_str, &name.length);
+    name.path_name = ink_astgen_string_new(
+        parent_scope, ink_astgen_str_bytes(parent_scope, name.str_index),
+        name.length);
+    child_scope->scope_id = (uint32_t)names->entries.count;
+    ink_astgen_name_vec_push(&names->entries, name);
+
+    const struct ink_string_ref qualified_str = {
+        .bytes = ink_astgen_str_bytes(parent_scope, name.str_index),
+        .length = name.length,
+    };
+    const struct ink_string_ref proto_str =
+        ink_string_from_node(parent_scope, proto);
+
+    g->proto_hash = ink_astgen_hash_fold(
+        g->proto_hash,
+        ink_hash_bytes(qualified_str.bytes, qualified_str.length));
+    g->proto_hash = ink_astgen_hash_fold(
+        g->proto_hash, ink_hash_bytes(proto_str.bytes, proto_str.length));
 
     struct ink_symbol proto_sym = {
-        .type = proto->type == INK_AST_FUNC_PROTO ? INK_SYMBOL_FUNC
-                                                  : INK_SYMBOL_KNOT,
+        .type = ink_ast_node_type(tree, proto) == INK_AST_FUNC_PROTO
+                    ? INK_SYMBOL_FUNC
+                    : INK_SYMBOL_KNOT,
         .node = proto,
         .as.knot.local_names = local_symtab,
-        .as.knot.str_index = child_scope->namespace_index,
+        .as.knot.scope_id = child_scope->scope_id,
+    };
+    const struct ink_astgen_name_key key = {
+        .parent = name.parent,
+        .local = name.local,
     };
 
     rc = ink_astgen_insert_name(parent_scope, lhs, &proto_sym);
@@ -1697,12 +1945,15 @@ static int ink_astgen_record_proto(struct ink_astgen *parent_scope,
         ink_astgen_error(parent_scope, INK_AST_E_REDEFINED_IDENTIFIER, lhs);
         return rc;
     }
+
+    ink_astgen_name_map_insert(&names->scopes, key, child_scope->scope_id);
+    ink_astgen_name_get(parent_scope, child_scope->scope_id)->sym = proto_sym;
     if (rhs) {
-        struct ink_ast_node_list *const args = rhs->data.many.list;
+        const struct ink_ast_node_list args = ink_ast_node_list(tree, rhs);
 
-        if (args) {
-            for (size_t i = 0; i < args->count; i++) {
-                struct ink_ast_node *const param = args->nodes[i];
+        if (args.count) {
+            for (size_t i = 0; i < args.count; i++) {
+                const uint32_t param = args.nodes[i];
                 struct ink_string_ref param_str =
                     ink_string_from_node(child_scope, param);
                 struct ink_symbol param_sym = {
@@ -1721,13 +1972,16 @@ static int ink_astgen_record_proto(struct ink_astgen *parent_scope,
                 }
             }
 
-            proto_sym.as.knot.arity = args->count;
+            proto_sym.as.knot.arity = args.count;
         }
 
         rc = ink_astgen_update_name(parent_scope, lhs, &proto_sym);
         if (rc < 0) {
             return rc;
         }
+
+        ink_astgen_name_get(parent_scope, child_scope->scope_id)->sym =
+            proto_sym;
     }
     return rc;
 }
@@ -1736,10 +1990,11 @@ static int ink_astgen_record_proto(struct ink_astgen *parent_scope,
  * Collect information for a stitch prototype.
  */
 static int ink_astgen_intern_stitch(struct ink_astgen *parent_scope,
-                                    const struct ink_ast_node *decl)
+                                    uint32_t decl)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     struct ink_astgen stitch_scope;
-    struct ink_ast_node *const proto = decl->data.bin.lhs;
+    const uint32_t proto = ink_ast_node_lhs(tree, decl);
 
     return ink_astgen_record_proto(parent_scope, proto, &stitch_scope);
 }
@@ -1748,24 +2003,25 @@ static int ink_astgen_intern_stitch(struct ink_astgen *parent_scope,
  * Collect information for a knot prototype.
  */
 static int ink_astgen_intern_knot(struct ink_astgen *parent_scope,
-                                  const struct ink_ast_node *decl)
+                                  uint32_t decl)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     int rc;
     struct ink_astgen knot_scope;
-    struct ink_ast_node *const proto = decl->data.knot_decl.proto;
-    struct ink_ast_node_list *const l = decl->data.knot_decl.children;
+    const uint32_t proto = ink_ast_node_lhs(tree, decl);
+    const struct ink_ast_node_list l = ink_ast_node_children(tree, decl);
 
     rc = ink_astgen_record_proto(parent_scope, proto, &knot_scope);
     if (rc < 0) {
         return rc;
     }
-    if (!l) {
+    if (!l.count) {
         return rc;
     }
-    for (size_t i = 0; i < l->count; i++) {
-        struct ink_ast_node *const child = l->nodes[i];
+    for (size_t i = 0; i < l.count; i++) {
+        const uint32_t child = l.nodes[i];
 
-        if (child->type == INK_AST_STITCH_DECL) {
+        if (ink_ast_node_type(tree, child) == INK_AST_STITCH_DECL) {
             rc = ink_astgen_intern_stitch(&knot_scope, child);
             if (rc < 0) {
                 break;
@@ -1781,7 +2037,7 @@ static int ink_astgen_intern_knot(struct ink_astgen *parent_scope,
  * Collect information for a function prototype.
  */
 static int ink_astgen_intern_func(struct ink_astgen *parent_scope,
-                                  const struct ink_ast_node *decl)
+                                  uint32_t decl)
 {
     return ink_astgen_intern_stitch(parent_scope, decl);
 }
@@ -1790,18 +2046,19 @@ static int ink_astgen_intern_func(struct ink_astgen *parent_scope,
  * Perform a pass over the AST, gathering prototype information.
  */
 static int ink_astgen_intern_paths(struct ink_astgen *parent_scope,
-                                   const struct ink_ast_node *root)
+                                   uint32_t root)
 {
+    const struct ink_ast *const tree = parent_scope->global->tree;
     int rc = 0;
-    struct ink_ast_node_list *const l = root->data.many.list;
+    const struct ink_ast_node_list l = ink_ast_node_list(tree, root);
 
-    if (!l) {
+    if (!l.count) {
         return rc;
     }
-    for (size_t i = 0; i < l->count; i++) {
-        struct ink_ast_node *const decl = l->nodes[i];
+    for (size_t i = 0; i < l.count; i++) {
+        const uint32_t decl = l.nodes[i];
 
-        switch (decl->type) {
+        switch (ink_ast_node_type(tree, decl)) {
         case INK_AST_KNOT_DECL:
             rc = ink_astgen_intern_knot(parent_scope, decl);
             break;
@@ -1812,7 +2069,7 @@ static int ink_astgen_intern_paths(struct ink_astgen *parent_scope,
             rc = ink_astgen_intern_func(parent_scope, decl);
             break;
         default:
-            assert(decl->type == INK_AST_BLOCK);
+            assert(ink_ast_node_type(tree, decl) == INK_AST_BLOCK);
             break;
         }
         if (rc < 0) {
@@ -1822,10 +2079,272 @@ static int ink_astgen_intern_paths(struct ink_astgen *parent_scope,
     return rc;
 }
 
-static void ink_astgen_file(struct ink_astgen_global *g,
-                            const struct ink_ast_node *file)
+/**
+ * Look up a content path from a previous compilation by name.
+ *
+ * Only paths compiled from source with a matching hash are returned.
+ */
+static struct ink_object *ink_astgen_prior_path(struct ink_astgen *scope,
+                                                struct ink_object *name_obj,
+                                                uint32_t source_hash)
+{
+    struct ink_story *const story = scope->global->story;
+    struct ink_object *path_obj = NULL;
+
+    if (!name_obj) {
+        return NULL;
+    }
+    if (ink_table_lookup(story, story->prior_paths, name_obj, &path_obj) < 0) {
+        return NULL;
+    }
+    if (INK_OBJ_AS_CONTENT_PATH(path_obj)->source_hash != source_hash) {
+        return NULL;
+    }
+    return path_obj;
+}
+
+/**
+ * Carry over the content paths of a top-level unit from a previous
+ * compilation.
+ *
+ * Paths are reused only if the source of the unit and the prototypes of
+ * every knot, stitch and function are unchanged, since code generated for
+ * a unit depends on nothing else.
+ */
+static bool ink_astgen_reuse_unit(struct ink_astgen *file_scope, uint32_t unit)
+{
+    const struct ink_ast *const tree = file_scope->global->tree;
+    bool rc = false;
+    struct ink_symbol sym;
+    struct ink_object_vec reused;
+    uint32_t proto = INK_AST_NULL;
+    struct ink_ast_node_list children = {0, NULL};
+    struct ink_astgen_global *const g = file_scope->global;
+    struct ink_story *const story = g->story;
+    struct ink_object *const paths_table = ink_story_get_paths(story);
+    const uint32_t source_hash = ink_astgen_hash_node(file_scope, unit);
+
+    if (!story->prior_paths || story->proto_hash != g->proto_hash) {
+        return false;
+    }
+    switch (ink_ast_node_type(tree, unit)) {
+    case INK_AST_BLOCK: {
+        struct ink_object *const name_obj =
+            ink_astgen_string_new(file_scope, (uint8_t *)INK_DEFAULT_PATH,
+                                  strlen(INK_DEFAULT_PATH));
+        struct ink_object *const path_obj =
+            ink_astgen_prior_path(file_scope, name_obj, source_hash);
+
+        if (!path_obj) {
+            return false;
+        }
+
+        ink_table_insert(story, paths_table,
+                         INK_OBJ(INK_OBJ_AS_CONTENT_PATH(path_obj)->name),
+                         path_obj);
+        return true;
+    }
+    case INK_AST_KNOT_DECL:
+        proto = ink_ast_node_lhs(tree, unit);
+        children = ink_ast_node_children(tree, unit);
+        break;
+    default:
+        proto = ink_ast_node_lhs(tree, unit);
+        break;
+    }
+    if (ink_astgen_lookup_name(file_scope, ink_ast_node_lhs(tree, proto),
+                               &sym) < 0) {
+        return false;
+    }
+
+    ink_object_vec_init(&reused);
+
+    const struct ink_astgen_name *const name =
+        ink_astgen_name_get(file_scope, sym.as.knot.scope_id);
+    struct ink_object *path_obj =
+        ink_astgen_prior_path(file_scope, name->path_name, source_hash);
+
+    if (!path_obj) {
+        goto out;
+    }
+
+    ink_object_vec_push(&reused, path_obj);
+
+    for (size_t i = 0; i < children.count; i++) {
+        struct ink_symbol child_sym;
+        const uint32_t child = children.nodes[i];
+
+        if (ink_ast_node_type(tree, child) != INK_AST_STITCH_DECL) {
+            continue;
+        }
+
+        const uint32_t child_name =
+            ink_ast_node_lhs(tree, ink_ast_node_lhs(tree, child));
+
+        if (ink_symtab_lookup(sym.as.knot.local_names,
+                              ink_string_from_node(file_scope, child_name),
+                              &child_sym) < 0) {
+            goto out;
+        }
+
+        path_obj = ink_astgen_prior_path(
+            file_scope,
+            ink_astgen_name_get(file_scope, child_sym.as.knot.scope_id)
+                ->path_name,
+            source_hash);
+        if (!path_obj) {
+            goto out;
+        }
+
+        ink_object_vec_push(&reused, path_obj);
+    }
+    for (size_t i = 0; i < reused.count; i++) {
+        struct ink_content_path *const path =
+            INK_OBJ_AS_CONTENT_PATH(reused.entries[i]);
+
+        ink_table_insert(story, paths_table, INK_OBJ(path->name),
+                         reused.entries[i]);
+    }
+
+    rc = true;
+out:
+    ink_object_vec_deinit(&reused);
+    return rc;
+}
+
+/**
+ * Generate code for a top-level knot, stitch or function declaration.
+ */
+static void ink_astgen_decl(struct ink_astgen *file_scope, uint32_t decl)
+{
+    const struct ink_ast *const tree = file_scope->global->tree;
+
+    assert(ink_ast_node_type(tree, decl) != INK_AST_BLOCK);
+
+    file_scope->global->unit_hash = ink_astgen_hash_node(file_scope, decl);
+
+    switch (ink_ast_node_type(tree, decl)) {
+    case INK_AST_KNOT_DECL:
+        ink_astgen_knot_decl(file_scope, decl);
+        break;
+    case INK_AST_STITCH_DECL:
+        ink_astgen_stitch_decl(file_scope, decl);
+        break;
+    case INK_AST_FUNC_DECL:
+        ink_astgen_func_decl(file_scope, decl);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Code generation unit for a top-level declaration, owned by one worker.
+ */
+struct ink_astgen_unit {
+    uint32_t decl;
+    struct ink_astgen_global global;
+    struct ink_ast_error_vec errors;
+    int rc;
+};
+
+/**
+ * Shared context for parallel code generation.
+ *
+ * The file's symbol tables and interned strings are read-only once all
+ * paths have been interned, so workers may consult them freely.
+ */
+struct ink_astgen_parallel {
+    struct ink_symtab *file_symtab;
+    struct ink_astgen_unit *units;
+    struct ink_mutex object_lock;
+};
+
+static void ink_astgen_unit_task(void *context, size_t index)
+{
+    struct ink_astgen_parallel *const p = context;
+    struct ink_astgen_unit *const unit = &p->units[index];
+    struct ink_astgen file_scope = {
+        .parent = NULL,
+        .global = &unit->global,
+        .symbol_table = p->file_symtab,
+    };
+
+    if (setjmp(unit->global.jmpbuf) == 0) {
+        ink_astgen_decl(&file_scope, unit->decl);
+        unit->rc = INK_E_OK;
+    } else {
+        unit->rc = -INK_E_PANIC;
+    }
+}
+
+/**
+ * Generate code for top-level declarations on a pool of worker threads.
+ *
+ * Outputs are merged in declaration order, so the resulting story is the
+ * same as one compiled sequentially.
+ */
+static int ink_astgen_file_parallel(struct ink_astgen *file_scope,
+                                    uint32_t *decls, size_t decl_count)
+{
+    int rc = INK_E_OK;
+    struct ink_astgen_parallel p;
+    struct ink_astgen_global *const g = file_scope->global;
+    struct ink_object *const paths_table = ink_story_get_paths(g->story);
+
+    p.file_symtab = file_scope->symbol_table;
+    p.units = ink_malloc(decl_count * sizeof(*p.units));
+    if (!p.units) {
+        return -INK_E_OOM;
+    }
+    if (ink_mutex_init(&p.object_lock) < 0) {
+        ink_free(p.units);
+        return -INK_E_OS;
+    }
+    for (size_t i = 0; i < decl_count; i++) {
+        struct ink_astgen_unit *const unit = &p.units[i];
+
+        unit->decl = decls[i];
+        unit->rc = INK_E_OK;
+        ink_ast_error_vec_init(&unit->errors);
+        ink_astgen_global_init_worker(&unit->global, g, &unit->errors,
+                                      &p.object_lock);
+    }
+
+    ink_parallel_for(decl_count, ink_thread_count(), ink_astgen_unit_task, &p);
+
+    for (size_t i = 0; i < decl_count; i++) {
+        struct ink_astgen_unit *const unit = &p.units[i];
+        struct ink_object_vec *const paths = &unit->global.paths;
+
+        for (size_t j = 0; j < unit->errors.count; j++) {
+            ink_ast_error_vec_push(g->errors, unit->errors.entries[j]);
+        }
+        for (size_t j = 0; j < paths->count; j++) {
+            struct ink_object *const path_obj = paths->entries[j];
+            struct ink_content_path *const path =
+                INK_OBJ_AS_CONTENT_PATH(path_obj);
+
+            ink_table_insert(g->story, paths_table, INK_OBJ(path->name),
+                             path_obj);
+        }
+        if (unit->rc < 0) {
+            rc = unit->rc;
+        }
+
+        ink_astgen_global_deinit(&unit->global);
+        ink_ast_error_vec_deinit(&unit->errors);
+    }
+
+    ink_mutex_deinit(&p.object_lock);
+    ink_free(p.units);
+    return rc;
+}
+
+static void ink_astgen_file(struct ink_astgen_global *g, uint32_t file)
 {
-    struct ink_ast_node_list *const l = file->data.many.list;
+    const struct ink_ast *const tree = g->tree;
+    const struct ink_ast_node_list l = ink_ast_node_list(tree, file);
     struct ink_symtab_pool *const st_pool = &g->symtab_pool;
     struct ink_astgen file_scope = {
         .parent = NULL,
@@ -1833,40 +2352,60 @@ static void ink_astgen_file(struct ink_astgen_global *g,
         .symbol_table = ink_symtab_make(st_pool),
     };
 
-    if (!l) {
-        ink_astgen_default_body(&file_scope, NULL);
+    if (!l.count) {
+        ink_astgen_default_body(&file_scope, INK_AST_NULL);
         ink_astgen_backpatch(&file_scope, file_scope.jumps_top,
                              g->branches.count);
         return;
     }
-    if (l->count > 0) {
-        struct ink_ast_node *const first = l->nodes[0];
+    if (l.count > 0) {
+        const uint32_t first = l.nodes[0];
         size_t i = 0;
 
         ink_astgen_intern_paths(&file_scope, file);
 
-        if (first->type == INK_AST_BLOCK) {
-            ink_astgen_default_body(&file_scope, first);
-            ink_astgen_backpatch(&file_scope, file_scope.jumps_top,
-                                 g->branches.count);
+        if (ink_ast_node_type(tree, first) == INK_AST_BLOCK) {
+            if (!ink_astgen_reuse_unit(&file_scope, first)) {
+                g->unit_hash = ink_astgen_hash_node(&file_scope, first);
+                ink_astgen_default_body(&file_scope, first);
+                ink_astgen_backpatch(&file_scope, file_scope.jumps_top,
+                                     g->branches.count);
+            }
+
             i++;
         }
-        for (; i < l->count; i++) {
-            struct ink_ast_node *const n = l->nodes[i];
 
-            assert(n->type != INK_AST_BLOCK);
-            switch (n->type) {
-            case INK_AST_KNOT_DECL:
-                ink_astgen_knot_decl(&file_scope, n);
-                break;
-            case INK_AST_STITCH_DECL:
-                ink_astgen_stitch_decl(&file_scope, n);
-                break;
-            case INK_AST_FUNC_DECL:
-                ink_astgen_func_decl(&file_scope, n);
-                break;
-            default:
-                break;
+        if (g->flags & INK_F_PARALLEL) {
+            struct ink_astgen_decl_vec pending;
+
+            ink_astgen_decl_vec_init(&pending);
+
+            for (; i < l.count; i++) {
+                if (!ink_astgen_reuse_unit(&file_scope, l.nodes[i])) {
+                    ink_astgen_decl_vec_push(&pending, l.nodes[i]);
+                }
+            }
+            if (pending.count > 1) {
+                const int rc = ink_astgen_file_parallel(
+                    &file_scope, pending.entries, pending.count);
+
+                ink_astgen_decl_vec_deinit(&pending);
+                if (rc < 0) {
+                    ink_astgen_global_panic(g);
+                }
+            } else if (pending.count == 1) {
+                const uint32_t decl = pending.entries[0];
+
+                ink_astgen_decl_vec_deinit(&pending);
+                ink_astgen_decl(&file_scope, decl);
+            } else {
+                ink_astgen_decl_vec_deinit(&pending);
+            }
+            return;
+        }
+        for (; i < l.count; i++) {
+            if (!ink_astgen_reuse_unit(&file_scope, l.nodes[i])) {
+                ink_astgen_decl(&file_scope, l.nodes[i]);
             }
         }
     }
@@ -1880,7 +2419,7 @@ int ink_astgen(struct ink_ast *tree, struct ink_story *story, int flags)
     int rc = -INK_E_FAIL;
     struct ink_astgen_global g;
 
-    ink_astgen_global_init(&g, tree, story);
+    ink_astgen_global_init(&g, tree, story, flags);
 
     if (!ink_ast_error_vec_is_empty(&tree->errors)) {
         ink_ast_render_errors(tree);
@@ -1897,6 +2436,7 @@ int ink_astgen(struct ink_ast *tree, struct ink_story *story, int flags)
         ink_ast_render_errors(tree);
         rc = -INK_E_FAIL;
     } else {
+        story->proto_hash = g.proto_hash;
         rc = INK_E_OK;
     }
 out:
@@ -0,0 +1,568 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bundle.h"
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "opcode.h"
+#include "story.h"
+
+enum ink_bundle_const_type {
+    INK_BUNDLE_CONST_FALSE,
+    INK_BUNDLE_CONST_TRUE,
+    INK_BUNDLE_CONST_INTEGER,
+    INK_BUNDLE_CONST_FLOAT,
+    INK_BUNDLE_CONST_STRING,
+};
+
+static int ink_bundle_write_bytes(struct ink_byte_vec *bytes,
+                                  const uint8_t *data, size_t length)
+{
+    return ink_byte_vec_append(bytes, data, length);
+}
+
+/**
+ * Reserve space for records that are patched once their contents have been
+ * written.
+ */
+static int ink_bundle_write_zeros(struct ink_byte_vec *bytes, size_t length)
+{
+    static const uint8_t zeros[64];
+    int rc;
+
+    while (length > 0) {
+        const size_t n = length < sizeof(zeros) ? length : sizeof(zeros);
+
+        rc = ink_byte_vec_append(bytes, zeros, n);
+        if (rc < 0) {
+            return rc;
+        }
+
+        length -= n;
+    }
+    return INK_E_OK;
+}
+
+static int ink_bundle_write_align(struct ink_byte_vec *bytes)
+{
+    const size_t rem = bytes->count % INK_BUNDLE_ALIGNMENT;
+
+    if (rem == 0) {
+        return INK_E_OK;
+    }
+    return ink_bundle_write_zeros(bytes, INK_BUNDLE_ALIGNMENT - rem);
+}
+
+static void ink_bundle_patch_u16(struct ink_byte_vec *bytes, size_t offset,
+                                 uint16_t value)
+{
+    assert(offset + 2 <= bytes->count);
+
+    bytes->entries[offset] = (uint8_t)(value & 0xff);
+    bytes->entries[offset + 1] = (uint8_t)((value >> 8) & 0xff);
+}
+
+static void ink_bundle_patch_u32(struct ink_byte_vec *bytes, size_t offset,
+                                 uint32_t value)
+{
+    assert(offset + 4 <= bytes->count);
+
+    for (size_t i = 0; i < 4; i++) {
+        bytes->entries[offset + i] = (uint8_t)((value >> (i * 8)) & 0xff);
+    }
+}
+
+/**
+ * Append an inline string record and return its offset.
+ */
+static int ink_bundle_write_string(struct ink_byte_vec *bytes,
+                                   const struct ink_string *str,
+                                   uint32_t *offset)
+{
+    int rc;
+    const size_t start = bytes->count;
+
+    rc = ink_bundle_write_zeros(bytes, INK_BUNDLE_STRING_SIZE);
+    if (rc < 0) {
+        return rc;
+    }
+
+    ink_bundle_patch_u32(bytes, start, str->hash);
+    ink_bundle_patch_u32(bytes, start + 4, str->length);
+
+    rc = ink_bundle_write_bytes(bytes, str->bytes, str->length + 1);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_bundle_write_align(bytes);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *offset = (uint32_t)start;
+    return INK_E_OK;
+}
+
+static int ink_bundle_write_const(struct ink_byte_vec *bytes, size_t offset,
+                                  const struct ink_object *obj)
+{
+    int rc;
+    uint32_t type = 0;
+    uint64_t value = 0;
+
+    switch (obj->type) {
+    case INK_OBJ_BOOL:
+        type = INK_OBJ_AS_BOOL(obj)->value ? INK_BUNDLE_CONST_TRUE
+                                           : INK_BUNDLE_CONST_FALSE;
+        break;
+    case INK_OBJ_NUMBER: {
+        const struct ink_number *const num = INK_OBJ_AS_NUMBER(obj);
+
+        if (num->is_int) {
+            type = INK_BUNDLE_CONST_INTEGER;
+            value = (uint64_t)num->as.integer;
+        } else {
+            type = INK_BUNDLE_CONST_FLOAT;
+            memcpy(&value, &num->as.floating, sizeof(value));
+        }
+        break;
+    }
+    case INK_OBJ_STRING: {
+        uint32_t str_offset = 0;
+
+        rc = ink_bundle_write_string(bytes, INK_OBJ_AS_STRING(obj),
+                                     &str_offset);
+        if (rc < 0) {
+            return rc;
+        }
+
+        type = INK_BUNDLE_CONST_STRING;
+        value = str_offset;
+        break;
+    }
+    default:
+        return -INK_E_INVALID_ARG;
+    }
+
+    ink_bundle_patch_u32(bytes, offset, type);
+    ink_bundle_patch_u32(bytes, offset + 4, (uint32_t)(value & 0xffffffff));
+    ink_bundle_patch_u32(bytes, offset + 8, (uint32_t)(value >> 32));
+    return INK_E_OK;
+}
+
+static int ink_bundle_write_path(struct ink_byte_vec *bytes, size_t offset,
+                                 const struct ink_content_path *path)
+{
+    int rc;
+    uint32_t name_offset = 0;
+    size_t code_offset = 0;
+    size_t consts_offset = 0;
+
+    rc = ink_bundle_write_string(bytes, path->name, &name_offset);
+    if (rc < 0) {
+        return rc;
+    }
+
+    code_offset = bytes->count;
+
+    rc = ink_bundle_write_bytes(bytes, path->code.entries, path->code.count);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_bundle_write_align(bytes);
+    if (rc < 0) {
+        return rc;
+    }
+
+    consts_offset = bytes->count;
+
+    rc = ink_bundle_write_zeros(bytes, path->const_pool.count *
+                                           INK_BUNDLE_CONST_SIZE);
+    if (rc < 0) {
+        return rc;
+    }
+    for (size_t i = 0; i < path->const_pool.count; i++) {
+        rc = ink_bundle_write_const(bytes,
+                                    consts_offset + i * INK_BUNDLE_CONST_SIZE,
+                                    path->const_pool.entries[i]);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    ink_bundle_patch_u32(bytes, offset, name_offset);
+    ink_bundle_patch_u32(bytes, offset + 4, path->arity);
+    ink_bundle_patch_u32(bytes, offset + 8, path->locals_count);
+    ink_bundle_patch_u32(bytes, offset + 12, (uint32_t)code_offset);
+    ink_bundle_patch_u32(bytes, offset + 16, (uint32_t)path->code.count);
+    ink_bundle_patch_u32(bytes, offset + 20, (uint32_t)consts_offset);
+    ink_bundle_patch_u32(bytes, offset + 24,
+                         (uint32_t)path->const_pool.count);
+    return INK_E_OK;
+}
+
+int ink_bundle_write(struct ink_story *story, uint32_t source_hash,
+                     struct ink_byte_vec *bytes)
+{
+    int rc;
+    size_t iter = 0;
+    size_t index = 0;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    const struct ink_table *const globals = INK_OBJ_AS_TABLE(story->globals);
+    const struct ink_table *const paths = INK_OBJ_AS_TABLE(story->paths);
+    const size_t globals_offset = INK_BUNDLE_HEADER_SIZE;
+    const size_t paths_offset = globals_offset + globals->count * 4;
+
+    rc = ink_bundle_write_zeros(bytes, paths_offset +
+                                           paths->count * INK_BUNDLE_PATH_SIZE);
+    if (rc < 0) {
+        return rc;
+    }
+    while (ink_table_next(story->globals, &iter, &key, NULL) == INK_E_OK) {
+        uint32_t name_offset = 0;
+
+        rc = ink_bundle_write_string(bytes, INK_OBJ_AS_STRING(key),
+                                     &name_offset);
+        if (rc < 0) {
+            return rc;
+        }
+
+        ink_bundle_patch_u32(bytes, globals_offset + index * 4, name_offset);
+        index++;
+    }
+
+    iter = 0;
+    index = 0;
+
+    while (ink_table_next(story->paths, &iter, NULL, &value) == INK_E_OK) {
+        rc = ink_bundle_write_path(bytes,
+                                   paths_offset + index * INK_BUNDLE_PATH_SIZE,
+                                   INK_OBJ_AS_CONTENT_PATH(value));
+        if (rc < 0) {
+            return rc;
+        }
+
+        index++;
+    }
+    if (bytes->count > UINT32_MAX) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    memcpy(bytes->entries, INK_BUNDLE_MAGIC, INK_BUNDLE_MAGIC_LENGTH);
+    ink_bundle_patch_u16(bytes, 4, INK_BUNDLE_VERSION);
+    ink_bundle_patch_u16(bytes, 6, 0);
+    ink_bundle_patch_u32(bytes, 8, source_hash);
+    ink_bundle_patch_u32(bytes, 12, globals->count);
+    ink_bundle_patch_u32(bytes, 16, (uint32_t)globals_offset);
+    ink_bundle_patch_u32(bytes, 20, paths->count);
+    ink_bundle_patch_u32(bytes, 24, (uint32_t)paths_offset);
+    ink_bundle_patch_u32(bytes, 28, (uint32_t)bytes->count);
+    return INK_E_OK;
+}
+
+static inline uint32_t ink_bundle_u32(const uint8_t *bytes, size_t offset)
+{
+    return (uint32_t)bytes[offset] | ((uint32_t)bytes[offset + 1] << 8) |
+           ((uint32_t)bytes[offset + 2] << 16) |
+           ((uint32_t)bytes[offset + 3] << 24);
+}
+
+/**
+ * Determine if a record of `size` bytes at `offset` lies within the bundle.
+ */
+static inline bool ink_bundle_in_bounds(size_t length, size_t offset,
+                                        size_t size)
+{
+    return offset <= length && size <= length - offset;
+}
+
+static int ink_bundle_read_string(struct ink_story *story,
+                                  const uint8_t *bytes, size_t length,
+                                  uint32_t offset, struct ink_object **str)
+{
+    uint32_t str_length = 0;
+
+    if (!ink_bundle_in_bounds(length, offset, INK_BUNDLE_STRING_SIZE)) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+
+    str_length = ink_bundle_u32(bytes, offset + 4);
+
+    if (!ink_bundle_in_bounds(length, offset + INK_BUNDLE_STRING_SIZE,
+                              (size_t)str_length + 1) ||
+        bytes[offset + INK_BUNDLE_STRING_SIZE + str_length] != '\0') {
+        return -INK_E_INVALID_BUNDLE;
+    }
+
+    *str = ink_string_new_hashed(story, bytes + offset + INK_BUNDLE_STRING_SIZE,
+                                 str_length, ink_bundle_u32(bytes, offset));
+    if (!*str) {
+        return -INK_E_OOM;
+    }
+    return INK_E_OK;
+}
+
+static int ink_bundle_read_const(struct ink_story *story,
+                                 const uint8_t *bytes, size_t length,
+                                 size_t offset, struct ink_object **obj)
+{
+    const uint32_t type = ink_bundle_u32(bytes, offset);
+    const uint32_t lo = ink_bundle_u32(bytes, offset + 4);
+    const uint32_t hi = ink_bundle_u32(bytes, offset + 8);
+    const uint64_t value = ((uint64_t)hi << 32) | lo;
+
+    switch (type) {
+    case INK_BUNDLE_CONST_FALSE:
+    case INK_BUNDLE_CONST_TRUE:
+        *obj = ink_bool_new(story, type == INK_BUNDLE_CONST_TRUE);
+        break;
+    case INK_BUNDLE_CONST_INTEGER:
+        *obj = ink_integer_new(story, (ink_integer)value);
+        break;
+    case INK_BUNDLE_CONST_FLOAT: {
+        ink_float floating;
+
+        memcpy(&floating, &value, sizeof(floating));
+        *obj = ink_float_new(story, floating);
+        break;
+    }
+    case INK_BUNDLE_CONST_STRING:
+        return ink_bundle_read_string(story, bytes, length, lo, obj);
+    default:
+        return -INK_E_INVALID_BUNDLE;
+    }
+    if (!*obj) {
+        return -INK_E_OOM;
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Validate the bytecode of a content path read from a bundle.
+ *
+ * Every opcode must be known and have its operand within the code, operands
+ * must name a constant or local slot of the path, jumps must land on an
+ * instruction, and the code must end by leaving the path, so the VM never
+ * reads past the code it was given.
+ */
+static int ink_bundle_check_code(const struct ink_content_path *path)
+{
+    int rc = -INK_E_INVALID_BUNDLE;
+    const uint8_t *const code = path->code.entries;
+    const size_t length = path->code.count;
+    const uint64_t slots = (uint64_t)path->arity + path->locals_count;
+    uint8_t last_op = INK_OP_EXIT;
+    bool *starts = NULL;
+
+    if (length == 0) {
+        return INK_E_OK;
+    }
+
+    starts = ink_malloc(length * sizeof(*starts));
+    if (!starts) {
+        return -INK_E_OOM;
+    }
+
+    memset(starts, 0, length * sizeof(*starts));
+
+    for (size_t i = 0; i < length;) {
+        const uint8_t op = code[i];
+        const size_t operand_size = ink_opcode_operand_size(op);
+
+        if (op > INK_OP_FLUSH || operand_size >= length - i) {
+            goto out;
+        }
+        switch (op) {
+        case INK_OP_CONST:
+            if (code[i + 1] >= path->const_pool.count) {
+                goto out;
+            }
+            break;
+        case INK_OP_LOAD:
+        case INK_OP_STORE:
+            if (code[i + 1] >= slots) {
+                goto out;
+            }
+            break;
+        case INK_OP_LOAD_GLOBAL:
+        case INK_OP_STORE_GLOBAL:
+        case INK_OP_CALL:
+        case INK_OP_DIVERT:
+            if (code[i + 1] >= path->const_pool.count ||
+                !INK_OBJ_IS_STRING(path->const_pool.entries[code[i + 1]])) {
+                goto out;
+            }
+            break;
+        default:
+            break;
+        }
+
+        starts[i] = true;
+        last_op = op;
+        i += 1 + operand_size;
+    }
+    if (last_op != INK_OP_EXIT && last_op != INK_OP_RET) {
+        goto out;
+    }
+    for (size_t i = 0; i < length; i += 1 + ink_opcode_operand_size(code[i])) {
+        size_t target = 0;
+
+        switch (code[i]) {
+        case INK_OP_JMP:
+        case INK_OP_JMP_T:
+        case INK_OP_JMP_F:
+            target = i + 3 + (size_t)((code[i + 1] << 8) | code[i + 2]);
+            if (target >= length || !starts[target]) {
+                goto out;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    rc = INK_E_OK;
+out:
+    ink_free(starts);
+    return rc;
+}
+
+static int ink_bundle_read_path(struct ink_story *story, const uint8_t *bytes,
+                                size_t length, size_t offset)
+{
+    int rc;
+    struct ink_object *name = NULL;
+    struct ink_object *path_obj = NULL;
+    struct ink_content_path *path = NULL;
+    const uint32_t code_offset = ink_bundle_u32(bytes, offset + 12);
+    const uint32_t code_length = ink_bundle_u32(bytes, offset + 16);
+    const uint32_t consts_offset = ink_bundle_u32(bytes, offset + 20);
+    const uint32_t consts_count = ink_bundle_u32(bytes, offset + 24);
+
+    if (!ink_bundle_in_bounds(length, code_offset, code_length) ||
+        !ink_bundle_in_bounds(length, consts_offset,
+                              (size_t)consts_count * INK_BUNDLE_CONST_SIZE)) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+
+    rc = ink_bundle_read_string(story, bytes, length,
+                                ink_bundle_u32(bytes, offset), &name);
+    if (rc < 0) {
+        return rc;
+    }
+
+    path_obj = ink_content_path_new(story, name);
+    if (!path_obj) {
+        return -INK_E_OOM;
+    }
+
+    path = INK_OBJ_AS_CONTENT_PATH(path_obj);
+    path->arity = ink_bundle_u32(bytes, offset + 4);
+    path->locals_count = ink_bundle_u32(bytes, offset + 8);
+
+    if (code_length > 0) {
+        path->code_is_borrowed = true;
+        path->code.entries = (uint8_t *)bytes + code_offset;
+        path->code.count = code_length;
+        path->code.capacity = code_length;
+    }
+    if (consts_count > 0) {
+        rc = ink_object_vec_reserve(&path->const_pool, consts_count);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (uint32_t i = 0; i < consts_count; i++) {
+        struct ink_object *obj = NULL;
+
+        rc = ink_bundle_read_const(story, bytes, length,
+                                   consts_offset + i * INK_BUNDLE_CONST_SIZE,
+                                   &obj);
+        if (rc < 0) {
+            return rc;
+        }
+
+        ink_object_vec_push(&path->const_pool, obj);
+    }
+
+    rc = ink_bundle_check_code(path);
+    if (rc < 0) {
+        return rc;
+    }
+    return ink_table_insert(story, story->paths, name, path_obj);
+}
+
+int ink_bundle_read_header(const uint8_t *bytes, size_t length,
+                           struct ink_bundle_header *header)
+{
+    if (length < INK_BUNDLE_HEADER_SIZE) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+    if (memcmp(bytes, INK_BUNDLE_MAGIC, INK_BUNDLE_MAGIC_LENGTH) != 0) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+
+    header->version = (uint16_t)(bytes[4] | (bytes[5] << 8));
+    header->flags = (uint16_t)(bytes[6] | (bytes[7] << 8));
+    header->source_hash = ink_bundle_u32(bytes, 8);
+    header->globals_count = ink_bundle_u32(bytes, 12);
+    header->globals_offset = ink_bundle_u32(bytes, 16);
+    header->paths_count = ink_bundle_u32(bytes, 20);
+    header->paths_offset = ink_bundle_u32(bytes, 24);
+    header->length = ink_bundle_u32(bytes, 28);
+
+    if (header->version != INK_BUNDLE_VERSION || header->length != length) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+    if (!ink_bundle_in_bounds(length, header->globals_offset,
+                              (size_t)header->globals_count * 4) ||
+        !ink_bundle_in_bounds(length, header->paths_offset,
+                              (size_t)header->paths_count *
+                                  INK_BUNDLE_PATH_SIZE)) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+    return INK_E_OK;
+}
+
+int ink_bundle_read(struct ink_story *story, const uint8_t *bytes,
+                    size_t length)
+{
+    int rc;
+    struct ink_bundle_header header;
+
+    rc = ink_bundle_read_header(bytes, length, &header);
+    if (rc < 0) {
+        return rc;
+    }
+    for (uint32_t i = 0; i < header.globals_count; i++) {
+        struct ink_object *name = NULL;
+
+        rc = ink_bundle_read_string(
+            story, bytes, length,
+            ink_bundle_u32(bytes, header.globals_offset + i * 4), &name);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_table_insert(story, story->globals, name, NULL);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (uint32_t i = 0; i < header.paths_count; i++) {
+        rc = ink_bundle_read_path(story, bytes, length,
+                                  header.paths_offset +
+                                      i * INK_BUNDLE_PATH_SIZE);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    return INK_E_OK;
+}
@@ -0,0 +1,78 @@
+#ifndef INK_BUNDLE_H
+#define INK_BUNDLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+
+#define INK_BUNDLE_MAGIC "INKB"
+#define INK_BUNDLE_MAGIC_LENGTH (4u)
+#define INK_BUNDLE_VERSION (2u)
+#define INK_BUNDLE_ALIGNMENT (4u)
+#define INK_BUNDLE_HEADER_SIZE (32u)
+#define INK_BUNDLE_PATH_SIZE (28u)
+#define INK_BUNDLE_CONST_SIZE (12u)
+#define INK_BUNDLE_STRING_SIZE (8u)
+
+struct ink_story;
+
+/**
+ * Fixed-size header found at the beginning of a compiled story bundle.
+ *
+ * A bundle is laid out so that it can be mapped read-only and used in place.
+ * Records refer to each other by byte offsets from the start of the bundle,
+ * never by pointers. All integers are encoded in little-endian byte order
+ * and every record is aligned to `INK_BUNDLE_ALIGNMENT`.
+ *
+ * The header is followed by an array of `globals_count` offsets to global
+ * names and an array of `paths_count` path records:
+ *
+ *     name, arity, locals_count, code_offset, code_length,
+ *     consts_offset, consts_count
+ *
+ * Constants are `INK_BUNDLE_CONST_SIZE` bytes wide, holding a type tag and a
+ * 64-bit payload, or the offset of a string record. Strings are stored
+ * inline as their hash, their length and their NUL-terminated bytes.
+ */
+struct ink_bundle_header {
+    uint16_t version;
+    uint16_t flags;
+    uint32_t source_hash;
+    uint32_t globals_count;
+    uint32_t globals_offset;
+    uint32_t paths_count;
+    uint32_t paths_offset;
+    uint32_t length;
+};
+
+/**
+ * Decode and validate the header of a compiled story bundle.
+ */
+extern int ink_bundle_read_header(const uint8_t *bytes, size_t length,
+                                  struct ink_bundle_header *header);
+
+/**
+ * Load the globals layout and content paths of a compiled story bundle.
+ *
+ * Bytecode is referenced directly from `bytes`, which must outlive the
+ * loaded content paths.
+ */
+extern int ink_bundle_read(struct ink_story *story, const uint8_t *bytes,
+                           size_t length);
+
+/**
+ * Serialize the globals layout and content paths of a story.
+ */
+extern int ink_bundle_write(struct ink_story *story, uint32_t source_hash,
+                            struct ink_byte_vec *bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include <ink/ink.h>
 
@@ -14,20 +22,54 @@
 enum {
     OPT_COLORS = 1000,
     OPT_COMPILE_ONLY,
+    OPT_COMPILE_TO,
     OPT_VM_TRACING,
     OPT_GC_TRACING,
     OPT_CACHING,
+    OPT_PARALLEL,
     OPT_DUMP_AST,
     OPT_DUMP_STORY,
     OPT_STDIN,
+    OPT_EXPLORE,
+    OPT_DFS,
+    OPT_MAX_DEPTH,
+    OPT_SIMULATE,
+    OPT_POLICY,
+    OPT_SEED,
+    OPT_INPUT,
+    OPT_REPEAT,
+    OPT_QUIET,
+    OPT_TIME,
     OPT_HELP,
 };
 
+/* Instructions a turn may execute while exploring or simulating before it is
+ * cut short. Guards against stories that loop forever. */
+#define INKC_EXPLORE_MAX_INSTRUCTIONS (10000000ul)
+/* Width of the bars of histograms, in characters. */
+#define INKC_HISTOGRAM_WIDTH (40u)
+/* Size of the buffer that story output is written through. */
+#define INKC_OUTPUT_BUFLEN (1u << 16)
+#define INKC_PRINTF_BUFLEN (1u << 12)
+
 static const struct option cli_options[] = {
     {"--colors", OPT_COLORS, false},
+    {"--cache", OPT_CACHING, false},
     {"--compile-only", OPT_COMPILE_ONLY, false},
+    {"--compile-to", OPT_COMPILE_TO, true},
     {"--dump-ast", OPT_DUMP_AST, false},
     {"--dump-story", OPT_DUMP_STORY, false},
+    {"--explore", OPT_EXPLORE, false},
+    {"--dfs", OPT_DFS, false},
+    {"--max-depth", OPT_MAX_DEPTH, true},
+    {"--simulate", OPT_SIMULATE, true},
+    {"--policy", OPT_POLICY, true},
+    {"--seed", OPT_SEED, true},
+    {"--input", OPT_INPUT, true},
+    {"--repeat", OPT_REPEAT, true},
+    {"--quiet", OPT_QUIET, false},
+    {"--time", OPT_TIME, false},
+    {"--parallel", OPT_PARALLEL, false},
     {"--trace", OPT_VM_TRACING, false},
     {"--trace-gc", OPT_GC_TRACING, false},
     {"--stdin", OPT_STDIN, false},
@@ -39,21 +81,272 @@ static const struct option cli_options[] = {
 static const char *usage_msg =
     "Usage: %s [OPTION]... [FILE]\n"
     "Load and execute an Ink story.\n\n"
-    "  -h, --help       Print this message\n"
-    "  --colors         Enable color output\n"
-    "  --compile-only   Compile the story without executing\n"
-    "  --dump-ast       Dump a source file's AST\n"
-    "  --dump-story     Dump a story's bytecode\n"
-    "  --trace          Enable execution tracing\n"
-    "  --trace-gc       Enable garbage collector tracing\n"
-    "  --stdin          Read source file from standard input\n"
+    "  -h, --help           Print this message\n"
+    "  --cache              Cache the compiled story alongside FILE\n"
+    "  --colors             Enable color output\n"
+    "  --compile-only       Compile the story without executing\n"
+    "  --compile-to BUNDLE  Compile the story to a bundle without executing\n"
+    "  --dump-ast           Dump a source file's AST\n"
+    "  --dump-story         Dump a story's bytecode\n"
+    "  --explore            Visit every choice and report coverage\n"
+    "  --dfs                Explore depth-first instead of breadth-first\n"
+    "  --max-depth N        Stop exploring or simulating after N choices\n"
+    "  --simulate N         Play N random playthroughs and report statistics\n"
+    "  --policy POLICY      Pick choices at random (default) or weighted\n"
+    "                       towards the first ones\n"
+    "  --seed S             Seed the random choices of a simulation\n"
+    "  --input FILE         Read choices from FILE, one per line\n"
+    "  --repeat N           Load and play the story N times\n"
+    "  --quiet              Do not print the story\n"
+    "  --time               Report load and run times on exit\n"
+    "  --parallel           Compile knots on multiple threads\n"
+    "  --trace              Enable execution tracing\n"
+    "  --trace-gc           Enable garbage collector tracing\n"
+    "  --stdin              Read source file from standard input\n"
+    "\n"
+    "FILE may also be a compiled story bundle (.inkb).\n"
+    "The garbage collector runs on every allocation to catch bugs, unless\n"
+    "--repeat or --time is given.\n"
     "\n";
 
+/**
+ * Buffer for story output, written to standard output once full.
+ *
+ * The story is written through this rather than stdout directly so that
+ * anything the library prints while loading is not held back.
+ */
+struct inkc_writer {
+    bool is_buffered;
+    size_t length;
+    char bytes[INKC_OUTPUT_BUFLEN];
+};
+
+static struct inkc_writer inkc_output;
+
+/**
+ * Choices to make, read from a file.
+ */
+struct inkc_script {
+    const uint8_t *bytes;
+    size_t length;
+    size_t offset;
+};
+
+/**
+ * Totals gathered over every repetition of a story.
+ */
+struct inkc_stats {
+    double load_time;
+    double run_time;
+    size_t lines;
+    uint64_t instructions;
+};
+
 static void print_usage(const char *name)
 {
     fprintf(stderr, usage_msg, name);
 }
 
+/**
+ * Return the time elapsed since an arbitrary point, in seconds.
+ *
+ * A monotonic clock is used where available, so that time spent waiting
+ * and on other threads is counted, and adjustments to the system clock are
+ * not. Otherwise, falls back to the processor time used.
+ */
+static double inkc_clock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    }
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static void inkc_flush(void)
+{
+    fwrite(inkc_output.bytes, 1, inkc_output.length, stdout);
+    fflush(stdout);
+    inkc_output.length = 0;
+}
+
+static void inkc_write(const void *bytes, size_t length)
+{
+    if (inkc_output.length + length > sizeof(inkc_output.bytes)) {
+        inkc_flush();
+    }
+    if (length > sizeof(inkc_output.bytes)) {
+        fwrite(bytes, 1, length, stdout);
+    } else {
+        memcpy(inkc_output.bytes + inkc_output.length, bytes, length);
+        inkc_output.length += length;
+    }
+    if (!inkc_output.is_buffered) {
+        inkc_flush();
+    }
+}
+
+static void inkc_printf(const char *fmt, ...)
+{
+    char buf[INKC_PRINTF_BUFLEN];
+    int length = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    length = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length >= sizeof(buf)) {
+        length = (int)sizeof(buf) - 1;
+    }
+
+    inkc_write(buf, (size_t)length);
+}
+
+/**
+ * Read the next choice from a script.
+ *
+ * Returns false once the script has no choices left.
+ */
+static bool inkc_script_next(struct inkc_script *script, size_t *choice_index)
+{
+    bool has_digits = false;
+
+    *choice_index = 0;
+
+    while (script->offset < script->length) {
+        const uint8_t c = script->bytes[script->offset++];
+
+        if (c >= '0' && c <= '9') {
+            *choice_index = *choice_index * 10 + (size_t)(c - '0');
+            has_digits = true;
+        } else if (c == '\n' && has_digits) {
+            break;
+        }
+    }
+    return has_digits;
+}
+
+/**
+ * Play a story until it ends, taking choices from a script when given.
+ * Otherwise, choices are read from standard input.
+ */
+static int inkc_play(struct ink_story *story, struct inkc_script *script,
+                     bool quiet, struct inkc_stats *stats)
+{
+    struct ink_choice choice;
+
+    while (ink_story_can_continue(story)) {
+        size_t choice_index = 0;
+        size_t linelen = 0;
+        uint8_t *line = NULL;
+        int rc = ink_story_continue(story, &line, &linelen);
+
+        if (rc < 0) {
+            return rc;
+        }
+        if (line) {
+            stats->lines++;
+
+            if (!quiet) {
+                inkc_write(line, linelen);
+            }
+        }
+        while (ink_story_choice_next(story, &choice) >= 0) {
+            choice_index++;
+
+            if (!quiet) {
+                inkc_printf("%zu: ", choice_index);
+                inkc_write(choice.bytes, choice.length);
+                inkc_write("\n", 1);
+            }
+        }
+        if (choice_index > 0) {
+            if (!quiet) {
+                inkc_printf("> ");
+            }
+            if (script) {
+                if (!inkc_script_next(script, &choice_index)) {
+                    break;
+                }
+            } else {
+                inkc_flush();
+                if (scanf("%zu", &choice_index) != 1) {
+                    break;
+                }
+            }
+
+            rc = ink_story_choose(story, choice_index);
+            if (rc < 0) {
+                ink_error("Invalid choice %zu.", choice_index);
+                return rc;
+            }
+        }
+    }
+    return INK_E_OK;
+}
+
+static void inkc_print_stats(const struct inkc_stats *stats, size_t repeat)
+{
+    const double run_time = stats->run_time > 0.0 ? stats->run_time : 1e-9;
+
+    fprintf(stderr, "Repetitions: %zu\n", repeat);
+    fprintf(stderr, "Load time: %.3f ms (%.3f ms each)\n",
+            stats->load_time * 1000.0,
+            stats->load_time * 1000.0 / (double)repeat);
+    fprintf(stderr, "Run time: %.3f ms (%.3f ms each)\n",
+            stats->run_time * 1000.0,
+            stats->run_time * 1000.0 / (double)repeat);
+    fprintf(stderr, "Lines: %zu (%.0f per second)\n", stats->lines,
+            (double)stats->lines / run_time);
+    fprintf(stderr, "Instructions: %" PRIu64 " (%.0f per second)\n",
+            stats->instructions, (double)stats->instructions / run_time);
+}
+
+/**
+ * Determine if a file name refers to a compiled story bundle.
+ */
+static bool inkc_is_bundle(const char *filename)
+{
+    const char *const ext = ".inkb";
+    const size_t ext_length = strlen(ext);
+    const size_t length = strlen(filename);
+
+    return length > ext_length &&
+           strcmp(filename + length - ext_length, ext) == 0;
+}
+
+/**
+ * Parse a decimal number of at most `max`.
+ *
+ * Unlike `strtoull` alone, signs, surrounding blanks and out of range values
+ * are rejected.
+ */
+static bool inkc_parse_number(const char *arg, uint64_t max, uint64_t *value)
+{
+    char *arg_end = NULL;
+    unsigned long long n;
+
+    if (!arg || *arg < '0' || *arg > '9') {
+        return false;
+    }
+
+    errno = 0;
+    n = strtoull(arg, &arg_end, 10);
+    if (errno == ERANGE || *arg_end != '\0' || n > max) {
+        return false;
+    }
+
+    *value = (uint64_t)n;
+    return true;
+}
+
 static void inkc_render_error(const char *filename, int rc)
 {
     switch (-rc) {
@@ -86,26 +379,258 @@ static void inkc_render_error(const char *filename, int rc)
     case INK_E_STACK_OVERFLOW:
         ink_error("Stack overflow.");
         break;
+    case INK_E_INVALID_BUNDLE:
+        ink_error("Could not load `%s`. Invalid or out of date story bundle.",
+                  filename);
+        break;
+    case INK_E_INVALID_STATE:
+        ink_error("Invalid or out of date story state.");
+        break;
+    case INK_E_YIELD:
+        ink_error("Instruction budget exhausted.");
+        break;
     default:
         ink_error("Unknown error.");
         break;
     }
 }
 
+/**
+ * Describe why an explored branch stopped.
+ */
+static const char *inkc_dead_end_reason(int rc)
+{
+    switch (-rc) {
+    case INK_E_OK:
+        return "ran out of content";
+    case INK_E_YIELD:
+        return "instruction limit exceeded";
+    case INK_E_STACK_OVERFLOW:
+        return "stack overflow";
+    default:
+        return "runtime error";
+    }
+}
+
+static void inkc_print_report(const struct ink_explore_report *report)
+{
+    const size_t visited = report->path_count - report->unvisited_path_count;
+
+    printf("States: %zu (%zu duplicate, %zu truncated)\n", report->states,
+           report->duplicates, report->truncated);
+    printf("Max depth: %zu\n", report->max_depth);
+    printf("Endings: %zu\n", report->endings);
+    printf("Dead ends: %zu\n", report->dead_end_count);
+    printf("Coverage: %zu/%zu paths (%.1f%%)\n", visited, report->path_count,
+           report->path_count > 0
+               ? 100.0 * (double)visited / (double)report->path_count
+               : 100.0);
+
+    if (report->unvisited_path_count > 0) {
+        printf("\nUnvisited paths:\n");
+
+        for (size_t i = 0; i < report->unvisited_path_count; i++) {
+            printf("  %s\n", report->unvisited_paths[i]);
+        }
+    }
+    if (report->dead_end_count > 0) {
+        printf("\nDead ends:\n");
+
+        for (size_t i = 0; i < report->dead_end_count; i++) {
+            const struct ink_explore_dead_end *const dead_end =
+                &report->dead_ends[i];
+
+            printf(" ");
+            for (size_t j = 0; j < dead_end->depth; j++) {
+                printf(" %zu", dead_end->choices[j]);
+            }
+
+            printf("%s%s\n", dead_end->depth > 0 ? ": " : " (start): ",
+                   inkc_dead_end_reason(dead_end->rc));
+        }
+    }
+}
+
+/**
+ * Explore every choice of a story and print a report.
+ */
+static int inkc_explore(const struct ink_load_opts *load_opts,
+                        const struct ink_explore_opts *opts)
+{
+    int rc;
+    struct ink_program *program = NULL;
+    struct ink_explore_report report;
+
+    rc = ink_program_load_opts(&program, load_opts);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_program_explore(program, opts, &report);
+    if (rc == INK_E_OK) {
+        inkc_print_report(&report);
+        ink_explore_report_deinit(&report);
+    }
+
+    ink_program_close(program);
+    return rc;
+}
+
+/**
+ * Print a bar of a histogram, scaled against the largest count.
+ */
+static void inkc_print_bar(size_t count, size_t count_max)
+{
+    const size_t width =
+        count_max > 0 ? count * INKC_HISTOGRAM_WIDTH / count_max : 0;
+
+    for (size_t i = 0; i < width; i++) {
+        putchar('#');
+    }
+    for (size_t i = width; i < INKC_HISTOGRAM_WIDTH; i++) {
+        putchar(' ');
+    }
+}
+
+static void inkc_print_simulation(const struct ink_simulate_report *report)
+{
+    const double playthroughs =
+        report->playthroughs > 0 ? (double)report->playthroughs : 1.0;
+    size_t turns_min = 0;
+    size_t turns_total = 0;
+    size_t count_max = 0;
+
+    for (size_t i = 0; i <= report->turns_max && report->turns; i++) {
+        if (report->turns[i] > 0 && turns_total == 0) {
+            turns_min = i;
+        }
+        if (report->turns[i] > count_max) {
+            count_max = report->turns[i];
+        }
+
+        turns_total += report->turns[i] * i;
+    }
+
+    printf("Playthroughs: %zu (%zu endings, %zu dead ends, %zu truncated)\n",
+           report->playthroughs, report->endings, report->dead_ends,
+           report->truncated);
+    printf("Choices: %.1f mean, %zu min, %zu max\n",
+           (double)turns_total / playthroughs, turns_min, report->turns_max);
+    printf("Instructions: %.1f mean\n",
+           (double)report->instructions / playthroughs);
+
+    if (report->turns) {
+        printf("\nChoices taken:\n");
+
+        for (size_t i = 0; i <= report->turns_max; i++) {
+            printf("  %4zu |", i);
+            inkc_print_bar(report->turns[i], count_max);
+            printf("| %zu\n", report->turns[i]);
+        }
+    }
+    if (report->path_count > 0) {
+        printf("\nPaths reached:\n");
+
+        for (size_t i = 0; i < report->path_count; i++) {
+            const struct ink_simulate_path *const path = &report->paths[i];
+
+            printf("  %6.1f%%  %s\n",
+                   100.0 * (double)path->playthroughs / playthroughs,
+                   path->name);
+        }
+    }
+    for (size_t i = 0; i < report->global_count; i++) {
+        const struct ink_simulate_global *const global = &report->globals[i];
+
+        printf("\nFinal values of %s:\n", global->name);
+
+        for (size_t j = 0; j < global->bin_count; j++) {
+            printf("  %6.1f%%  %s\n",
+                   100.0 * (double)global->bins[j].count / playthroughs,
+                   global->bins[j].value);
+        }
+    }
+}
+
+/**
+ * Simulate playthroughs of a story and print statistics about them.
+ */
+static int inkc_simulate(const struct ink_load_opts *load_opts,
+                         const struct ink_simulate_opts *opts)
+{
+    int rc;
+    struct ink_program *program = NULL;
+    struct ink_simulate_report report;
+
+    rc = ink_program_load_opts(&program, load_opts);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_program_simulate(program, opts, &report);
+    if (rc == INK_E_OK) {
+        inkc_print_simulation(&report);
+        ink_simulate_report_deinit(&report);
+    }
+
+    ink_program_close(program);
+    return rc;
+}
+
 int main(int argc, char *argv[])
 {
     struct ink_source source;
-    struct ink_choice choice;
+    struct ink_source input = {
+        .bytes = NULL,
+        .length = 0,
+        .is_mapped = false,
+    };
+    struct inkc_script script = {
+        .bytes = NULL,
+        .length = 0,
+        .offset = 0,
+    };
+    struct inkc_stats stats = {
+        .load_time = 0.0,
+        .run_time = 0.0,
+        .lines = 0,
+        .instructions = 0,
+    };
     bool compile_only = false;
     bool use_stdin = false;
+    bool use_bundle = false;
+    bool explore = false;
+    bool simulate = false;
+    bool quiet = false;
+    bool show_time = false;
     int flags = INK_F_GC_ENABLE | INK_F_GC_STRESS;
     int opt = 0;
     int rc = -1;
-    size_t choice_index = 0;
-    size_t linelen = 0;
-    uint8_t *line = NULL;
+    int status = EXIT_SUCCESS;
+    size_t repeat = 1;
+    uint64_t number = 0;
     const char *filename = NULL;
+    const char *bundle_path = NULL;
+    const char *input_path = NULL;
+    const char *arg = NULL;
     struct ink_story *story = NULL;
+    struct ink_explore_opts explore_opts = {
+        .order = INK_EXPLORE_BFS,
+        .thread_count = 0,
+        .max_depth = 0,
+        .max_states = 0,
+        .max_instructions = INKC_EXPLORE_MAX_INSTRUCTIONS,
+    };
+    struct ink_simulate_opts simulate_opts = {
+        .policy = INK_SIMULATE_RANDOM,
+        .weight = NULL,
+        .userdata = NULL,
+        .playthrough_count = 0,
+        .thread_count = 0,
+        .seed = 0,
+        .max_turns = 0,
+        .max_instructions = INKC_EXPLORE_MAX_INSTRUCTIONS,
+    };
 
     option_setopts(cli_options, argv);
 
@@ -121,20 +646,103 @@ int main(int argc, char *argv[])
             flags |= INK_F_GC_TRACING;
             break;
         case OPT_CACHING:
-            /* flags |= INK_F_CACHING; */
+            flags |= INK_F_CACHING;
             break;
         case OPT_DUMP_AST:
             flags |= INK_F_DUMP_AST;
             break;
+        case OPT_PARALLEL:
+            flags |= INK_F_PARALLEL;
+            break;
         case OPT_DUMP_STORY:
             flags |= INK_F_DUMP_CODE;
             break;
         case OPT_COMPILE_ONLY:
+            compile_only = true;
+            break;
+        case OPT_COMPILE_TO:
+            bundle_path = option_nextarg();
+            if (!bundle_path || *bundle_path == '\0') {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
             compile_only = true;
             break;
         case OPT_STDIN:
             use_stdin = true;
             break;
+        case OPT_EXPLORE:
+            explore = true;
+            break;
+        case OPT_DFS:
+            explore_opts.order = INK_EXPLORE_DFS;
+            break;
+        case OPT_MAX_DEPTH:
+            if (!inkc_parse_number(option_nextarg(), SIZE_MAX, &number)) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            explore_opts.max_depth = (size_t)number;
+            simulate_opts.max_turns = explore_opts.max_depth;
+            break;
+        case OPT_SIMULATE:
+            if (!inkc_parse_number(option_nextarg(), SIZE_MAX, &number) ||
+                number == 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            simulate_opts.playthrough_count = (size_t)number;
+            simulate = true;
+            break;
+        case OPT_POLICY:
+            arg = option_nextarg();
+            if (!arg) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            if (strcmp(arg, "random") == 0) {
+                simulate_opts.policy = INK_SIMULATE_RANDOM;
+            } else if (strcmp(arg, "weighted") == 0) {
+                simulate_opts.policy = INK_SIMULATE_WEIGHTED;
+            } else {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_SEED:
+            if (!inkc_parse_number(option_nextarg(), UINT64_MAX,
+                                   &simulate_opts.seed)) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_INPUT:
+            input_path = option_nextarg();
+            if (!input_path || *input_path == '\0') {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_REPEAT:
+            if (!inkc_parse_number(option_nextarg(), SIZE_MAX, &number) ||
+                number == 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            repeat = (size_t)number;
+            flags &= ~INK_F_GC_STRESS;
+            break;
+        case OPT_QUIET:
+            quiet = true;
+            break;
+        case OPT_TIME:
+            show_time = true;
+            flags &= ~INK_F_GC_STRESS;
+            break;
         case OPTION_UNKNOWN:
             fprintf(stderr, "Unrecognised option %s.\n\n", option_unknown_opt);
             print_usage(argv[0]);
@@ -158,6 +766,12 @@ int main(int argc, char *argv[])
             print_usage(argv[0]);
             return EXIT_FAILURE;
         }
+    } else if (inkc_is_bundle(filename)) {
+        source.bytes = NULL;
+        source.length = 0;
+        source.is_mapped = false;
+        use_bundle = true;
+        rc = INK_E_OK;
     } else {
         rc = ink_source_load(filename, &source);
     }
@@ -166,52 +780,110 @@ int main(int argc, char *argv[])
         return rc;
     }
 
-    story = ink_open();
-    if (!story) {
-        goto out;
+    if (explore || simulate) {
+        const struct ink_load_opts opts = {
+            .source_bytes = source.bytes,
+            .source_length = source.length,
+            .filename = (uint8_t *)filename,
+            .flags = flags,
+        };
+
+        if (use_bundle) {
+            rc = -INK_E_INVALID_ARG;
+        } else if (explore) {
+            rc = inkc_explore(&opts, &explore_opts);
+        } else {
+            rc = inkc_simulate(&opts, &simulate_opts);
+        }
+        if (rc < 0) {
+            inkc_render_error(filename, rc);
+        }
+
+        ink_source_free(&source);
+        return rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
-    const struct ink_load_opts opts = {
-        .source_bytes = source.bytes,
-        .source_length = source.length,
-        .filename = (uint8_t *)filename,
-        .flags = flags,
-    };
+    if (input_path) {
+        rc = ink_source_load_raw(input_path, &input);
+        if (rc < 0) {
+            inkc_render_error(input_path, rc);
+            ink_source_free(&source);
+            return EXIT_FAILURE;
+        }
 
-    rc = ink_story_load_opts(story, &opts);
-    if (rc < 0) {
-        /* TODO(Brett): Returning EXIT_FAILURE breaks llvm-lit. Look for a
-         * workaround */
-        goto out;
+        script.bytes = input.bytes;
+        script.length = input.length;
     }
-    if (!compile_only) {
-        while (ink_story_can_continue(story)) {
-            line = NULL;
-            linelen = 0;
-            choice_index = 0;
 
-            if (ink_story_continue(story, &line, &linelen) < 0) {
-                goto out;
-            }
-            if (line) {
-                printf("%.*s", (int)linelen, line);
+    /* Traces are interleaved with the output of the story as it runs. */
+    inkc_output.is_buffered =
+        !(flags & (INK_F_VM_TRACING | INK_F_GC_TRACING));
+
+    for (size_t i = 0; i < repeat; i++) {
+        double time_start = inkc_clock();
+
+        story = ink_open();
+        if (!story) {
+            goto out;
+        }
+        if (use_bundle) {
+            rc = ink_story_load_bundle(story, filename, flags);
+        } else {
+            const struct ink_load_opts opts = {
+                .source_bytes = source.bytes,
+                .source_length = source.length,
+                .filename = (uint8_t *)filename,
+                .flags = flags,
+            };
+
+            rc = ink_story_load_opts(story, &opts);
+        }
+
+        stats.load_time += inkc_clock() - time_start;
+
+        if (rc < 0) {
+            if (rc == -INK_E_INVALID_BUNDLE) {
+                inkc_render_error(filename, rc);
             }
-            while (ink_story_choice_next(story, &choice) >= 0) {
-                printf("%zu: %.*s\n", ++choice_index, (int)choice.length,
-                       choice.bytes);
+            /* TODO(Brett): Returning EXIT_FAILURE breaks llvm-lit. Look for a
+             * workaround */
+            goto out;
+        }
+        if (bundle_path && i == 0) {
+            rc = ink_story_save_bundle(story, bundle_path);
+            if (rc < 0) {
+                inkc_render_error(bundle_path, rc);
+                goto out;
             }
-            if (choice_index > 0) {
-                printf("> ");
-                scanf("%zu", &choice_index);
-                ink_story_choose(story, choice_index);
+        }
+        if (!compile_only) {
+            script.offset = 0;
+            time_start = inkc_clock();
+            rc = inkc_play(story, input_path ? &script : NULL, quiet, &stats);
+            stats.run_time += inkc_clock() - time_start;
+            stats.instructions += ink_story_instruction_count(story);
+
+            if (rc < 0) {
+                /* The story stopped on an error, such as a stack overflow. */
+                status = EXIT_FAILURE;
+                goto out;
             }
         }
+
+        ink_close(story);
+        story = NULL;
     }
-    if (rc < 0) {
-        inkc_render_error(filename, rc);
+    if (show_time) {
+        inkc_flush();
+        inkc_print_stats(&stats, repeat);
     }
 out:
-    ink_close(story);
+    inkc_flush();
+    if (story) {
+        ink_close(story);
+    }
+
+    ink_source_free(&input);
     ink_source_free(&source);
-    return EXIT_SUCCESS;
+    return status;
 }
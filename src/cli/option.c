@@ -63,6 +63,9 @@ char *option_nextarg(void)
     char *arg = _g_arg_ptr;
     char *arg_p = arg;
 
+    if (!arg) {
+        return NULL;
+    }
     while (*arg_p != '\0' && *arg_p != ',') {
         ++arg_p;
     }
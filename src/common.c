@@ -13,3 +13,87 @@ uint32_t ink_fnv32a(const uint8_t *data, size_t length)
     }
     return hash;
 }
+
+#define INK_HASH_SEED (0x9e3779b97f4a7c15ull)
+#define INK_HASH_MULTIPLIER (0x517cc1b727220a95ull)
+
+static inline uint64_t ink_hash_rotl(uint64_t x, unsigned int n)
+{
+    return (x << n) | (x >> (64u - n));
+}
+
+static inline uint64_t ink_hash_mix(uint64_t hash, uint64_t word)
+{
+    return (ink_hash_rotl(hash, 5) ^ word) * INK_HASH_MULTIPLIER;
+}
+
+/**
+ * Avalanche the bits of a 64-bit value.
+ */
+static inline uint32_t ink_hash_finalize(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return (uint32_t)hash;
+}
+
+/**
+ * Load a little-endian 64-bit word.
+ */
+static inline uint64_t ink_hash_load64(const uint8_t *data)
+{
+    uint64_t word = 0;
+
+    for (size_t i = 0; i < sizeof(word); i++) {
+        word |= (uint64_t)data[i] << (i * 8);
+    }
+    return word;
+}
+
+/**
+ * Load a little-endian 32-bit word.
+ */
+static inline uint32_t ink_hash_load32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * Hash a range of bytes, consuming a machine word at a time.
+ *
+ * Words are loaded in little-endian order, so the result is the same on
+ * every host and may be persisted in compiled bundles.
+ */
+uint32_t ink_hash_bytes(const uint8_t *data, size_t length)
+{
+    uint64_t hash = INK_HASH_SEED ^ (uint64_t)length;
+
+    while (length >= sizeof(uint64_t)) {
+        hash = ink_hash_mix(hash, ink_hash_load64(data));
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+    if (length >= sizeof(uint32_t)) {
+        hash = ink_hash_mix(hash, ink_hash_load32(data));
+        data += sizeof(uint32_t);
+        length -= sizeof(uint32_t);
+    }
+    while (length > 0) {
+        hash = ink_hash_mix(hash, *data);
+        data++;
+        length--;
+    }
+    return ink_hash_finalize(hash);
+}
+
+/**
+ * Hash a pointer value.
+ */
+uint32_t ink_hash_ptr(const void *ptr)
+{
+    return ink_hash_finalize((uint64_t)(uintptr_t)ptr);
+}
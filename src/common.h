@@ -4,23 +4,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <ink/ink.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-enum ink_status {
-    INK_E_OK,
-    INK_E_FAIL,
-    INK_E_PANIC,
-    INK_E_OOM,
-    INK_E_OS,
-    INK_E_FILE,
-    INK_E_OVERWRITE,
-    INK_E_INVALID_OPTION,
-    INK_E_INVALID_INST,
-    INK_E_INVALID_ARG,
-    INK_E_STACK_OVERFLOW,
-};
+#if defined(__GNUC__) || defined(__clang__)
+#define INK_MAYBE_UNUSED __attribute__((unused))
+#else
+#define INK_MAYBE_UNUSED
+#endif
 
 #define INK_VA_ARGS_NTH(_1, _2, _3, _4, _5, N, ...) N
 #define INK_VA_ARGS_COUNT(...) INK_VA_ARGS_NTH(__VA_ARGS__, 5, 4, 3, 2, 1, 0)
@@ -42,6 +36,8 @@ enum ink_status {
     INK_DISPATCHER(func, INK_VA_ARGS_COUNT(__VA_ARGS__), __VA_ARGS__)
 
 extern uint32_t ink_fnv32a(const uint8_t *data, size_t length);
+extern uint32_t ink_hash_bytes(const uint8_t *data, size_t length);
+extern uint32_t ink_hash_ptr(const void *ptr);
 
 extern const char *INK_DEFAULT_PATH;
 
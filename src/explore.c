@@ -0,0 +1,484 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ink/ink.h>
+
+#include "common.h"
+#include "explore.h"
+#include "memory.h"
+#include "object.h"
+#include "state.h"
+#include "story.h"
+#include "thread.h"
+
+/**
+ * Run a session until its next set of choices, and record the outcome.
+ *
+ * Returns a non-zero value if the branch could not be recorded. Errors raised
+ * by the story itself make the branch a dead end.
+ */
+static int ink_explore_step(const struct ink_explorer *explorer,
+                            struct ink_story *session,
+                            struct ink_explore_branch *branch)
+{
+    int rc;
+    const uint8_t *bytes = NULL;
+    size_t length = 0;
+    struct ink_turn turn;
+
+    if (explorer->opts.max_instructions > 0) {
+        rc = ink_story_continue_budget(session, explorer->opts.max_instructions,
+                                       &turn);
+    } else {
+        rc = ink_story_continue_all(session, &turn);
+    }
+
+    branch->rc = rc;
+    branch->hash = 0;
+    branch->bytes = NULL;
+    branch->length = 0;
+
+    if (rc < 0) {
+        branch->outcome = INK_EXPLORE_DEAD_END;
+        return INK_E_OK;
+    }
+    if (turn.choice_count == 0) {
+        branch->outcome =
+            session->is_exited ? INK_EXPLORE_ENDING : INK_EXPLORE_DEAD_END;
+        return INK_E_OK;
+    }
+
+    rc = ink_story_save_state(session, &bytes, &length);
+    if (rc < 0) {
+        return rc;
+    }
+
+    branch->bytes = ink_malloc(length);
+    if (!branch->bytes) {
+        return -INK_E_OOM;
+    }
+
+    /* States are compared by their bytes, which must not depend on how many
+     * states were saved before. */
+    memcpy(branch->bytes, bytes, length);
+    ink_state_set_checkpoint(branch->bytes, 1, 1);
+    branch->outcome = INK_EXPLORE_CHOICES;
+    branch->hash = ink_hash_bytes(branch->bytes, length);
+    branch->length = length;
+    return INK_E_OK;
+}
+
+/**
+ * Take every choice of a choice point, each in a fork of its saved state.
+ */
+static void ink_explore_expand(void *context, size_t index)
+{
+    int rc;
+    struct ink_explorer *const explorer = context;
+    struct ink_explore_task *const task = &explorer->tasks[index];
+    const struct ink_explore_node *const node =
+        &explorer->nodes.entries[task->node];
+    struct ink_story *const base =
+        ink_session_open(explorer->program, INK_F_GC_ENABLE);
+    size_t choice_count = 0;
+
+    ink_explore_branch_vec_shrink(&task->branches, 0);
+
+    if (!base) {
+        task->rc = -INK_E_OOM;
+        return;
+    }
+
+    rc = ink_story_load_state(base, node->bytes, node->length);
+    if (rc < 0) {
+        goto out;
+    }
+
+    base->coverage = &task->coverage;
+    choice_count = base->current_choices.count;
+
+    for (size_t i = 1; i <= choice_count; i++) {
+        struct ink_story *session = base;
+        struct ink_explore_branch branch = {
+            .parent = task->node,
+            .choice_index = i,
+        };
+
+        /* The last choice is taken in the loaded session itself. */
+        if (i < choice_count) {
+            rc = ink_story_fork(base, &session);
+            if (rc < 0) {
+                goto out;
+            }
+
+            session->coverage = &task->coverage;
+        }
+
+        rc = ink_story_choose(session, i);
+        if (rc == INK_E_OK) {
+            rc = ink_explore_step(explorer, session, &branch);
+        }
+        if (rc == INK_E_OK) {
+            rc = ink_explore_branch_vec_push(&task->branches, branch);
+            if (rc < 0) {
+                ink_free(branch.bytes);
+            }
+        }
+        if (session != base) {
+            ink_close(session);
+        }
+        if (rc < 0) {
+            goto out;
+        }
+    }
+out:
+    task->rc = rc;
+    ink_close(base);
+}
+
+/**
+ * Merge a branch into the results, taking ownership of its saved state.
+ */
+static int ink_explore_merge(struct ink_explorer *explorer,
+                             const struct ink_explore_branch *branch)
+{
+    int rc;
+    size_t index = 0;
+    struct ink_explore_report *const report = explorer->report;
+    struct ink_explore_node node = {
+        .parent = branch->parent,
+        .choice_index = branch->choice_index,
+        .depth = 0,
+        .hash = branch->hash,
+        .bytes = branch->bytes,
+        .length = branch->length,
+    };
+    const struct ink_explore_key key = {
+        .bytes = branch->bytes,
+        .length = branch->length,
+        .hash = branch->hash,
+    };
+
+    switch (branch->outcome) {
+    case INK_EXPLORE_ENDING:
+        report->endings++;
+        return INK_E_OK;
+    case INK_EXPLORE_DEAD_END: {
+        const struct ink_explore_leaf leaf = {
+            .rc = branch->rc,
+            .parent = branch->parent,
+            .choice_index = branch->choice_index,
+        };
+
+        return ink_explore_leaf_vec_push(&explorer->dead_ends, leaf);
+    }
+    case INK_EXPLORE_CHOICES:
+        break;
+    }
+    if (ink_explore_map_lookup(&explorer->states, key, &index) == INK_E_OK) {
+        report->duplicates++;
+        ink_free(branch->bytes);
+        return INK_E_OK;
+    }
+    if (explorer->opts.max_states > 0 &&
+        explorer->nodes.count >= explorer->opts.max_states) {
+        report->truncated++;
+        ink_free(branch->bytes);
+        return INK_E_OK;
+    }
+    if (branch->parent != INK_EXPLORE_ROOT) {
+        node.depth = explorer->nodes.entries[branch->parent].depth + 1;
+    }
+
+    index = explorer->nodes.count;
+    rc = ink_explore_node_vec_push(&explorer->nodes, node);
+    if (rc < 0) {
+        ink_free(branch->bytes);
+        return rc;
+    }
+
+    rc = ink_explore_map_insert(&explorer->states, key, index);
+    if (rc < 0) {
+        return rc;
+    }
+    if (node.depth > report->max_depth) {
+        report->max_depth = node.depth;
+    }
+    if (explorer->opts.max_depth > 0 &&
+        node.depth >= explorer->opts.max_depth) {
+        report->truncated++;
+        return INK_E_OK;
+    }
+    return ink_explore_index_vec_push(&explorer->frontier, index);
+}
+
+/**
+ * Merge content paths entered by a task into the overall coverage.
+ */
+static int ink_explore_merge_coverage(struct ink_explorer *explorer,
+                                      struct ink_object_set *coverage)
+{
+    for (size_t i = 0; i < coverage->capacity; i++) {
+        const struct ink_object_set_kv *const entry = &coverage->entries[i];
+
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED) {
+            const int rc =
+                ink_object_set_insert(&explorer->coverage, entry->key, NULL);
+
+            if (rc < 0 && rc != -INK_E_OVERWRITE) {
+                return rc;
+            }
+        }
+    }
+
+    ink_object_set_clear(coverage);
+    return INK_E_OK;
+}
+
+/**
+ * Run the start of the story up to its first set of choices.
+ */
+static int ink_explore_start(struct ink_explorer *explorer)
+{
+    int rc;
+    struct ink_story *const session =
+        ink_session_open(explorer->program, INK_F_GC_ENABLE);
+    struct ink_explore_branch branch = {
+        .parent = INK_EXPLORE_ROOT,
+        .choice_index = 0,
+    };
+    const struct ink_object_set_key key = {
+        .obj = session ? session->current_path : NULL,
+    };
+
+    if (!session) {
+        return -INK_E_OOM;
+    }
+    if (key.obj) {
+        rc = ink_object_set_insert(&explorer->coverage, key, NULL);
+        if (rc < 0) {
+            goto out;
+        }
+    }
+
+    session->coverage = &explorer->coverage;
+
+    rc = ink_explore_step(explorer, session, &branch);
+    if (rc == INK_E_OK) {
+        rc = ink_explore_merge(explorer, &branch);
+    }
+out:
+    ink_close(session);
+    return rc;
+}
+
+/**
+ * Expand a batch of choice points from the frontier on the worker threads.
+ */
+static int ink_explore_round(struct ink_explorer *explorer,
+                             size_t thread_count)
+{
+    int rc = INK_E_OK;
+    struct ink_explore_index_vec *const frontier = &explorer->frontier;
+    size_t batch = frontier->count - explorer->frontier_head;
+
+    if (batch > explorer->task_count) {
+        batch = explorer->task_count;
+    }
+    for (size_t i = 0; i < batch; i++) {
+        struct ink_explore_task *const task = &explorer->tasks[i];
+
+        if (explorer->opts.order == INK_EXPLORE_DFS) {
+            task->node = ink_explore_index_vec_pop(frontier);
+        } else {
+            task->node = frontier->entries[explorer->frontier_head++];
+        }
+    }
+    if (explorer->frontier_head == frontier->count) {
+        explorer->frontier_head = 0;
+        ink_explore_index_vec_shrink(frontier, 0);
+    }
+
+    ink_parallel_for(batch, thread_count, ink_explore_expand, explorer);
+
+    for (size_t i = 0; i < batch; i++) {
+        struct ink_explore_task *const task = &explorer->tasks[i];
+
+        if (rc == INK_E_OK) {
+            rc = task->rc;
+        }
+        for (size_t j = 0; j < task->branches.count; j++) {
+            const struct ink_explore_branch *const branch =
+                &task->branches.entries[j];
+
+            if (rc == INK_E_OK) {
+                rc = ink_explore_merge(explorer, branch);
+            } else {
+                ink_free(branch->bytes);
+            }
+        }
+        if (rc == INK_E_OK) {
+            rc = ink_explore_merge_coverage(explorer, &task->coverage);
+        }
+    }
+    return rc;
+}
+
+/**
+ * Fill in the coverage and dead end sections of the report.
+ */
+static int ink_explore_finish(struct ink_explorer *explorer)
+{
+    size_t iter = 0;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    struct ink_explore_report *const report = explorer->report;
+    const struct ink_object *const paths = explorer->program->story->paths;
+    const size_t dead_end_count = explorer->dead_ends.count;
+
+    report->states = explorer->nodes.count;
+    report->path_count = INK_OBJ_AS_TABLE(paths)->count;
+    report->unvisited_paths =
+        ink_malloc(sizeof(*report->unvisited_paths) * report->path_count);
+    if (!report->unvisited_paths) {
+        return -INK_E_OOM;
+    }
+    while (ink_table_next(paths, &iter, &key, &value) == INK_E_OK) {
+        const struct ink_object_set_key path_key = {
+            .obj = value,
+        };
+        void *unused = NULL;
+
+        if (ink_object_set_lookup(&explorer->coverage, path_key, &unused) < 0) {
+            report->unvisited_paths[report->unvisited_path_count++] =
+                (const char *)INK_OBJ_AS_STRING(key)->bytes;
+        }
+    }
+    if (dead_end_count == 0) {
+        return INK_E_OK;
+    }
+
+    report->dead_ends =
+        ink_malloc(sizeof(*report->dead_ends) * dead_end_count);
+    if (!report->dead_ends) {
+        return -INK_E_OOM;
+    }
+    for (size_t i = 0; i < dead_end_count; i++) {
+        const struct ink_explore_leaf *const leaf =
+            &explorer->dead_ends.entries[i];
+        struct ink_explore_dead_end *const dead_end =
+            &report->dead_ends[report->dead_end_count];
+        size_t depth = 0;
+        size_t parent = leaf->parent;
+
+        if (parent != INK_EXPLORE_ROOT) {
+            depth = explorer->nodes.entries[parent].depth + 1;
+        }
+
+        dead_end->rc = leaf->rc;
+        dead_end->depth = depth;
+        dead_end->choices = NULL;
+
+        if (depth > 0) {
+            dead_end->choices = ink_malloc(sizeof(*dead_end->choices) * depth);
+            if (!dead_end->choices) {
+                return -INK_E_OOM;
+            }
+
+            dead_end->choices[depth - 1] = leaf->choice_index;
+
+            for (size_t j = depth - 1; j > 0; j--) {
+                const struct ink_explore_node *const node =
+                    &explorer->nodes.entries[parent];
+
+                dead_end->choices[j - 1] = node->choice_index;
+                parent = node->parent;
+            }
+        }
+
+        report->dead_end_count++;
+    }
+    return INK_E_OK;
+}
+
+int ink_program_explore(struct ink_program *program,
+                        const struct ink_explore_opts *opts,
+                        struct ink_explore_report *report)
+{
+    int rc;
+    size_t thread_count = opts->thread_count;
+    struct ink_explorer explorer;
+
+    memset(report, 0, sizeof(*report));
+
+    if (thread_count == 0) {
+        thread_count = ink_thread_count();
+    }
+
+    explorer.program = program;
+    explorer.opts = *opts;
+    explorer.task_count = thread_count * INK_EXPLORE_BATCH;
+    explorer.frontier_head = 0;
+    explorer.report = report;
+    ink_explore_index_vec_init(&explorer.frontier);
+    ink_explore_node_vec_init(&explorer.nodes);
+    ink_explore_leaf_vec_init(&explorer.dead_ends);
+    ink_explore_map_init(&explorer.states, INK_EXPLORE_LOAD_MAX);
+    ink_object_set_init(&explorer.coverage, INK_OBJECT_SET_LOAD_MAX);
+
+    explorer.tasks = ink_malloc(sizeof(*explorer.tasks) * explorer.task_count);
+    if (!explorer.tasks) {
+        rc = -INK_E_OOM;
+        goto out;
+    }
+    for (size_t i = 0; i < explorer.task_count; i++) {
+        struct ink_explore_task *const task = &explorer.tasks[i];
+
+        task->rc = INK_E_OK;
+        task->node = 0;
+        ink_explore_branch_vec_init(&task->branches);
+        ink_object_set_init(&task->coverage, INK_OBJECT_SET_LOAD_MAX);
+    }
+
+    rc = ink_explore_start(&explorer);
+    while (rc == INK_E_OK && explorer.frontier.count > 0) {
+        rc = ink_explore_round(&explorer, thread_count);
+    }
+    if (rc == INK_E_OK) {
+        rc = ink_explore_finish(&explorer);
+    }
+    if (explorer.tasks) {
+        for (size_t i = 0; i < explorer.task_count; i++) {
+            ink_explore_branch_vec_deinit(&explorer.tasks[i].branches);
+            ink_object_set_deinit(&explorer.tasks[i].coverage);
+        }
+    }
+out:
+    for (size_t i = 0; i < explorer.nodes.count; i++) {
+        ink_free(explorer.nodes.entries[i].bytes);
+    }
+
+    ink_free(explorer.tasks);
+    ink_object_set_deinit(&explorer.coverage);
+    ink_explore_map_deinit(&explorer.states);
+    ink_explore_leaf_vec_deinit(&explorer.dead_ends);
+    ink_explore_node_vec_deinit(&explorer.nodes);
+    ink_explore_index_vec_deinit(&explorer.frontier);
+
+    if (rc < 0) {
+        ink_explore_report_deinit(report);
+    }
+    return rc;
+}
+
+void ink_explore_report_deinit(struct ink_explore_report *report)
+{
+    for (size_t i = 0; i < report->dead_end_count; i++) {
+        ink_free(report->dead_ends[i].choices);
+    }
+
+    ink_free(report->dead_ends);
+    ink_free(report->unvisited_paths);
+    memset(report, 0, sizeof(*report));
+}
@@ -0,0 +1,136 @@
+#ifndef INK_EXPLORE_H
+#define INK_EXPLORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ink/ink.h>
+
+#include "common.h"
+#include "hashmap.h"
+#include "object.h"
+#include "story.h"
+#include "vec.h"
+
+#define INK_EXPLORE_LOAD_MAX (80ul)
+/* Choice points expanded per thread in each round. */
+#define INK_EXPLORE_BATCH (32u)
+/* Parent of the branch that starts the story. */
+#define INK_EXPLORE_ROOT SIZE_MAX
+
+enum ink_explore_outcome {
+    INK_EXPLORE_CHOICES,
+    INK_EXPLORE_ENDING,
+    INK_EXPLORE_DEAD_END,
+};
+
+/**
+ * Choice point reached during exploration.
+ */
+struct ink_explore_node {
+    size_t parent;
+    size_t choice_index;
+    size_t depth;
+    uint32_t hash;
+    /* Saved runtime state of the choice point. */
+    uint8_t *bytes;
+    size_t length;
+};
+
+/**
+ * Result of taking a choice from a choice point.
+ *
+ * For branches that reach another choice point, `bytes` holds its saved
+ * state until the branch is merged.
+ */
+struct ink_explore_branch {
+    enum ink_explore_outcome outcome;
+    int rc;
+    size_t parent;
+    size_t choice_index;
+    uint32_t hash;
+    uint8_t *bytes;
+    size_t length;
+};
+
+/**
+ * Branch that stopped without reaching the end of the story.
+ */
+struct ink_explore_leaf {
+    int rc;
+    size_t parent;
+    size_t choice_index;
+};
+
+struct ink_explore_key {
+    const uint8_t *bytes;
+    size_t length;
+    uint32_t hash;
+};
+
+/**
+ * Hash function for explored states.
+ */
+static inline uint32_t ink_explore_key_hash(const void *key, size_t length)
+{
+    const struct ink_explore_key *const k = key;
+
+    return k->hash;
+}
+
+/**
+ * Key comparison function for explored states.
+ */
+static inline bool ink_explore_key_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_explore_key *const key_lhs = lhs;
+    const struct ink_explore_key *const key_rhs = rhs;
+
+    return key_lhs->length == key_rhs->length &&
+           memcmp(key_lhs->bytes, key_rhs->bytes, key_lhs->length) == 0;
+}
+
+INK_VEC_T(ink_explore_node_vec, struct ink_explore_node)
+INK_VEC_T(ink_explore_branch_vec, struct ink_explore_branch)
+INK_VEC_T(ink_explore_leaf_vec, struct ink_explore_leaf)
+INK_VEC_T(ink_explore_index_vec, size_t)
+INK_HASHMAP_T_EX(ink_explore_map, struct ink_explore_key, size_t,
+                 ink_explore_key_hash, ink_explore_key_cmp)
+
+/**
+ * Choice point being expanded by a worker thread.
+ */
+struct ink_explore_task {
+    int rc;
+    size_t node;
+    struct ink_explore_branch_vec branches;
+    /* Content paths entered while expanding the choice point. */
+    struct ink_object_set coverage;
+};
+
+struct ink_explorer {
+    struct ink_program *program;
+    struct ink_explore_opts opts;
+    size_t task_count;
+    struct ink_explore_task *tasks;
+    /* Choice points waiting to be expanded, starting at `frontier_head`. */
+    size_t frontier_head;
+    struct ink_explore_index_vec frontier;
+    struct ink_explore_node_vec nodes;
+    struct ink_explore_map states;
+    struct ink_explore_leaf_vec dead_ends;
+    struct ink_object_set coverage;
+    struct ink_explore_report *report;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -122,16 +122,21 @@ void ink_gc_collect(struct ink_story *story)
     for (size_t i = 0; i < story->gc_owned.capacity; i++) {
         struct ink_object_set_kv *const entry = &story->gc_owned.entries[i];
 
-        if (entry->key.obj) {
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED) {
             ink_gc_mark_object(story, INK_OBJ(entry->key.obj));
         }
     }
 
     ink_gc_mark_object(story, story->globals);
     ink_gc_mark_object(story, story->paths);
+    ink_gc_mark_object(story, story->prior_paths);
+    ink_gc_mark_object(story, story->initial_globals);
     ink_gc_mark_object(story, story->current_path);
     ink_gc_mark_object(story, story->current_choice_id);
 
+    for (size_t i = 0; i < story->output_spans.count; i++) {
+        ink_gc_mark_object(story, story->output_spans.entries[i]);
+    }
     for (size_t i = 0; i < story->current_choices.count; i++) {
         struct ink_choice *const choice = &story->current_choices.entries[i];
 
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "common.h"
@@ -19,15 +20,21 @@ extern "C" {
 enum ink_hashmap_entry_state {
     INK_HASHMAP_IS_EMPTY = 0,
     INK_HASHMAP_IS_OCCUPIED,
-    INK_HASHMAP_IS_DELETED,
 };
 
+/*
+ * Hashmap template with hashing and key comparison supplied at runtime.
+ *
+ * Functions for key comparison and hashing are stored within the hashmap and
+ * called indirectly.
+ */
 #define INK_HASHMAP_T(__T, __K, __V)                                           \
     /**                                                                        \
      * Hashmap bucket.                                                         \
      */                                                                        \
     struct __T##_kv {                                                          \
         enum ink_hashmap_entry_state state;                                    \
+        uint32_t hash;                                                         \
         __K key;                                                               \
         __V value;                                                             \
     };                                                                         \
@@ -41,6 +48,18 @@ enum ink_hashmap_entry_state {
         bool (*compare)(const void *lhs, const void *rhs);                     \
     };                                                                         \
                                                                                \
+    static inline uint32_t __T##_hash_of(const struct __T *self,               \
+                                         const __K *key)                       \
+    {                                                                          \
+        return self->hasher(key, sizeof(__K));                                 \
+    }                                                                          \
+                                                                               \
+    static inline bool __T##_keys_equal(const struct __T *self,                \
+                                        const __K *lhs, const __K *rhs)        \
+    {                                                                          \
+        return self->compare(lhs, rhs);                                        \
+    }                                                                          \
+                                                                               \
     /**                                                                        \
      * Perform initialization on the hashmap.                                  \
      *                                                                         \
@@ -63,6 +82,80 @@ enum ink_hashmap_entry_state {
         self->max_load_percentage = max_load_percentage;                       \
     }                                                                          \
                                                                                \
+    INK_HASHMAP_IMPL(__T, __K, __V)                                            \
+    /**/
+
+/*
+ * Hashmap template with hashing and key comparison fixed at compile time.
+ *
+ * `__HASH` and `__CMP` name functions with the same signatures as the runtime
+ * hooks of `INK_HASHMAP_T`. They are called directly, which allows them to be
+ * inlined into the probing loop.
+ */
+#define INK_HASHMAP_T_EX(__T, __K, __V, __HASH, __CMP)                         \
+    /**                                                                        \
+     * Hashmap bucket.                                                         \
+     */                                                                        \
+    struct __T##_kv {                                                          \
+        enum ink_hashmap_entry_state state;                                    \
+        uint32_t hash;                                                         \
+        __K key;                                                               \
+        __V value;                                                             \
+    };                                                                         \
+                                                                               \
+    struct __T {                                                               \
+        size_t max_load_percentage;                                            \
+        size_t count;                                                          \
+        size_t capacity;                                                       \
+        struct __T##_kv *entries;                                              \
+    };                                                                         \
+                                                                               \
+    static inline uint32_t __T##_hash_of(const struct __T *self,               \
+                                         const __K *key)                       \
+    {                                                                          \
+        (void)self;                                                            \
+        return __HASH(key, sizeof(__K));                                       \
+    }                                                                          \
+                                                                               \
+    static inline bool __T##_keys_equal(const struct __T *self,                \
+                                        const __K *lhs, const __K *rhs)        \
+    {                                                                          \
+        (void)self;                                                            \
+        return __CMP(lhs, rhs);                                                \
+    }                                                                          \
+                                                                               \
+    /**                                                                        \
+     * Perform initialization on the hashmap.                                  \
+     *                                                                         \
+     * Heap memory for the buckets store is allocated lazily upon insertion.   \
+     */                                                                        \
+    static inline void __T##_init(struct __T *self,                            \
+                                  size_t max_load_percentage)                  \
+    {                                                                          \
+        assert(max_load_percentage > 0ul && max_load_percentage < 100ul);      \
+        self->count = 0;                                                       \
+        self->capacity = 0;                                                    \
+        self->entries = (void *)0;                                             \
+        self->max_load_percentage = max_load_percentage;                       \
+    }                                                                          \
+                                                                               \
+    INK_HASHMAP_IMPL(__T, __K, __V)                                            \
+    /**/
+
+/*
+ * Operations shared by all hashmap templates.
+ *
+ * Collisions are resolved with Robin Hood probing. Each bucket stores the
+ * full hash of its key, which is used to derive the probe distance of the
+ * entry and to reject mismatched keys before calling the key comparison
+ * function. Removal shifts subsequent entries backwards, so no tombstones are
+ * left behind.
+ *
+ * Resizing and insertion are too large to be worth inlining, so they are
+ * plain static functions. They are marked as possibly unused, since not every
+ * translation unit that instantiates a hashmap inserts into it.
+ */
+#define INK_HASHMAP_IMPL(__T, __K, __V)                                        \
     /**                                                                        \
      * Perform de-initialization on the hashmap.                               \
      *                                                                         \
@@ -74,8 +167,6 @@ enum ink_hashmap_entry_state {
         self->count = 0;                                                       \
         self->capacity = 0;                                                    \
         self->entries = (void *)0;                                             \
-        self->hasher = (void *)0;                                              \
-        self->compare = (void *)0;                                             \
         self->max_load_percentage = 0;                                         \
     }                                                                          \
                                                                                \
@@ -100,74 +191,122 @@ enum ink_hashmap_entry_state {
         if (self->capacity == 0) {                                             \
             return true;                                                       \
         }                                                                      \
-        return ((self->count * 100ul) / self->capacity) >                      \
+        return (((self->count + 1) * 100ul) / self->capacity) >                \
                self->max_load_percentage;                                      \
     }                                                                          \
                                                                                \
     /**                                                                        \
-     * Perform linear probing on the buckets store.                            \
+     * Calculate the distance of a bucket from the ideal bucket of its entry.  \
+     */                                                                        \
+    static inline size_t __T##_probe_distance(const struct __T *self,          \
+                                              uint32_t hash, size_t index)     \
+    {                                                                          \
+        return (index - (hash & (self->capacity - 1))) &                       \
+               (self->capacity - 1);                                           \
+    }                                                                          \
+                                                                               \
+    /**                                                                        \
+     * Perform Robin Hood probing on the buckets store.                        \
      *                                                                         \
-     * An entry pointer shall be returned if the entry's key matches or if the \
-     * key has not yet been set.                                               \
+     * An entry pointer shall be returned if the entry's key matches.          \
+     * Probing stops early once an entry closer to its ideal bucket than the   \
+     * supplied key would be is reached.                                       \
      */                                                                        \
     static inline struct __T##_kv *__T##_find_slot(                            \
-        struct __T##_kv *entries, size_t capacity, const void *key,            \
-        uint32_t (*hasher)(const void *bytes, size_t length),                  \
-        bool (*compare)(const void *lhs, const void *rhs))                     \
+        const struct __T *self, const __K *key, uint32_t hash)                 \
     {                                                                          \
-        struct __T##_kv *tombstone = (void *)0;                                \
-        size_t index = hasher(key, sizeof(__K)) & (capacity - 1);              \
+        const size_t mask = self->capacity - 1;                                \
+        size_t index = hash & mask;                                            \
                                                                                \
-        for (;;) {                                                             \
-            struct __T##_kv *const slot = &entries[index];                     \
+        for (size_t distance = 0;; distance++) {                               \
+            struct __T##_kv *const slot = &self->entries[index];               \
                                                                                \
             if (slot->state == INK_HASHMAP_IS_EMPTY) {                         \
-                return tombstone ? tombstone : slot;                           \
-            } else if (slot->state == INK_HASHMAP_IS_DELETED) {                \
-                if (!tombstone) {                                              \
-                    tombstone = slot;                                          \
-                }                                                              \
-            } else if (compare(key, (void *)&slot->key)) {                     \
+                return (void *)0;                                              \
+            }                                                                  \
+            if (__T##_probe_distance(self, slot->hash, index) < distance) {    \
+                return (void *)0;                                              \
+            }                                                                  \
+            if (slot->hash == hash &&                                          \
+                __T##_keys_equal(self, key, &slot->key)) {                     \
                 return slot;                                                   \
             }                                                                  \
                                                                                \
-            index = (index + 1) & (capacity - 1);                              \
+            index = (index + 1) & mask;                                        \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /**                                                                        \
+     * Place an entry into the buckets store.                                  \
+     *                                                                         \
+     * The key must not already be present. Entries that are closer to their   \
+     * ideal bucket are displaced to make room.                                \
+     */                                                                        \
+    static inline void __T##_place(struct __T *self, uint32_t hash, __K key,   \
+                                   __V value)                                  \
+    {                                                                          \
+        const size_t mask = self->capacity - 1;                                \
+        size_t index = hash & mask;                                            \
+        struct __T##_kv entry = {                                              \
+            .state = INK_HASHMAP_IS_OCCUPIED,                                  \
+            .hash = hash,                                                      \
+            .key = key,                                                        \
+            .value = value,                                                    \
+        };                                                                     \
+                                                                               \
+        for (size_t distance = 0;; distance++) {                               \
+            struct __T##_kv *const slot = &self->entries[index];               \
+                                                                               \
+            if (slot->state == INK_HASHMAP_IS_EMPTY) {                         \
+                *slot = entry;                                                 \
+                return;                                                        \
+            }                                                                  \
+                                                                               \
+            const size_t slot_distance =                                       \
+                __T##_probe_distance(self, slot->hash, index);                 \
+                                                                               \
+            if (slot_distance < distance) {                                    \
+                const struct __T##_kv tmp = *slot;                             \
+                                                                               \
+                *slot = entry;                                                 \
+                entry = tmp;                                                   \
+                distance = slot_distance;                                      \
+            }                                                                  \
+                                                                               \
+            index = (index + 1) & mask;                                        \
         }                                                                      \
     }                                                                          \
                                                                                \
     /**                                                                        \
      * The buckets store shall be resized quadratically.                       \
+     *                                                                         \
+     * Stored hashes are reused, so keys are not hashed again.                 \
      */                                                                        \
-    static inline int __T##_resize(struct __T *self)                           \
+    static INK_MAYBE_UNUSED int __T##_resize(struct __T *self)                 \
     {                                                                          \
-        struct __T##_kv *entries, *src, *dst;                                  \
-        size_t count = 0;                                                      \
+        struct __T##_kv *const entries_old = self->entries;                    \
+        const size_t capacity_old = self->capacity;                            \
         const size_t capacity = __T##_next_size(self);                         \
-        const size_t size = sizeof(*entries) * capacity;                       \
+        const size_t size = sizeof(*entries_old) * capacity;                   \
+        struct __T##_kv *const entries = (struct __T##_kv *)ink_malloc(size);  \
                                                                                \
-        entries = (struct __T##_kv *)ink_malloc(size);                         \
         if (!entries) {                                                        \
             return -INK_E_OOM;                                                 \
         }                                                                      \
                                                                                \
         memset(entries, 0, size);                                              \
+        self->capacity = capacity;                                             \
+        self->entries = entries;                                               \
+                                                                               \
+        for (size_t i = 0; i < capacity_old; i++) {                            \
+            struct __T##_kv *const src = &entries_old[i];                      \
                                                                                \
-        for (size_t i = 0; i < self->capacity; i++) {                          \
-            src = &self->entries[i];                                           \
             if (src->state == INK_HASHMAP_IS_OCCUPIED) {                       \
-                dst = __T##_find_slot(entries, capacity, &src->key,            \
-                                      self->hasher, self->compare);            \
-                dst->state = src->state;                                       \
-                dst->key = src->key;                                           \
-                dst->value = src->value;                                       \
-                count++;                                                       \
+                __T##_place(self, src->hash, src->key, src->value);            \
             }                                                                  \
         }                                                                      \
                                                                                \
-        ink_free(self->entries);                                               \
-        self->count = count;                                                   \
-        self->capacity = capacity;                                             \
-        self->entries = entries;                                               \
+        ink_free(entries_old);                                                 \
         return INK_E_OK;                                                       \
     }                                                                          \
                                                                                \
@@ -182,9 +321,8 @@ enum ink_hashmap_entry_state {
             return -INK_E_FAIL;                                                \
         }                                                                      \
                                                                                \
-        entry = __T##_find_slot(self->entries, self->capacity, (void *)&key,   \
-                                self->hasher, self->compare);                  \
-        if (entry->state != INK_HASHMAP_IS_OCCUPIED) {                         \
+        entry = __T##_find_slot(self, &key, __T##_hash_of(self, &key));        \
+        if (!entry) {                                                          \
             return -INK_E_FAIL;                                                \
         }                                                                      \
                                                                                \
@@ -195,11 +333,21 @@ enum ink_hashmap_entry_state {
     /**                                                                        \
      * Insert an element into the hashmap.                                     \
      */                                                                        \
-    static inline int __T##_insert(struct __T *self, __K key, __V value)       \
+    static INK_MAYBE_UNUSED int __T##_insert(struct __T *self, __K key,        \
+                                             __V value)                        \
     {                                                                          \
         int rc;                                                                \
         struct __T##_kv *entry;                                                \
+        const uint32_t hash = __T##_hash_of(self, &key);                       \
                                                                                \
+        if (self->count > 0) {                                                 \
+            entry = __T##_find_slot(self, &key, hash);                         \
+            if (entry) {                                                       \
+                entry->key = key;                                              \
+                entry->value = value;                                          \
+                return -INK_E_OVERWRITE;                                       \
+            }                                                                  \
+        }                                                                      \
         if (__T##_needs_resize(self)) {                                        \
             rc = __T##_resize(self);                                           \
             if (rc < 0) {                                                      \
@@ -207,44 +355,58 @@ enum ink_hashmap_entry_state {
             }                                                                  \
         }                                                                      \
                                                                                \
-        entry = __T##_find_slot(self->entries, self->capacity, (void *)&key,   \
-                                self->hasher, self->compare);                  \
-        if (entry->state != INK_HASHMAP_IS_OCCUPIED) {                         \
-            entry->state = INK_HASHMAP_IS_OCCUPIED;                            \
-            self->count++;                                                     \
-            rc = INK_E_OK;                                                     \
-        } else {                                                               \
-            rc = -INK_E_OVERWRITE;                                             \
-        }                                                                      \
-                                                                               \
-        entry->key = key;                                                      \
-        entry->value = value;                                                  \
-        return rc;                                                             \
+        __T##_place(self, hash, key, value);                                   \
+        self->count++;                                                         \
+        return INK_E_OK;                                                       \
     }                                                                          \
                                                                                \
     /**                                                                        \
      * Remove an entry from the map.                                           \
      *                                                                         \
-     * If a bucket for the supplied key is found, the bucket shall be marked   \
-     * witha  tombstone value and return zero. Otherwise the operation shall   \
-     * fail and return a non-zero failure code.                                \
+     * If a bucket for the supplied key is found, the entries following it     \
+     * shall be shifted backwards and zero returned. Otherwise the operation   \
+     * shall fail and return a non-zero failure code.                          \
      */                                                                        \
     static inline int __T##_remove(struct __T *self, __K key)                  \
     {                                                                          \
         struct __T##_kv *entry;                                                \
+        size_t index, next;                                                    \
+        const size_t mask = self->capacity - 1;                                \
                                                                                \
         if (self->count == 0) {                                                \
             return -INK_E_FAIL;                                                \
         }                                                                      \
                                                                                \
-        entry = __T##_find_slot(self->entries, self->capacity, (void *)&key,   \
-                                self->hasher, self->compare);                  \
-        if (entry->state != INK_HASHMAP_IS_OCCUPIED) {                         \
+        entry = __T##_find_slot(self, &key, __T##_hash_of(self, &key));        \
+        if (!entry) {                                                          \
             return -INK_E_FAIL;                                                \
         }                                                                      \
                                                                                \
-        entry->state = INK_HASHMAP_IS_DELETED;                                 \
+        index = (size_t)(entry - self->entries);                               \
+        next = (index + 1) & mask;                                             \
+                                                                               \
+        while (self->entries[next].state == INK_HASHMAP_IS_OCCUPIED &&         \
+               __T##_probe_distance(self, self->entries[next].hash, next) >    \
+                   0) {                                                        \
+            self->entries[index] = self->entries[next];                        \
+            index = next;                                                      \
+            next = (next + 1) & mask;                                          \
+        }                                                                      \
+                                                                               \
+        memset(&self->entries[index], 0, sizeof(self->entries[index]));        \
+        self->count--;                                                         \
         return INK_E_OK;                                                       \
+    }                                                                          \
+                                                                               \
+    /**                                                                        \
+     * Remove all elements from the hashmap, keeping the buckets store.        \
+     */                                                                        \
+    static inline void __T##_clear(struct __T *self)                           \
+    {                                                                          \
+        if (self->count > 0) {                                                 \
+            memset(self->entries, 0, self->capacity * sizeof(*self->entries)); \
+            self->count = 0;                                                   \
+        }                                                                      \
     }                                                                          \
     /**/
 
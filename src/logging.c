@@ -1,7 +1,15 @@
+#if defined(INK_USE_PTHREADS)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdarg.h>
 #include <stdio.h>
 
 #include "logging.h"
+#include "thread.h"
+
+/* Keeps messages logged from different threads from interleaving. */
+static struct ink_mutex INK_LOG_LOCK = INK_MUTEX_INIT;
 
 static const char *INK_LOG_LEVEL_STR[] = {
     [INK_LOG_LEVEL_TRACE] = "TRACE",
@@ -18,9 +26,11 @@ void ink_log(enum ink_log_level log_level, const char *fmt, va_list args)
 {
     const char *level_str = INK_LOG_LEVEL_STR[log_level];
 
+    ink_mutex_lock(&INK_LOG_LOCK);
     fprintf(stderr, "[%s] ", level_str);
     vfprintf(stderr, fmt, args);
     fprintf(stderr, "\n");
+    ink_mutex_unlock(&INK_LOG_LOCK);
 }
 
 void ink_error(const char *fmt, ...)
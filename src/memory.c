@@ -1,7 +1,12 @@
+#if defined(INK_USE_PTHREADS)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <assert.h>
 #include <stdlib.h>
 
 #include "memory.h"
+#include "thread.h"
 
 static void *ink_default_alloc(struct ink_allocator *gpa, size_t size)
 {
@@ -32,6 +37,10 @@ static struct ink_allocator INK_DEFAULT_GPA = {
 
 static struct ink_allocator *INK_GPA = &INK_DEFAULT_GPA;
 
+/* Custom allocators need not be thread-safe, so calls into them are
+ * serialized. The default allocator is backed by the C library, which is. */
+static struct ink_mutex INK_GPA_LOCK = INK_MUTEX_INIT;
+
 void ink_set_global_allocator(struct ink_allocator *gpa)
 {
     INK_GPA = gpa;
@@ -44,21 +53,43 @@ void ink_get_global_allocator(struct ink_allocator **gpa)
 
 void *ink_malloc(size_t size)
 {
+    void *memory = NULL;
     struct ink_allocator *const gpa = INK_GPA;
 
-    return gpa->allocate(gpa, size);
+    if (gpa == &INK_DEFAULT_GPA) {
+        return gpa->allocate(gpa, size);
+    }
+
+    ink_mutex_lock(&INK_GPA_LOCK);
+    memory = gpa->allocate(gpa, size);
+    ink_mutex_unlock(&INK_GPA_LOCK);
+    return memory;
 }
 
 void *ink_realloc(void *memory, size_t size)
 {
     struct ink_allocator *const gpa = INK_GPA;
 
-    return gpa->resize(gpa, memory, size);
+    if (gpa == &INK_DEFAULT_GPA) {
+        return gpa->resize(gpa, memory, size);
+    }
+
+    ink_mutex_lock(&INK_GPA_LOCK);
+    memory = gpa->resize(gpa, memory, size);
+    ink_mutex_unlock(&INK_GPA_LOCK);
+    return memory;
 }
 
 void ink_free(void *memory)
 {
     struct ink_allocator *const gpa = INK_GPA;
 
+    if (gpa == &INK_DEFAULT_GPA) {
+        gpa->free(gpa, memory);
+        return;
+    }
+
+    ink_mutex_lock(&INK_GPA_LOCK);
     gpa->free(gpa, memory);
+    ink_mutex_unlock(&INK_GPA_LOCK);
 }
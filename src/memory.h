@@ -15,6 +15,12 @@ struct ink_allocator {
     void (*free)(struct ink_allocator *self, void *memory);
 };
 
+/**
+ * Replace the global allocator.
+ *
+ * Calls into a custom allocator are serialized, so it need not be
+ * thread-safe. It must not be replaced while other threads use the library.
+ */
 INK_API void ink_set_global_allocator(struct ink_allocator *gpa);
 INK_API void ink_get_global_allocator(struct ink_allocator **gpa);
 INK_API void *ink_malloc(size_t size);
@@ -53,7 +53,10 @@ void ink_object_free(struct ink_story *story, struct ink_object *obj)
     case INK_OBJ_CONTENT_PATH: {
         struct ink_content_path *const typed_obj = INK_OBJ_AS_CONTENT_PATH(obj);
 
-        ink_byte_vec_deinit(&typed_obj->code);
+        if (!typed_obj->code_is_borrowed) {
+            ink_byte_vec_deinit(&typed_obj->code);
+        }
+
         ink_object_vec_deinit(&typed_obj->const_pool);
         break;
     }
@@ -109,24 +112,22 @@ void ink_object_print(const struct ink_object *obj)
         break;
     }
     case INK_OBJ_TABLE: {
-        struct ink_table *const typed_obj = INK_OBJ_AS_TABLE(obj);
+        size_t iter = 0;
+        struct ink_object *key = NULL;
+        struct ink_object *value = NULL;
 
         fprintf(stderr, "{");
 
-        for (size_t i = 0; i < typed_obj->capacity; i++) {
-            struct ink_table_kv entry = typed_obj->entries[i];
-
-            if (entry.key) {
-                fprintf(stderr, "[\"%s\"] => ", entry.key->bytes);
-
-                if (entry.value) {
-                    ink_object_print(entry.value);
-                } else {
-                    fprintf(stderr, "NULL");
-                }
+        while (ink_table_next(obj, &iter, &key, &value) == INK_E_OK) {
+            fprintf(stderr, "[\"%s\"] => ", INK_OBJ_AS_STRING(key)->bytes);
 
-                fprintf(stderr, ", ");
+            if (value) {
+                ink_object_print(value);
+            } else {
+                fprintf(stderr, "NULL");
             }
+
+            fprintf(stderr, ", ");
         }
 
         fprintf(stderr, "}");
@@ -197,6 +198,14 @@ bool ink_number_eq(const struct ink_number *lhs, const struct ink_number *rhs)
 
 struct ink_object *ink_string_new(struct ink_story *story, const uint8_t *bytes,
                                   size_t length)
+{
+    return ink_string_new_hashed(story, bytes, length,
+                                 ink_hash_bytes(bytes, length));
+}
+
+struct ink_object *ink_string_new_hashed(struct ink_story *story,
+                                         const uint8_t *bytes, size_t length,
+                                         uint32_t hash)
 {
     struct ink_string *const obj = INK_OBJ_AS_STRING(
         ink_object_new(story, INK_OBJ_STRING, sizeof(*obj) + length + 1));
@@ -208,6 +217,7 @@ struct ink_object *ink_string_new(struct ink_story *story, const uint8_t *bytes,
 
         obj->bytes[length] = '\0';
         obj->length = (uint32_t)length;
+        obj->hash = hash;
     }
     return INK_OBJ(obj);
 }
@@ -256,70 +266,133 @@ struct ink_object *ink_table_new(struct ink_story *story)
     return INK_OBJ(obj);
 }
 
-static struct ink_table_kv *ink_table_find_slot(struct ink_table_kv *entries,
-                                                size_t capacity,
-                                                struct ink_string *key)
+/**
+ * Calculate the distance of a bucket from the ideal bucket of its entry.
+ */
+static inline uint32_t ink_table_probe_distance(const struct ink_table *table,
+                                                uint32_t hash, uint32_t index)
+{
+    return (index - (hash & (table->capacity - 1))) & (table->capacity - 1);
+}
+
+/**
+ * Perform Robin Hood probing on the buckets store.
+ *
+ * Stored hashes are compared before the key bytes. Returns NULL if the key
+ * is not present.
+ */
+static struct ink_table_kv *ink_table_find_slot(const struct ink_table *table,
+                                                const struct ink_string *key)
 {
-    size_t index = key->hash & (capacity - 1);
+    const uint32_t mask = table->capacity - 1;
+    uint32_t index = key->hash & mask;
 
-    for (;;) {
-        struct ink_table_kv *const entry = &entries[index];
+    for (uint32_t distance = 0;; distance++) {
+        struct ink_table_kv *const entry = &table->entries[index];
 
-        if (entry->key == NULL || ink_string_eq(entry->key, key)) {
+        if (!entry->key) {
+            return NULL;
+        }
+        if (ink_table_probe_distance(table, entry->hash, index) < distance) {
+            return NULL;
+        }
+        if (entry->hash == key->hash &&
+            (entry->key == key || ink_string_eq(entry->key, key))) {
             return entry;
         }
 
-        index = (index + 1) & (capacity - 1);
+        index = (index + 1) & mask;
     }
 }
 
-static inline uint32_t ink_table_next_size(const struct ink_table *table)
+/**
+ * Place an entry into the buckets store.
+ *
+ * The key must not already be present.
+ */
+static void ink_table_place(struct ink_table *table, struct ink_string *key,
+                            struct ink_object *value)
 {
-    const uint32_t capacity = table->capacity;
+    const uint32_t mask = table->capacity - 1;
+    uint32_t index = key->hash & mask;
+    struct ink_table_kv entry = {
+        .hash = key->hash,
+        .key = key,
+        .value = value,
+    };
+
+    for (uint32_t distance = 0;; distance++) {
+        struct ink_table_kv *const slot = &table->entries[index];
+
+        if (!slot->key) {
+            *slot = entry;
+            return;
+        }
 
-    if (capacity < INK_TABLE_CAPACITY_MIN) {
-        return INK_TABLE_CAPACITY_MIN;
+        const uint32_t slot_distance =
+            ink_table_probe_distance(table, slot->hash, index);
+
+        if (slot_distance < distance) {
+            const struct ink_table_kv tmp = *slot;
+
+            *slot = entry;
+            entry = tmp;
+            distance = slot_distance;
+        }
+
+        index = (index + 1) & mask;
     }
-    return capacity * INK_TABLE_SCALE_FACTOR;
 }
 
-static inline bool ink_table_needs_resize(struct ink_table *table)
+static inline bool ink_table_needs_grow(const struct ink_table *table)
 {
     if (table->capacity == 0) {
         return true;
     }
-    return ((table->count * 100ul) / table->capacity) > INK_TABLE_LOAD_MAX;
+    return (((table->count + 1) * 100ul) / table->capacity) >
+           INK_TABLE_LOAD_MAX;
+}
+
+static inline bool ink_table_needs_shrink(const struct ink_table *table)
+{
+    if (table->capacity <= INK_TABLE_CAPACITY_MIN) {
+        return false;
+    }
+    return ((table->count * 100ul) / table->capacity) < INK_TABLE_LOAD_MIN;
 }
 
-static int ink_table_resize(struct ink_story *story, struct ink_table *table)
+/**
+ * Resize the buckets store of a table.
+ *
+ * Memory is requested from the system allocator directly, so that a
+ * collection cannot run while entries are being moved.
+ */
+static int ink_table_resize(struct ink_story *story, struct ink_table *table,
+                            uint32_t capacity)
 {
-    struct ink_table_kv *entries, *src, *dst;
-    const uint32_t capacity = ink_table_next_size(table);
-    const uint32_t size = sizeof(*table->entries) * capacity;
-    uint32_t count = 0;
+    struct ink_table_kv *const entries_old = table->entries;
+    const uint32_t capacity_old = table->capacity;
+    const size_t size = sizeof(*entries_old) * capacity;
+    struct ink_table_kv *const entries = ink_malloc(size);
 
-    entries =
-        ink_story_mem_alloc(story, NULL, 0, capacity * (sizeof(*entries)));
     if (!entries) {
         return -INK_E_OOM;
     }
 
     memset(entries, 0, size);
+    story->gc_allocated += size;
+    table->entries = entries;
+    table->capacity = capacity;
+
+    for (uint32_t i = 0; i < capacity_old; i++) {
+        struct ink_table_kv *const src = &entries_old[i];
 
-    for (size_t i = 0; i < table->capacity; i++) {
-        src = &table->entries[i];
         if (src->key) {
-            dst = ink_table_find_slot(entries, capacity, src->key);
-            dst->key = src->key;
-            dst->value = src->value;
-            count++;
+            ink_table_place(table, src->key, src->value);
         }
     }
 
-    ink_story_mem_free(story, table->entries);
-    table->entries = entries;
-    table->capacity = capacity;
-    table->count = count;
+    ink_story_mem_free(story, entries_old);
     return INK_E_OK;
 }
 
@@ -329,16 +402,17 @@ int ink_table_lookup(struct ink_story *story, struct ink_object *obj,
     struct ink_table *const table = INK_OBJ_AS_TABLE(obj);
 
     assert(INK_OBJ_IS_TABLE(obj));
+    assert(INK_OBJ_IS_STRING(key));
 
     if (table->count == 0) {
-        return -INK_E_OOM;
+        return -INK_E_FAIL;
     }
 
-    struct ink_table_kv *const kv = ink_table_find_slot(
-        table->entries, table->capacity, INK_OBJ_AS_STRING(key));
+    struct ink_table_kv *const kv =
+        ink_table_find_slot(table, INK_OBJ_AS_STRING(key));
 
-    if (!kv->key) {
-        return -INK_E_OOM;
+    if (!kv) {
+        return -INK_E_FAIL;
     }
 
     *value = kv->value;
@@ -355,30 +429,125 @@ int ink_table_insert(struct ink_story *story, struct ink_object *obj,
     assert(INK_OBJ_IS_TABLE(obj));
     assert(INK_OBJ_IS_STRING(key));
 
-    if (ink_table_needs_resize(table)) {
-        rc = ink_table_resize(story, table);
+    if (table->count > 0) {
+        struct ink_table_kv *const entry = ink_table_find_slot(table, key_str);
+
+        if (entry) {
+            entry->key = key_str;
+            entry->value = value;
+            return 1;
+        }
+    }
+    if (ink_table_needs_grow(table)) {
+        const uint32_t capacity = table->capacity < INK_TABLE_CAPACITY_MIN
+                                      ? INK_TABLE_CAPACITY_MIN
+                                      : table->capacity * INK_TABLE_SCALE_FACTOR;
+
+        rc = ink_table_resize(story, table, capacity);
         if (rc < 0) {
             return rc;
         }
     }
 
-    struct ink_table_kv *const entry =
-        ink_table_find_slot(table->entries, table->capacity, key_str);
+    ink_table_place(table, key_str, value);
+    table->count++;
+    return INK_E_OK;
+}
+
+int ink_table_reserve(struct ink_story *story, struct ink_object *obj,
+                      uint32_t count)
+{
+    struct ink_table *const table = INK_OBJ_AS_TABLE(obj);
+    const uint64_t total = (uint64_t)table->count + count;
+    uint64_t capacity = table->capacity < INK_TABLE_CAPACITY_MIN
+                            ? INK_TABLE_CAPACITY_MIN
+                            : table->capacity;
 
-    if (!entry->key) {
-        entry->key = key_str;
-        entry->value = value;
-        table->count++;
+    assert(INK_OBJ_IS_TABLE(obj));
+
+    if (count == 0) {
+        return INK_E_OK;
+    }
+    while ((total * 100ul) / capacity > INK_TABLE_LOAD_MAX) {
+        capacity *= INK_TABLE_SCALE_FACTOR;
+    }
+    if (capacity > UINT32_MAX) {
+        return -INK_E_OOM;
+    }
+    if (capacity == table->capacity) {
         return INK_E_OK;
     }
+    return ink_table_resize(story, table, (uint32_t)capacity);
+}
+
+int ink_table_remove(struct ink_story *story, struct ink_object *obj,
+                     struct ink_object *key)
+{
+    struct ink_table *const table = INK_OBJ_AS_TABLE(obj);
+
+    assert(INK_OBJ_IS_TABLE(obj));
+    assert(INK_OBJ_IS_STRING(key));
+
+    if (table->count == 0) {
+        return -INK_E_FAIL;
+    }
+
+    struct ink_table_kv *const entry =
+        ink_table_find_slot(table, INK_OBJ_AS_STRING(key));
+
+    if (!entry) {
+        return -INK_E_FAIL;
+    }
+
+    const uint32_t mask = table->capacity - 1;
+    uint32_t index = (uint32_t)(entry - table->entries);
+    uint32_t next = (index + 1) & mask;
+
+    while (table->entries[next].key &&
+           ink_table_probe_distance(table, table->entries[next].hash, next) >
+               0) {
+        table->entries[index] = table->entries[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+
+    memset(&table->entries[index], 0, sizeof(table->entries[index]));
+    table->count--;
+
+    if (ink_table_needs_shrink(table)) {
+        /* Failing to shrink leaves the table intact. */
+        ink_table_resize(story, table,
+                         table->capacity / INK_TABLE_SCALE_FACTOR);
+    }
+    return INK_E_OK;
+}
+
+int ink_table_next(const struct ink_object *obj, size_t *iter,
+                   struct ink_object **key, struct ink_object **value)
+{
+    const struct ink_table *const table = INK_OBJ_AS_TABLE(obj);
+
+    assert(INK_OBJ_IS_TABLE(obj));
 
-    entry->key = key_str;
-    entry->value = value;
-    return 1;
+    while (*iter < table->capacity) {
+        const struct ink_table_kv *const entry = &table->entries[(*iter)++];
+
+        if (entry->key) {
+            if (key) {
+                *key = INK_OBJ(entry->key);
+            }
+            if (value) {
+                *value = entry->value;
+            }
+            return INK_E_OK;
+        }
+    }
+    return -INK_E_FAIL;
 }
 
 #undef INK_TABLE_CAPACITY_MIN
 #undef INK_TABLE_LOAD_MAX
+#undef INK_TABLE_LOAD_MIN
 #undef INK_TABLE_SCALE_FACTOR
 
 struct ink_object *ink_content_path_new(struct ink_story *story,
@@ -396,6 +565,8 @@ struct ink_object *ink_content_path_new(struct ink_story *story,
     obj->name = INK_OBJ_AS_STRING(name);
     obj->arity = 0;
     obj->locals_count = 0;
+    obj->code_is_borrowed = false;
+    obj->source_hash = 0;
     ink_byte_vec_init(&obj->code);
     ink_object_vec_init(&obj->const_pool);
     return INK_OBJ(obj);
@@ -17,6 +17,7 @@ struct ink_object;
 #define INK_TABLE_CAPACITY_MIN (8ul)
 #define INK_TABLE_SCALE_FACTOR (2ul)
 #define INK_TABLE_LOAD_MAX (80ul)
+#define INK_TABLE_LOAD_MIN (20ul)
 
 INK_VEC_T(ink_byte_vec, uint8_t)
 INK_VEC_T(ink_object_vec, struct ink_object *)
@@ -61,6 +62,7 @@ struct ink_string {
 };
 
 struct ink_table_kv {
+    uint32_t hash;
     struct ink_string *key;
     struct ink_object *value;
 };
@@ -77,6 +79,10 @@ struct ink_content_path {
     struct ink_string *name;
     uint32_t arity;
     uint32_t locals_count;
+    /* Set when `code` points into a mapped bundle rather than owned memory. */
+    bool code_is_borrowed;
+    /* Hash of the source the path was compiled from, or zero if unknown. */
+    uint32_t source_hash;
     struct ink_byte_vec code;
     struct ink_object_vec const_pool;
 };
@@ -166,6 +172,15 @@ extern bool ink_number_eq(const struct ink_number *lhs,
 extern struct ink_object *ink_string_new(struct ink_story *story,
                                          const uint8_t *bytes, size_t length);
 
+/**
+ * Create a string object from bytes with a precomputed hash.
+ *
+ * `hash` must be the result of `ink_hash_bytes` over the same bytes.
+ */
+extern struct ink_object *ink_string_new_hashed(struct ink_story *story,
+                                                const uint8_t *bytes,
+                                                size_t length, uint32_t hash);
+
 /**
  * Check two strings for equality.
  */
@@ -197,6 +212,30 @@ extern int ink_table_lookup(struct ink_story *story, struct ink_object *obj,
 extern int ink_table_insert(struct ink_story *story, struct ink_object *obj,
                             struct ink_object *key, struct ink_object *value);
 
+/**
+ * Grow a table object so that `count` more entries can be inserted without
+ * allocating.
+ */
+extern int ink_table_reserve(struct ink_story *story, struct ink_object *obj,
+                             uint32_t count);
+
+/**
+ * Remove an entry from a table object.
+ *
+ * The buckets store is shrunk once the table becomes sparse.
+ */
+extern int ink_table_remove(struct ink_story *story, struct ink_object *obj,
+                            struct ink_object *key);
+
+/**
+ * Iterate over the entries of a table object.
+ *
+ * `iter` must be initialized to zero. Returns a non-zero value once all
+ * entries have been visited.
+ */
+extern int ink_table_next(const struct ink_object *obj, size_t *iter,
+                          struct ink_object **key, struct ink_object **value);
+
 /**
  * Create a content path object.
  */
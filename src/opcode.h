@@ -1,6 +1,9 @@
 #ifndef INK_OPCODE_H
 #define INK_OPCODE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -46,6 +49,29 @@ enum ink_vm_opcode {
 };
 #undef T
 
+/**
+ * Determine the number of operand bytes that follow an opcode.
+ */
+static inline size_t ink_opcode_operand_size(uint8_t op)
+{
+    switch (op) {
+    case INK_OP_CONST:
+    case INK_OP_LOAD:
+    case INK_OP_STORE:
+    case INK_OP_LOAD_GLOBAL:
+    case INK_OP_STORE_GLOBAL:
+    case INK_OP_CALL:
+    case INK_OP_DIVERT:
+        return 1;
+    case INK_OP_JMP:
+    case INK_OP_JMP_T:
+    case INK_OP_JMP_F:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,10 +2,10 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "arena.h"
 #include "ast.h"
 #include "common.h"
 #include "parser.h"
@@ -22,7 +22,7 @@ struct ink_parser_state {
     size_t source_offset;
 };
 
-INK_VEC_T(ink_parser_node_vec, struct ink_ast_node *)
+INK_VEC_T(ink_parser_node_vec, uint32_t)
 INK_VEC_T(ink_parser_state_vec, struct ink_parser_state)
 
 enum ink_stmt_context_type {
@@ -32,7 +32,7 @@ enum ink_stmt_context_type {
 
 struct ink_stmt_context {
     enum ink_stmt_context_type type;
-    struct ink_ast_node *node;
+    uint32_t node;
     bool is_block_created;
     size_t level;
     size_t blocks_top;
@@ -43,7 +43,6 @@ struct ink_stmt_context {
 struct ink_parser {
     bool panic_mode; /* TODO: Add this to `flags`? */
     int flags;
-    struct ink_arena *arena;
     struct ink_ast *tree;
     struct ink_token token;
     struct ink_scanner scanner;
@@ -204,23 +203,17 @@ ink_make_stmt_context(const struct ink_parser *p,
  * No memory is allocated here, as it is performed lazily.
  */
 static void ink_parser_init(struct ink_parser *p, struct ink_ast *tree,
-                            struct ink_arena *arena, int flags)
+                            size_t source_length, int flags)
 {
-    struct ink_scanner sn = {
-        .source_bytes = tree->source_bytes,
-        .is_line_start = true,
-    };
-
     p->panic_mode = false;
     p->flags = flags;
-    p->arena = arena;
     p->tree = tree;
     p->token.type = INK_TT_ERROR;
     p->token.bytes_start = 0;
     p->token.bytes_end = 0;
-    p->scanner = sn;
     p->knot_offset = 0;
 
+    ink_scanner_init(&p->scanner, tree->source_bytes, source_length);
     ink_parser_node_vec_init(&p->scratch);
     ink_parser_state_vec_init(&p->open_blocks);
     ink_parser_state_vec_init(&p->open_choices);
@@ -239,13 +232,13 @@ static void ink_parser_deinit(struct ink_parser *p)
 /**
  * Raise an error in the parser.
  */
-static void *ink_parser_error(struct ink_parser *p,
-                              enum ink_ast_error_type type,
-                              const struct ink_token *t)
+static uint32_t ink_parser_error(struct ink_parser *p,
+                                 enum ink_ast_error_type type,
+                                 const struct ink_token *t)
 
 {
     if (p->panic_mode) {
-        return NULL;
+        return INK_AST_NULL;
     } else {
         p->panic_mode = true;
     }
@@ -257,7 +250,7 @@ static void *ink_parser_error(struct ink_parser *p,
     };
 
     ink_ast_error_vec_push(&p->tree->errors, err);
-    return NULL;
+    return INK_AST_NULL;
 }
 
 static void ink_parser_panic(struct ink_parser *p)
@@ -421,7 +414,7 @@ static bool ink_parser_scratch_is_empty(struct ink_parser *p,
     return ctx->scratch_top == p->scratch.count;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_scratch_peek(struct ink_parser *p, struct ink_stmt_context *ctx)
 {
     assert(ctx->scratch_top < p->scratch.count);
@@ -429,14 +422,13 @@ ink_parser_scratch_peek(struct ink_parser *p, struct ink_stmt_context *ctx)
 }
 
 static void ink_parser_scratch_push(struct ink_parser *p,
-                                    struct ink_stmt_context *ctx,
-                                    struct ink_ast_node *n)
+                                    struct ink_stmt_context *ctx, uint32_t n)
 {
     ink_parser_node_vec_push(&p->scratch, n);
 }
 
-static struct ink_ast_node *ink_parser_scratch_pop(struct ink_parser *p,
-                                                   struct ink_stmt_context *ctx)
+static uint32_t ink_parser_scratch_pop(struct ink_parser *p,
+                                       struct ink_stmt_context *ctx)
 {
     assert(ctx->scratch_top < p->scratch.count);
     return ink_parser_node_vec_pop(&p->scratch);
@@ -510,31 +502,20 @@ ink_parser_choices_pop(struct ink_parser *p, struct ink_stmt_context *ctx)
     return ink_parser_state_vec_pop(&p->open_choices);
 }
 
-static struct ink_ast_node_list *
-ink_ast_list_from_scratch(struct ink_parser_node_vec *s, size_t start_offset,
-                          size_t end_offset, struct ink_arena *arena)
+static uint32_t ink_ast_list_from_scratch(struct ink_ast *tree,
+                                          struct ink_parser_node_vec *s,
+                                          size_t start_offset,
+                                          size_t end_offset)
 {
-    struct ink_ast_node_list *l = NULL;
-    size_t li = 0;
+    uint32_t l = INK_AST_NULL;
 
     if (start_offset < end_offset) {
         const size_t span = end_offset - start_offset;
-        const size_t size = sizeof(*l) + span * sizeof(l->nodes);
-
-        assert(span > 0);
 
-        l = ink_arena_allocate(arena, size);
+        l = ink_ast_list_new(tree, &s->entries[start_offset], span);
         if (!l) {
             /* TODO(Brett): Handle and log the error. */
-            return NULL;
-        }
-
-        l->count = span;
-
-        for (size_t i = start_offset; i < end_offset; i++) {
-            l->nodes[li] = s->entries[i];
-            s->entries[i] = NULL;
-            li++;
+            return INK_AST_NULL;
         }
 
         ink_parser_node_vec_shrink(s, start_offset);
@@ -542,45 +523,43 @@ ink_ast_list_from_scratch(struct ink_parser_node_vec *s, size_t start_offset,
     return l;
 }
 
-static struct ink_ast_node_list *ink_parser_make_list(struct ink_parser *p,
-                                                      size_t start_offset)
+static uint32_t ink_parser_make_list(struct ink_parser *p, size_t start_offset)
 {
-    return ink_ast_list_from_scratch(&p->scratch, start_offset,
-                                     p->scratch.count, p->arena);
+    return ink_ast_list_from_scratch(p->tree, &p->scratch, start_offset,
+                                     p->scratch.count);
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_make_sequence(struct ink_parser *p, struct ink_stmt_context *ctx,
                          enum ink_ast_node_type type, size_t bytes_start,
                          size_t bytes_end, size_t scratch_offset)
 {
-    struct ink_ast_node_list *l = NULL;
+    uint32_t l = INK_AST_NULL;
 
     if (!ink_parser_scratch_is_empty(p, ctx)) {
         l = ink_parser_make_list(p, scratch_offset);
         if (!l) {
-            return NULL;
+            return INK_AST_NULL;
         }
     }
-    return ink_ast_many_new(type, bytes_start, bytes_end, l, p->arena);
+    return ink_ast_many_new(p->tree, type, bytes_start, bytes_end, l);
 }
 
-static struct ink_ast_node *ink_parser_fixup_block(struct ink_parser *p,
-                                                   struct ink_stmt_context *ctx,
-                                                   struct ink_ast_node *n)
+static uint32_t ink_parser_fixup_block(struct ink_parser *p,
+                                       struct ink_stmt_context *ctx, uint32_t n)
 {
-    struct ink_ast_node *stmt = NULL;
+    uint32_t stmt = INK_AST_NULL;
 
     if (!ink_parser_scratch_is_empty(p, ctx)) {
         stmt = ink_parser_scratch_peek(p, ctx);
 
-        switch (stmt->type) {
+        switch (ink_ast_node_type(p->tree, stmt)) {
         case INK_AST_CHOICE_STAR_STMT:
         case INK_AST_CHOICE_PLUS_STMT:
         case INK_AST_SWITCH_CASE:
         case INK_AST_IF_BRANCH:
         case INK_AST_ELSE_BRANCH:
-            stmt->data.bin.rhs = n;
+            ink_ast_node_set_rhs(p->tree, stmt, n);
             return ink_parser_scratch_pop(p, ctx);
         default:
             break;
@@ -591,14 +570,14 @@ static struct ink_ast_node *ink_parser_fixup_block(struct ink_parser *p,
     return n;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_collect_block(struct ink_parser *p, struct ink_stmt_context *ctx,
                          size_t level)
 {
     size_t b_start, b_end;
     struct ink_parser_state b;
-    struct ink_ast_node *n = NULL;
-    struct ink_ast_node *last = NULL;
+    uint32_t n = INK_AST_NULL;
+    uint32_t last = INK_AST_NULL;
 
     if (!ink_parser_blocks_is_empty(p, ctx)) {
         b = ink_parser_blocks_peek(p, ctx);
@@ -607,7 +586,7 @@ ink_parser_collect_block(struct ink_parser *p, struct ink_stmt_context *ctx,
 
             if (!ink_parser_scratch_is_empty(p, ctx)) {
                 last = ink_parser_scratch_peek(p, ctx);
-                b_end = last->bytes_end;
+                b_end = ink_ast_node_end(p->tree, last);
             } else {
                 b_end = b_start;
             }
@@ -621,12 +600,12 @@ ink_parser_collect_block(struct ink_parser *p, struct ink_stmt_context *ctx,
     return n;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_collect_context(struct ink_parser *p, struct ink_stmt_context *ctx,
                            size_t level, bool should_gather)
 {
     struct ink_parser_state prev_c, c, b;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     /**
      * The level of the current choice should always be greater then the
@@ -685,40 +664,42 @@ ink_parser_collect_context(struct ink_parser *p, struct ink_stmt_context *ctx,
     if (!ink_parser_scratch_is_empty(p, ctx)) {
         return ink_parser_scratch_pop(p, ctx);
     }
-    return NULL;
+    return INK_AST_NULL;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_collect_stitch(struct ink_parser *p, struct ink_stmt_context *ctx)
 {
     size_t b_end;
-    struct ink_ast_node *proto = NULL;
-    struct ink_ast_node *n = ink_parser_collect_context(p, ctx, 0, false);
+    uint32_t proto = INK_AST_NULL;
+    uint32_t n = ink_parser_collect_context(p, ctx, 0, false);
 
     if (!ink_parser_scratch_is_empty(p, ctx)) {
         proto = ink_parser_scratch_peek(p, ctx);
-        if (proto->type == INK_AST_STITCH_PROTO) {
-            b_end = n ? n->bytes_end : proto->bytes_end;
+        if (ink_ast_node_type(p->tree, proto) == INK_AST_STITCH_PROTO) {
+            b_end = ink_ast_node_end(p->tree, n ? n : proto);
             ink_parser_scratch_pop(p, ctx);
-            return ink_ast_binary_new(INK_AST_STITCH_DECL, proto->bytes_start,
-                                      b_end, proto, n, p->arena);
-        } else if (proto->type == INK_AST_FUNC_PROTO) {
-            b_end = n ? n->bytes_end : proto->bytes_end;
+            return ink_ast_binary_new(p->tree, INK_AST_STITCH_DECL,
+                                      ink_ast_node_start(p->tree, proto), b_end,
+                                      proto, n);
+        } else if (ink_ast_node_type(p->tree, proto) == INK_AST_FUNC_PROTO) {
+            b_end = ink_ast_node_end(p->tree, n ? n : proto);
             ink_parser_scratch_pop(p, ctx);
-            return ink_ast_binary_new(INK_AST_FUNC_DECL, proto->bytes_start,
-                                      b_end, proto, n, p->arena);
+            return ink_ast_binary_new(p->tree, INK_AST_FUNC_DECL,
+                                      ink_ast_node_start(p->tree, proto), b_end,
+                                      proto, n);
         }
     }
     return n;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parser_collect_knot(struct ink_parser *p, struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = NULL;
-    struct ink_ast_node *child = NULL;
-    struct ink_ast_node *proto = NULL;
-    struct ink_ast_node_list *l = NULL;
+    uint32_t n = INK_AST_NULL;
+    uint32_t child = INK_AST_NULL;
+    uint32_t proto = INK_AST_NULL;
+    uint32_t l = INK_AST_NULL;
     struct ink_parser_node_vec *scratch = &p->scratch;
 
     if (!ink_parser_scratch_is_empty(p, ctx)) {
@@ -728,14 +709,13 @@ ink_parser_collect_knot(struct ink_parser *p, struct ink_stmt_context *ctx)
         }
 
         proto = scratch->entries[p->knot_offset];
-        if (proto->type == INK_AST_KNOT_PROTO) {
-            l = ink_ast_list_from_scratch(scratch, p->knot_offset + 1,
-                                          scratch->count, p->arena);
+        if (ink_ast_node_type(p->tree, proto) == INK_AST_KNOT_PROTO) {
+            l = ink_ast_list_from_scratch(p->tree, scratch, p->knot_offset + 1,
+                                          scratch->count);
             ink_parser_scratch_pop(p, ctx);
-            n = ink_ast_knot_decl_new(INK_AST_KNOT_DECL, proto->bytes_start,
-                                      child ? child->bytes_end
-                                            : proto->bytes_end,
-                                      proto, l, p->arena);
+            n = ink_ast_knot_decl_new(
+                p->tree, INK_AST_KNOT_DECL, ink_ast_node_start(p->tree, proto),
+                ink_ast_node_end(p->tree, child ? child : proto), proto, l);
         }
     }
     return n;
@@ -744,7 +724,7 @@ ink_parser_collect_knot(struct ink_parser *p, struct ink_stmt_context *ctx)
 static void ink_parser_handle_conditional_branch(struct ink_parser *p,
                                                  struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = ink_parser_collect_context(p, ctx, 0, false);
+    uint32_t n = ink_parser_collect_context(p, ctx, 0, false);
 
     if (n) {
         ink_parser_scratch_push(p, ctx, n);
@@ -753,18 +733,19 @@ static void ink_parser_handle_conditional_branch(struct ink_parser *p,
 
 static void ink_parser_handle_choice_branch(struct ink_parser *p,
                                             struct ink_stmt_context *ctx,
-                                            struct ink_ast_node *node)
+                                            uint32_t node)
 {
     struct ink_parser_state b, c;
     struct ink_parser_node_vec *scratch = &p->scratch;
     const size_t level = ctx->level;
 
     if (ink_parser_blocks_is_empty(p, ctx)) {
-        ink_parser_blocks_emplace(p, ctx, 0, scratch->count, node->bytes_start);
+        ink_parser_blocks_emplace(p, ctx, 0, scratch->count,
+                                  ink_ast_node_start(p->tree, node));
     }
     if (ink_parser_choices_is_empty(p, ctx)) {
         ink_parser_choices_emplace(p, ctx, level, scratch->count,
-                                   node->bytes_start);
+                                   ink_ast_node_start(p->tree, node));
     } else {
         c = ink_parser_choices_peek(p, ctx);
         b = ink_parser_blocks_peek(p, ctx);
@@ -776,7 +757,7 @@ static void ink_parser_handle_choice_branch(struct ink_parser *p,
             }
 
             ink_parser_choices_emplace(p, ctx, level, scratch->count,
-                                       node->bytes_start);
+                                       ink_ast_node_start(p->tree, node));
         } else if (level == c.level) {
             node = ink_parser_collect_block(p, ctx, level);
             if (node) {
@@ -793,18 +774,18 @@ static void ink_parser_handle_choice_branch(struct ink_parser *p,
 
 static void ink_parser_handle_gather(struct ink_parser *p,
                                      struct ink_stmt_context *ctx,
-                                     struct ink_ast_node **node)
+                                     uint32_t *node)
 {
     struct ink_parser_state b, c;
     struct ink_parser_node_vec *scratch = &p->scratch;
-    struct ink_ast_node *tmp = NULL;
+    uint32_t tmp = INK_AST_NULL;
     const struct ink_token t = p->token;
     const size_t level = ctx->level;
 
     if (ink_parser_blocks_is_empty(p, ctx)) {
         assert(ink_parser_choices_is_empty(p, ctx));
         ink_parser_blocks_emplace(p, ctx, 0, scratch->count,
-                                  (*node)->bytes_start);
+                                  ink_ast_node_start(p->tree, *node));
     }
     /**
      * Gather points terminate compound statements at the appropriate level.
@@ -816,20 +797,21 @@ static void ink_parser_handle_gather(struct ink_parser *p,
         if (level > c.level) {
             if (b.level != c.level) {
                 ink_parser_blocks_emplace(p, ctx, c.level, scratch->count,
-                                          (*node)->bytes_start);
+                                          ink_ast_node_start(p->tree, *node));
             }
         } else if (!ink_parser_scratch_is_empty(p, ctx)) {
             tmp = ink_parser_collect_context(p, ctx, level - 1, true);
-            if (tmp->type == INK_AST_CHOICE_STMT) {
+            if (ink_ast_node_type(p->tree, tmp) == INK_AST_CHOICE_STMT) {
                 *node =
-                    ink_ast_binary_new(INK_AST_GATHERED_STMT, tmp->bytes_start,
-                                       t.bytes_start, tmp, *node, p->arena);
+                    ink_ast_binary_new(p->tree, INK_AST_GATHERED_STMT,
+                                       ink_ast_node_start(p->tree, tmp),
+                                       t.bytes_start, tmp, *node);
             }
             if (!ink_parser_blocks_is_empty(p, ctx)) {
                 b = ink_parser_blocks_peek(p, ctx);
                 if (b.level == level) {
                     tmp = ink_parser_collect_block(p, ctx, level);
-                    if (tmp != NULL) {
+                    if (tmp != INK_AST_NULL) {
                         ink_parser_scratch_push(p, ctx, tmp);
                     }
                 }
@@ -840,13 +822,14 @@ static void ink_parser_handle_gather(struct ink_parser *p,
 
 static void ink_parser_handle_content(struct ink_parser *p,
                                       struct ink_stmt_context *ctx,
-                                      struct ink_ast_node *node)
+                                      uint32_t node)
 {
     struct ink_parser_state b, c;
     struct ink_parser_node_vec *scratch = &p->scratch;
 
     if (ink_parser_blocks_is_empty(p, ctx)) {
-        ink_parser_blocks_emplace(p, ctx, 0, scratch->count, node->bytes_start);
+        ink_parser_blocks_emplace(p, ctx, 0, scratch->count,
+                                  ink_ast_node_start(p->tree, node));
     }
     if (!ink_parser_choices_is_empty(p, ctx)) {
         b = ink_parser_blocks_peek(p, ctx);
@@ -854,7 +837,7 @@ static void ink_parser_handle_content(struct ink_parser *p,
 
         if (b.level != c.level) {
             ink_parser_blocks_emplace(p, ctx, c.level, scratch->count,
-                                      node->bytes_start);
+                                      ink_ast_node_start(p->tree, node));
         }
     }
 }
@@ -862,7 +845,7 @@ static void ink_parser_handle_content(struct ink_parser *p,
 static void ink_parser_handle_knot(struct ink_parser *p,
                                    struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = ink_parser_collect_knot(p, ctx);
+    uint32_t n = ink_parser_collect_knot(p, ctx);
 
     if (n) {
         ink_parser_scratch_push(p, ctx, n);
@@ -874,7 +857,7 @@ static void ink_parser_handle_knot(struct ink_parser *p,
 static void ink_parser_handle_stitch(struct ink_parser *p,
                                      struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = ink_parser_collect_stitch(p, ctx);
+    uint32_t n = ink_parser_collect_stitch(p, ctx);
 
     if (n) {
         ink_parser_scratch_push(p, ctx, n);
@@ -887,36 +870,34 @@ static void ink_parser_handle_func(struct ink_parser *p,
     ink_parser_handle_stitch(p, ctx);
 }
 
-static struct ink_ast_node *ink_parse_content(struct ink_parser *,
-                                              const enum ink_token_type *);
-static struct ink_ast_node *ink_parse_arglist(struct ink_parser *);
-static struct ink_ast_node *ink_parse_stmt(struct ink_parser *,
-                                           struct ink_stmt_context *);
-static struct ink_ast_node *ink_parse_expr(struct ink_parser *);
-static struct ink_ast_node *ink_parse_infix_expr(struct ink_parser *,
-                                                 struct ink_ast_node *,
-                                                 enum ink_precedence);
-static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *);
+static uint32_t ink_parse_content(struct ink_parser *,
+                                  const enum ink_token_type *);
+static uint32_t ink_parse_arglist(struct ink_parser *);
+static uint32_t ink_parse_stmt(struct ink_parser *, struct ink_stmt_context *);
+static uint32_t ink_parse_expr(struct ink_parser *);
+static uint32_t ink_parse_infix_expr(struct ink_parser *, uint32_t,
+                                     enum ink_precedence);
+static uint32_t ink_parse_lbrace_expr(struct ink_parser *);
 
-static struct ink_ast_node *ink_parse_atom(struct ink_parser *parser,
-                                           enum ink_ast_node_type type)
+static uint32_t ink_parse_atom(struct ink_parser *parser,
+                               enum ink_ast_node_type type)
 {
     /* NOTE: Advancing the parser MUST only happen after the node is
      * created. This prevents trailing whitespace. */
     const struct ink_token t = parser->token;
-    struct ink_ast_node *const n =
-        ink_ast_leaf_new(type, t.bytes_start, t.bytes_end, parser->arena);
+    const uint32_t n =
+        ink_ast_leaf_new(parser->tree, type, t.bytes_start, t.bytes_end);
 
     ink_parser_advance(parser);
     return n;
 }
 
-static struct ink_ast_node *ink_parse_identifier(struct ink_parser *p)
+static uint32_t ink_parse_identifier(struct ink_parser *p)
 {
     return ink_parse_atom(p, INK_AST_IDENTIFIER);
 }
 
-static struct ink_ast_node *ink_parse_expect_identifier(struct ink_parser *p)
+static uint32_t ink_parse_expect_identifier(struct ink_parser *p)
 {
     if (!ink_parser_check(p, INK_TT_IDENTIFIER)) {
         return ink_parser_error(p, INK_AST_E_EXPECTED_IDENTIFIER, &p->token);
@@ -924,10 +905,10 @@ static struct ink_ast_node *ink_parse_expect_identifier(struct ink_parser *p)
     return ink_parse_identifier(p);
 }
 
-static struct ink_ast_node *ink_parse_expect_expr(struct ink_parser *p)
+static uint32_t ink_parse_expect_expr(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *const n = ink_parse_expr(p);
+    const uint32_t n = ink_parse_expr(p);
 
     if (!n) {
         ink_parser_error(p, INK_AST_E_EXPECTED_EXPR, &t);
@@ -944,7 +925,7 @@ static size_t ink_parse_expect_stmt_end(struct ink_parser *p)
     return ink_parser_advance(p);
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parse_string(struct ink_parser *p, const enum ink_token_type *token_set)
 {
     const struct ink_token t = p->token;
@@ -952,15 +933,16 @@ ink_parse_string(struct ink_parser *p, const enum ink_token_type *token_set)
     while (!ink_parser_check_many(p, token_set)) {
         ink_parser_advance(p);
     }
-    return ink_ast_leaf_new(t.bytes_start == p->token.bytes_start
+    return ink_ast_leaf_new(p->tree,
+                            t.bytes_start == p->token.bytes_start
                                 ? INK_AST_EMPTY_STRING
                                 : INK_AST_STRING,
-                            t.bytes_start, p->token.bytes_start, p->arena);
+                            t.bytes_start, p->token.bytes_start);
 }
 
-static struct ink_ast_node *ink_parse_arglist(struct ink_parser *p)
+static uint32_t ink_parse_arglist(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     struct ink_stmt_context ctx = ink_make_stmt_context(p, INK_PARSE_BLOCK);
     const size_t b_start = ink_parser_expect_token(p, INK_TT_LEFT_PAREN);
     size_t cnt = 0;
@@ -988,15 +970,15 @@ static struct ink_ast_node *ink_parse_arglist(struct ink_parser *p)
                                     p->token.bytes_start, ctx.scratch_top);
 }
 
-static struct ink_ast_node *ink_parse_identifier_expr(struct ink_parser *p)
+static uint32_t ink_parse_identifier_expr(struct ink_parser *p)
 {
-    struct ink_ast_node *lhs = ink_parse_expect_identifier(p);
+    uint32_t lhs = ink_parse_expect_identifier(p);
 
     if (!lhs) {
         return lhs;
     }
     for (;;) {
-        struct ink_ast_node *rhs = NULL;
+        uint32_t rhs = INK_AST_NULL;
 
         switch (p->token.type) {
         case INK_TT_DOT:
@@ -1007,31 +989,33 @@ static struct ink_ast_node *ink_parse_identifier_expr(struct ink_parser *p)
                 return rhs;
             }
 
-            lhs = ink_ast_binary_new(INK_AST_SELECTOR_EXPR, lhs->bytes_start,
-                                     p->token.bytes_start, lhs, rhs, p->arena);
+            lhs = ink_ast_binary_new(p->tree, INK_AST_SELECTOR_EXPR,
+                                     ink_ast_node_start(p->tree, lhs),
+                                     p->token.bytes_start, lhs, rhs);
             break;
         case INK_TT_LEFT_PAREN:
             rhs = ink_parse_arglist(p);
-            return ink_ast_binary_new(INK_AST_CALL_EXPR, lhs->bytes_start,
-                                      p->token.bytes_start, lhs, rhs, p->arena);
+            return ink_ast_binary_new(p->tree, INK_AST_CALL_EXPR,
+                                      ink_ast_node_start(p->tree, lhs),
+                                      p->token.bytes_start, lhs, rhs);
         default:
             return lhs;
         }
     }
 }
 
-static struct ink_ast_node *ink_parse_divert(struct ink_parser *p)
+static uint32_t ink_parse_divert(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     ink_parser_advance(p);
     n = ink_parse_identifier_expr(p);
-    return ink_ast_binary_new(INK_AST_DIVERT, t.bytes_start,
-                              p->token.bytes_start, n, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_DIVERT, t.bytes_start,
+                              p->token.bytes_start, n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_string_expr(struct ink_parser *p)
+static uint32_t ink_parse_string_expr(struct ink_parser *p)
 {
     static const enum ink_token_type token_set[] = {
         INK_TT_DOUBLE_QUOTE,
@@ -1039,20 +1023,20 @@ static struct ink_ast_node *ink_parse_string_expr(struct ink_parser *p)
         INK_TT_EOF,
     };
     const size_t b_start = ink_parser_expect_token(p, INK_TT_DOUBLE_QUOTE);
-    struct ink_ast_node *const lhs = ink_parse_string(p, token_set);
+    const uint32_t lhs = ink_parse_string(p, token_set);
 
     if (!ink_parser_check(p, INK_TT_DOUBLE_QUOTE)) {
         return ink_parser_error(p, INK_AST_E_EXPECTED_DQUOTE, &p->token);
     }
 
     ink_parser_advance(p);
-    return ink_ast_binary_new(INK_AST_STRING_EXPR, b_start,
-                              p->token.bytes_start, lhs, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_STRING_EXPR, b_start,
+                              p->token.bytes_start, lhs, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_primary_expr(struct ink_parser *p)
+static uint32_t ink_parse_primary_expr(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     switch (p->token.type) {
     case INK_TT_INTEGER:
@@ -1070,7 +1054,7 @@ static struct ink_ast_node *ink_parse_primary_expr(struct ink_parser *p)
     case INK_TT_LEFT_PAREN:
         ink_parser_advance(p);
 
-        n = ink_parse_infix_expr(p, NULL, INK_PREC_NONE);
+        n = ink_parse_infix_expr(p, INK_AST_NULL, INK_PREC_NONE);
         if (!n) {
             return n;
         }
@@ -1083,9 +1067,9 @@ static struct ink_ast_node *ink_parse_primary_expr(struct ink_parser *p)
     }
 }
 
-static struct ink_ast_node *ink_parse_prefix_expr(struct ink_parser *p)
+static uint32_t ink_parse_prefix_expr(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     const struct ink_token t = p->token;
 
     switch (t.type) {
@@ -1097,8 +1081,9 @@ static struct ink_ast_node *ink_parse_prefix_expr(struct ink_parser *p)
         if (!n) {
             return n;
         }
-        return ink_ast_binary_new(ink_token_prefix_type(t.type), t.bytes_start,
-                                  n->bytes_end, n, NULL, p->arena);
+        return ink_ast_binary_new(p->tree, ink_token_prefix_type(t.type),
+                                  t.bytes_start, ink_ast_node_end(p->tree, n),
+                                  n, INK_AST_NULL);
     case INK_TT_RIGHT_ARROW:
         return ink_parse_divert(p);
     default:
@@ -1106,9 +1091,8 @@ static struct ink_ast_node *ink_parse_prefix_expr(struct ink_parser *p)
     }
 }
 
-static struct ink_ast_node *ink_parse_infix_expr(struct ink_parser *p,
-                                                 struct ink_ast_node *lhs,
-                                                 enum ink_precedence prec)
+static uint32_t ink_parse_infix_expr(struct ink_parser *p, uint32_t lhs,
+                                     enum ink_precedence prec)
 {
     if (!lhs) {
         lhs = ink_parse_prefix_expr(p);
@@ -1117,21 +1101,21 @@ static struct ink_ast_node *ink_parse_infix_expr(struct ink_parser *p,
         }
     }
     for (;;) {
-        struct ink_ast_node *rhs = NULL;
+        uint32_t rhs = INK_AST_NULL;
         const struct ink_token t = p->token;
         const enum ink_precedence t_prec = ink_binding_power(t.type);
 
         if (ink_binding_power(t.type) > prec) {
             ink_parser_advance(p);
 
-            rhs = ink_parse_infix_expr(p, NULL, t_prec);
+            rhs = ink_parse_infix_expr(p, INK_AST_NULL, t_prec);
             if (!rhs) {
                 return rhs;
             }
 
-            lhs = ink_ast_binary_new(ink_token_infix_type(t.type),
-                                     lhs->bytes_start, rhs->bytes_end, lhs, rhs,
-                                     p->arena);
+            lhs = ink_ast_binary_new(p->tree, ink_token_infix_type(t.type),
+                                     ink_ast_node_start(p->tree, lhs),
+                                     ink_ast_node_end(p->tree, rhs), lhs, rhs);
         } else {
             break;
         }
@@ -1139,59 +1123,59 @@ static struct ink_ast_node *ink_parse_infix_expr(struct ink_parser *p,
     return lhs;
 }
 
-static struct ink_ast_node *ink_parse_divert_expr(struct ink_parser *p)
+static uint32_t ink_parse_divert_expr(struct ink_parser *p)
 {
     const size_t b_start = ink_parser_advance(p);
-    struct ink_ast_node *const n = ink_parse_identifier_expr(p);
+    const uint32_t n = ink_parse_identifier_expr(p);
 
-    return ink_ast_binary_new(INK_AST_DIVERT, b_start, p->token.bytes_start, n,
-                              NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_DIVERT, b_start,
+                              p->token.bytes_start, n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_expr(struct ink_parser *p)
+static uint32_t ink_parse_expr(struct ink_parser *p)
 {
-    return ink_parse_infix_expr(p, NULL, INK_PREC_NONE);
+    return ink_parse_infix_expr(p, INK_AST_NULL, INK_PREC_NONE);
 }
 
-static struct ink_ast_node *ink_parse_return_stmt(struct ink_parser *p)
+static uint32_t ink_parse_return_stmt(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     ink_parser_advance(p);
 
     if (!ink_parser_check(p, INK_TT_NL) && !ink_parser_check(p, INK_TT_EOF)) {
         n = ink_parse_expr(p);
     }
-    return ink_ast_binary_new(INK_AST_RETURN_STMT, t.bytes_start,
-                              ink_parse_expect_stmt_end(p), n, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_RETURN_STMT, t.bytes_start,
+                              ink_parse_expect_stmt_end(p), n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_divert_stmt(struct ink_parser *p)
+static uint32_t ink_parse_divert_stmt(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     ink_parser_push_scanner(p, INK_GRAMMAR_EXPRESSION);
     n = ink_parse_divert_expr(p);
     ink_parser_pop_scanner(p);
-    return ink_ast_binary_new(INK_AST_DIVERT_STMT, t.bytes_start,
-                              ink_parse_expect_stmt_end(p), n, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_DIVERT_STMT, t.bytes_start,
+                              ink_parse_expect_stmt_end(p), n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_glue(struct ink_parser *p)
+static uint32_t ink_parse_glue(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
 
     ink_parser_advance(p);
-    return ink_ast_leaf_new(INK_AST_GLUE, t.bytes_start, t.bytes_end, p->arena);
+    return ink_ast_leaf_new(p->tree, INK_AST_GLUE, t.bytes_start, t.bytes_end);
 }
 
-static struct ink_ast_node *ink_parse_temp_decl(struct ink_parser *p)
+static uint32_t ink_parse_temp_decl(struct ink_parser *p)
 {
     const size_t b_start = ink_parser_advance(p);
-    struct ink_ast_node *const lhs = ink_parse_expect_identifier(p);
-    struct ink_ast_node *rhs = NULL;
+    const uint32_t lhs = ink_parse_expect_identifier(p);
+    uint32_t rhs = INK_AST_NULL;
 
     if (!lhs) {
         return lhs;
@@ -1203,25 +1187,25 @@ static struct ink_ast_node *ink_parse_temp_decl(struct ink_parser *p)
     if (!rhs) {
         return rhs;
     }
-    return ink_ast_binary_new(INK_AST_TEMP_DECL, b_start,
-                              ink_parse_expect_stmt_end(p), lhs, rhs, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_TEMP_DECL, b_start,
+                              ink_parse_expect_stmt_end(p), lhs, rhs);
 }
 
-static struct ink_ast_node *ink_parse_expr_stmt(struct ink_parser *p,
-                                                struct ink_ast_node *lhs)
+static uint32_t ink_parse_expr_stmt(struct ink_parser *p, uint32_t lhs)
 {
-    const size_t b_start = lhs ? lhs->bytes_start : p->token.bytes_start;
-    struct ink_ast_node *const n = ink_parse_infix_expr(p, lhs, INK_PREC_NONE);
+    const size_t b_start =
+        lhs ? ink_ast_node_start(p->tree, lhs) : p->token.bytes_start;
+    const uint32_t n = ink_parse_infix_expr(p, lhs, INK_PREC_NONE);
 
-    return ink_ast_binary_new(INK_AST_EXPR_STMT, b_start,
-                              ink_parse_expect_stmt_end(p), n, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_EXPR_STMT, b_start,
+                              ink_parse_expect_stmt_end(p), n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_assign_stmt(struct ink_parser *p)
+static uint32_t ink_parse_assign_stmt(struct ink_parser *p)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *const lhs = ink_parse_identifier_expr(p);
-    struct ink_ast_node *rhs = NULL;
+    const uint32_t lhs = ink_parse_identifier_expr(p);
+    uint32_t rhs = INK_AST_NULL;
 
     if (!ink_parser_match(p, INK_TT_EQUAL)) {
         return ink_parse_expr_stmt(p, lhs);
@@ -1231,13 +1215,13 @@ static struct ink_ast_node *ink_parse_assign_stmt(struct ink_parser *p)
     if (!rhs) {
         return rhs;
     }
-    return ink_ast_binary_new(INK_AST_ASSIGN_STMT, t.bytes_start,
-                              ink_parse_expect_stmt_end(p), lhs, rhs, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_ASSIGN_STMT, t.bytes_start,
+                              ink_parse_expect_stmt_end(p), lhs, rhs);
 }
 
-static struct ink_ast_node *ink_parse_tilde_stmt(struct ink_parser *p)
+static uint32_t ink_parse_tilde_stmt(struct ink_parser *p)
 {
-    struct ink_ast_node *lhs = NULL;
+    uint32_t lhs = INK_AST_NULL;
 
     ink_parser_push_scanner(p, INK_GRAMMAR_EXPRESSION);
     ink_parser_advance(p);
@@ -1253,7 +1237,7 @@ static struct ink_ast_node *ink_parse_tilde_stmt(struct ink_parser *p)
         lhs = ink_parse_assign_stmt(p);
         break;
     default:
-        lhs = ink_parse_expr_stmt(p, NULL);
+        lhs = ink_parse_expr_stmt(p, INK_AST_NULL);
         break;
     }
 
@@ -1261,11 +1245,11 @@ static struct ink_ast_node *ink_parse_tilde_stmt(struct ink_parser *p)
     return lhs;
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parse_content(struct ink_parser *p, const enum ink_token_type *token_set)
 {
     enum ink_ast_node_type type;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     struct ink_stmt_context ctx = ink_make_stmt_context(p, INK_PARSE_BLOCK);
     const struct ink_token t = p->token;
 
@@ -1301,11 +1285,11 @@ exit_loop:
                                     p->token.bytes_start, ctx.scratch_top);
 }
 
-static struct ink_ast_node *
+static uint32_t
 ink_parse_conditional_branch(struct ink_parser *p, enum ink_ast_node_type type)
 {
     const struct ink_token t = p->token;
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     if (ink_parser_match(p, INK_TT_KEYWORD_ELSE)) {
         type = INK_AST_ELSE_BRANCH;
@@ -1316,21 +1300,20 @@ ink_parse_conditional_branch(struct ink_parser *p, enum ink_ast_node_type type)
         }
     }
     if (!ink_parser_match(p, INK_TT_COLON)) {
-        return NULL;
+        return INK_AST_NULL;
     }
     if (ink_parser_check(p, INK_TT_NL)) {
         ink_parser_advance(p);
     }
-    return ink_ast_binary_new(type, t.bytes_start, p->token.bytes_start, n,
-                              NULL, p->arena);
+    return ink_ast_binary_new(p->tree, type, t.bytes_start,
+                              p->token.bytes_start, n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_conditional(struct ink_parser *p,
-                                                  struct ink_ast_node *expr)
+static uint32_t ink_parse_conditional(struct ink_parser *p, uint32_t expr)
 {
     enum ink_ast_node_type type = 0;
-    struct ink_ast_node *n = NULL;
-    struct ink_ast_node_list *l = NULL;
+    uint32_t n = INK_AST_NULL;
+    uint32_t l = INK_AST_NULL;
     const struct ink_token t = p->token;
     struct ink_stmt_context ctx = ink_make_stmt_context(p, INK_PARSE_SWITCH);
 
@@ -1357,19 +1340,19 @@ static struct ink_ast_node *ink_parse_conditional(struct ink_parser *p,
     } else {
         type = INK_AST_IF_STMT;
     }
-    return ink_ast_switch_stmt_new(type, t.bytes_start, p->token.bytes_start,
-                                   expr, l, p->arena);
+    return ink_ast_switch_stmt_new(p->tree, type, t.bytes_start,
+                                   p->token.bytes_start, expr, l);
 }
 
-static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *p)
+static uint32_t ink_parse_lbrace_expr(struct ink_parser *p)
 {
     static const enum ink_token_type token_set[] = {
         INK_TT_LEFT_BRACE, INK_TT_RIGHT_BRACE, INK_TT_RIGHT_ARROW,
         INK_TT_GLUE,       INK_TT_NL,          INK_TT_EOF,
     };
 
-    struct ink_ast_node *lhs = NULL;
-    struct ink_ast_node *rhs = NULL;
+    uint32_t lhs = INK_AST_NULL;
+    uint32_t rhs = INK_AST_NULL;
     const struct ink_token t = p->token;
 
     ink_parser_push_scanner(p, INK_GRAMMAR_EXPRESSION);
@@ -1381,7 +1364,7 @@ static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *p)
             ink_parser_pop_scanner(p);
             ink_parser_error(p, INK_AST_E_INVALID_EXPR, &p->token);
             ink_parser_advance(p);
-            return NULL;
+            return INK_AST_NULL;
         }
         if (ink_parser_check(p, INK_TT_COLON)) {
             ink_parser_push_scanner(p, INK_GRAMMAR_CONTENT);
@@ -1392,9 +1375,9 @@ static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *p)
                 rhs = ink_parse_conditional(p, lhs);
             } else {
                 rhs = ink_parse_content(p, token_set);
-                rhs = ink_ast_binary_new(INK_AST_IF_EXPR, t.bytes_start,
-                                         p->token.bytes_start, lhs, rhs,
-                                         p->arena);
+                rhs = ink_ast_binary_new(p->tree, INK_AST_IF_EXPR,
+                                         t.bytes_start, p->token.bytes_start,
+                                         lhs, rhs);
             }
 
             ink_parser_pop_scanner(p);
@@ -1402,14 +1385,14 @@ static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *p)
         } else {
             ink_parser_pop_scanner(p);
             ink_parser_expect_token(p, INK_TT_RIGHT_BRACE);
-            return ink_ast_binary_new(INK_AST_INLINE_LOGIC, t.bytes_start,
-                                      p->token.bytes_start, lhs, NULL,
-                                      p->arena);
+            return ink_ast_binary_new(p->tree, INK_AST_INLINE_LOGIC,
+                                      t.bytes_start, p->token.bytes_start, lhs,
+                                      INK_AST_NULL);
         }
     } else {
         ink_parser_advance(p);
         ink_parser_push_scanner(p, INK_GRAMMAR_CONTENT);
-        rhs = ink_parse_conditional(p, NULL);
+        rhs = ink_parse_conditional(p, INK_AST_NULL);
         ink_parser_expect_token(p, INK_TT_RIGHT_BRACE);
         ink_parser_pop_scanner(p);
     }
@@ -1418,41 +1401,42 @@ static struct ink_ast_node *ink_parse_lbrace_expr(struct ink_parser *p)
     return rhs;
 }
 
-static struct ink_ast_node *ink_parse_content_stmt(struct ink_parser *p)
+static uint32_t ink_parse_content_stmt(struct ink_parser *p)
 {
     static const enum ink_token_type token_set[] = {
         INK_TT_LEFT_BRACE, INK_TT_RIGHT_BRACE, INK_TT_RIGHT_ARROW,
         INK_TT_GLUE,       INK_TT_NL,          INK_TT_EOF,
     };
     const size_t b_start = p->token.bytes_start;
-    struct ink_ast_node *const n = ink_parse_content(p, token_set);
-    const size_t b_end = n ? n->bytes_end : p->token.bytes_start;
+    const uint32_t n = ink_parse_content(p, token_set);
+    const size_t b_end =
+        n ? ink_ast_node_end(p->tree, n) : p->token.bytes_start;
 
     if (ink_parser_check(p, INK_TT_NL)) {
         ink_parser_advance(p);
         /* FIXME: Trailing whitespace is interpreted as empty content. */
         ink_parser_match(p, INK_TT_WHITESPACE);
     }
-    return ink_ast_binary_new(INK_AST_CONTENT_STMT, b_start, b_end, n, NULL,
-                              p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_CONTENT_STMT, b_start, b_end, n,
+                              INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_choice_expr(struct ink_parser *p)
+static uint32_t ink_parse_choice_expr(struct ink_parser *p)
 {
     static const enum ink_token_type token_set[] = {
         INK_TT_LEFT_BRACE,    INK_TT_LEFT_BRACKET, INK_TT_RIGHT_BRACE,
         INK_TT_RIGHT_BRACKET, INK_TT_RIGHT_ARROW,  INK_TT_NL,
         INK_TT_EOF,
     };
-    struct ink_ast_node *lhs = NULL;
-    struct ink_ast_node *mhs = NULL;
-    struct ink_ast_node *rhs = NULL;
+    uint32_t lhs = INK_AST_NULL;
+    uint32_t mhs = INK_AST_NULL;
+    uint32_t rhs = INK_AST_NULL;
     const struct ink_token t = p->token;
 
     lhs = ink_parse_string(p, token_set);
     if (lhs) {
-        if (lhs->type != INK_AST_EMPTY_STRING) {
-            lhs->type = INK_AST_CHOICE_START_EXPR;
+        if (ink_ast_node_type(p->tree, lhs) != INK_AST_EMPTY_STRING) {
+            ink_ast_node_set_type(p->tree, lhs, INK_AST_CHOICE_START_EXPR);
         }
     }
     if (ink_parser_check(p, INK_TT_LEFT_BRACKET)) {
@@ -1462,8 +1446,9 @@ static struct ink_ast_node *ink_parse_choice_expr(struct ink_parser *p)
         if (!ink_parser_check(p, INK_TT_RIGHT_BRACKET)) {
             mhs = ink_parse_string(p, token_set);
             if (mhs) {
-                if (mhs->type != INK_AST_EMPTY_STRING) {
-                    mhs->type = INK_AST_CHOICE_OPTION_EXPR;
+                if (ink_ast_node_type(p->tree, mhs) != INK_AST_EMPTY_STRING) {
+                    ink_ast_node_set_type(p->tree, mhs,
+                                          INK_AST_CHOICE_OPTION_EXPR);
                 }
             }
         }
@@ -1473,39 +1458,39 @@ static struct ink_ast_node *ink_parse_choice_expr(struct ink_parser *p)
         if (!ink_parser_check_many(p, token_set)) {
             rhs = ink_parse_string(p, token_set);
             if (rhs) {
-                if (rhs->type != INK_AST_EMPTY_STRING) {
-                    rhs->type = INK_AST_CHOICE_INNER_EXPR;
+                if (ink_ast_node_type(p->tree, rhs) != INK_AST_EMPTY_STRING) {
+                    ink_ast_node_set_type(p->tree, rhs,
+                                          INK_AST_CHOICE_INNER_EXPR);
                 }
             }
         }
     }
-    return ink_ast_choice_expr_new(INK_AST_CHOICE_EXPR, t.bytes_start,
-                                   p->token.bytes_start, lhs, mhs, rhs,
-                                   p->arena);
+    return ink_ast_choice_expr_new(p->tree, INK_AST_CHOICE_EXPR, t.bytes_start,
+                                   p->token.bytes_start, lhs, mhs, rhs);
 }
 
-static struct ink_ast_node *ink_parse_choice_stmt(struct ink_parser *p,
-                                                  struct ink_stmt_context *ctx)
+static uint32_t ink_parse_choice_stmt(struct ink_parser *p,
+                                      struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     const struct ink_token t = p->token;
     size_t b_end = 0;
 
     ctx->level = ink_parser_match_many(p, t.type, true);
     n = ink_parse_choice_expr(p);
-    b_end = n ? n->bytes_end : p->token.bytes_start;
+    b_end = n ? ink_ast_node_end(p->tree, n) : p->token.bytes_start;
 
     if (ink_parser_check(p, INK_TT_NL)) {
         ink_parser_advance(p);
     }
-    return ink_ast_binary_new(ink_branch_type(t.type), t.bytes_start, b_end, n,
-                              NULL, p->arena);
+    return ink_ast_binary_new(p->tree, ink_branch_type(t.type), t.bytes_start,
+                              b_end, n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_gather_point(struct ink_parser *p,
-                                                   struct ink_stmt_context *ctx)
+static uint32_t ink_parse_gather_point(struct ink_parser *p,
+                                       struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     const struct ink_token t = p->token;
     size_t b_end = 0;
 
@@ -1513,15 +1498,14 @@ static struct ink_ast_node *ink_parse_gather_point(struct ink_parser *p,
     b_end = p->token.bytes_start;
     ink_parser_match(p, INK_TT_WHITESPACE);
     ink_parser_match(p, INK_TT_NL);
-    return ink_ast_binary_new(INK_AST_GATHER_POINT_STMT, t.bytes_start, b_end,
-                              n, NULL, p->arena);
+    return ink_ast_binary_new(p->tree, INK_AST_GATHER_POINT_STMT, t.bytes_start,
+                              b_end, n, INK_AST_NULL);
 }
 
-static struct ink_ast_node *ink_parse_var(struct ink_parser *p,
-                                          enum ink_ast_node_type type)
+static uint32_t ink_parse_var(struct ink_parser *p, enum ink_ast_node_type type)
 {
-    struct ink_ast_node *lhs = NULL;
-    struct ink_ast_node *rhs = NULL;
+    uint32_t lhs = INK_AST_NULL;
+    uint32_t rhs = INK_AST_NULL;
     const struct ink_token t = p->token;
 
     ink_parser_push_scanner(p, INK_GRAMMAR_EXPRESSION);
@@ -1530,48 +1514,48 @@ static struct ink_ast_node *ink_parse_var(struct ink_parser *p,
     lhs = ink_parse_expect_identifier(p);
     if (!lhs) {
         ink_parser_pop_scanner(p);
-        return NULL;
+        return INK_AST_NULL;
     }
 
     ink_parser_expect_token(p, INK_TT_EQUAL);
     rhs = ink_parse_expect_expr(p);
     ink_parser_pop_scanner(p);
-    return ink_ast_binary_new(type, t.bytes_start, ink_parse_expect_stmt_end(p),
-                              lhs, rhs, p->arena);
+    return ink_ast_binary_new(p->tree, type, t.bytes_start,
+                              ink_parse_expect_stmt_end(p), lhs, rhs);
 }
 
-static struct ink_ast_node *ink_parse_var_decl(struct ink_parser *p)
+static uint32_t ink_parse_var_decl(struct ink_parser *p)
 {
     return ink_parse_var(p, INK_AST_VAR_DECL);
 }
 
-static struct ink_ast_node *ink_parse_const_decl(struct ink_parser *p)
+static uint32_t ink_parse_const_decl(struct ink_parser *p)
 {
     return ink_parse_var(p, INK_AST_CONST_DECL);
 }
 
-static struct ink_ast_node *ink_parse_parameter_decl(struct ink_parser *p)
+static uint32_t ink_parse_parameter_decl(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     if (ink_parser_check(p, INK_TT_KEYWORD_REF)) {
         ink_parser_advance(p);
         n = ink_parse_expect_identifier(p);
         if (n) {
-            n->type = INK_AST_REF_PARAM_DECL;
+            ink_ast_node_set_type(p->tree, n, INK_AST_REF_PARAM_DECL);
         }
     } else {
         n = ink_parse_expect_identifier(p);
         if (n) {
-            n->type = INK_AST_PARAM_DECL;
+            ink_ast_node_set_type(p->tree, n, INK_AST_PARAM_DECL);
         }
     }
     return n;
 }
 
-static struct ink_ast_node *ink_parse_parameter_list(struct ink_parser *p)
+static uint32_t ink_parse_parameter_list(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     struct ink_stmt_context ctx = ink_make_stmt_context(p, INK_PARSE_BLOCK);
     size_t b_start = ink_parser_expect_token(p, INK_TT_LEFT_PAREN);
     size_t cnt = 0;
@@ -1602,11 +1586,11 @@ static struct ink_ast_node *ink_parse_parameter_list(struct ink_parser *p)
                                     p->token.bytes_start, ctx.scratch_top);
 }
 
-static struct ink_ast_node *ink_parse_knot_decl(struct ink_parser *p)
+static uint32_t ink_parse_knot_decl(struct ink_parser *p)
 {
     enum ink_ast_node_type type = INK_AST_STITCH_PROTO;
-    struct ink_ast_node *lhs = NULL;
-    struct ink_ast_node *rhs = NULL;
+    uint32_t lhs = INK_AST_NULL;
+    uint32_t rhs = INK_AST_NULL;
     const size_t b_start = ink_parser_advance(p);
 
     ink_parser_push_scanner(p, INK_GRAMMAR_EXPRESSION);
@@ -1628,7 +1612,7 @@ static struct ink_ast_node *ink_parse_knot_decl(struct ink_parser *p)
     lhs = ink_parse_expect_identifier(p);
     if (!lhs) {
         ink_parser_pop_scanner(p);
-        return NULL;
+        return INK_AST_NULL;
     }
     if (ink_parser_check(p, INK_TT_LEFT_PAREN)) {
         rhs = ink_parse_parameter_list(p);
@@ -1639,14 +1623,14 @@ static struct ink_ast_node *ink_parse_knot_decl(struct ink_parser *p)
     }
 
     ink_parser_pop_scanner(p);
-    return ink_ast_binary_new(type, b_start, ink_parse_expect_stmt_end(p), lhs,
-                              rhs, p->arena);
+    return ink_ast_binary_new(p->tree, type, b_start,
+                              ink_parse_expect_stmt_end(p), lhs, rhs);
 }
 
-static struct ink_ast_node *ink_parse_stmt(struct ink_parser *p,
-                                           struct ink_stmt_context *ctx)
+static uint32_t ink_parse_stmt(struct ink_parser *p,
+                               struct ink_stmt_context *ctx)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
 
     ink_parser_match(p, INK_TT_WHITESPACE);
 
@@ -1720,9 +1704,9 @@ static struct ink_ast_node *ink_parse_stmt(struct ink_parser *p,
     if (!n || p->panic_mode) {
         ink_parser_sync(p);
         ink_parser_match(p, INK_TT_NL);
-        return NULL;
+        return INK_AST_NULL;
     }
-    switch (n->type) {
+    switch (ink_ast_node_type(p->tree, n)) {
     case INK_AST_IF_BRANCH:
     case INK_AST_ELSE_BRANCH:
     case INK_AST_SWITCH_CASE:
@@ -1751,9 +1735,9 @@ static struct ink_ast_node *ink_parse_stmt(struct ink_parser *p,
     return n;
 }
 
-static struct ink_ast_node *ink_parse_file(struct ink_parser *p)
+static uint32_t ink_parse_file(struct ink_parser *p)
 {
-    struct ink_ast_node *n = NULL;
+    uint32_t n = INK_AST_NULL;
     struct ink_stmt_context ctx = ink_make_stmt_context(p, INK_PARSE_BLOCK);
 
     if (setjmp(p->jmpbuf) == 0) {
@@ -1777,15 +1761,21 @@ static struct ink_ast_node *ink_parse_file(struct ink_parser *p)
  * Parse a source file and output an AST.
  *
  * Returns zero on success and a negative integer on an internal failure.
+ * Nodes address the source with 32-bit offsets, so sources larger than
+ * 4 GiB are rejected.
  */
 int ink_parse(const uint8_t *source_bytes, size_t source_length,
-              const uint8_t *filename, struct ink_arena *arena,
-              struct ink_ast *tree, int flags)
+              const uint8_t *filename, struct ink_ast *tree, int flags)
 {
     struct ink_parser p;
 
     ink_ast_init(tree, filename, source_bytes);
-    ink_parser_init(&p, tree, arena, flags);
+
+    if (source_length > UINT32_MAX) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    ink_parser_init(&p, tree, source_length, flags);
     ink_parser_advance(&p);
 
     tree->root = ink_parse_file(&p);
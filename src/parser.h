@@ -8,12 +8,11 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
-struct ink_arena;
 struct ink_ast;
 
 extern int ink_parse(const uint8_t *source_bytes, size_t source_length,
-                     const uint8_t *filename, struct ink_arena *arena,
-                     struct ink_ast *tree, int flags);
+                     const uint8_t *filename, struct ink_ast *tree,
+                     int flags);
 
 #ifdef __cplusplus
 }
@@ -1,10 +1,36 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "scanner.h"
 #include "token.h"
 
+#if defined(INK_USE_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INK_SCAN_AVX2
+#define INK_SCAN_WIDTH (32u)
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INK_SCAN_SSE2
+#define INK_SCAN_WIDTH (16u)
+#endif
+#endif
+
+#define INK_KEYWORD_TABLE_SIZE (32u)
+
+/**
+ * Classes of byte runs that the scanner can skip over in bulk.
+ */
+enum ink_scan_class {
+    INK_SCAN_IDENTIFIER,
+    INK_SCAN_BLANK,
+    INK_SCAN_COMMENT_LINE,
+    INK_SCAN_COMMENT_BLOCK,
+};
+
 enum ink_lex_state {
     INK_LEX_START,
     INK_LEX_MINUS,
@@ -71,6 +97,175 @@ static inline bool ink_is_identifier(uint8_t ch)
     return ink_is_alpha(ch) || ink_is_digit(ch) || ch == '_';
 }
 
+void ink_scanner_init(struct ink_scanner *scanner,
+                      const uint8_t *source_bytes, size_t source_length)
+{
+    scanner->source_bytes = source_bytes;
+    scanner->source_length = source_length;
+    scanner->start_offset = 0;
+    scanner->cursor_offset = 0;
+    scanner->mode_depth = 0;
+    scanner->is_line_start = true;
+    scanner->mode_stack[0].type = INK_GRAMMAR_CONTENT;
+    scanner->mode_stack[0].source_offset = 0;
+}
+
+/**
+ * Check if a byte continues a run of the given class.
+ */
+static inline bool ink_scan_continues(uint8_t ch, enum ink_scan_class c)
+{
+    switch (c) {
+    case INK_SCAN_IDENTIFIER:
+        return ink_is_identifier(ch);
+    case INK_SCAN_BLANK:
+        return ch == ' ' || ch == '\t';
+    case INK_SCAN_COMMENT_LINE:
+        return ch != '\n' && ch != '\0';
+    case INK_SCAN_COMMENT_BLOCK:
+        return ch != '*' && ch != '\0';
+    default:
+        return false;
+    }
+}
+
+#if defined(INK_SCAN_WIDTH)
+static inline unsigned int ink_scan_first_bit(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int n = 0;
+
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+#endif
+
+#if defined(INK_SCAN_AVX2)
+/**
+ * Return a mask of the bytes in a block that end a run of the given class.
+ */
+static inline uint32_t ink_scan_stop_mask(const uint8_t *bytes,
+                                          enum ink_scan_class c)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i *)bytes);
+    __m256i stop;
+
+    switch (c) {
+    case INK_SCAN_IDENTIFIER: {
+        const __m256i alpha = _mm256_sub_epi8(
+            _mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        const __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+        const __m256i run = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(
+                    _mm256_min_epu8(alpha, _mm256_set1_epi8(25)), alpha),
+                _mm256_cmpeq_epi8(
+                    _mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit)),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+
+        return ~(uint32_t)_mm256_movemask_epi8(run);
+    }
+    case INK_SCAN_BLANK: {
+        const __m256i run =
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+
+        return ~(uint32_t)_mm256_movemask_epi8(run);
+    }
+    case INK_SCAN_COMMENT_LINE:
+        stop = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        break;
+    case INK_SCAN_COMMENT_BLOCK:
+        stop = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*'));
+        break;
+    default:
+        return 1;
+    }
+
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return (uint32_t)_mm256_movemask_epi8(stop);
+}
+#elif defined(INK_SCAN_SSE2)
+/**
+ * Return a mask of the bytes in a block that end a run of the given class.
+ */
+static inline uint32_t ink_scan_stop_mask(const uint8_t *bytes,
+                                          enum ink_scan_class c)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)bytes);
+    __m128i stop;
+
+    switch (c) {
+    case INK_SCAN_IDENTIFIER: {
+        const __m128i alpha = _mm_sub_epi8(
+            _mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        const __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+        const __m128i run = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(25)), alpha),
+                _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit)),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+        return ~(uint32_t)_mm_movemask_epi8(run) & 0xffffu;
+    }
+    case INK_SCAN_BLANK: {
+        const __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        const __m128i tab = _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'));
+        const __m128i run = _mm_or_si128(space, tab);
+
+        return ~(uint32_t)_mm_movemask_epi8(run) & 0xffffu;
+    }
+    case INK_SCAN_COMMENT_LINE:
+        stop = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        break;
+    case INK_SCAN_COMMENT_BLOCK:
+        stop = _mm_cmpeq_epi8(v, _mm_set1_epi8('*'));
+        break;
+    default:
+        return 1;
+    }
+
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return (uint32_t)_mm_movemask_epi8(stop);
+}
+#endif
+
+/**
+ * Return the offset of the first byte at or after `offset` that does not
+ * continue a run of the given class.
+ *
+ * Whole blocks are tested at once where vector instructions are available.
+ * Blocks never extend past the end of the source, with the remaining bytes
+ * checked one at a time up to the terminating NUL.
+ */
+static size_t ink_scanner_skip(const struct ink_scanner *scanner,
+                               size_t offset, enum ink_scan_class c)
+{
+    const uint8_t *const bytes = scanner->source_bytes;
+
+#if defined(INK_SCAN_WIDTH)
+    while (offset + INK_SCAN_WIDTH <= scanner->source_length) {
+        const uint32_t mask = ink_scan_stop_mask(&bytes[offset], c);
+
+        if (mask) {
+            return offset + ink_scan_first_bit(mask);
+        }
+
+        offset += INK_SCAN_WIDTH;
+    }
+#endif
+    while (ink_scan_continues(bytes[offset], c)) {
+        offset++;
+    }
+    return offset;
+}
+
 struct ink_scanner_mode *ink_scanner_current(struct ink_scanner *scanner)
 {
     return &scanner->mode_stack[scanner->mode_depth];
@@ -112,6 +307,34 @@ void ink_scanner_rewind(struct ink_scanner *scanner, size_t source_offset)
     scanner->cursor_offset = source_offset;
 }
 
+/**
+ * Perfect hash of a keyword's length, first byte and last byte.
+ */
+#define INK_KEYWORD_HASH(length, first, last)                                  \
+    (((length) + 4u * (first) + (last)) & (INK_KEYWORD_TABLE_SIZE - 1u))
+
+/**
+ * Keyword table, indexed by `INK_KEYWORD_HASH`.
+ *
+ * Unused slots have a length of zero. Two keywords hashing to the same slot
+ * would initialize it twice, which the compiler reports as a warning.
+ */
+static const struct ink_keyword {
+    enum ink_token_type type;
+    size_t length;
+    const char *bytes;
+} ink_keyword_table[INK_KEYWORD_TABLE_SIZE] = {
+#define T(name, keyword, first, last)                                          \
+    [INK_KEYWORD_HASH(sizeof(keyword) - 1u, (unsigned char)(first),            \
+                      (unsigned char)(last))] = {                              \
+        .type = INK_##name,                                                    \
+        .length = sizeof(keyword) - 1u,                                        \
+        .bytes = keyword,                                                      \
+    },
+    INK_MAKE_KEYWORD_LIST(T)
+#undef T
+};
+
 static enum ink_token_type ink_scanner_keyword(struct ink_scanner *scanner,
                                                enum ink_token_type type,
                                                size_t bytes_start,
@@ -119,62 +342,17 @@ static enum ink_token_type ink_scanner_keyword(struct ink_scanner *scanner,
 {
     const uint8_t *lexeme = &scanner->source_bytes[bytes_start];
     const size_t length = bytes_end - bytes_start;
+    const struct ink_keyword *keyword;
 
-    switch (length) {
-    case 2: {
-        if (memcmp(lexeme, "or", length) == 0) {
-            type = INK_TT_KEYWORD_OR;
-        }
-        break;
-    }
-    case 3: {
-        if (memcmp(lexeme, "and", length) == 0) {
-            type = INK_TT_KEYWORD_AND;
-        } else if (memcmp(lexeme, "mod", length) == 0) {
-            type = INK_TT_KEYWORD_MOD;
-        } else if (memcmp(lexeme, "not", length) == 0) {
-            type = INK_TT_KEYWORD_NOT;
-        } else if (memcmp(lexeme, "ref", length) == 0) {
-            type = INK_TT_KEYWORD_REF;
-        } else if (memcmp(lexeme, "VAR", length) == 0) {
-            type = INK_TT_KEYWORD_VAR;
-        }
-        break;
-    }
-    case 4: {
-        if (memcmp(lexeme, "else", length) == 0) {
-            type = INK_TT_KEYWORD_ELSE;
-        } else if (memcmp(lexeme, "temp", length) == 0) {
-            type = INK_TT_KEYWORD_TEMP;
-        } else if (memcmp(lexeme, "true", length) == 0) {
-            type = INK_TT_KEYWORD_TRUE;
-        } else if (memcmp(lexeme, "LIST", length) == 0) {
-            type = INK_TT_KEYWORD_LIST;
-        }
-        break;
+    if (length == 0) {
+        return type;
     }
-    case 5: {
-        if (memcmp(lexeme, "false", length) == 0) {
-            type = INK_TT_KEYWORD_FALSE;
-        } else if (memcmp(lexeme, "CONST", length) == 0) {
-            type = INK_TT_KEYWORD_CONST;
-        }
-        break;
-    }
-    case 6: {
-        if (memcmp(lexeme, "return", length) == 0) {
-            type = INK_TT_KEYWORD_RETURN;
-        }
-        break;
-    }
-    case 8: {
-        if (memcmp(lexeme, "function", length) == 0) {
-            type = INK_TT_KEYWORD_FUNCTION;
-        }
-        break;
-    }
-    default:
-        break;
+
+    keyword = &ink_keyword_table[INK_KEYWORD_HASH(length, lexeme[0],
+                                                  lexeme[length - 1])];
+    if (keyword->length == length &&
+        memcmp(lexeme, keyword->bytes, length) == 0) {
+        return keyword->type;
     }
     return type;
 }
@@ -183,9 +361,6 @@ static enum ink_token_type ink_scanner_keyword(struct ink_scanner *scanner,
  * Return a token type representing a keyword that the specified token
  * represents. If the token's type does not correspond to a keyword,
  * the token's type will be returned instead.
- *
- * TODO(Brett): Perhaps we could add an early return to ignore any
- * UTF-8 encoded byte sequence, as no reserved words contain such things.
  */
 static enum ink_token_type
 ink_scanner_keyword_from_token(struct ink_scanner *scanner,
@@ -445,7 +620,10 @@ void ink_scanner_next(struct ink_scanner *scanner, struct ink_token *token)
                 token->type = INK_TT_STRING;
                 goto exit_loop;
             }
-            break;
+
+            scanner->cursor_offset = ink_scanner_skip(
+                scanner, scanner->cursor_offset, INK_SCAN_IDENTIFIER);
+            continue;
         }
         case INK_LEX_NUMBER: {
             if (ch == '.') {
@@ -487,13 +665,18 @@ void ink_scanner_next(struct ink_scanner *scanner, struct ink_token *token)
                 }
                 goto exit_loop;
             }
-            break;
+
+            scanner->cursor_offset = ink_scanner_skip(
+                scanner, scanner->cursor_offset, INK_SCAN_IDENTIFIER);
+            continue;
         }
         case INK_LEX_WHITESPACE: {
             switch (ch) {
             case ' ':
             case '\t':
-                break;
+                scanner->cursor_offset = ink_scanner_skip(
+                    scanner, scanner->cursor_offset, INK_SCAN_BLANK);
+                continue;
             default:
                 if (scanner->is_line_start ||
                     mode->type == INK_GRAMMAR_EXPRESSION) {
@@ -516,7 +699,9 @@ void ink_scanner_next(struct ink_scanner *scanner, struct ink_token *token)
                 scanner->is_line_start = true;
                 break;
             default:
-                break;
+                scanner->cursor_offset = ink_scanner_skip(
+                    scanner, scanner->cursor_offset, INK_SCAN_COMMENT_LINE);
+                continue;
             }
             break;
         }
@@ -529,7 +714,9 @@ void ink_scanner_next(struct ink_scanner *scanner, struct ink_token *token)
                 state = INK_LEX_COMMENT_BLOCK_STAR;
                 break;
             default:
-                break;
+                scanner->cursor_offset = ink_scanner_skip(
+                    scanner, scanner->cursor_offset, INK_SCAN_COMMENT_BLOCK);
+                continue;
             }
             break;
         }
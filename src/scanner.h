@@ -25,6 +25,7 @@ struct ink_scanner_mode {
 
 struct ink_scanner {
     const uint8_t *source_bytes; /* Source code bytes. NULL-terminated */
+    size_t source_length;        /* Length of the source, excluding NULL */
     size_t start_offset;         /* Start offset for current lexeme. */
     size_t cursor_offset;        /* Current offset */
     size_t mode_depth;           /* Mode stack depth */
@@ -32,6 +33,9 @@ struct ink_scanner {
     struct ink_scanner_mode mode_stack[INK_SCANNER_DEPTH_MAX];
 };
 
+extern void ink_scanner_init(struct ink_scanner *scanner,
+                             const uint8_t *source_bytes,
+                             size_t source_length);
 extern bool ink_scanner_try_keyword(struct ink_scanner *scanner,
                                     struct ink_token *token,
                                     enum ink_token_type type);
@@ -0,0 +1,403 @@
+#if defined(INK_USE_PTHREADS)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "scheduler.h"
+#include "story.h"
+#include "thread.h"
+
+/**
+ * Queue a schedule on a worker, either as the most recent or the oldest.
+ *
+ * Must be called with the scheduler lock held.
+ */
+static int ink_scheduler_enqueue(struct ink_scheduler *scheduler,
+                                 struct ink_scheduler_worker *worker,
+                                 struct ink_schedule *schedule, bool is_oldest)
+{
+    int rc;
+    struct ink_schedule_vec *const queue = &worker->queue;
+
+    ink_mutex_lock(&worker->lock);
+    rc = ink_schedule_vec_push(queue, schedule);
+    if (rc >= 0 && is_oldest) {
+        memmove(queue->entries + 1, queue->entries,
+                (queue->count - 1) * sizeof(*queue->entries));
+        queue->entries[0] = schedule;
+    }
+    ink_mutex_unlock(&worker->lock);
+
+    if (rc < 0) {
+        return -INK_E_OOM;
+    }
+
+    scheduler->runnable++;
+    ink_cond_signal(&scheduler->work);
+    return INK_E_OK;
+}
+
+/**
+ * Take the most recently queued schedule of a worker.
+ */
+static struct ink_schedule *ink_scheduler_pop(struct ink_scheduler_worker *w)
+{
+    struct ink_schedule *schedule = NULL;
+
+    ink_mutex_lock(&w->lock);
+    if (w->queue.count > 0) {
+        schedule = ink_schedule_vec_pop(&w->queue);
+    }
+    ink_mutex_unlock(&w->lock);
+    return schedule;
+}
+
+/**
+ * Take the oldest queued schedule of a worker.
+ */
+static struct ink_schedule *ink_scheduler_steal(struct ink_scheduler_worker *w)
+{
+    struct ink_schedule *schedule = NULL;
+
+    ink_mutex_lock(&w->lock);
+    if (w->queue.count > 0) {
+        schedule = w->queue.entries[0];
+        w->queue.count--;
+        memmove(w->queue.entries, w->queue.entries + 1,
+                w->queue.count * sizeof(*w->queue.entries));
+    }
+    ink_mutex_unlock(&w->lock);
+    return schedule;
+}
+
+/**
+ * Claim a schedule, preferring the worker's own queue.
+ *
+ * The caller must have reserved a runnable schedule beforehand, so one is
+ * always found.
+ */
+static struct ink_schedule *ink_scheduler_claim(struct ink_scheduler *s,
+                                                struct ink_scheduler_worker *w)
+{
+    const size_t index = (size_t)(w - s->workers);
+
+    for (;;) {
+        struct ink_schedule *schedule = ink_scheduler_pop(w);
+
+        if (schedule) {
+            return schedule;
+        }
+        for (size_t i = 1; i < s->worker_count; i++) {
+            struct ink_scheduler_worker *const victim =
+                &s->workers[(index + i) % s->worker_count];
+
+            schedule = ink_scheduler_steal(victim);
+            if (schedule) {
+                return schedule;
+            }
+        }
+    }
+}
+
+/**
+ * Run the next job of a schedule for at most one slice.
+ *
+ * Returns `-INK_E_YIELD` if the job has yet to complete. Otherwise, the
+ * completion callback has been called.
+ */
+static int ink_scheduler_run_job(struct ink_scheduler *scheduler,
+                                 struct ink_story *session, size_t choice_index)
+{
+    int rc = INK_E_OK;
+    struct ink_turn turn;
+
+    if (choice_index > 0 && !session->is_yielded) {
+        rc = ink_story_choose(session, choice_index);
+    }
+    if (rc == INK_E_OK) {
+        rc = ink_story_continue_budget(session, INK_SCHEDULER_SLICE, &turn);
+        if (rc == -INK_E_YIELD) {
+            return rc;
+        }
+    }
+
+    scheduler->callback(session, rc, rc == INK_E_OK ? &turn : NULL,
+                        scheduler->userdata);
+    return rc;
+}
+
+/**
+ * Run jobs on behalf of a worker.
+ *
+ * When `block` is set, waits for more jobs until the scheduler is stopped.
+ * Otherwise, returns once no jobs are left.
+ */
+static void ink_scheduler_run(struct ink_scheduler_worker *worker, bool block)
+{
+    struct ink_scheduler *const scheduler = worker->scheduler;
+
+    for (;;) {
+        int rc = INK_E_OK;
+        struct ink_schedule *schedule = NULL;
+        size_t choice_index = 0;
+
+        ink_mutex_lock(&scheduler->lock);
+        while (block && scheduler->runnable == 0 && !scheduler->is_stopping) {
+            ink_cond_wait(&scheduler->work, &scheduler->lock);
+        }
+        if (scheduler->runnable == 0) {
+            ink_mutex_unlock(&scheduler->lock);
+            break;
+        }
+
+        scheduler->runnable--;
+        ink_mutex_unlock(&scheduler->lock);
+
+        schedule = ink_scheduler_claim(scheduler, worker);
+
+        ink_mutex_lock(&scheduler->lock);
+        choice_index = schedule->jobs.entries[schedule->job_next];
+        ink_mutex_unlock(&scheduler->lock);
+
+        for (;;) {
+            bool is_queued = false;
+
+            rc = ink_scheduler_run_job(scheduler, schedule->session,
+                                       choice_index);
+            if (rc != -INK_E_YIELD) {
+                break;
+            }
+
+            ink_mutex_lock(&scheduler->lock);
+            is_queued = ink_scheduler_enqueue(scheduler, worker, schedule,
+                                              true) == INK_E_OK;
+            ink_mutex_unlock(&scheduler->lock);
+
+            /* If the schedule could not be queued, keep running it here. */
+            if (is_queued) {
+                break;
+            }
+        }
+        if (rc == -INK_E_YIELD) {
+            continue;
+        }
+
+        ink_mutex_lock(&scheduler->lock);
+        schedule->job_next++;
+        scheduler->pending--;
+
+        while (schedule->job_next < schedule->jobs.count) {
+            if (ink_scheduler_enqueue(scheduler, worker, schedule, false) ==
+                INK_E_OK) {
+                schedule = NULL;
+                break;
+            }
+
+            /* The schedule could not be requeued, so its next job fails.
+             * The session stays pinned to this worker until the callback
+             * returns, and the jobs after it are retried. */
+            schedule->job_next++;
+            ink_mutex_unlock(&scheduler->lock);
+            scheduler->callback(schedule->session, -INK_E_OOM, NULL,
+                                scheduler->userdata);
+            ink_mutex_lock(&scheduler->lock);
+            scheduler->pending--;
+        }
+        if (schedule) {
+            const struct ink_schedule_key key = {
+                .session = schedule->session,
+            };
+
+            ink_schedule_map_remove(&scheduler->schedules, key);
+        }
+        if (scheduler->pending == 0) {
+            ink_cond_broadcast(&scheduler->idle);
+        }
+
+        ink_mutex_unlock(&scheduler->lock);
+
+        if (schedule) {
+            ink_job_vec_deinit(&schedule->jobs);
+            ink_free(schedule);
+        }
+    }
+}
+
+static void ink_scheduler_worker_main(void *context)
+{
+    ink_scheduler_run(context, true);
+}
+
+struct ink_scheduler *ink_scheduler_open(size_t thread_count,
+                                         ink_job_callback callback,
+                                         void *userdata)
+{
+    struct ink_scheduler *const scheduler = ink_malloc(sizeof(*scheduler));
+
+    if (!scheduler) {
+        return NULL;
+    }
+    if (thread_count == 0) {
+        thread_count = ink_thread_count();
+    }
+    if (thread_count > INK_SCHEDULER_THREADS_MAX) {
+        thread_count = INK_SCHEDULER_THREADS_MAX;
+    }
+
+    scheduler->is_stopping = false;
+    scheduler->pending = 0;
+    scheduler->runnable = 0;
+    scheduler->next_worker = 0;
+    scheduler->worker_count = thread_count;
+    scheduler->thread_count = 0;
+    scheduler->callback = callback;
+    scheduler->userdata = userdata;
+    ink_schedule_map_init(&scheduler->schedules, INK_SCHEDULER_LOAD_MAX);
+
+    if (ink_mutex_init(&scheduler->lock) < 0) {
+        goto err_lock;
+    }
+    if (ink_cond_init(&scheduler->work) < 0) {
+        goto err_work;
+    }
+    if (ink_cond_init(&scheduler->idle) < 0) {
+        goto err_idle;
+    }
+    for (size_t i = 0; i < scheduler->worker_count; i++) {
+        struct ink_scheduler_worker *const worker = &scheduler->workers[i];
+
+        if (ink_mutex_init(&worker->lock) < 0) {
+            while (i-- > 0) {
+                ink_mutex_deinit(&scheduler->workers[i].lock);
+            }
+            goto err_workers;
+        }
+
+        worker->scheduler = scheduler;
+        ink_schedule_vec_init(&worker->queue);
+    }
+    while (scheduler->thread_count < scheduler->worker_count) {
+        struct ink_scheduler_worker *const worker =
+            &scheduler->workers[scheduler->thread_count];
+
+        if (ink_thread_start(&worker->thread, ink_scheduler_worker_main,
+                             worker) < 0) {
+            break;
+        }
+
+        scheduler->thread_count++;
+    }
+    return scheduler;
+err_workers:
+    ink_cond_deinit(&scheduler->idle);
+err_idle:
+    ink_cond_deinit(&scheduler->work);
+err_work:
+    ink_mutex_deinit(&scheduler->lock);
+err_lock:
+    ink_free(scheduler);
+    return NULL;
+}
+
+int ink_scheduler_submit(struct ink_scheduler *scheduler,
+                         struct ink_story *session, size_t choice_index)
+{
+    int rc = INK_E_OK;
+    struct ink_schedule *schedule = NULL;
+    const struct ink_schedule_key key = {
+        .session = session,
+    };
+
+    ink_mutex_lock(&scheduler->lock);
+
+    if (ink_schedule_map_lookup(&scheduler->schedules, key, &schedule) ==
+        INK_E_OK) {
+        if (ink_job_vec_push(&schedule->jobs, choice_index) < 0) {
+            rc = -INK_E_OOM;
+        }
+        goto out;
+    }
+
+    schedule = ink_malloc(sizeof(*schedule));
+    if (!schedule) {
+        rc = -INK_E_OOM;
+        goto out;
+    }
+
+    schedule->session = session;
+    schedule->job_next = 0;
+    ink_job_vec_init(&schedule->jobs);
+
+    if (ink_job_vec_push(&schedule->jobs, choice_index) < 0 ||
+        ink_schedule_map_insert(&scheduler->schedules, key, schedule) < 0) {
+        rc = -INK_E_OOM;
+        goto err;
+    }
+
+    /* Without worker threads, jobs are queued on the first worker until
+     * `ink_scheduler_wait` runs them. */
+    rc = ink_scheduler_enqueue(
+        scheduler,
+        &scheduler->workers[scheduler->next_worker++ % scheduler->worker_count],
+        schedule, false);
+    if (rc < 0) {
+        ink_schedule_map_remove(&scheduler->schedules, key);
+        goto err;
+    }
+out:
+    if (rc == INK_E_OK) {
+        scheduler->pending++;
+    }
+
+    ink_mutex_unlock(&scheduler->lock);
+    return rc;
+err:
+    ink_mutex_unlock(&scheduler->lock);
+    ink_job_vec_deinit(&schedule->jobs);
+    ink_free(schedule);
+    return rc;
+}
+
+void ink_scheduler_wait(struct ink_scheduler *scheduler)
+{
+    if (scheduler->thread_count == 0) {
+        ink_scheduler_run(&scheduler->workers[0], false);
+        return;
+    }
+
+    ink_mutex_lock(&scheduler->lock);
+    while (scheduler->pending > 0) {
+        ink_cond_wait(&scheduler->idle, &scheduler->lock);
+    }
+    ink_mutex_unlock(&scheduler->lock);
+}
+
+void ink_scheduler_close(struct ink_scheduler *scheduler)
+{
+    ink_scheduler_wait(scheduler);
+
+    ink_mutex_lock(&scheduler->lock);
+    scheduler->is_stopping = true;
+    ink_cond_broadcast(&scheduler->work);
+    ink_mutex_unlock(&scheduler->lock);
+
+    for (size_t i = 0; i < scheduler->thread_count; i++) {
+        ink_thread_join(&scheduler->workers[i].thread);
+    }
+    for (size_t i = 0; i < scheduler->worker_count; i++) {
+        ink_schedule_vec_deinit(&scheduler->workers[i].queue);
+        ink_mutex_deinit(&scheduler->workers[i].lock);
+    }
+
+    ink_schedule_map_deinit(&scheduler->schedules);
+    ink_cond_deinit(&scheduler->idle);
+    ink_cond_deinit(&scheduler->work);
+    ink_mutex_deinit(&scheduler->lock);
+    ink_free(scheduler);
+}
@@ -0,0 +1,103 @@
+#ifndef INK_SCHEDULER_H
+#define INK_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ink/ink.h>
+
+#include "common.h"
+#include "hashmap.h"
+#include "thread.h"
+#include "vec.h"
+
+#define INK_SCHEDULER_THREADS_MAX (64u)
+#define INK_SCHEDULER_LOAD_MAX (80ul)
+/* Instructions a job may run before yielding its worker to other sessions. */
+#define INK_SCHEDULER_SLICE (100000ul)
+
+INK_VEC_T(ink_job_vec, size_t)
+
+/**
+ * Jobs submitted for a session, in submission order.
+ *
+ * A session has at most one record, which is either queued on a worker or
+ * being run by one. This pins the session to a single thread at a time.
+ */
+struct ink_schedule {
+    struct ink_story *session;
+    size_t job_next;
+    struct ink_job_vec jobs;
+};
+
+struct ink_schedule_key {
+    struct ink_story *session;
+};
+
+/**
+ * Hash function for schedules.
+ */
+static inline uint32_t ink_schedule_key_hash(const void *key, size_t length)
+{
+    const struct ink_schedule_key *const k = key;
+
+    return ink_hash_ptr(k->session);
+}
+
+/**
+ * Key comparison function for schedules.
+ */
+static inline bool ink_schedule_key_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_schedule_key *const key_lhs = lhs;
+    const struct ink_schedule_key *const key_rhs = rhs;
+
+    return (key_lhs->session == key_rhs->session);
+}
+
+INK_VEC_T(ink_schedule_vec, struct ink_schedule *)
+INK_HASHMAP_T_EX(ink_schedule_map, struct ink_schedule_key,
+                 struct ink_schedule *, ink_schedule_key_hash,
+                 ink_schedule_key_cmp)
+
+/**
+ * Worker of a scheduler.
+ *
+ * Each worker runs schedules from its own queue, most recent first, and
+ * steals the oldest schedules from other workers once its queue is empty.
+ * Schedules whose job yielded are queued as the oldest.
+ */
+struct ink_scheduler_worker {
+    struct ink_scheduler *scheduler;
+    struct ink_mutex lock;
+    struct ink_schedule_vec queue;
+    struct ink_thread thread;
+};
+
+struct ink_scheduler {
+    bool is_stopping;
+    /* Jobs that have been submitted but not yet completed. */
+    size_t pending;
+    /* Schedules queued on workers and not yet claimed. */
+    size_t runnable;
+    size_t next_worker;
+    size_t worker_count;
+    size_t thread_count;
+    ink_job_callback callback;
+    void *userdata;
+    struct ink_mutex lock;
+    struct ink_cond work;
+    struct ink_cond idle;
+    struct ink_schedule_map schedules;
+    struct ink_scheduler_worker workers[INK_SCHEDULER_THREADS_MAX];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
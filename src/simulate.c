@@ -0,0 +1,694 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ink/ink.h>
+
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "simulate.h"
+#include "story.h"
+#include "thread.h"
+
+#define INK_SIMULATE_VALUE_BUFLEN (64u)
+
+/**
+ * Scramble a 64-bit value. This is the finalizer of SplitMix64.
+ */
+static uint64_t ink_simulate_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Advance a SplitMix64 generator.
+ */
+static uint64_t ink_simulate_next(uint64_t *state)
+{
+    *state += 0x9e3779b97f4a7c15ull;
+    return ink_simulate_mix(*state);
+}
+
+/**
+ * Return a uniformly distributed number in [0, 1).
+ */
+static double ink_simulate_uniform(uint64_t *state)
+{
+    return (double)(ink_simulate_next(state) >> 11) / 9007199254740992.0;
+}
+
+/**
+ * Pick the zero-based index of a choice according to the policy.
+ */
+static size_t ink_simulate_pick(const struct ink_simulator *simulator,
+                                uint64_t *rng, const struct ink_choice *choices,
+                                size_t choice_count)
+{
+    const struct ink_simulate_opts *const opts = &simulator->opts;
+    double total = 0.0;
+    double target = 0.0;
+
+    if (opts->policy == INK_SIMULATE_RANDOM) {
+        return (size_t)(ink_simulate_next(rng) % choice_count);
+    }
+    for (size_t i = 0; i < choice_count; i++) {
+        const double weight = opts->weight ? opts->weight(&choices[i], i,
+                                                          opts->userdata)
+                                           : 1.0 / (double)(i + 1);
+
+        if (weight > 0.0) {
+            total += weight;
+        }
+    }
+    if (!(total > 0.0)) {
+        return (size_t)(ink_simulate_next(rng) % choice_count);
+    }
+
+    target = ink_simulate_uniform(rng) * total;
+
+    for (size_t i = 0; i < choice_count; i++) {
+        const double weight = opts->weight ? opts->weight(&choices[i], i,
+                                                          opts->userdata)
+                                           : 1.0 / (double)(i + 1);
+
+        if (weight > 0.0) {
+            if (target < weight) {
+                return i;
+            }
+
+            target -= weight;
+        }
+    }
+    return choice_count - 1;
+}
+
+/**
+ * Format the value of a global as text.
+ */
+static size_t ink_simulate_format(const struct ink_object *obj, char *buf,
+                                  size_t size)
+{
+    int length = 0;
+
+    if (!obj) {
+        length = snprintf(buf, size, "null");
+    } else if (INK_OBJ_IS_BOOL(obj)) {
+        length =
+            snprintf(buf, size, INK_OBJ_AS_BOOL(obj)->value ? "true" : "false");
+    } else if (INK_OBJ_IS_NUMBER(obj)) {
+        const struct ink_number *const number = INK_OBJ_AS_NUMBER(obj);
+
+        if (number->is_int) {
+            length = snprintf(buf, size, "%ld", number->as.integer);
+        } else {
+            length = snprintf(buf, size, "%lf", number->as.floating);
+        }
+    } else if (INK_OBJ_IS_STRING(obj)) {
+        const struct ink_string *const string = INK_OBJ_AS_STRING(obj);
+
+        length = snprintf(buf, size, "\"%.*s\"", (int)string->length,
+                          (const char *)string->bytes);
+    } else {
+        length = snprintf(buf, size, "<object>");
+    }
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t)length < size ? (size_t)length : size - 1;
+}
+
+/**
+ * Count playthroughs that ended with a global set to a value.
+ */
+static int ink_simulate_count_value(struct ink_simulate_value_map *values,
+                                    const struct ink_string *name,
+                                    const uint8_t *bytes, size_t length,
+                                    size_t count)
+{
+    int rc;
+    struct ink_simulate_value *value = NULL;
+    struct ink_simulate_value_key key = {
+        .name = name,
+        .bytes = bytes,
+        .length = length,
+        .hash = ink_hash_bytes(bytes, length) ^ name->hash,
+    };
+
+    if (ink_simulate_value_map_lookup(values, key, &value) == INK_E_OK) {
+        value->count += count;
+        return INK_E_OK;
+    }
+
+    value = ink_malloc(sizeof(*value) + length);
+    if (!value) {
+        return -INK_E_OOM;
+    }
+
+    value->count = count;
+    memcpy(value->bytes, bytes, length);
+    value->bytes[length] = '\0';
+    key.bytes = value->bytes;
+
+    rc = ink_simulate_value_map_insert(values, key, value);
+    if (rc < 0) {
+        ink_free(value);
+    }
+    return rc;
+}
+
+/**
+ * Count a playthrough that took `turn_count` choices.
+ */
+static int ink_simulate_count_turns(struct ink_offset_vec *turns,
+                                    size_t turn_count, size_t count)
+{
+    while (turns->count <= turn_count) {
+        const int rc = ink_offset_vec_push(turns, 0);
+
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    turns->entries[turn_count] += count;
+    return INK_E_OK;
+}
+
+/**
+ * Record the paths entered and the final globals of a playthrough.
+ */
+static int ink_simulate_record(const struct ink_simulator *simulator,
+                               struct ink_simulate_task *task,
+                               struct ink_story *session)
+{
+    size_t iter = 0;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    struct ink_object_set *const coverage = &task->coverage;
+
+    for (size_t i = 0; i < coverage->capacity; i++) {
+        struct ink_object_set_kv *const entry = &coverage->entries[i];
+        size_t index = 0;
+
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED &&
+            ink_simulate_path_map_lookup(
+                (struct ink_simulate_path_map *)&simulator->path_indices,
+                entry->key, &index) == INK_E_OK) {
+            task->path_counts[index]++;
+        }
+    }
+
+    ink_object_set_clear(coverage);
+
+    while (ink_table_next(session->globals, &iter, &key, &value) == INK_E_OK) {
+        char buf[INK_SIMULATE_VALUE_BUFLEN];
+        const size_t length = ink_simulate_format(value, buf, sizeof(buf));
+        const int rc = ink_simulate_count_value(
+            &task->values, INK_OBJ_AS_STRING(key), (const uint8_t *)buf,
+            length, 1);
+
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Run a single playthrough.
+ */
+static int ink_simulate_play(const struct ink_simulator *simulator,
+                             struct ink_simulate_task *task, size_t index)
+{
+    int rc;
+    size_t turn_count = 0;
+    uint64_t rng = ink_simulate_mix(simulator->opts.seed ^
+                                    ink_simulate_mix((uint64_t)index + 1));
+    const struct ink_simulate_opts *const opts = &simulator->opts;
+    struct ink_story *const session =
+        ink_session_open(simulator->program, INK_F_GC_ENABLE);
+    struct ink_turn turn;
+
+    if (!session) {
+        return -INK_E_OOM;
+    }
+    if (session->current_path) {
+        const struct ink_object_set_key key = {
+            .obj = session->current_path,
+        };
+
+        rc = ink_object_set_insert(&task->coverage, key, NULL);
+        if (rc < 0) {
+            goto out;
+        }
+    }
+
+    session->coverage = &task->coverage;
+
+    for (;;) {
+        if (opts->max_instructions > 0) {
+            rc = ink_story_continue_budget(session, opts->max_instructions,
+                                           &turn);
+        } else {
+            rc = ink_story_continue_all(session, &turn);
+        }
+        if (rc == -INK_E_YIELD) {
+            task->truncated++;
+            break;
+        }
+        if (rc < 0) {
+            task->dead_ends++;
+            break;
+        }
+        if (turn.choice_count == 0) {
+            if (session->is_exited) {
+                task->endings++;
+            } else {
+                task->dead_ends++;
+            }
+            break;
+        }
+        if (opts->max_turns > 0 && turn_count == opts->max_turns) {
+            task->truncated++;
+            break;
+        }
+
+        rc = ink_story_choose(
+            session,
+            ink_simulate_pick(simulator, &rng, turn.choices,
+                              turn.choice_count) +
+                1);
+        if (rc < 0) {
+            task->dead_ends++;
+            break;
+        }
+
+        turn_count++;
+    }
+
+    task->instructions += ink_story_instruction_count(session);
+
+    rc = ink_simulate_count_turns(&task->turns, turn_count, 1);
+    if (rc == INK_E_OK) {
+        rc = ink_simulate_record(simulator, task, session);
+    }
+out:
+    ink_close(session);
+    return rc;
+}
+
+static void ink_simulate_task_run(void *context, size_t index)
+{
+    struct ink_simulator *const simulator = context;
+    struct ink_simulate_task *const task = &simulator->tasks[index];
+
+    for (size_t i = 0; i < task->count; i++) {
+        task->rc = ink_simulate_play(simulator, task, task->first + i);
+        if (task->rc < 0) {
+            return;
+        }
+    }
+}
+
+/**
+ * Merge the statistics of a task into another.
+ */
+static int ink_simulate_merge(const struct ink_simulator *simulator,
+                              struct ink_simulate_task *dst,
+                              struct ink_simulate_task *src)
+{
+    int rc = INK_E_OK;
+
+    dst->endings += src->endings;
+    dst->dead_ends += src->dead_ends;
+    dst->truncated += src->truncated;
+    dst->instructions += src->instructions;
+
+    for (size_t i = 0; i < simulator->path_count; i++) {
+        dst->path_counts[i] += src->path_counts[i];
+    }
+    for (size_t i = 0; i < src->turns.count; i++) {
+        rc = ink_simulate_count_turns(&dst->turns, i, src->turns.entries[i]);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (size_t i = 0; i < src->values.capacity; i++) {
+        const struct ink_simulate_value_map_kv *const entry =
+            &src->values.entries[i];
+
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED) {
+            rc = ink_simulate_count_value(&dst->values, entry->key.name,
+                                          entry->key.bytes, entry->key.length,
+                                          entry->value->count);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_simulate_path_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_simulate_path *const path_lhs = lhs;
+    const struct ink_simulate_path *const path_rhs = rhs;
+
+    if (path_lhs->playthroughs != path_rhs->playthroughs) {
+        return path_lhs->playthroughs > path_rhs->playthroughs ? -1 : 1;
+    }
+    return strcmp(path_lhs->name, path_rhs->name);
+}
+
+static int ink_simulate_bin_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_simulate_bin *const bin_lhs = lhs;
+    const struct ink_simulate_bin *const bin_rhs = rhs;
+
+    if (bin_lhs->count != bin_rhs->count) {
+        return bin_lhs->count > bin_rhs->count ? -1 : 1;
+    }
+    return strcmp(bin_lhs->value, bin_rhs->value);
+}
+
+static int ink_simulate_global_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_simulate_global *const global_lhs = lhs;
+    const struct ink_simulate_global *const global_rhs = rhs;
+
+    return strcmp(global_lhs->name, global_rhs->name);
+}
+
+/**
+ * Fill in the histograms of a global from the merged values.
+ */
+static int ink_simulate_finish_global(const struct ink_simulate_task *totals,
+                                      const struct ink_string *name,
+                                      struct ink_simulate_global *global)
+{
+    size_t bin_count = 0;
+
+    global->name = (const char *)name->bytes;
+    global->bins = NULL;
+    global->bin_count = 0;
+
+    for (size_t i = 0; i < totals->values.capacity; i++) {
+        const struct ink_simulate_value_map_kv *const entry =
+            &totals->values.entries[i];
+
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED &&
+            ink_simulate_name_eq(entry->key.name, name)) {
+            bin_count++;
+        }
+    }
+    if (bin_count == 0) {
+        return INK_E_OK;
+    }
+
+    global->bins = ink_malloc(sizeof(*global->bins) * bin_count);
+    if (!global->bins) {
+        return -INK_E_OOM;
+    }
+    for (size_t i = 0; i < totals->values.capacity; i++) {
+        const struct ink_simulate_value_map_kv *const entry =
+            &totals->values.entries[i];
+
+        if (entry->state == INK_HASHMAP_IS_OCCUPIED &&
+            ink_simulate_name_eq(entry->key.name, name)) {
+            struct ink_simulate_bin *const bin =
+                &global->bins[global->bin_count];
+
+            bin->count = entry->value->count;
+            bin->value = ink_malloc(entry->key.length + 1);
+            if (!bin->value) {
+                return -INK_E_OOM;
+            }
+
+            memcpy(bin->value, entry->key.bytes, entry->key.length + 1);
+            global->bin_count++;
+        }
+    }
+
+    qsort(global->bins, global->bin_count, sizeof(*global->bins),
+          ink_simulate_bin_cmp);
+    return INK_E_OK;
+}
+
+/**
+ * Fill in the report from the merged statistics.
+ */
+static int ink_simulate_finish(const struct ink_simulator *simulator,
+                               const struct ink_simulate_task *totals,
+                               struct ink_simulate_report *report)
+{
+    report->playthroughs = simulator->opts.playthrough_count;
+    report->endings = totals->endings;
+    report->dead_ends = totals->dead_ends;
+    report->truncated = totals->truncated;
+    report->instructions = totals->instructions;
+
+    if (totals->turns.count > 0) {
+        report->turns =
+            ink_malloc(sizeof(*report->turns) * totals->turns.count);
+        if (!report->turns) {
+            return -INK_E_OOM;
+        }
+
+        memcpy(report->turns, totals->turns.entries,
+               sizeof(*report->turns) * totals->turns.count);
+        report->turns_max = totals->turns.count - 1;
+    }
+    if (simulator->path_count > 0) {
+        report->paths =
+            ink_malloc(sizeof(*report->paths) * simulator->path_count);
+        if (!report->paths) {
+            return -INK_E_OOM;
+        }
+        for (size_t i = 0; i < simulator->path_count; i++) {
+            struct ink_simulate_path *const path = &report->paths[i];
+
+            path->name =
+                (const char *)INK_OBJ_AS_STRING(simulator->path_names[i])
+                    ->bytes;
+            path->playthroughs = totals->path_counts[i];
+        }
+
+        report->path_count = simulator->path_count;
+        qsort(report->paths, report->path_count, sizeof(*report->paths),
+              ink_simulate_path_cmp);
+    }
+
+    if (totals->values.count == 0) {
+        return INK_E_OK;
+    }
+
+    /* Globals are defined as stories run, so they are found from the values
+     * they were left with. */
+    report->globals =
+        ink_malloc(sizeof(*report->globals) * totals->values.count);
+    if (!report->globals) {
+        return -INK_E_OOM;
+    }
+    for (size_t i = 0; i < totals->values.capacity; i++) {
+        const struct ink_simulate_value_map_kv *const entry =
+            &totals->values.entries[i];
+        size_t j = 0;
+
+        if (entry->state != INK_HASHMAP_IS_OCCUPIED) {
+            continue;
+        }
+        while (j < report->global_count &&
+               strcmp(report->globals[j].name,
+                      (const char *)entry->key.name->bytes) != 0) {
+            j++;
+        }
+        if (j == report->global_count) {
+            const int rc = ink_simulate_finish_global(
+                totals, entry->key.name, &report->globals[j]);
+
+            report->global_count++;
+            if (rc < 0) {
+                return rc;
+            }
+        }
+    }
+
+    qsort(report->globals, report->global_count, sizeof(*report->globals),
+          ink_simulate_global_cmp);
+    return INK_E_OK;
+}
+
+/**
+ * Index the content paths of the program.
+ */
+static int ink_simulate_index_paths(struct ink_simulator *simulator)
+{
+    size_t iter = 0;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    const struct ink_object *const paths = simulator->program->story->paths;
+    const size_t path_count = INK_OBJ_AS_TABLE(paths)->count;
+
+    if (path_count == 0) {
+        return INK_E_OK;
+    }
+
+    simulator->path_names =
+        ink_malloc(sizeof(*simulator->path_names) * path_count);
+    if (!simulator->path_names) {
+        return -INK_E_OOM;
+    }
+    while (ink_table_next(paths, &iter, &key, &value) == INK_E_OK) {
+        const struct ink_object_set_key path_key = {
+            .obj = value,
+        };
+        const int rc = ink_simulate_path_map_insert(
+            &simulator->path_indices, path_key, simulator->path_count);
+
+        if (rc < 0) {
+            return rc;
+        }
+
+        simulator->path_names[simulator->path_count] = key;
+        simulator->path_count++;
+    }
+    return INK_E_OK;
+}
+
+int ink_program_simulate(struct ink_program *program,
+                         const struct ink_simulate_opts *opts,
+                         struct ink_simulate_report *report)
+{
+    int rc;
+    size_t thread_count = opts->thread_count;
+    size_t next = 0;
+    struct ink_simulator simulator;
+
+    memset(report, 0, sizeof(*report));
+
+    if (thread_count == 0) {
+        thread_count = ink_thread_count();
+    }
+
+    simulator.program = program;
+    simulator.opts = *opts;
+    simulator.path_count = 0;
+    simulator.path_names = NULL;
+    simulator.task_count = thread_count * INK_SIMULATE_TASKS_PER_THREAD;
+    simulator.tasks = NULL;
+    ink_simulate_path_map_init(&simulator.path_indices, INK_SIMULATE_LOAD_MAX);
+
+    if (simulator.task_count > opts->playthrough_count) {
+        simulator.task_count = opts->playthrough_count;
+    }
+    if (simulator.task_count == 0) {
+        simulator.task_count = 1;
+    }
+
+    rc = ink_simulate_index_paths(&simulator);
+    if (rc < 0) {
+        goto out;
+    }
+
+    simulator.tasks =
+        ink_malloc(sizeof(*simulator.tasks) * simulator.task_count);
+    if (!simulator.tasks) {
+        rc = -INK_E_OOM;
+        goto out;
+    }
+    for (size_t i = 0; i < simulator.task_count; i++) {
+        struct ink_simulate_task *const task = &simulator.tasks[i];
+        const size_t remainder = opts->playthrough_count % simulator.task_count;
+        const size_t count = opts->playthrough_count / simulator.task_count +
+                             (i < remainder ? 1 : 0);
+
+        task->rc = INK_E_OK;
+        task->first = next;
+        task->count = count;
+        task->endings = 0;
+        task->dead_ends = 0;
+        task->truncated = 0;
+        task->instructions = 0;
+        task->path_counts = ink_malloc(sizeof(*task->path_counts) *
+                                       (simulator.path_count + 1));
+        ink_offset_vec_init(&task->turns);
+        ink_simulate_value_map_init(&task->values, INK_SIMULATE_LOAD_MAX);
+        ink_object_set_init(&task->coverage, INK_OBJECT_SET_LOAD_MAX);
+        next += count;
+
+        if (!task->path_counts) {
+            rc = -INK_E_OOM;
+        } else {
+            memset(task->path_counts, 0,
+                   sizeof(*task->path_counts) * (simulator.path_count + 1));
+        }
+    }
+    if (rc < 0) {
+        goto out;
+    }
+
+    ink_parallel_for(simulator.task_count, thread_count, ink_simulate_task_run,
+                     &simulator);
+
+    rc = simulator.tasks[0].rc;
+    for (size_t i = 1; i < simulator.task_count; i++) {
+        const int merge_rc = ink_simulate_merge(
+            &simulator, &simulator.tasks[0], &simulator.tasks[i]);
+
+        if (rc == INK_E_OK) {
+            rc = simulator.tasks[i].rc < 0 ? simulator.tasks[i].rc : merge_rc;
+        }
+    }
+    if (rc == INK_E_OK) {
+        rc = ink_simulate_finish(&simulator, &simulator.tasks[0], report);
+    }
+out:
+    if (simulator.tasks) {
+        for (size_t i = 0; i < simulator.task_count; i++) {
+            struct ink_simulate_task *const task = &simulator.tasks[i];
+
+            for (size_t j = 0; j < task->values.capacity; j++) {
+                if (task->values.entries[j].state == INK_HASHMAP_IS_OCCUPIED) {
+                    ink_free(task->values.entries[j].value);
+                }
+            }
+
+            ink_free(task->path_counts);
+            ink_offset_vec_deinit(&task->turns);
+            ink_simulate_value_map_deinit(&task->values);
+            ink_object_set_deinit(&task->coverage);
+        }
+    }
+
+    ink_free(simulator.tasks);
+    ink_free(simulator.path_names);
+    ink_simulate_path_map_deinit(&simulator.path_indices);
+
+    if (rc < 0) {
+        ink_simulate_report_deinit(report);
+    }
+    return rc;
+}
+
+void ink_simulate_report_deinit(struct ink_simulate_report *report)
+{
+    for (size_t i = 0; i < report->global_count; i++) {
+        struct ink_simulate_global *const global = &report->globals[i];
+
+        for (size_t j = 0; j < global->bin_count; j++) {
+            ink_free(global->bins[j].value);
+        }
+
+        ink_free(global->bins);
+    }
+
+    ink_free(report->globals);
+    ink_free(report->paths);
+    ink_free(report->turns);
+    memset(report, 0, sizeof(*report));
+}
@@ -0,0 +1,125 @@
+#ifndef INK_SIMULATE_H
+#define INK_SIMULATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ink/ink.h>
+
+#include "common.h"
+#include "hashmap.h"
+#include "object.h"
+#include "story.h"
+#include "vec.h"
+
+#define INK_SIMULATE_LOAD_MAX (80ul)
+/* Tasks created per thread, so that threads finishing early can take over
+ * the remaining playthroughs. */
+#define INK_SIMULATE_TASKS_PER_THREAD (4u)
+
+/**
+ * Value of a global at the end of a playthrough.
+ *
+ * Globals are told apart by the text of their name, as a global may be
+ * stored through a different name object from each content path.
+ */
+struct ink_simulate_value_key {
+    const struct ink_string *name;
+    const uint8_t *bytes;
+    size_t length;
+    uint32_t hash;
+};
+
+/**
+ * Number of playthroughs that ended with a global set to a value.
+ *
+ * The key of the entry points into `bytes`, which is NUL-terminated.
+ */
+struct ink_simulate_value {
+    size_t count;
+    uint8_t bytes[1];
+};
+
+/**
+ * Determine if two global names have the same text.
+ */
+static inline bool ink_simulate_name_eq(const struct ink_string *lhs,
+                                        const struct ink_string *rhs)
+{
+    return lhs->length == rhs->length &&
+           memcmp(lhs->bytes, rhs->bytes, lhs->length) == 0;
+}
+
+/**
+ * Hash function for global values.
+ */
+static inline uint32_t ink_simulate_value_key_hash(const void *key,
+                                                   size_t length)
+{
+    const struct ink_simulate_value_key *const k = key;
+
+    return k->hash;
+}
+
+/**
+ * Key comparison function for global values.
+ */
+static inline bool ink_simulate_value_key_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_simulate_value_key *const key_lhs = lhs;
+    const struct ink_simulate_value_key *const key_rhs = rhs;
+
+    return ink_simulate_name_eq(key_lhs->name, key_rhs->name) &&
+           key_lhs->length == key_rhs->length &&
+           memcmp(key_lhs->bytes, key_rhs->bytes, key_lhs->length) == 0;
+}
+
+INK_HASHMAP_T_EX(ink_simulate_value_map, struct ink_simulate_value_key,
+                 struct ink_simulate_value *, ink_simulate_value_key_hash,
+                 ink_simulate_value_key_cmp)
+INK_HASHMAP_T_EX(ink_simulate_path_map, struct ink_object_set_key, size_t,
+                 ink_object_set_key_hash, ink_object_set_key_cmp)
+
+/**
+ * Range of playthroughs, and the statistics gathered from them.
+ */
+struct ink_simulate_task {
+    int rc;
+    size_t first;
+    size_t count;
+    size_t endings;
+    size_t dead_ends;
+    size_t truncated;
+    uint64_t instructions;
+    /* Playthroughs that entered each path, indexed like `paths`. */
+    size_t *path_counts;
+    /* Playthroughs by the number of choices taken. */
+    struct ink_offset_vec turns;
+    /* Owns its values. */
+    struct ink_simulate_value_map values;
+    /* Content paths entered by the current playthrough. */
+    struct ink_object_set coverage;
+};
+
+struct ink_simulator {
+    struct ink_program *program;
+    struct ink_simulate_opts opts;
+    size_t path_count;
+    /* Names of the content paths, indexed like `path_indices`. */
+    struct ink_object **path_names;
+    struct ink_simulate_path_map path_indices;
+    size_t task_count;
+    struct ink_simulate_task *tasks;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,9 +1,20 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "common.h"
 #include "memory.h"
 #include "source.h"
@@ -59,6 +70,7 @@ int ink_source_load_stdin(struct ink_source *s)
 
     s->bytes = NULL;
     s->length = 0;
+    s->is_mapped = false;
 
     while (fgets(b, INK_SOURCE_BUF_MAX, stdin)) {
         const size_t len = s->length;
@@ -92,6 +104,7 @@ int ink_source_load(const char *file_path, struct ink_source *s)
 
     s->bytes = NULL;
     s->length = 0;
+    s->is_mapped = false;
 
     if (namelen < INK_FILE_EXT_LENGTH) {
         return -INK_E_FILE;
@@ -104,9 +117,154 @@ int ink_source_load(const char *file_path, struct ink_source *s)
     return ink_read_file(file_path, &s->bytes, &s->length);
 }
 
+/**
+ * Load the contents of a file from the file system, regardless of its
+ * extension.
+ */
+int ink_source_load_raw(const char *file_path, struct ink_source *s)
+{
+    s->bytes = NULL;
+    s->length = 0;
+    s->is_mapped = false;
+    return ink_read_file(file_path, &s->bytes, &s->length);
+}
+
+/**
+ * Map a file from the file system into memory, read-only.
+ *
+ * Falls back to reading the whole file where mapping is unavailable.
+ */
+int ink_source_map(const char *file_path, struct ink_source *s)
+{
+#if !defined(_WIN32)
+    struct stat st;
+    void *bytes = NULL;
+    const int fd = open(file_path, O_RDONLY);
+
+    s->bytes = NULL;
+    s->length = 0;
+    s->is_mapped = false;
+
+    if (fd < 0) {
+        return -INK_E_OS;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -INK_E_OS;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return ink_source_load_raw(file_path, s);
+    }
+
+    bytes = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (bytes == MAP_FAILED) {
+        return ink_source_load_raw(file_path, s);
+    }
+
+    s->bytes = bytes;
+    s->length = (size_t)st.st_size;
+    s->is_mapped = true;
+    return INK_E_OK;
+#else
+    return ink_source_load_raw(file_path, s);
+#endif
+}
+
 void ink_source_free(struct ink_source *s)
 {
+#if !defined(_WIN32)
+    if (s->is_mapped) {
+        munmap(s->bytes, s->length);
+    } else {
+        ink_free(s->bytes);
+    }
+#else
     ink_free(s->bytes);
+#endif
     s->bytes = NULL;
     s->length = 0;
+    s->is_mapped = false;
+}
+
+/**
+ * Replace the contents of a file on the file system.
+ *
+ * The bytes are written to a temporary file in the same directory, which is
+ * then renamed over the target. Readers that have the previous contents
+ * mapped keep seeing them, and a failed write leaves the target untouched.
+ */
+int ink_source_write(const char *file_path, const uint8_t *bytes,
+                     size_t length)
+{
+    int rc = INK_E_OK;
+    const size_t namelen = strlen(file_path);
+    char *const tmp_path = ink_malloc(namelen + sizeof(".XXXXXX"));
+
+    if (!tmp_path) {
+        return -INK_E_OOM;
+    }
+
+    memcpy(tmp_path, file_path, namelen);
+    memcpy(tmp_path + namelen, ".XXXXXX", sizeof(".XXXXXX"));
+#if !defined(_WIN32)
+    {
+        size_t written = 0;
+        const int fd = mkstemp(tmp_path);
+
+        if (fd < 0) {
+            ink_free(tmp_path);
+            return -INK_E_OS;
+        }
+        if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) < 0) {
+            rc = -INK_E_OS;
+        }
+        while (rc == INK_E_OK && written < length) {
+            const ssize_t n = write(fd, bytes + written, length - written);
+
+            if (n < 0) {
+                rc = -INK_E_OS;
+                break;
+            }
+
+            written += (size_t)n;
+        }
+        if (rc == INK_E_OK && fsync(fd) < 0) {
+            rc = -INK_E_OS;
+        }
+        if (close(fd) < 0) {
+            rc = -INK_E_OS;
+        }
+    }
+#else
+    {
+        FILE *const fp = fopen(tmp_path, "wb");
+
+        if (!fp) {
+            ink_free(tmp_path);
+            return -INK_E_OS;
+        }
+        if (fwrite(bytes, 1u, length, fp) < length || fflush(fp) != 0) {
+            rc = -INK_E_OS;
+        }
+        if (fclose(fp) != 0) {
+            rc = -INK_E_OS;
+        }
+        /* rename() does not replace an existing file on Windows. */
+        if (rc == INK_E_OK) {
+            remove(file_path);
+        }
+    }
+#endif
+    if (rc == INK_E_OK && rename(tmp_path, file_path) != 0) {
+        rc = -INK_E_OS;
+    }
+    if (rc < 0) {
+        remove(tmp_path);
+    }
+
+    ink_free(tmp_path);
+    return rc;
 }
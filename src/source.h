@@ -5,6 +5,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -13,11 +14,17 @@ extern "C" {
 struct ink_source {
     uint8_t *bytes;
     size_t length;
+    bool is_mapped;
 };
 
 INK_API int ink_source_load(const char *filename, struct ink_source *source);
+INK_API int ink_source_load_raw(const char *filename,
+                                 struct ink_source *source);
+INK_API int ink_source_map(const char *filename, struct ink_source *source);
 INK_API int ink_source_load_stdin(struct ink_source *source);
 INK_API void ink_source_free(struct ink_source *source);
+INK_API int ink_source_write(const char *filename, const uint8_t *bytes,
+                             size_t length);
 
 #ifdef __cplusplus
 }
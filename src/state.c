@@ -0,0 +1,1227 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "opcode.h"
+#include "state.h"
+#include "story.h"
+#include "stream.h"
+
+#define INK_STATE_CAPACITY_MIN (256u)
+#define INK_STATE_PATHS_MAX (2u * INK_STORY_STACK_MAX + 1u)
+
+enum ink_state_value_type {
+    INK_STATE_VALUE_NULL,
+    INK_STATE_VALUE_FALSE,
+    INK_STATE_VALUE_TRUE,
+    INK_STATE_VALUE_INTEGER,
+    INK_STATE_VALUE_FLOAT,
+    INK_STATE_VALUE_STRING,
+};
+
+enum ink_state_flags {
+    INK_STATE_F_EXITED = (1 << 0),
+    INK_STATE_F_CAN_CONTINUE = (1 << 1),
+    INK_STATE_F_OUTPUT_BREAK = (1 << 2),
+};
+
+/**
+ * Content paths referred to by a state, indexed by path ID.
+ *
+ * Only the current path and the paths of the call stack are referenced, so
+ * the table is small enough to be searched linearly.
+ */
+struct ink_state_paths {
+    size_t count;
+    struct ink_content_path *entries[INK_STATE_PATHS_MAX];
+};
+
+struct ink_state_reader {
+    const uint8_t *bytes;
+    size_t length;
+    size_t offset;
+};
+
+static int ink_state_write_bytes(struct ink_byte_vec *bytes, const void *data,
+                                 size_t length)
+{
+    if (bytes->count + length > bytes->capacity) {
+        size_t capacity = bytes->capacity;
+        uint8_t *entries = NULL;
+
+        if (capacity < INK_STATE_CAPACITY_MIN) {
+            capacity = INK_STATE_CAPACITY_MIN;
+        }
+        while (capacity < bytes->count + length) {
+            capacity *= 2;
+        }
+
+        entries = ink_realloc(bytes->entries, capacity);
+        if (!entries) {
+            return -INK_E_OOM;
+        }
+
+        bytes->entries = entries;
+        bytes->capacity = capacity;
+    }
+    if (length > 0) {
+        memcpy(bytes->entries + bytes->count, data, length);
+        bytes->count += length;
+    }
+    return INK_E_OK;
+}
+
+static void ink_state_store_u16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t)(value & 0xff);
+    dst[1] = (uint8_t)((value >> 8) & 0xff);
+}
+
+static void ink_state_store_u32(uint8_t *dst, uint32_t value)
+{
+    for (size_t i = 0; i < 4; i++) {
+        dst[i] = (uint8_t)((value >> (i * 8)) & 0xff);
+    }
+}
+
+static int ink_state_write_u32(struct ink_byte_vec *bytes, uint32_t value)
+{
+    uint8_t data[4];
+
+    ink_state_store_u32(data, value);
+    return ink_state_write_bytes(bytes, data, sizeof(data));
+}
+
+static int ink_state_write_u64(struct ink_byte_vec *bytes, uint64_t value)
+{
+    uint8_t data[8];
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)((value >> (i * 8)) & 0xff);
+    }
+    return ink_state_write_bytes(bytes, data, sizeof(data));
+}
+
+static int ink_state_write_str(struct ink_byte_vec *bytes, const uint8_t *str,
+                               size_t length)
+{
+    const int rc = ink_state_write_u32(bytes, (uint32_t)length);
+
+    if (rc < 0) {
+        return rc;
+    }
+    return ink_state_write_bytes(bytes, str, length);
+}
+
+/**
+ * Write a value, tagged with its type.
+ *
+ * Only values that may be produced at runtime can be written.
+ */
+static int ink_state_write_value(struct ink_byte_vec *bytes,
+                                 const struct ink_object *obj)
+{
+    int rc;
+    uint8_t type = INK_STATE_VALUE_NULL;
+    uint64_t value = 0;
+
+    if (obj) {
+        switch (obj->type) {
+        case INK_OBJ_BOOL:
+            type = INK_OBJ_AS_BOOL(obj)->value ? INK_STATE_VALUE_TRUE
+                                               : INK_STATE_VALUE_FALSE;
+            break;
+        case INK_OBJ_NUMBER: {
+            const struct ink_number *const num = INK_OBJ_AS_NUMBER(obj);
+
+            if (num->is_int) {
+                type = INK_STATE_VALUE_INTEGER;
+                value = (uint64_t)num->as.integer;
+            } else {
+                type = INK_STATE_VALUE_FLOAT;
+                memcpy(&value, &num->as.floating, sizeof(value));
+            }
+            break;
+        }
+        case INK_OBJ_STRING:
+            type = INK_STATE_VALUE_STRING;
+            break;
+        default:
+            return -INK_E_INVALID_ARG;
+        }
+    }
+
+    rc = ink_state_write_bytes(bytes, &type, 1);
+    if (rc < 0) {
+        return rc;
+    }
+    switch (type) {
+    case INK_STATE_VALUE_INTEGER:
+    case INK_STATE_VALUE_FLOAT:
+        return ink_state_write_u64(bytes, value);
+    case INK_STATE_VALUE_STRING: {
+        const struct ink_string *const str = INK_OBJ_AS_STRING(obj);
+
+        return ink_state_write_str(bytes, str->bytes, str->length);
+    }
+    default:
+        return INK_E_OK;
+    }
+}
+
+/**
+ * Return the ID of a content path, assigning one if necessary.
+ */
+static uint32_t ink_state_path_id(struct ink_state_paths *paths,
+                                  struct ink_content_path *path)
+{
+    if (!path) {
+        return INK_STATE_NONE;
+    }
+    for (size_t i = 0; i < paths->count; i++) {
+        if (paths->entries[i] == path) {
+            return (uint32_t)i;
+        }
+    }
+
+    assert(paths->count < INK_STATE_PATHS_MAX);
+    paths->entries[paths->count] = path;
+    return (uint32_t)paths->count++;
+}
+
+/**
+ * Return the sequence number of the checkpoint following the current one.
+ */
+static uint32_t ink_state_next_sequence(const struct ink_story *story)
+{
+    const uint32_t sequence = story->state_sequence + 1;
+
+    return sequence == 0 || sequence == INK_STATE_NONE ? 1 : sequence;
+}
+
+/**
+ * Pick an ID for a new chain of checkpoints.
+ *
+ * IDs only need to tell apart the chains that a story may be given, so the
+ * time, the address of the story and its previous chain are mixed together.
+ */
+static uint32_t ink_state_new_chain(const struct ink_story *story)
+{
+    uint64_t x = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^
+                 (uint64_t)(uintptr_t)story ^
+                 ((uint64_t)story->state_chain << 16);
+    uint32_t chain;
+
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    chain = (uint32_t)(x ^ (x >> 32));
+
+    while (chain == 0 || chain == story->state_chain) {
+        chain++;
+    }
+    return chain;
+}
+
+/**
+ * Begin a new checkpoint once a state has been written or applied.
+ */
+static void ink_state_checkpoint(struct ink_story *story, uint32_t chain,
+                                 uint32_t sequence)
+{
+    story->state_chain = chain;
+    story->state_sequence = sequence;
+    ink_object_set_clear(&story->state_dirty);
+}
+
+/**
+ * Determine if a global has been stored since the last checkpoint.
+ */
+static bool ink_state_is_dirty(struct ink_story *story,
+                               struct ink_object *name)
+{
+    void *unused = NULL;
+    const struct ink_object_set_key key = {
+        .obj = name,
+    };
+
+    return ink_object_set_lookup(&story->state_dirty, key, &unused) ==
+           INK_E_OK;
+}
+
+void ink_state_set_checkpoint(uint8_t *bytes, uint32_t chain,
+                              uint32_t sequence)
+{
+    ink_state_store_u32(&bytes[INK_STATE_SEQUENCE_OFFSET], sequence);
+    ink_state_store_u32(&bytes[INK_STATE_CHAIN_OFFSET], chain);
+}
+
+int ink_state_touch(struct ink_story *story, struct ink_object *name)
+{
+    const struct ink_object_set_key key = {
+        .obj = name,
+    };
+    const int rc = ink_object_set_insert(&story->state_dirty, key, NULL);
+
+    return rc == -INK_E_OVERWRITE ? INK_E_OK : rc;
+}
+
+int ink_state_write(struct ink_story *story, struct ink_byte_vec *bytes,
+                    bool delta)
+{
+    int rc;
+    uint16_t flags = 0;
+    uint32_t globals_count = 0;
+    const uint32_t sequence = ink_state_next_sequence(story);
+    uint8_t header[INK_STATE_HEADER_SIZE];
+    struct ink_state_paths paths;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    size_t iter = 0;
+    const struct ink_stream *const stream = &story->stream;
+    const size_t stream_length =
+        stream->bytes ? stream->length - stream->cursor : 0;
+    uint32_t current_path, chain;
+
+    if (delta && story->state_sequence == 0) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    chain = delta ? story->state_chain : ink_state_new_chain(story);
+    paths.count = 0;
+    bytes->count = 0;
+    current_path = ink_state_path_id(
+        &paths, INK_OBJ_AS_CONTENT_PATH(story->current_path));
+
+    for (size_t i = 0; i < story->call_stack_top; i++) {
+        ink_state_path_id(&paths, story->call_stack[i].callee);
+        ink_state_path_id(&paths, story->call_stack[i].caller);
+    }
+    if (story->is_exited) {
+        flags |= INK_STATE_F_EXITED;
+    }
+    if (story->can_continue) {
+        flags |= INK_STATE_F_CAN_CONTINUE;
+    }
+    if (story->output_break) {
+        flags |= INK_STATE_F_OUTPUT_BREAK;
+    }
+
+    memcpy(header, INK_STATE_MAGIC, INK_STATE_MAGIC_LENGTH);
+    ink_state_store_u16(&header[4], INK_STATE_VERSION);
+    ink_state_store_u16(&header[6], flags);
+    ink_state_store_u32(&header[8], story->source_hash);
+    ink_state_store_u32(&header[12], (uint32_t)story->choice_index);
+    ink_state_store_u32(&header[16], (uint32_t)paths.count);
+    ink_state_store_u32(&header[20], current_path);
+    ink_state_store_u32(&header[24], (uint32_t)story->stack_top);
+    ink_state_store_u32(&header[28], (uint32_t)story->call_stack_top);
+    ink_state_store_u32(&header[32], 0);
+    ink_state_store_u32(&header[36], (uint32_t)story->current_choices.count);
+    ink_state_store_u32(&header[40], (uint32_t)stream_length);
+    ink_state_store_u32(&header[44], (uint32_t)story->output_spans.count);
+    ink_state_store_u32(&header[INK_STATE_SEQUENCE_OFFSET], sequence);
+    ink_state_store_u32(&header[52],
+                        delta ? story->state_sequence : INK_STATE_NONE);
+    ink_state_store_u32(&header[INK_STATE_CHAIN_OFFSET], chain);
+
+    rc = ink_state_write_bytes(bytes, header, sizeof(header));
+    if (rc < 0) {
+        return rc;
+    }
+
+    for (size_t i = 0; i < paths.count; i++) {
+        const struct ink_string *const name = paths.entries[i]->name;
+
+        rc = ink_state_write_str(bytes, name->bytes, name->length);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (size_t i = 0; i < story->stack_top; i++) {
+        rc = ink_state_write_value(bytes, story->stack[i]);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (size_t i = 0; i < story->call_stack_top; i++) {
+        const struct ink_call_frame *const frame = &story->call_stack[i];
+        uint8_t data[16];
+
+        ink_state_store_u32(&data[0], ink_state_path_id(&paths, frame->callee));
+        ink_state_store_u32(&data[4], ink_state_path_id(&paths, frame->caller));
+        ink_state_store_u32(
+            &data[8], (uint32_t)(frame->ip - frame->callee->code.entries));
+        ink_state_store_u32(&data[12], (uint32_t)(frame->sp - story->stack));
+
+        rc = ink_state_write_bytes(bytes, data, sizeof(data));
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    /* Stores replace the key of a table entry with the name they were made
+     * through, so each dirty global is matched exactly once. */
+    while (ink_table_next(story->globals, &iter, &key, &value) == INK_E_OK) {
+        const struct ink_string *const name = INK_OBJ_AS_STRING(key);
+
+        if (delta && !ink_state_is_dirty(story, key)) {
+            continue;
+        }
+
+        globals_count++;
+        rc = ink_state_write_str(bytes, name->bytes, name->length);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_state_write_value(bytes, value);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    rc = ink_state_write_value(bytes, story->current_choice_id);
+    if (rc < 0) {
+        return rc;
+    }
+    for (size_t i = 0; i < story->current_choices.count; i++) {
+        const struct ink_choice *const choice =
+            &story->current_choices.entries[i];
+
+        rc = ink_state_write_value(bytes, choice->id);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_state_write_str(bytes, choice->bytes, choice->length);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    if (stream_length > 0) {
+        rc = ink_state_write_bytes(bytes, stream->bytes + stream->cursor,
+                                   stream_length);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    for (size_t i = 0; i < story->output_spans.count; i++) {
+        rc = ink_state_write_value(bytes, story->output_spans.entries[i]);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    ink_state_store_u32(&bytes->entries[32], globals_count);
+    ink_state_checkpoint(story, chain, sequence);
+    return INK_E_OK;
+}
+
+static bool ink_state_has(const struct ink_state_reader *reader,
+                          size_t length)
+{
+    return length <= reader->length - reader->offset;
+}
+
+static int ink_state_read_bytes(struct ink_state_reader *reader,
+                                const uint8_t **bytes, size_t length)
+{
+    if (!ink_state_has(reader, length)) {
+        return -INK_E_INVALID_STATE;
+    }
+
+    *bytes = reader->bytes + reader->offset;
+    reader->offset += length;
+    return INK_E_OK;
+}
+
+static uint32_t ink_state_load_u32(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+           ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static int ink_state_read_u32(struct ink_state_reader *reader,
+                              uint32_t *value)
+{
+    const uint8_t *bytes = NULL;
+    const int rc = ink_state_read_bytes(reader, &bytes, 4);
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    *value = ink_state_load_u32(bytes);
+    return INK_E_OK;
+}
+
+static int ink_state_read_str(struct ink_state_reader *reader,
+                              const uint8_t **bytes, size_t *length)
+{
+    uint32_t n = 0;
+    const int rc = ink_state_read_u32(reader, &n);
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    *length = n;
+    return ink_state_read_bytes(reader, bytes, n);
+}
+
+/**
+ * Read a tagged value, creating a runtime object for it.
+ */
+static int ink_state_read_value(struct ink_story *story,
+                                struct ink_state_reader *reader,
+                                struct ink_object **obj)
+{
+    int rc;
+    const uint8_t *bytes = NULL;
+    size_t length = 0;
+    uint64_t value = 0;
+
+    rc = ink_state_read_bytes(reader, &bytes, 1);
+    if (rc < 0) {
+        return rc;
+    }
+    switch (bytes[0]) {
+    case INK_STATE_VALUE_NULL:
+        *obj = NULL;
+        return INK_E_OK;
+    case INK_STATE_VALUE_FALSE:
+    case INK_STATE_VALUE_TRUE:
+        *obj = ink_bool_new(story, bytes[0] == INK_STATE_VALUE_TRUE);
+        break;
+    case INK_STATE_VALUE_INTEGER:
+    case INK_STATE_VALUE_FLOAT: {
+        const uint8_t type = bytes[0];
+
+        rc = ink_state_read_bytes(reader, &bytes, 8);
+        if (rc < 0) {
+            return rc;
+        }
+        for (size_t i = 0; i < 8; i++) {
+            value |= (uint64_t)bytes[i] << (i * 8);
+        }
+        if (type == INK_STATE_VALUE_INTEGER) {
+            *obj = ink_integer_new(story, (ink_integer)value);
+        } else {
+            ink_float floating;
+
+            memcpy(&floating, &value, sizeof(floating));
+            *obj = ink_float_new(story, floating);
+        }
+        break;
+    }
+    case INK_STATE_VALUE_STRING:
+        rc = ink_state_read_str(reader, &bytes, &length);
+        if (rc < 0) {
+            return rc;
+        }
+
+        *obj = ink_string_new(story, bytes, length);
+        break;
+    default:
+        return -INK_E_INVALID_STATE;
+    }
+    if (!*obj) {
+        return -INK_E_OOM;
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Decoded state, held apart from the story until it has been validated.
+ *
+ * Everything the story needs is allocated while decoding, so that applying
+ * the state cannot fail part of the way through.
+ */
+struct ink_state_decoded {
+    uint16_t flags;
+    uint32_t chain;
+    uint32_t sequence;
+    /* Replacement for the globals of the story, when loading a full state.
+     * Deltas are applied on top of the existing globals instead. */
+    struct ink_object *globals_table;
+    uint32_t choice_index;
+    uint32_t stack_count;
+    uint32_t frames_count;
+    struct ink_content_path *current_path;
+    struct ink_object *current_choice_id;
+    uint8_t *stream_bytes;
+    size_t stream_length;
+    struct ink_arena choice_arena;
+    struct ink_object_vec globals;
+    struct ink_choice_vec choices;
+    struct ink_object_vec spans;
+    struct ink_state_paths paths;
+    struct ink_object *stack[INK_STORY_STACK_MAX];
+    struct ink_call_frame frames[INK_STORY_STACK_MAX];
+    uint32_t frame_sp[INK_STORY_STACK_MAX];
+};
+
+static int ink_state_decode_paths(struct ink_story *story,
+                                  struct ink_state_reader *reader,
+                                  struct ink_state_decoded *state)
+{
+    for (size_t i = 0; i < state->paths.count; i++) {
+        int rc;
+        const uint8_t *bytes = NULL;
+        size_t length = 0;
+        struct ink_object *name = NULL;
+        struct ink_object *path = NULL;
+
+        rc = ink_state_read_str(reader, &bytes, &length);
+        if (rc < 0) {
+            return rc;
+        }
+
+        name = ink_string_new(story, bytes, length);
+        if (!name) {
+            return -INK_E_OOM;
+        }
+
+        rc = ink_table_lookup(story, story->paths, name, &path);
+        if (rc < 0 || !INK_OBJ_IS_CONTENT_PATH(path)) {
+            return -INK_E_INVALID_STATE;
+        }
+
+        state->paths.entries[i] = INK_OBJ_AS_CONTENT_PATH(path);
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Determine if an offset falls on an instruction boundary of a content path.
+ *
+ * The end of the bytecode counts as a boundary, as it is where a frame stops
+ * once its last instruction has been executed.
+ */
+static bool ink_state_is_boundary(const struct ink_content_path *path,
+                                  size_t offset)
+{
+    const uint8_t *const code = path->code.entries;
+    size_t i = 0;
+
+    while (i < offset) {
+        i += 1 + ink_opcode_operand_size(code[i]);
+    }
+    return i == offset;
+}
+
+/**
+ * Decode the call stack.
+ *
+ * Frames must resume on an instruction of their callee, with the arguments
+ * and locals of each frame on the value stack above those of its caller, and
+ * the innermost frame must belong to the current path.
+ */
+static int ink_state_decode_frames(struct ink_state_reader *reader,
+                                   struct ink_state_decoded *state)
+{
+    for (size_t i = 0; i < state->frames_count; i++) {
+        int rc;
+        const uint8_t *bytes = NULL;
+        struct ink_call_frame *const frame = &state->frames[i];
+        uint32_t callee, caller, ip, sp;
+        uint64_t frame_top;
+
+        rc = ink_state_read_bytes(reader, &bytes, 16);
+        if (rc < 0) {
+            return rc;
+        }
+
+        callee = ink_state_load_u32(&bytes[0]);
+        caller = ink_state_load_u32(&bytes[4]);
+        ip = ink_state_load_u32(&bytes[8]);
+        sp = ink_state_load_u32(&bytes[12]);
+
+        if (callee >= state->paths.count ||
+            (caller != INK_STATE_NONE && caller >= state->paths.count) ||
+            sp > state->stack_count) {
+            return -INK_E_INVALID_STATE;
+        }
+
+        frame->callee = state->paths.entries[callee];
+        frame->caller =
+            caller == INK_STATE_NONE ? NULL : state->paths.entries[caller];
+
+        if (ip > frame->callee->code.count ||
+            !ink_state_is_boundary(frame->callee, ip)) {
+            return -INK_E_INVALID_STATE;
+        }
+        frame_top = (uint64_t)sp + frame->callee->arity +
+                    frame->callee->locals_count;
+        if (frame_top > state->stack_count ||
+            (i > 0 && sp < state->frame_sp[i - 1])) {
+            return -INK_E_INVALID_STATE;
+        }
+
+        frame->ip = frame->callee->code.entries + ip;
+        frame->sp = NULL;
+        state->frame_sp[i] = sp;
+    }
+    if (state->frames_count > 0 &&
+        state->frames[state->frames_count - 1].callee != state->current_path) {
+        return -INK_E_INVALID_STATE;
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_decode_globals(struct ink_story *story,
+                                    struct ink_state_reader *reader,
+                                    struct ink_state_decoded *state,
+                                    uint32_t globals_count)
+{
+    for (size_t i = 0; i < globals_count; i++) {
+        int rc;
+        const uint8_t *bytes = NULL;
+        size_t length = 0;
+        struct ink_object *name = NULL;
+        struct ink_object *value = NULL;
+
+        rc = ink_state_read_str(reader, &bytes, &length);
+        if (rc < 0) {
+            return rc;
+        }
+
+        name = ink_string_new(story, bytes, length);
+        if (!name) {
+            return -INK_E_OOM;
+        }
+
+        rc = ink_state_read_value(story, reader, &value);
+        if (rc < 0) {
+            return rc;
+        }
+        if (state->globals_table) {
+            rc = ink_table_insert(story, state->globals_table, name, value);
+            if (rc < 0) {
+                return rc;
+            }
+        } else if (ink_object_vec_push(&state->globals, name) < 0 ||
+                   ink_object_vec_push(&state->globals, value) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_decode_choices(struct ink_story *story,
+                                    struct ink_state_reader *reader,
+                                    struct ink_state_decoded *state,
+                                    uint32_t choices_count)
+{
+    for (size_t i = 0; i < choices_count; i++) {
+        int rc;
+        const uint8_t *bytes = NULL;
+        struct ink_choice choice;
+
+        rc = ink_state_read_value(story, reader, &choice.id);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_state_read_str(reader, &bytes, &choice.length);
+        if (rc < 0) {
+            return rc;
+        }
+
+        choice.bytes =
+            ink_arena_allocate(&state->choice_arena, choice.length + 1);
+        if (!choice.bytes) {
+            return -INK_E_OOM;
+        }
+        if (choice.length > 0) {
+            memcpy(choice.bytes, bytes, choice.length);
+        }
+
+        choice.bytes[choice.length] = '\0';
+
+        if (ink_choice_vec_push(&state->choices, choice) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_decode_spans(struct ink_story *story,
+                                  struct ink_state_reader *reader,
+                                  struct ink_state_decoded *state,
+                                  uint32_t spans_count)
+{
+    for (size_t i = 0; i < spans_count; i++) {
+        struct ink_object *span = NULL;
+        const int rc = ink_state_read_value(story, reader, &span);
+
+        if (rc < 0) {
+            return rc;
+        }
+        if (span && !INK_OBJ_IS_STRING(span)) {
+            return -INK_E_INVALID_STATE;
+        }
+        if (ink_object_vec_push(&state->spans, span) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_decode_stream(struct ink_state_reader *reader,
+                                   struct ink_state_decoded *state)
+{
+    const uint8_t *bytes = NULL;
+    const int rc = ink_state_read_bytes(reader, &bytes, state->stream_length);
+
+    if (rc < 0) {
+        return rc;
+    }
+    if (state->stream_length > 0) {
+        state->stream_bytes = ink_malloc(state->stream_length + 1);
+        if (!state->stream_bytes) {
+            return -INK_E_OOM;
+        }
+
+        memcpy(state->stream_bytes, bytes, state->stream_length);
+        state->stream_bytes[state->stream_length] = '\0';
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_decode(struct ink_story *story,
+                            struct ink_state_reader *reader,
+                            struct ink_state_decoded *state)
+{
+    int rc;
+    const uint8_t *header = NULL;
+    uint32_t base, current_path, globals_count, choices_count, spans_count;
+
+    rc = ink_state_read_bytes(reader, &header, INK_STATE_HEADER_SIZE);
+    if (rc < 0) {
+        return rc;
+    }
+    if (memcmp(header, INK_STATE_MAGIC, INK_STATE_MAGIC_LENGTH) != 0 ||
+        (header[4] | (header[5] << 8)) != INK_STATE_VERSION ||
+        ink_state_load_u32(&header[8]) != story->source_hash) {
+        return -INK_E_INVALID_STATE;
+    }
+
+    /* A delta only applies to the checkpoint it was taken against, and only
+     * while no globals have been stored since. */
+    base = ink_state_load_u32(&header[52]);
+    state->chain = ink_state_load_u32(&header[INK_STATE_CHAIN_OFFSET]);
+    if (base != INK_STATE_NONE &&
+        (base != story->state_sequence || state->chain != story->state_chain ||
+         story->state_dirty.count > 0)) {
+        return -INK_E_INVALID_STATE;
+    }
+
+    state->flags = (uint16_t)(header[6] | (header[7] << 8));
+    state->choice_index = ink_state_load_u32(&header[12]);
+    state->paths.count = ink_state_load_u32(&header[16]);
+    current_path = ink_state_load_u32(&header[20]);
+    state->stack_count = ink_state_load_u32(&header[24]);
+    state->frames_count = ink_state_load_u32(&header[28]);
+    globals_count = ink_state_load_u32(&header[32]);
+    choices_count = ink_state_load_u32(&header[36]);
+    state->stream_length = ink_state_load_u32(&header[40]);
+    spans_count = ink_state_load_u32(&header[44]);
+    state->sequence = ink_state_load_u32(&header[INK_STATE_SEQUENCE_OFFSET]);
+
+    if (state->paths.count > INK_STATE_PATHS_MAX ||
+        state->stack_count > INK_STORY_STACK_MAX ||
+        state->frames_count > INK_STORY_STACK_MAX ||
+        state->sequence == 0 || state->sequence == INK_STATE_NONE ||
+        state->chain == 0 ||
+        (current_path != INK_STATE_NONE &&
+         current_path >= state->paths.count)) {
+        return -INK_E_INVALID_STATE;
+    }
+
+    rc = ink_state_decode_paths(story, reader, state);
+    if (rc < 0) {
+        return rc;
+    }
+
+    state->current_path = current_path == INK_STATE_NONE
+                              ? NULL
+                              : state->paths.entries[current_path];
+
+    for (size_t i = 0; i < state->stack_count; i++) {
+        rc = ink_state_read_value(story, reader, &state->stack[i]);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    rc = ink_state_decode_frames(reader, state);
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (base == INK_STATE_NONE) {
+        state->globals_table = ink_table_new(story);
+        if (!state->globals_table) {
+            return -INK_E_OOM;
+        }
+    }
+
+    rc = ink_state_decode_globals(story, reader, state, globals_count);
+    if (rc < 0) {
+        return rc;
+    }
+    if (!state->globals_table) {
+        rc = ink_table_reserve(story, story->globals,
+                               (uint32_t)(state->globals.count / 2));
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    rc = ink_state_read_value(story, reader, &state->current_choice_id);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_state_decode_choices(story, reader, state, choices_count);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_state_decode_stream(reader, state);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_state_decode_spans(story, reader, state, spans_count);
+    if (rc < 0) {
+        return rc;
+    }
+    if (reader->offset != reader->length) {
+        return -INK_E_INVALID_STATE;
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Replace the runtime state of a story with a decoded state.
+ *
+ * The previous choices, output and choice text are handed back to `state`,
+ * to be released along with it.
+ */
+static void ink_state_apply(struct ink_story *story,
+                            struct ink_state_decoded *state)
+{
+    struct ink_stream *const stream = &story->stream;
+    const struct ink_arena choice_arena = story->choice_arena;
+    const struct ink_choice_vec choices = story->current_choices;
+    const struct ink_object_vec spans = story->output_spans;
+    uint8_t *const stream_bytes = stream->bytes;
+
+    stream->bytes = state->stream_bytes;
+    stream->length = state->stream_length;
+    stream->cursor = 0;
+    state->stream_bytes = stream_bytes;
+
+    story->choice_arena = state->choice_arena;
+    state->choice_arena = choice_arena;
+    story->current_choices = state->choices;
+    state->choices = choices;
+    story->output_spans = state->spans;
+    state->spans = spans;
+
+    if (state->globals_table) {
+        story->globals = state->globals_table;
+    }
+    for (size_t i = 0; i < state->globals.count; i += 2) {
+        /* Room for these was reserved while decoding. */
+        const int rc = ink_table_insert(story, story->globals,
+                                        state->globals.entries[i],
+                                        state->globals.entries[i + 1]);
+
+        assert(rc >= 0);
+        (void)rc;
+    }
+
+    memset(story->stack, 0, sizeof(*story->stack) * INK_STORY_STACK_MAX);
+    memset(story->call_stack, 0,
+           sizeof(*story->call_stack) * INK_STORY_STACK_MAX);
+
+    for (size_t i = 0; i < state->stack_count; i++) {
+        story->stack[i] = state->stack[i];
+    }
+    for (size_t i = 0; i < state->frames_count; i++) {
+        story->call_stack[i] = state->frames[i];
+        story->call_stack[i].sp = &story->stack[state->frame_sp[i]];
+    }
+
+    story->stack_top = state->stack_count;
+    story->call_stack_top = state->frames_count;
+    story->current_path = INK_OBJ(state->current_path);
+    story->current_choice_id = state->current_choice_id;
+    story->choice_index = state->choice_index;
+    story->is_exited = (state->flags & INK_STATE_F_EXITED) != 0;
+    story->can_continue = (state->flags & INK_STATE_F_CAN_CONTINUE) != 0;
+    story->is_yielded = false;
+    story->output_break = (state->flags & INK_STATE_F_OUTPUT_BREAK) != 0;
+    ink_state_checkpoint(story, state->chain, state->sequence);
+}
+
+int ink_state_read(struct ink_story *story, const uint8_t *bytes,
+                   size_t length)
+{
+    int rc;
+    const int flags = story->flags;
+    struct ink_state_reader reader = {
+        .bytes = bytes,
+        .length = length,
+        .offset = 0,
+    };
+    struct ink_state_decoded *const state = ink_malloc(sizeof(*state));
+
+    if (!state) {
+        return -INK_E_OOM;
+    }
+
+    state->paths.count = 0;
+    state->current_choice_id = NULL;
+    state->globals_table = NULL;
+    state->stream_bytes = NULL;
+    state->stream_length = 0;
+    ink_arena_init(&state->choice_arena, INK_STORY_CHOICE_BLOCK_SIZE, 1);
+    ink_object_vec_init(&state->globals);
+    ink_choice_vec_init(&state->choices);
+    ink_object_vec_init(&state->spans);
+
+    /* Decoded objects are only reachable from `state` until it has been
+     * applied, so they must not be collected. */
+    story->flags &= ~INK_F_GC_ENABLE;
+
+    rc = ink_state_decode(story, &reader, state);
+    if (rc == INK_E_OK) {
+        ink_state_apply(story, state);
+    }
+
+    story->flags = flags;
+    ink_free(state->stream_bytes);
+    ink_arena_release(&state->choice_arena);
+    ink_object_vec_deinit(&state->globals);
+    ink_choice_vec_deinit(&state->choices);
+    ink_object_vec_deinit(&state->spans);
+    ink_free(state);
+    return rc;
+}
+
+/**
+ * Copy a value into the heap of another story.
+ *
+ * Objects of a program are kept marked and are shared rather than copied.
+ * `copies` maps the objects copied so far to their copies, so that values
+ * referenced more than once are only copied once.
+ */
+static int ink_state_copy_value(struct ink_story *dst,
+                                struct ink_object_set *copies,
+                                struct ink_object *obj,
+                                struct ink_object **copy)
+{
+    void *memo = NULL;
+    const struct ink_object_set_key key = {
+        .obj = obj,
+    };
+
+    if (!obj || obj->is_marked) {
+        *copy = obj;
+        return INK_E_OK;
+    }
+    if (ink_object_set_lookup(copies, key, &memo) == INK_E_OK) {
+        *copy = memo;
+        return INK_E_OK;
+    }
+    switch (obj->type) {
+    case INK_OBJ_BOOL:
+        *copy = ink_bool_new(dst, INK_OBJ_AS_BOOL(obj)->value);
+        break;
+    case INK_OBJ_NUMBER: {
+        const struct ink_number *const num = INK_OBJ_AS_NUMBER(obj);
+
+        *copy = num->is_int ? ink_integer_new(dst, num->as.integer)
+                            : ink_float_new(dst, num->as.floating);
+        break;
+    }
+    case INK_OBJ_STRING: {
+        const struct ink_string *const str = INK_OBJ_AS_STRING(obj);
+
+        *copy = ink_string_new_hashed(dst, str->bytes, str->length, str->hash);
+        break;
+    }
+    default:
+        return -INK_E_INVALID_ARG;
+    }
+    if (!*copy) {
+        return -INK_E_OOM;
+    }
+    if (ink_object_set_insert(copies, key, *copy) < 0) {
+        return -INK_E_OOM;
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_copy_globals(struct ink_story *dst,
+                                  struct ink_object_set *copies,
+                                  const struct ink_story *src)
+{
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
+    size_t iter = 0;
+
+    dst->globals = ink_table_new(dst);
+    if (!dst->globals) {
+        return -INK_E_OOM;
+    }
+    while (ink_table_next(src->globals, &iter, &key, &value) == INK_E_OK) {
+        int rc = ink_state_copy_value(dst, copies, key, &key);
+
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_state_copy_value(dst, copies, value, &value);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = ink_table_insert(dst, dst->globals, key, value);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_copy_choices(struct ink_story *dst,
+                                  struct ink_object_set *copies,
+                                  const struct ink_story *src)
+{
+    for (size_t i = 0; i < src->current_choices.count; i++) {
+        const struct ink_choice *const choice =
+            &src->current_choices.entries[i];
+        struct ink_choice copy = {
+            .id = NULL,
+            .bytes = ink_arena_allocate(&dst->choice_arena, choice->length + 1),
+            .length = choice->length,
+        };
+        const int rc = ink_state_copy_value(dst, copies, choice->id, &copy.id);
+
+        if (rc < 0) {
+            return rc;
+        }
+        if (!copy.bytes) {
+            return -INK_E_OOM;
+        }
+
+        memcpy(copy.bytes, choice->bytes, choice->length + 1);
+
+        if (ink_choice_vec_push(&dst->current_choices, copy) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
+
+static int ink_state_copy_output(struct ink_story *dst,
+                                 struct ink_object_set *copies,
+                                 const struct ink_story *src)
+{
+    const struct ink_stream *const stream = &src->stream;
+
+    if (stream->bytes) {
+        dst->stream.bytes = ink_malloc(stream->length + 1);
+        if (!dst->stream.bytes) {
+            return -INK_E_OOM;
+        }
+
+        memcpy(dst->stream.bytes, stream->bytes, stream->length + 1);
+        dst->stream.length = stream->length;
+        dst->stream.cursor = stream->cursor;
+    }
+    for (size_t i = 0; i < src->output_spans.count; i++) {
+        struct ink_object *span = NULL;
+        const int rc = ink_state_copy_value(
+            dst, copies, src->output_spans.entries[i], &span);
+
+        if (rc < 0) {
+            return rc;
+        }
+        if (ink_object_vec_push(&dst->output_spans, span) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
+
+int ink_state_copy(struct ink_story *dst, const struct ink_story *src)
+{
+    int rc = -1;
+    const int flags = dst->flags;
+    struct ink_object_set copies;
+
+    ink_object_set_init(&copies, INK_OBJECT_SET_LOAD_MAX);
+
+    /* Copies are unreachable until the stack and globals are in place. */
+    dst->flags &= ~INK_F_GC_ENABLE;
+
+    for (size_t i = 0; i < src->stack_top; i++) {
+        rc = ink_state_copy_value(dst, &copies, src->stack[i], &dst->stack[i]);
+        if (rc < 0) {
+            goto out;
+        }
+    }
+    for (size_t i = 0; i < src->call_stack_top; i++) {
+        dst->call_stack[i] = src->call_stack[i];
+        dst->call_stack[i].sp =
+            dst->stack + (src->call_stack[i].sp - src->stack);
+    }
+
+    dst->stack_top = src->stack_top;
+    dst->call_stack_top = src->call_stack_top;
+
+    rc = ink_state_copy_globals(dst, &copies, src);
+    if (rc < 0) {
+        goto out;
+    }
+
+    rc = ink_state_copy_value(dst, &copies, src->current_choice_id,
+                              &dst->current_choice_id);
+    if (rc < 0) {
+        goto out;
+    }
+
+    rc = ink_state_copy_choices(dst, &copies, src);
+    if (rc < 0) {
+        goto out;
+    }
+
+    rc = ink_state_copy_output(dst, &copies, src);
+    if (rc < 0) {
+        goto out;
+    }
+
+    dst->current_path = src->current_path;
+    dst->choice_index = src->choice_index;
+    dst->is_exited = src->is_exited;
+    dst->can_continue = src->can_continue;
+    dst->output_break = src->output_break;
+out:
+    dst->flags = flags;
+    ink_object_set_deinit(&copies);
+    return rc;
+}
@@ -0,0 +1,84 @@
+#ifndef INK_STATE_H
+#define INK_STATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+
+#define INK_STATE_MAGIC "INKS"
+#define INK_STATE_MAGIC_LENGTH (4u)
+#define INK_STATE_VERSION (3u)
+#define INK_STATE_HEADER_SIZE (60u)
+#define INK_STATE_SEQUENCE_OFFSET (48u)
+#define INK_STATE_CHAIN_OFFSET (56u)
+#define INK_STATE_NONE (0xffffffffu)
+
+struct ink_story;
+
+/**
+ * Serialize the runtime state of a story.
+ *
+ * The state is laid out as a fixed-size header, followed by:
+ *
+ *     path names, stack values, call frames, globals,
+ *     current choice ID, choices, pending output, pending spans
+ *
+ * All integers are encoded in little-endian byte order. Content paths are
+ * referred to by their index in the list of path names, and instruction and
+ * stack pointers are stored as offsets, so that a state can be loaded into
+ * any story compiled from the same source. Compiled content paths are never
+ * written.
+ *
+ * Every state is a checkpoint with a sequence number. When `delta` is set,
+ * only the globals stored since the previous checkpoint are written, and the
+ * state can only be applied on top of that checkpoint. Each full state starts
+ * a new chain with a random ID, which its deltas carry along so that they
+ * are never applied to a checkpoint of another chain.
+ */
+extern int ink_state_write(struct ink_story *story, struct ink_byte_vec *bytes,
+                           bool delta);
+
+/**
+ * Restore the runtime state of a story.
+ *
+ * The state is decoded, validated and allocated for in full before any of
+ * it is applied, so the story is left intact if the state is invalid or
+ * memory runs out.
+ */
+extern int ink_state_read(struct ink_story *story, const uint8_t *bytes,
+                          size_t length);
+
+/**
+ * Copy the runtime state of a story into a fresh story that shares its
+ * program.
+ *
+ * Values reachable from the state are copied into the heap of `dst`, while
+ * objects of the program are shared.
+ */
+extern int ink_state_copy(struct ink_story *dst, const struct ink_story *src);
+
+/**
+ * Overwrite the chain ID and sequence number of a saved state.
+ *
+ * Equal states saved along different histories differ only in their chain ID
+ * and sequence number.
+ */
+extern void ink_state_set_checkpoint(uint8_t *bytes, uint32_t chain,
+                                     uint32_t sequence);
+
+/**
+ * Record that a global variable has been stored since the last checkpoint.
+ */
+extern int ink_state_touch(struct ink_story *story, struct ink_object *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
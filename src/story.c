@@ -6,12 +6,15 @@
 
 #include <ink/ink.h>
 
+#include "arena.h"
+#include "bundle.h"
 #include "compile.h"
 #include "gc.h"
 #include "logging.h"
 #include "object.h"
 #include "opcode.h"
 #include "source.h"
+#include "state.h"
 #include "story.h"
 #include "stream.h"
 
@@ -21,19 +24,6 @@ const char *INK_DEFAULT_PATH = "@main";
 static const char *INK_OPCODE_TYPE_STR[] = {INK_MAKE_OPCODE_LIST(T)};
 #undef T
 
-static uint32_t ink_object_set_key_hash(const void *key, size_t length)
-{
-    return ink_fnv32a((uint8_t *)key, length);
-}
-
-static bool ink_object_set_key_cmp(const void *lhs, const void *rhs)
-{
-    const struct ink_object_set_key *const key_lhs = lhs;
-    const struct ink_object_set_key *const key_rhs = rhs;
-
-    return (key_lhs->obj == key_rhs->obj);
-}
-
 /**
  * Return a printable string for an opcode type.
  */
@@ -43,15 +33,16 @@ static inline const char *ink_opcode_strz(enum ink_vm_opcode type)
 }
 
 /**
- * Throw a runtime error.
+ * Report a runtime error and stop the story.
  *
- * Does not return.
+ * The caller returns the matching status code, so that embedders such as the
+ * scheduler can recover instead of losing the process.
  */
 static void ink_runtime_error(struct ink_story *story, const char *fmt)
 {
-    (void)story;
     ink_error("%s!", fmt);
-    exit(EXIT_FAILURE);
+    story->is_exited = true;
+    story->can_continue = false;
 }
 
 void *ink_story_mem_alloc(struct ink_story *story, void *ptr, size_t size_old,
@@ -228,6 +219,19 @@ static size_t ink_story_disassemble(const struct ink_story *story,
     }
 }
 
+/**
+ * Record that a content path has been entered.
+ */
+static int ink_story_cover(struct ink_story *story, struct ink_object *path)
+{
+    const struct ink_object_set_key key = {
+        .obj = path,
+    };
+    const int rc = ink_object_set_insert(story->coverage, key, NULL);
+
+    return rc == -INK_E_OVERWRITE ? INK_E_OK : rc;
+}
+
 /**
  * Invoke a content path with LIFO discipline.
  */
@@ -239,11 +243,11 @@ static int ink_story_call(struct ink_story *story, struct ink_object *path_obj)
 
     if (story->call_stack_top == INK_STORY_STACK_MAX) {
         ink_runtime_error(story, "Stack overflow.");
-        return -1;
+        return -INK_E_STACK_OVERFLOW;
     }
     if (story->stack_top < path->arity) {
         ink_runtime_error(story, "Not enough arguments to path.");
-        return -1;
+        return -INK_E_INVALID_ARG;
     }
 
     struct ink_object **const stack_top = &story->stack[story->stack_top];
@@ -256,6 +260,10 @@ static int ink_story_call(struct ink_story *story, struct ink_object *path_obj)
     frame->ip = &path->code.entries[0];
     story->current_path = INK_OBJ(path);
     story->stack_top += path->locals_count;
+
+    if (story->coverage) {
+        return ink_story_cover(story, path_obj);
+    }
     return INK_E_OK;
 }
 
@@ -271,7 +279,7 @@ static int ink_story_divert(struct ink_story *story,
 
     if (story->stack_top < path->arity) {
         ink_runtime_error(story, "Not enough arguments to path.");
-        return -1;
+        return -INK_E_INVALID_ARG;
     }
 
     struct ink_call_frame *const frame = &story->call_stack[0];
@@ -287,6 +295,10 @@ static int ink_story_divert(struct ink_story *story,
     story->call_stack_top = 1;
     story->current_path = INK_OBJ(path);
     story->stack_top = path->arity + path->locals_count;
+
+    if (story->coverage) {
+        return ink_story_cover(story, path_obj);
+    }
     return INK_E_OK;
 }
 
@@ -663,23 +675,36 @@ static int ink_vm_cmp(struct ink_story *story, enum ink_vm_opcode op)
     return INK_E_OK;
 }
 
+/**
+ * Negate the number on top of the stack.
+ *
+ * The operand may be a constant of the program or the value of a global, so
+ * the result is always a new number.
+ */
 static int ink_vm_neg(struct ink_story *story)
 {
-    struct ink_number *v = NULL;
-    struct ink_object *arg = ink_story_stack_peek(story, 0);
+    struct ink_object *v = NULL;
+    struct ink_number *arg = NULL;
+    struct ink_object *const obj = ink_story_stack_peek(story, 0);
 
-    if (!arg) {
+    if (!obj) {
         return -INK_E_STACK_OVERFLOW;
     }
 
-    assert(arg->type == INK_OBJ_NUMBER);
-    v = INK_OBJ_AS_NUMBER(arg);
+    assert(obj->type == INK_OBJ_NUMBER);
+    arg = INK_OBJ_AS_NUMBER(obj);
 
-    if (v->is_int) {
-        v->as.integer = -v->as.integer;
+    if (arg->is_int) {
+        v = ink_integer_new(story, -arg->as.integer);
     } else {
-        v->as.floating = -v->as.floating;
+        v = ink_float_new(story, -arg->as.floating);
     }
+    if (!v) {
+        return -INK_E_OOM;
+    }
+
+    ink_story_stack_pop(story);
+    ink_story_stack_push(story, v);
     return INK_E_OK;
 }
 
@@ -707,7 +732,7 @@ static int ink_vm_load_const(struct ink_story *story,
 {
     struct ink_object_vec *const const_pool = &frame->callee->const_pool;
 
-    if (offset > const_pool->count) {
+    if (offset >= const_pool->count) {
         return -INK_E_INVALID_ARG;
     }
     if (ink_story_stack_push(story, const_pool->entries[offset]) < 0) {
@@ -716,6 +741,115 @@ static int ink_vm_load_const(struct ink_story *story,
     return INK_E_OK;
 }
 
+static void ink_story_sink_span(struct ink_story *story,
+                                enum ink_span_type type, const uint8_t *bytes,
+                                size_t length)
+{
+    const struct ink_span span = {
+        .type = type,
+        .bytes = bytes,
+        .length = length,
+    };
+
+    story->output_sink(story->output_userdata, &span);
+}
+
+/**
+ * Deliver a pending line break to the output sink.
+ *
+ * Line breaks are held back until more output is produced, so that glue may
+ * still cancel them.
+ */
+static void ink_story_sink_break(struct ink_story *story)
+{
+    if (story->output_break) {
+        story->output_break = false;
+        ink_story_sink_span(story, INK_SPAN_LINE, (uint8_t *)"\n", 1);
+    }
+}
+
+/**
+ * Deliver pending content to the output sink.
+ *
+ * Pending glue is recorded as a NULL entry.
+ */
+static void ink_story_sink_flush(struct ink_story *story)
+{
+    struct ink_object_vec *const spans = &story->output_spans;
+
+    for (size_t i = 0; i < spans->count; i++) {
+        struct ink_object *const obj = spans->entries[i];
+
+        if (obj) {
+            const struct ink_string *const str = INK_OBJ_AS_STRING(obj);
+
+            ink_story_sink_span(story, INK_SPAN_TEXT, str->bytes, str->length);
+        } else {
+            ink_story_sink_span(story, INK_SPAN_GLUE, NULL, 0);
+        }
+    }
+
+    ink_object_vec_shrink(spans, 0);
+}
+
+/**
+ * Copy the text of a choice into the choice arena.
+ *
+ * The text is gathered from pending output, either from the stream or from
+ * the output sink's spans. Its address remains stable until the next choice
+ * is selected.
+ */
+static int ink_story_choice_text(struct ink_story *story,
+                                 struct ink_choice *choice)
+{
+    uint8_t *bytes = NULL;
+    size_t length = 0;
+
+    if (story->output_sink) {
+        struct ink_object_vec *const spans = &story->output_spans;
+
+        ink_story_sink_break(story);
+
+        for (size_t i = 0; i < spans->count; i++) {
+            if (spans->entries[i]) {
+                length += INK_OBJ_AS_STRING(spans->entries[i])->length;
+            }
+        }
+
+        choice->bytes = ink_arena_allocate(&story->choice_arena, length + 1);
+        if (!choice->bytes) {
+            return -INK_E_OOM;
+        }
+        for (size_t i = 0; i < spans->count; i++) {
+            if (spans->entries[i]) {
+                const struct ink_string *const str =
+                    INK_OBJ_AS_STRING(spans->entries[i]);
+
+                memcpy(choice->bytes + choice->length, str->bytes,
+                       str->length);
+                choice->length += str->length;
+            }
+        }
+
+        ink_object_vec_shrink(spans, 0);
+    } else {
+        ink_stream_read_line(&story->stream, &bytes, &length);
+
+        choice->bytes = ink_arena_allocate(&story->choice_arena, length + 1);
+        if (!choice->bytes) {
+            return -INK_E_OOM;
+        }
+        if (length > 0) {
+            memcpy(choice->bytes, bytes, length);
+        }
+
+        choice->length = length;
+    }
+
+    choice->bytes[choice->length] = '\0';
+    return INK_E_OK;
+}
+
 /**
  * Main interpreter loop.
  *
@@ -728,6 +862,8 @@ static int ink_story_exec(struct ink_story *story)
     struct ink_object *const paths_pool = story->paths;
     struct ink_call_frame *frame = NULL;
 
+    story->is_yielded = false;
+
     if (story->call_stack_top > 0) {
         frame = &story->call_stack[story->call_stack_top - 1];
     } else {
@@ -740,6 +876,14 @@ static int ink_story_exec(struct ink_story *story)
     (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
 
     for (;;) {
+        if (story->instruction_count == story->instruction_limit) {
+            story->is_yielded = true;
+            rc = -INK_E_YIELD;
+            goto exit_loop;
+        }
+
+        story->instruction_count++;
+
         if (story->flags & INK_F_VM_TRACING) {
             ink_trace_exec(story, frame);
         }
@@ -751,6 +895,11 @@ static int ink_story_exec(struct ink_story *story)
         case INK_OP_EXIT: {
             rc = INK_E_OK;
             story->is_exited = true;
+
+            if (story->output_sink) {
+                ink_story_sink_flush(story);
+                ink_story_sink_break(story);
+            }
             goto exit_loop;
         }
         case INK_OP_RET: {
@@ -770,6 +919,7 @@ static int ink_story_exec(struct ink_story *story)
             }
 
             frame = &story->call_stack[story->call_stack_top - 1];
+            story->current_path = INK_OBJ(frame->callee);
             break;
         }
         case INK_OP_POP: {
@@ -940,6 +1090,12 @@ static int ink_story_exec(struct ink_story *story)
             if (rc < 0) {
                 goto exit_loop;
             }
+            if (story->state_sequence != 0) {
+                rc = ink_state_touch(story, arg);
+                if (rc < 0) {
+                    goto exit_loop;
+                }
+            }
 
             ink_story_stack_pop(story);
 
@@ -956,16 +1112,31 @@ static int ink_story_exec(struct ink_story *story)
                 struct ink_object *const str_arg = ink_vm_to_string(story, arg);
                 struct ink_string *const str = INK_OBJ_AS_STRING(str_arg);
 
-                ink_stream_write(&story->stream, str->bytes, str->length);
+                if (story->output_sink) {
+                    ink_story_sink_break(story);
+                    ink_object_vec_push(&story->output_spans, str_arg);
+                } else {
+                    ink_stream_write(&story->stream, str->bytes, str->length);
+                }
             }
             break;
         }
         case INK_OP_LINE: {
-            ink_stream_writef(&story->stream, "\n");
+            if (story->output_sink) {
+                ink_story_sink_flush(story);
+                story->output_break = true;
+            } else {
+                ink_stream_writef(&story->stream, "\n");
+            }
             break;
         }
         case INK_OP_GLUE: {
-            ink_stream_trim(&story->stream);
+            if (story->output_sink) {
+                story->output_break = false;
+                ink_object_vec_push(&story->output_spans, NULL);
+            } else {
+                ink_stream_trim(&story->stream);
+            }
             break;
         }
         case INK_OP_CHOICE: {
@@ -973,8 +1144,19 @@ static int ink_story_exec(struct ink_story *story)
                 .id = ink_story_stack_pop(story),
             };
 
-            ink_stream_read_line(&story->stream, &choice.bytes, &choice.length);
-            ink_choice_vec_push(&story->current_choices, choice);
+            rc = ink_story_choice_text(story, &choice);
+            if (rc < 0) {
+                goto exit_loop;
+            }
+
+            rc = ink_choice_vec_push(&story->current_choices, choice);
+            if (rc < 0) {
+                goto exit_loop;
+            }
+            if (story->output_sink) {
+                ink_story_sink_span(story, INK_SPAN_CHOICE, choice.bytes,
+                                    choice.length);
+            }
             break;
         }
         case INK_OP_LOAD_CHOICE_ID: {
@@ -986,6 +1168,11 @@ static int ink_story_exec(struct ink_story *story)
         }
         case INK_OP_FLUSH: {
             rc = INK_E_OK;
+
+            if (story->output_sink) {
+                ink_story_sink_flush(story);
+                ink_story_sink_break(story);
+            }
             goto exit_loop;
         }
         default:
@@ -1014,7 +1201,27 @@ int ink_story_continue(struct ink_story *s, uint8_t **line, size_t *linelen)
     if (linelen) {
         *linelen = 0;
     }
+    if (s->output_sink) {
+        if (s->is_yielded || (!s->is_exited && s->current_choices.count == 0)) {
+            rc = ink_story_exec(s);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+        if (s->is_exited || s->current_choices.count > 0) {
+            s->can_continue = false;
+        }
+        return INK_E_OK;
+    }
     for (;;) {
+        /* A yielded story is resumed before anything is read, as its stream
+         * may end with a partial line. */
+        if (s->is_yielded) {
+            rc = ink_story_exec(s);
+            if (rc < 0) {
+                return rc;
+            }
+        }
         if (!ink_stream_is_empty(&s->stream)) {
             ink_stream_read_line(&s->stream, line, linelen);
 
@@ -1037,6 +1244,86 @@ int ink_story_continue(struct ink_story *s, uint8_t **line, size_t *linelen)
     }
 }
 
+int ink_story_continue_all(struct ink_story *s, struct ink_turn *turn)
+{
+    int rc = INK_E_OK;
+    uint8_t *line = NULL;
+    size_t linelen = 0;
+
+    /* A yielded turn keeps the output gathered so far. */
+    if (!s->is_yielded) {
+        ink_byte_vec_shrink(&s->turn_bytes, 0);
+        ink_offset_vec_shrink(&s->turn_lines, 0);
+    }
+    while (s->can_continue) {
+        rc = ink_story_continue(s, &line, &linelen);
+        if (rc < 0) {
+            return rc;
+        }
+        if (!line) {
+            continue;
+        }
+
+        rc = ink_offset_vec_push(&s->turn_lines, s->turn_bytes.count);
+        if (rc < 0) {
+            return rc;
+        }
+        rc = ink_byte_vec_append(&s->turn_bytes, line, linelen);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    rc = ink_offset_vec_push(&s->turn_lines, s->turn_bytes.count);
+    if (rc < 0) {
+        return rc;
+    }
+
+    turn->bytes = s->turn_bytes.entries;
+    turn->length = s->turn_bytes.count;
+    turn->lines = s->turn_lines.entries;
+    turn->line_count = s->turn_lines.count - 1;
+    turn->choices = s->current_choices.entries;
+    turn->choice_count = s->current_choices.count;
+    return INK_E_OK;
+}
+
+int ink_story_continue_budget(struct ink_story *s, size_t max_instructions,
+                              struct ink_turn *turn)
+{
+    int rc;
+
+    if (max_instructions == 0) {
+        return -INK_E_INVALID_ARG;
+    }
+    if (max_instructions < UINT64_MAX - s->instruction_count) {
+        s->instruction_limit = s->instruction_count + max_instructions;
+    }
+
+    rc = ink_story_continue_all(s, turn);
+    s->instruction_limit = UINT64_MAX;
+    return rc;
+}
+
+uint64_t ink_story_instruction_count(struct ink_story *s)
+{
+    return s->instruction_count;
+}
+
+int ink_story_set_output_sink(struct ink_story *s, ink_output_sink sink,
+                              void *userdata)
+{
+    if (!ink_stream_is_empty(&s->stream)) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    s->output_break = false;
+    s->output_sink = sink;
+    s->output_userdata = userdata;
+    ink_object_vec_shrink(&s->output_spans, 0);
+    return INK_E_OK;
+}
+
 int ink_story_choose(struct ink_story *s, size_t index)
 {
     struct ink_choice *ch;
@@ -1051,6 +1338,7 @@ int ink_story_choose(struct ink_story *s, size_t index)
         s->current_choice_id = ch->id;
         s->can_continue = true;
         ink_choice_vec_shrink(&s->current_choices, 0);
+        ink_arena_reset(&s->choice_arena);
         return INK_E_OK;
     }
     return -INK_E_INVALID_ARG;
@@ -1072,74 +1360,361 @@ struct ink_object *ink_story_get_paths(struct ink_story *story)
 
 void ink_story_dump(struct ink_story *story)
 {
-    const struct ink_table *const paths_table = INK_OBJ_AS_TABLE(story->paths);
+    size_t iter = 0;
+    struct ink_object *path_obj = NULL;
+
+    while (ink_table_next(story->paths, &iter, NULL, &path_obj) == INK_E_OK) {
+        const struct ink_content_path *const path =
+            INK_OBJ_AS_CONTENT_PATH(path_obj);
+        const struct ink_string *const path_name =
+            INK_OBJ_AS_STRING(path->name);
+
+        assert(path->code.count > 0);
+        fprintf(stderr, "=== %s(args: %u, locals: %u) ===\n", path_name->bytes,
+                path->arity, path->locals_count);
+
+        for (size_t offset = 0; offset < path->code.count;) {
+            offset = ink_story_disassemble(story, path, path->code.entries,
+                                           offset, false);
+        }
+    }
+}
+
+/**
+ * Prepare a story for loading.
+ *
+ * Garbage collection is held off until loading has completed.
+ */
+static int ink_story_load_begin(struct ink_story *story, int flags)
+{
+    story->flags = flags & ~INK_F_GC_ENABLE;
+    story->globals = ink_table_new(story);
+    if (!story->globals) {
+        return -INK_E_OOM;
+    }
+
+    story->paths = ink_table_new(story);
+    if (!story->paths) {
+        return -INK_E_OOM;
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Copy the entries of a table of globals into another.
+ */
+static int ink_story_copy_globals(struct ink_story *story,
+                                  struct ink_object *dst,
+                                  const struct ink_object *src)
+{
+    size_t iter = 0;
+    struct ink_object *key = NULL;
+    struct ink_object *value = NULL;
 
-    for (size_t i = 0; i < paths_table->capacity; i++) {
-        struct ink_table_kv *const entry = &paths_table->entries[i];
+    while (ink_table_next(src, &iter, &key, &value) == INK_E_OK) {
+        if (ink_table_insert(story, dst, key, value) < 0) {
+            return -INK_E_OOM;
+        }
+    }
+    return INK_E_OK;
+}
 
-        if (entry->key) {
-            const struct ink_content_path *const path =
-                INK_OBJ_AS_CONTENT_PATH(entry->value);
-            const struct ink_string *const path_name =
-                INK_OBJ_AS_STRING(path->name);
+/**
+ * Divert a story to its entry point.
+ */
+static int ink_story_start(struct ink_story *story)
+{
+    struct ink_object *main_path = NULL;
+    struct ink_object *const main_name = ink_string_new(
+        story, (uint8_t *)INK_DEFAULT_PATH, strlen(INK_DEFAULT_PATH));
 
-            assert(path->code.count > 0);
-            fprintf(stderr, "=== %s(args: %u, locals: %u) ===\n",
-                    path_name->bytes, path->arity, path->locals_count);
+    if (!main_name) {
+        return -INK_E_OOM;
+    }
+    if (ink_table_lookup(story, story->paths, main_name, &main_path) ==
+        INK_E_OK) {
+        ink_story_divert(story, main_path);
+    }
 
-            for (size_t offset = 0; offset < path->code.count;) {
-                offset = ink_story_disassemble(story, path, path->code.entries,
-                                               offset, false);
-            }
+    story->can_continue = true;
+    return INK_E_OK;
+}
+
+/**
+ * Finish loading a story by diverting to its entry point.
+ */
+static int ink_story_load_end(struct ink_story *story, int flags)
+{
+    int rc;
+
+    story->initial_globals = NULL;
+
+    if (!story->program && INK_OBJ_AS_TABLE(story->globals)->count > 0) {
+        story->initial_globals = ink_table_new(story);
+        if (!story->initial_globals) {
+            return -INK_E_OOM;
+        }
+        if (ink_story_copy_globals(story, story->initial_globals,
+                                   story->globals) < 0) {
+            return -INK_E_OOM;
         }
     }
+
+    rc = ink_story_start(story);
+    if (rc < 0) {
+        return rc;
+    }
+    if (flags & INK_F_GC_ENABLE) {
+        story->flags |= INK_F_GC_ENABLE;
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Load the globals layout and content paths of a story from a mapped
+ * bundle.
+ *
+ * When `source_hash` is non-zero, the bundle is rejected unless it was
+ * compiled from the same source.
+ */
+static int ink_story_load_bundle_bytes(struct ink_story *story,
+                                       const uint8_t *bytes, size_t length,
+                                       uint32_t source_hash)
+{
+    int rc = -1;
+    struct ink_bundle_header header;
+
+    rc = ink_bundle_read_header(bytes, length, &header);
+    if (rc < 0) {
+        return rc;
+    }
+    if (source_hash && header.source_hash != source_hash) {
+        return -INK_E_INVALID_BUNDLE;
+    }
+
+    rc = ink_bundle_read(story, bytes, length);
+    if (rc < 0) {
+        return rc;
+    }
+
+    story->source_hash = header.source_hash;
+
+    if (story->flags & INK_F_DUMP_CODE) {
+        ink_story_dump(story);
+    }
+    return INK_E_OK;
+}
+
+/**
+ * Determine the path of the bundle cached alongside an Ink source file.
+ *
+ * Returns NULL if the file is not an Ink source file.
+ */
+static char *ink_story_cache_path(const uint8_t *filename)
+{
+    const char *const ext = ".ink";
+    const size_t ext_length = strlen(ext);
+    const size_t length = filename ? strlen((const char *)filename) : 0;
+    char *path = NULL;
+
+    if (length <= ext_length ||
+        strcmp((const char *)filename + length - ext_length, ext) != 0) {
+        return NULL;
+    }
+
+    path = ink_malloc(length + 2);
+    if (!path) {
+        return NULL;
+    }
+
+    memcpy(path, filename, length);
+    path[length] = 'b';
+    path[length + 1] = '\0';
+    return path;
+}
+
+/**
+ * Attempt to load a story from the bundle cached alongside its source file.
+ */
+static int ink_story_load_cached(struct ink_story *story,
+                                 const char *cache_path, uint32_t source_hash)
+{
+    int rc = -1;
+    struct ink_source s;
+    FILE *const fp = fopen(cache_path, "rb");
+
+    /* A missing cache is expected the first time a story is loaded. */
+    if (!fp) {
+        return -INK_E_OS;
+    }
+
+    fclose(fp);
+
+    rc = ink_source_map(cache_path, &s);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_story_load_bundle_bytes(story, s.bytes, s.length, source_hash);
+    if (rc < 0) {
+        ink_source_free(&s);
+        return rc;
+    }
+
+    story->bundle = s;
+    return INK_E_OK;
 }
 
 int ink_story_load_opts(struct ink_story *story,
                         const struct ink_load_opts *opts)
 {
     int rc = -1;
+    char *cache_path = NULL;
 
     if (!opts->source_bytes) {
         return -INK_E_PANIC;
     }
+    if (story->program) {
+        return -INK_E_INVALID_ARG;
+    }
 
-    story->flags = opts->flags & ~INK_F_GC_ENABLE;
-    story->globals = ink_table_new(story);
-    story->paths = ink_table_new(story);
+    rc = ink_story_load_begin(story, opts->flags);
+    if (rc < 0) {
+        return rc;
+    }
+
+    story->source_hash = ink_fnv32a(opts->source_bytes, opts->source_length);
+
+    if (opts->flags & INK_F_CACHING) {
+        cache_path = ink_story_cache_path(opts->filename);
+    }
+    if (cache_path) {
+        rc = ink_story_load_cached(story, cache_path, story->source_hash);
+        if (rc == INK_E_OK) {
+            goto out;
+        }
+
+        /* The cached bundle is missing or stale. Start over with fresh
+         * tables, leaving partially loaded objects for the collector. */
+        rc = ink_story_load_begin(story, opts->flags);
+        if (rc < 0) {
+            goto out;
+        }
+    }
 
     rc = ink_compile(story, opts);
     if (rc < 0) {
-        goto err;
+        goto out;
     }
+    if (cache_path) {
+        /* Failing to update the cache is not fatal. */
+        ink_story_save_bundle(story, cache_path);
+    }
+out:
+    ink_free(cache_path);
 
-    struct ink_table *const paths_table = INK_OBJ_AS_TABLE(story->paths);
+    if (rc < 0) {
+        return rc;
+    }
+    return ink_story_load_end(story, opts->flags);
+}
 
-    for (size_t i = 0; i < paths_table->capacity; i++) {
-        struct ink_table_kv *const entry = &paths_table->entries[i];
+/**
+ * Discard the runtime state of a story.
+ */
+static void ink_story_restart(struct ink_story *story)
+{
+    story->is_exited = false;
+    story->can_continue = false;
+    story->is_yielded = false;
+    story->output_break = false;
+    story->choice_index = 0;
+    story->stack_top = 0;
+    story->call_stack_top = 0;
+    story->current_path = NULL;
+    story->current_choice_id = NULL;
 
-        if (entry->key) {
-            const struct ink_content_path *const cpath =
-                INK_OBJ_AS_CONTENT_PATH(entry->value);
-            const struct ink_string *const path_name =
-                INK_OBJ_AS_STRING(cpath->name);
+    memset(story->stack, 0, sizeof(*story->stack) * INK_STORY_STACK_MAX);
+    memset(story->call_stack, 0,
+           sizeof(*story->call_stack) * INK_STORY_STACK_MAX);
+    ink_stream_deinit(&story->stream);
+    ink_stream_init(&story->stream);
+    ink_choice_vec_shrink(&story->current_choices, 0);
+    ink_arena_reset(&story->choice_arena);
+    ink_object_vec_shrink(&story->output_spans, 0);
+    story->state_sequence = 0;
+    story->state_chain = 0;
+    ink_object_set_clear(&story->state_dirty);
+}
 
-            if (strcmp(INK_DEFAULT_PATH, (char *)path_name->bytes) == 0) {
-                ink_story_divert(story, entry->value);
-                break;
-            }
-        }
+int ink_story_recompile(struct ink_story *story,
+                        const struct ink_load_opts *opts)
+{
+    int rc = -1;
+    struct ink_object *const globals = story->globals;
+    struct ink_object *const paths = story->paths;
+
+    if (!opts->source_bytes) {
+        return -INK_E_PANIC;
+    }
+    if (story->program) {
+        return -INK_E_INVALID_ARG;
+    }
+    if (!paths) {
+        return ink_story_load_opts(story, opts);
     }
 
-    story->can_continue = true;
+    rc = ink_story_load_begin(story, opts->flags);
+    if (rc < 0) {
+        goto fail;
+    }
+
+    story->prior_paths = paths;
+    rc = ink_compile(story, opts);
+    story->prior_paths = NULL;
+    if (rc < 0) {
+        goto fail;
+    }
+
+    story->source_hash = ink_fnv32a(opts->source_bytes, opts->source_length);
+    ink_story_restart(story);
+    return ink_story_load_end(story, opts->flags);
+fail:
+    story->globals = globals;
+    story->paths = paths;
 
     if (opts->flags & INK_F_GC_ENABLE) {
         story->flags |= INK_F_GC_ENABLE;
     }
-err:
     return rc;
 }
 
+int ink_story_reset(struct ink_story *story)
+{
+    const struct ink_object *const initial_globals =
+        story->program ? story->program->story->globals
+                       : story->initial_globals;
+
+    if (!story->paths) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    /* The new table is rooted before it is filled in, as growing it may
+     * trigger a collection. */
+    story->globals = ink_table_new(story);
+    if (!story->globals) {
+        return -INK_E_OOM;
+    }
+    if (initial_globals &&
+        ink_story_copy_globals(story, story->globals, initial_globals) < 0) {
+        return -INK_E_OOM;
+    }
+
+    ink_story_restart(story);
+    story->instruction_count = 0;
+    return ink_story_start(story);
+}
+
 int ink_story_load_string(struct ink_story *story, const char *source,
                           int flags)
 {
@@ -1176,6 +1751,121 @@ int ink_story_load_file(struct ink_story *story, const char *file_path,
     return rc;
 }
 
+int ink_story_load_bundle(struct ink_story *story, const char *file_path,
+                          int flags)
+{
+    int rc = -1;
+    struct ink_source s;
+
+    if (story->program) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    rc = ink_source_map(file_path, &s);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = ink_story_load_begin(story, flags);
+    if (rc < 0) {
+        goto err;
+    }
+
+    rc = ink_story_load_bundle_bytes(story, s.bytes, s.length, 0);
+    if (rc < 0) {
+        goto err;
+    }
+
+    story->bundle = s;
+    return ink_story_load_end(story, flags);
+err:
+    ink_source_free(&s);
+    return rc;
+}
+
+int ink_story_save_bundle(struct ink_story *story, const char *file_path)
+{
+    int rc = -1;
+    struct ink_byte_vec bytes;
+
+    if (!story->paths) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    ink_byte_vec_init(&bytes);
+
+    rc = ink_bundle_write(story, story->source_hash, &bytes);
+    if (rc < 0) {
+        goto out;
+    }
+
+    rc = ink_source_write(file_path, bytes.entries, bytes.count);
+out:
+    ink_byte_vec_deinit(&bytes);
+    return rc;
+}
+
+int ink_story_save_state(struct ink_story *story, const uint8_t **bytes,
+                         size_t *length)
+{
+    int rc;
+
+    if (!story->paths || story->is_yielded) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    rc = ink_state_write(story, &story->state_bytes, false);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *bytes = story->state_bytes.entries;
+    *length = story->state_bytes.count;
+    return INK_E_OK;
+}
+
+int ink_story_save_delta(struct ink_story *story, const uint8_t **bytes,
+                         size_t *length)
+{
+    int rc;
+
+    if (!story->paths || story->is_yielded) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    rc = ink_state_write(story, &story->state_bytes, true);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *bytes = story->state_bytes.entries;
+    *length = story->state_bytes.count;
+    return INK_E_OK;
+}
+
+int ink_story_load_state(struct ink_story *story, const uint8_t *bytes,
+                         size_t length)
+{
+    if (!story->paths) {
+        return -INK_E_INVALID_ARG;
+    }
+    return ink_state_read(story, bytes, length);
+}
+
+int ink_story_load_state_chain(struct ink_story *story,
+                               const uint8_t *const *states,
+                               const size_t *lengths, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const int rc = ink_story_load_state(story, states[i], lengths[i]);
+
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    return INK_E_OK;
+}
+
 struct ink_story *ink_open(void)
 {
     struct ink_story *const story = ink_malloc(sizeof(*story));
@@ -1186,8 +1876,14 @@ struct ink_story *ink_open(void)
 
     story->is_exited = false;
     story->can_continue = false;
+    story->is_yielded = false;
+    story->output_break = false;
     story->flags = 0;
+    story->source_hash = 0;
+    story->proto_hash = 0;
     story->choice_index = 0;
+    story->instruction_count = 0;
+    story->instruction_limit = UINT64_MAX;
     story->stack_top = 0;
     story->call_stack_top = 0;
     story->gc_allocated = 0;
@@ -1195,23 +1891,165 @@ struct ink_story *ink_open(void)
     story->gc_objects = NULL;
     story->globals = NULL;
     story->paths = NULL;
+    story->prior_paths = NULL;
+    story->initial_globals = NULL;
     story->current_path = NULL;
     story->current_choice_id = NULL;
+    story->output_sink = NULL;
+    story->output_userdata = NULL;
+    story->coverage = NULL;
+    story->program = NULL;
 
     ink_stream_init(&story->stream);
     memset(story->stack, 0, sizeof(*story->stack) * INK_STORY_STACK_MAX);
     memset(story->call_stack, 0,
            sizeof(*story->call_stack) * INK_STORY_STACK_MAX);
     ink_object_vec_init(&story->gc_gray);
-    ink_object_set_init(&story->gc_owned, INK_OBJECT_SET_LOAD_MAX,
-                        ink_object_set_key_hash, ink_object_set_key_cmp);
+    ink_object_set_init(&story->gc_owned, INK_OBJECT_SET_LOAD_MAX);
     ink_choice_vec_init(&story->current_choices);
+    ink_arena_init(&story->choice_arena, INK_STORY_CHOICE_BLOCK_SIZE, 1);
+    ink_object_vec_init(&story->output_spans);
+    ink_byte_vec_init(&story->turn_bytes);
+    ink_offset_vec_init(&story->turn_lines);
+    ink_byte_vec_init(&story->state_bytes);
+    story->state_sequence = 0;
+    story->state_chain = 0;
+    ink_object_set_init(&story->state_dirty, INK_OBJECT_SET_LOAD_MAX);
+    story->bundle.bytes = NULL;
+    story->bundle.length = 0;
+    story->bundle.is_mapped = false;
     return story;
 }
 
+int ink_program_load_opts(struct ink_program **program,
+                          const struct ink_load_opts *opts)
+{
+    int rc = -1;
+    struct ink_program *p = NULL;
+    struct ink_load_opts program_opts = *opts;
+
+    p = ink_malloc(sizeof(*p));
+    if (!p) {
+        return -INK_E_OOM;
+    }
+
+    p->story = ink_open();
+    if (!p->story) {
+        ink_free(p);
+        return -INK_E_OOM;
+    }
+
+    /* The content of a program is never collected. */
+    program_opts.flags &= ~(INK_F_GC_ENABLE | INK_F_GC_STRESS);
+
+    rc = ink_story_load_opts(p->story, &program_opts);
+    if (rc < 0) {
+        ink_close(p->story);
+        ink_free(p);
+        return rc;
+    }
+    for (struct ink_object *obj = p->story->gc_objects; obj; obj = obj->next) {
+        obj->is_marked = true;
+    }
+
+    *program = p;
+    return INK_E_OK;
+}
+
+void ink_program_close(struct ink_program *program)
+{
+    ink_close(program->story);
+    ink_free(program);
+}
+
+/**
+ * Create a story that borrows the content of a program.
+ *
+ * Garbage collection is held off until the session has been set up.
+ */
+static struct ink_story *ink_session_new(const struct ink_program *program,
+                                         int flags)
+{
+    const struct ink_story *const content = program->story;
+    struct ink_story *const session = ink_open();
+
+    if (!session) {
+        return NULL;
+    }
+
+    session->flags = flags & ~INK_F_GC_ENABLE;
+    session->program = program;
+    session->source_hash = content->source_hash;
+    session->proto_hash = content->proto_hash;
+    session->paths = content->paths;
+    return session;
+}
+
+struct ink_story *ink_session_open(struct ink_program *program, int flags)
+{
+    struct ink_object *key = NULL;
+    size_t iter = 0;
+    const struct ink_story *const content = program->story;
+    struct ink_story *const session = ink_session_new(program, flags);
+
+    if (!session) {
+        return NULL;
+    }
+
+    session->globals = ink_table_new(session);
+    if (!session->globals) {
+        goto err;
+    }
+    while (ink_table_next(content->globals, &iter, &key, NULL) == INK_E_OK) {
+        if (ink_table_insert(session, session->globals, key, NULL) < 0) {
+            goto err;
+        }
+    }
+    if (ink_story_load_end(session, flags) < 0) {
+        goto err;
+    }
+    return session;
+err:
+    ink_close(session);
+    return NULL;
+}
+
+int ink_story_fork(struct ink_story *story, struct ink_story **fork)
+{
+    int rc = -1;
+    struct ink_story *session = NULL;
+
+    if (!story->program || story->is_yielded) {
+        return -INK_E_INVALID_ARG;
+    }
+
+    session = ink_session_new(story->program, story->flags);
+    if (!session) {
+        return -INK_E_OOM;
+    }
+
+    rc = ink_state_copy(session, story);
+    if (rc < 0) {
+        ink_close(session);
+        return rc;
+    }
+
+    session->output_sink = story->output_sink;
+    session->output_userdata = story->output_userdata;
+    session->flags = story->flags;
+    *fork = session;
+    return INK_E_OK;
+}
+
 void ink_close(struct ink_story *story)
 {
     ink_choice_vec_deinit(&story->current_choices);
+    ink_arena_release(&story->choice_arena);
+    ink_object_vec_deinit(&story->output_spans);
+    ink_byte_vec_deinit(&story->turn_bytes);
+    ink_offset_vec_deinit(&story->turn_lines);
+    ink_byte_vec_deinit(&story->state_bytes);
+    ink_object_set_deinit(&story->state_dirty);
     ink_object_vec_deinit(&story->gc_gray);
     ink_object_set_deinit(&story->gc_owned);
     ink_stream_deinit(&story->stream);
@@ -1223,6 +2061,7 @@ void ink_close(struct ink_story *story)
         ink_object_free(story, obj);
     }
 
+    ink_source_free(&story->bundle);
     memset(story, 0, sizeof(*story));
     ink_free(story);
 }
@@ -9,7 +9,9 @@ extern "C" {
 
 #include <ink/ink.h>
 
+#include "arena.h"
 #include "hashmap.h"
+#include "source.h"
 #include "stream.h"
 #include "vec.h"
 
@@ -19,13 +21,38 @@ extern "C" {
 #define INK_GC_HEAP_SIZE_MIN (1024ul * 1024ul)
 #define INK_GC_HEAP_GROWTH_PERCENT (50ul)
 #define INK_OBJECT_SET_LOAD_MAX (80ul)
+#define INK_STORY_CHOICE_BLOCK_SIZE (1024ul)
 
 struct ink_object_set_key {
     struct ink_object *obj;
 };
 
 INK_VEC_T(ink_choice_vec, struct ink_choice)
-INK_HASHMAP_T(ink_object_set, struct ink_object_set_key, void *)
+INK_VEC_T(ink_offset_vec, size_t)
+
+/**
+ * Hash function for object sets.
+ */
+static inline uint32_t ink_object_set_key_hash(const void *key, size_t length)
+{
+    const struct ink_object_set_key *const k = key;
+
+    return ink_hash_ptr(k->obj);
+}
+
+/**
+ * Key comparison function for object sets.
+ */
+static inline bool ink_object_set_key_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_object_set_key *const key_lhs = lhs;
+    const struct ink_object_set_key *const key_rhs = rhs;
+
+    return (key_lhs->obj == key_rhs->obj);
+}
+
+INK_HASHMAP_T_EX(ink_object_set, struct ink_object_set_key, void *,
+                 ink_object_set_key_hash, ink_object_set_key_cmp)
 
 struct ink_call_frame {
     struct ink_content_path *callee;
@@ -34,13 +61,35 @@ struct ink_call_frame {
     struct ink_object **sp;
 };
 
+/**
+ * Compiled content of a story, shared between sessions.
+ *
+ * The objects of a program live in the heap of a story that never runs. They
+ * are kept marked, so that collections in sessions treat them as reachable
+ * without ever writing to them.
+ */
+struct ink_program {
+    struct ink_story *story;
+};
+
 struct ink_story {
     /* TODO: Could this be added to `flags`? */
     bool is_exited;
     /* TODO: Could this be added to `flags`? */
     bool can_continue;
+    /* Set when execution stopped mid-turn because the instruction budget was
+     * exhausted. */
+    bool is_yielded;
+    bool output_break;
     int flags;
+    uint32_t source_hash;
+    /* Hash of the knot, stitch and function prototypes of the story. */
+    uint32_t proto_hash;
     size_t choice_index;
+    /* Instructions executed over the lifetime of the story. */
+    uint64_t instruction_count;
+    /* Value of `instruction_count` at which execution yields. */
+    uint64_t instruction_limit;
     size_t stack_top;
     size_t call_stack_top;
     size_t gc_allocated;
@@ -50,10 +99,37 @@ struct ink_story {
     struct ink_object *gc_objects;
     struct ink_object *globals;
     struct ink_object *paths;
+    /* Paths of a previous compilation, available for reuse while
+     * recompiling. */
+    struct ink_object *prior_paths;
+    /* Globals as they were once loaded, restored by `ink_story_reset`. NULL
+     * when the story had none, or for sessions, which use the globals of
+     * their program instead. */
+    struct ink_object *initial_globals;
     struct ink_object *current_path;
     struct ink_object *current_choice_id;
     struct ink_choice_vec current_choices;
+    struct ink_arena choice_arena;
     struct ink_stream stream;
+    ink_output_sink output_sink;
+    void *output_userdata;
+    struct ink_object_vec output_spans;
+    struct ink_byte_vec turn_bytes;
+    struct ink_offset_vec turn_lines;
+    /* Buffer for the most recently saved state. */
+    struct ink_byte_vec state_bytes;
+    /* Sequence number of the last checkpoint, or zero if there is none. */
+    uint32_t state_sequence;
+    /* ID of the chain the last checkpoint belongs to. */
+    uint32_t state_chain;
+    /* Names of the globals stored since the last checkpoint. */
+    struct ink_object_set state_dirty;
+    /* Content paths entered by the story are added to this set, if set. */
+    struct ink_object_set *coverage;
+    /* Program that a session borrows its content paths from. */
+    const struct ink_program *program;
+    /* Mapped bundle that loaded content paths may borrow bytecode from. */
+    struct ink_source bundle;
     struct ink_object *stack[INK_STORY_STACK_MAX];
     struct ink_call_frame call_stack[INK_STORY_STACK_MAX];
 };
@@ -11,28 +11,6 @@ struct ink_symtab_node {
     struct ink_symtab table;
 };
 
-/**
- * Hash function for symbol table maps.
- */
-static uint32_t ink_symtab_hash(const void *bytes, size_t length)
-{
-    const struct ink_string_ref *const key = bytes;
-
-    return ink_fnv32a(key->bytes, key->length);
-}
-
-/**
- * Key comparison function for symbol table maps.
- */
-static bool ink_symtab_cmp(const void *lhs, const void *rhs)
-{
-    const struct ink_string_ref *const key_lhs = lhs;
-    const struct ink_string_ref *const key_rhs = rhs;
-
-    return key_lhs->length == key_rhs->length &&
-           memcmp(key_lhs->bytes, key_rhs->bytes, key_lhs->length) == 0;
-}
-
 struct ink_symtab *ink_symtab_make(struct ink_symtab_pool *st_pool)
 {
     struct ink_symtab_node *const node = ink_malloc(sizeof(*node));
@@ -41,8 +19,7 @@ struct ink_symtab *ink_symtab_make(struct ink_symtab_pool *st_pool)
         return NULL;
     }
 
-    ink_symtab_init(&node->table, INK_SYMTAB_LOAD_MAX, ink_symtab_hash,
-                    ink_symtab_cmp);
+    ink_symtab_init(&node->table, INK_SYMTAB_LOAD_MAX);
 
     node->next = st_pool->head;
     st_pool->head = node;
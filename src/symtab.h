@@ -27,7 +27,7 @@ enum ink_symbol_type {
 
 struct ink_symbol {
     enum ink_symbol_type type;
-    const struct ink_ast_node *node;
+    uint32_t node;
     union {
         struct {
             bool is_const;
@@ -39,7 +39,7 @@ struct ink_symbol {
         struct {
             size_t arity;
             size_t const_slot;
-            size_t str_index;
+            uint32_t scope_id;
             struct ink_symtab *local_names;
         } knot;
     } as;
@@ -50,7 +50,30 @@ struct ink_string_ref {
     size_t length;
 };
 
-INK_HASHMAP_T(ink_symtab, struct ink_string_ref, struct ink_symbol)
+/**
+ * Hash function for symbol table maps.
+ */
+static inline uint32_t ink_symtab_hash(const void *bytes, size_t length)
+{
+    const struct ink_string_ref *const key = bytes;
+
+    return ink_hash_bytes(key->bytes, key->length);
+}
+
+/**
+ * Key comparison function for symbol table maps.
+ */
+static inline bool ink_symtab_cmp(const void *lhs, const void *rhs)
+{
+    const struct ink_string_ref *const key_lhs = lhs;
+    const struct ink_string_ref *const key_rhs = rhs;
+
+    return key_lhs->length == key_rhs->length &&
+           memcmp(key_lhs->bytes, key_rhs->bytes, key_lhs->length) == 0;
+}
+
+INK_HASHMAP_T_EX(ink_symtab, struct ink_string_ref, struct ink_symbol,
+                 ink_symtab_hash, ink_symtab_cmp)
 
 extern void ink_symtab_pool_init(struct ink_symtab_pool *symtab_pool);
 extern void ink_symtab_pool_deinit(struct ink_symtab_pool *symtab_pool);
@@ -0,0 +1,262 @@
+#if defined(INK_USE_PTHREADS)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stddef.h>
+
+#if defined(INK_USE_PTHREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+#include "memory.h"
+#include "thread.h"
+
+#define INK_THREAD_COUNT_MAX (64u)
+
+/**
+ * Shared state for the workers of a parallel loop.
+ */
+struct ink_parallel_loop {
+    struct ink_mutex lock;
+    size_t next_index;
+    size_t task_count;
+    ink_task_fn task;
+    void *context;
+};
+
+int ink_mutex_init(struct ink_mutex *mutex)
+{
+#if defined(INK_USE_PTHREADS)
+    if (pthread_mutex_init(&mutex->handle, NULL) != 0) {
+        return -INK_E_OS;
+    }
+#else
+    mutex->unused = 0;
+#endif
+    return INK_E_OK;
+}
+
+void ink_mutex_deinit(struct ink_mutex *mutex)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_mutex_destroy(&mutex->handle);
+#else
+    (void)mutex;
+#endif
+}
+
+void ink_mutex_lock(struct ink_mutex *mutex)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_mutex_lock(&mutex->handle);
+#else
+    (void)mutex;
+#endif
+}
+
+void ink_mutex_unlock(struct ink_mutex *mutex)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_mutex_unlock(&mutex->handle);
+#else
+    (void)mutex;
+#endif
+}
+
+int ink_cond_init(struct ink_cond *cond)
+{
+#if defined(INK_USE_PTHREADS)
+    if (pthread_cond_init(&cond->handle, NULL) != 0) {
+        return -INK_E_OS;
+    }
+#else
+    cond->unused = 0;
+#endif
+    return INK_E_OK;
+}
+
+void ink_cond_deinit(struct ink_cond *cond)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_cond_destroy(&cond->handle);
+#else
+    (void)cond;
+#endif
+}
+
+void ink_cond_wait(struct ink_cond *cond, struct ink_mutex *mutex)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_cond_wait(&cond->handle, &mutex->handle);
+#else
+    (void)cond;
+    (void)mutex;
+#endif
+}
+
+void ink_cond_signal(struct ink_cond *cond)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_cond_signal(&cond->handle);
+#else
+    (void)cond;
+#endif
+}
+
+void ink_cond_broadcast(struct ink_cond *cond)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_cond_broadcast(&cond->handle);
+#else
+    (void)cond;
+#endif
+}
+
+#if defined(INK_USE_PTHREADS)
+/**
+ * Arguments for a thread, passed through `pthread_create`.
+ */
+struct ink_thread_start {
+    ink_thread_fn fn;
+    void *context;
+};
+
+static void *ink_thread_main(void *arg)
+{
+    struct ink_thread_start start = *(struct ink_thread_start *)arg;
+
+    ink_free(arg);
+    start.fn(start.context);
+    return NULL;
+}
+#endif
+
+int ink_thread_start(struct ink_thread *thread, ink_thread_fn fn,
+                     void *context)
+{
+#if defined(INK_USE_PTHREADS)
+    struct ink_thread_start *const start = ink_malloc(sizeof(*start));
+
+    if (!start) {
+        return -INK_E_OOM;
+    }
+
+    start->fn = fn;
+    start->context = context;
+
+    if (pthread_create(&thread->handle, NULL, ink_thread_main, start) != 0) {
+        ink_free(start);
+        return -INK_E_OS;
+    }
+    return INK_E_OK;
+#else
+    (void)thread;
+    (void)fn;
+    (void)context;
+    return -INK_E_OS;
+#endif
+}
+
+void ink_thread_join(struct ink_thread *thread)
+{
+#if defined(INK_USE_PTHREADS)
+    pthread_join(thread->handle, NULL);
+#else
+    (void)thread;
+#endif
+}
+
+size_t ink_thread_count(void)
+{
+#if defined(INK_USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (count > 0) {
+        return (size_t)count;
+    }
+#endif
+    return 1;
+}
+
+/**
+ * Claim and run tasks until none are left.
+ */
+static void ink_parallel_loop_run(struct ink_parallel_loop *loop)
+{
+    for (;;) {
+        size_t index;
+
+        ink_mutex_lock(&loop->lock);
+        index = loop->next_index;
+
+        if (index < loop->task_count) {
+            loop->next_index++;
+        }
+
+        ink_mutex_unlock(&loop->lock);
+
+        if (index >= loop->task_count) {
+            break;
+        }
+
+        loop->task(loop->context, index);
+    }
+}
+
+#if defined(INK_USE_PTHREADS)
+static void *ink_parallel_loop_worker(void *arg)
+{
+    ink_parallel_loop_run(arg);
+    return NULL;
+}
+#endif
+
+void ink_parallel_for(size_t task_count, size_t thread_count, ink_task_fn task,
+                      void *context)
+{
+    struct ink_parallel_loop loop = {
+        .next_index = 0,
+        .task_count = task_count,
+        .task = task,
+        .context = context,
+    };
+
+    if (thread_count > task_count) {
+        thread_count = task_count;
+    }
+    if (thread_count > INK_THREAD_COUNT_MAX) {
+        thread_count = INK_THREAD_COUNT_MAX;
+    }
+    if (ink_mutex_init(&loop.lock) < 0) {
+        for (size_t i = 0; i < task_count; i++) {
+            task(context, i);
+        }
+        return;
+    }
+#if defined(INK_USE_PTHREADS)
+    pthread_t threads[INK_THREAD_COUNT_MAX];
+    size_t started = 0;
+
+    /* The calling thread participates in the loop, so it counts towards
+     * `thread_count`. */
+    while (started + 1 < thread_count) {
+        if (pthread_create(&threads[started], NULL, ink_parallel_loop_worker,
+                           &loop) != 0) {
+            break;
+        }
+
+        started++;
+    }
+
+    ink_parallel_loop_run(&loop);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+#else
+    ink_parallel_loop_run(&loop);
+#endif
+    ink_mutex_deinit(&loop.lock);
+}
@@ -0,0 +1,111 @@
+#ifndef INK_THREAD_H
+#define INK_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#if defined(INK_USE_PTHREADS)
+#include <pthread.h>
+#endif
+
+/**
+ * Mutual exclusion lock.
+ *
+ * Locking is a no-op when the library is built without thread support.
+ */
+struct ink_mutex {
+#if defined(INK_USE_PTHREADS)
+    pthread_mutex_t handle;
+#else
+    int unused;
+#endif
+};
+
+#if defined(INK_USE_PTHREADS)
+#define INK_MUTEX_INIT {PTHREAD_MUTEX_INITIALIZER}
+#else
+#define INK_MUTEX_INIT {0}
+#endif
+
+/**
+ * Condition variable, used together with a mutex.
+ *
+ * Waiting returns immediately when the library is built without thread
+ * support.
+ */
+struct ink_cond {
+#if defined(INK_USE_PTHREADS)
+    pthread_cond_t handle;
+#else
+    int unused;
+#endif
+};
+
+/**
+ * Handle for a thread started with `ink_thread_start`.
+ */
+struct ink_thread {
+#if defined(INK_USE_PTHREADS)
+    pthread_t handle;
+#else
+    int unused;
+#endif
+};
+
+/**
+ * Task callback for parallel loops.
+ */
+typedef void (*ink_task_fn)(void *context, size_t index);
+
+/**
+ * Entry point for threads.
+ */
+typedef void (*ink_thread_fn)(void *context);
+
+extern int ink_mutex_init(struct ink_mutex *mutex);
+extern void ink_mutex_deinit(struct ink_mutex *mutex);
+extern void ink_mutex_lock(struct ink_mutex *mutex);
+extern void ink_mutex_unlock(struct ink_mutex *mutex);
+extern int ink_cond_init(struct ink_cond *cond);
+extern void ink_cond_deinit(struct ink_cond *cond);
+extern void ink_cond_wait(struct ink_cond *cond, struct ink_mutex *mutex);
+extern void ink_cond_signal(struct ink_cond *cond);
+extern void ink_cond_broadcast(struct ink_cond *cond);
+
+/**
+ * Start a thread running `fn`.
+ *
+ * Fails with `INK_E_OS` when the library is built without thread support.
+ */
+extern int ink_thread_start(struct ink_thread *thread, ink_thread_fn fn,
+                            void *context);
+
+/**
+ * Wait for a thread to finish.
+ */
+extern void ink_thread_join(struct ink_thread *thread);
+
+/**
+ * Return the number of hardware threads available, or one when the library
+ * is built without thread support.
+ */
+extern size_t ink_thread_count(void);
+
+/**
+ * Run `task` for every index in [0, `task_count`) on a pool of up to
+ * `thread_count` threads, returning once all tasks have completed.
+ *
+ * Tasks are handed out in index order. Falls back to running the tasks on
+ * the calling thread if worker threads cannot be created.
+ */
+extern void ink_parallel_for(size_t task_count, size_t thread_count,
+                             ink_task_fn task, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -72,6 +72,28 @@ extern "C" {
     T(TT_WHITESPACE, "Whitespace")                                             \
     T(TT_ERROR, "Error")
 
+/**
+ * Reserved words, along with the first and last bytes of their spelling.
+ *
+ * The bytes are repeated here so that a keyword's slot in the scanner's hash
+ * table can be computed at compile time.
+ */
+#define INK_MAKE_KEYWORD_LIST(T)                                               \
+    T(TT_KEYWORD_AND, "and", 'a', 'd')                                         \
+    T(TT_KEYWORD_CONST, "CONST", 'C', 'T')                                     \
+    T(TT_KEYWORD_ELSE, "else", 'e', 'e')                                       \
+    T(TT_KEYWORD_FALSE, "false", 'f', 'e')                                     \
+    T(TT_KEYWORD_FUNCTION, "function", 'f', 'n')                               \
+    T(TT_KEYWORD_LIST, "LIST", 'L', 'T')                                       \
+    T(TT_KEYWORD_MOD, "mod", 'm', 'd')                                         \
+    T(TT_KEYWORD_NOT, "not", 'n', 't')                                         \
+    T(TT_KEYWORD_OR, "or", 'o', 'r')                                           \
+    T(TT_KEYWORD_REF, "ref", 'r', 'f')                                         \
+    T(TT_KEYWORD_RETURN, "return", 'r', 'n')                                   \
+    T(TT_KEYWORD_TEMP, "temp", 't', 'p')                                       \
+    T(TT_KEYWORD_TRUE, "true", 't', 'e')                                       \
+    T(TT_KEYWORD_VAR, "VAR", 'V', 'R')
+
 #define T(name, description) INK_##name,
 enum ink_token_type {
     INK_MAKE_TOKEN_LIST(T)
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "common.h"
 #include "memory.h"
@@ -88,6 +89,35 @@ extern "C" {
         return INK_E_OK;                                                       \
     }                                                                          \
                                                                                \
+    static inline int __T##_append(struct __T *self, const __V *entries,     \
+                                   size_t count)                              \
+    {                                                                          \
+        size_t capacity = self->capacity;                                      \
+                                                                               \
+        if (self->count + count > capacity) {                                  \
+            if (capacity < INK_VEC_COUNT_MIN) {                                \
+                capacity = INK_VEC_COUNT_MIN;                                  \
+            }                                                                  \
+            while (self->count + count > capacity) {                           \
+                capacity *= INK_VEC_GROWTH_FACTOR;                             \
+            }                                                                  \
+                                                                               \
+            self->entries =                                                    \
+                (__V *)ink_realloc(self->entries, capacity * sizeof(__V));     \
+            if (!self->entries) {                                              \
+                return -INK_E_OOM;                                             \
+            }                                                                  \
+                                                                               \
+            self->capacity = capacity;                                         \
+        }                                                                      \
+        if (count > 0) {                                                       \
+            memcpy(self->entries + self->count, entries, count * sizeof(__V)); \
+        }                                                                      \
+                                                                               \
+        self->count += count;                                                  \
+        return INK_E_OK;                                                       \
+    }                                                                          \
+                                                                               \
     static inline __V __T##_pop(struct __T *self)                              \
     {                                                                          \
         assert(self->count > 0);                                               \
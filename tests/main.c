@@ -65,6 +65,46 @@ static struct ink_allocator NULL_GPA = {
     .free = nullgpa_dealloc,
 };
 
+/* Allocations left before the failing allocator starts returning NULL. */
+static size_t FAIL_GPA_BUDGET;
+static struct ink_allocator *FAIL_GPA_NEXT;
+
+static void *failgpa_alloc(struct ink_allocator *self, size_t size)
+{
+    (void)self;
+
+    if (FAIL_GPA_BUDGET == 0) {
+        return NULL;
+    }
+
+    FAIL_GPA_BUDGET--;
+    return FAIL_GPA_NEXT->allocate(FAIL_GPA_NEXT, size);
+}
+
+static void *failgpa_realloc(struct ink_allocator *self, void *ptr, size_t size)
+{
+    (void)self;
+
+    if (FAIL_GPA_BUDGET == 0) {
+        return NULL;
+    }
+
+    FAIL_GPA_BUDGET--;
+    return FAIL_GPA_NEXT->resize(FAIL_GPA_NEXT, ptr, size);
+}
+
+static void failgpa_dealloc(struct ink_allocator *self, void *ptr)
+{
+    (void)self;
+    FAIL_GPA_NEXT->free(FAIL_GPA_NEXT, ptr);
+}
+
+static struct ink_allocator FAIL_GPA = {
+    .allocate = failgpa_alloc,
+    .resize = failgpa_realloc,
+    .free = failgpa_dealloc,
+};
+
 static int parse_int(const char *chars, size_t length)
 {
     int res = 0;
@@ -211,6 +251,1039 @@ static void test_exec(void)
     }
 }
 
+static void test_output_sink_collect(void *userdata,
+                                     const struct ink_span *span)
+{
+    struct ink_stream *const output = userdata;
+
+    switch (span->type) {
+    case INK_SPAN_TEXT:
+    case INK_SPAN_LINE:
+        ink_stream_write(output, span->bytes, span->length);
+        break;
+    case INK_SPAN_GLUE:
+        ink_stream_writef(output, "<>");
+        break;
+    case INK_SPAN_CHOICE:
+        ink_stream_writef(output, "[%.*s]", (int)span->length, span->bytes);
+        break;
+    }
+}
+
+static void test_output_sink(void **state)
+{
+    const char *source = "Hello, <>\n"
+                         "world!\n"
+                         "* First\n"
+                         "* Second[] choice\n"
+                         "- Done.\n";
+    const char *expected = "Hello, <>world!\n[First][Second]";
+    struct ink_story *story = ink_open();
+    struct ink_stream output;
+
+    assert_non_null(story);
+    ink_stream_init(&output);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE |
+                                                             INK_F_GC_STRESS),
+                     INK_E_OK);
+    assert_int_equal(
+        ink_story_set_output_sink(story, test_output_sink_collect, &output),
+        INK_E_OK);
+
+    while (ink_story_can_continue(story)) {
+        assert_int_equal(ink_story_continue(story, NULL, NULL), INK_E_OK);
+    }
+
+    assert_int_equal(output.length, strlen(expected));
+    assert_memory_equal(output.bytes, expected, output.length);
+    ink_stream_deinit(&output);
+    ink_close(story);
+}
+
+static void test_continue_all(void **state)
+{
+    const char *source = "First line.\n"
+                         "Second line.\n"
+                         "* Left\n"
+                         "  Went left.\n"
+                         "* Right\n"
+                         "  Went right.\n"
+                         "- The end.\n";
+    struct ink_story *story = ink_open();
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE |
+                                                             INK_F_GC_STRESS),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.line_count, 2);
+    assert_int_equal(turn.lines[0], 0);
+    assert_int_equal(turn.lines[1], strlen("First line.\n"));
+    assert_int_equal(turn.lines[2], turn.length);
+    assert_int_equal(turn.length, strlen("First line.\nSecond line.\n"));
+    assert_memory_equal(turn.bytes, "First line.\nSecond line.\n",
+                        turn.length);
+    assert_int_equal(turn.choice_count, 2);
+    assert_string_equal(turn.choices[0].bytes, "Left");
+    assert_string_equal(turn.choices[1].bytes, "Right");
+    assert_int_equal(ink_story_choose(story, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.choice_count, 0);
+    assert_false(ink_story_can_continue(story));
+    ink_close(story);
+}
+
+static void test_bundle_roundtrip(void **state)
+{
+    const char *source = "VAR greeting = \"Hello\"\n"
+                         "{greeting}, world!\n"
+                         "* [Left]\n"
+                         "  Went left.\n"
+                         "* [Right]\n"
+                         "  Went right.\n";
+    const char *bundle_path = "test_bundle_roundtrip.inkb";
+    struct ink_story *story = ink_open();
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE |
+                                                             INK_F_GC_STRESS),
+                     INK_E_OK);
+    assert_int_equal(ink_story_save_bundle(story, bundle_path), INK_E_OK);
+    ink_close(story);
+
+    story = ink_open();
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_bundle(story, bundle_path,
+                                           INK_F_GC_ENABLE | INK_F_GC_STRESS),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Hello, world!\n"));
+    assert_memory_equal(turn.bytes, "Hello, world!\n", turn.length);
+    assert_int_equal(turn.choice_count, 2);
+    assert_string_equal(turn.choices[1].bytes, "Right");
+    assert_int_equal(ink_story_choose(story, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Went right.\n"));
+    assert_memory_equal(turn.bytes, "Went right.\n", turn.length);
+    ink_close(story);
+    remove(bundle_path);
+}
+
+static uint32_t test_bundle_u32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void test_bundle_bad_code(void **state)
+{
+    const char *bundle_path = "test_bundle_bad_code.inkb";
+    struct ink_story *story = ink_open();
+    uint8_t bytes[4096];
+    uint32_t paths_offset = 0;
+    uint32_t code_offset = 0;
+    size_t length = 0;
+    FILE *fp = NULL;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, "Hello.\n", INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_save_bundle(story, bundle_path), INK_E_OK);
+    ink_close(story);
+
+    fp = fopen(bundle_path, "rb");
+    assert_non_null(fp);
+    length = fread(bytes, 1, sizeof(bytes), fp);
+    fclose(fp);
+
+    /* Replace the first opcode of the first path with an unknown one. */
+    assert_true(length >= 32);
+    paths_offset = test_bundle_u32(bytes + 24);
+    assert_true(paths_offset + 16 <= length);
+    code_offset = test_bundle_u32(bytes + paths_offset + 12);
+    assert_true(code_offset < length);
+    bytes[code_offset] = 0xff;
+
+    fp = fopen(bundle_path, "wb");
+    assert_non_null(fp);
+    assert_int_equal(fwrite(bytes, 1, length, fp), length);
+    fclose(fp);
+
+    story = ink_open();
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_bundle(story, bundle_path, INK_F_GC_ENABLE),
+                     -INK_E_INVALID_BUNDLE);
+    ink_close(story);
+    remove(bundle_path);
+}
+
+static void test_parallel_compile(void **state)
+{
+    const char *source = "-> first\n"
+                         "== first ==\n"
+                         "First knot.\n"
+                         "-> second.inner\n"
+                         "== second ==\n"
+                         "Unreachable.\n"
+                         "= inner\n"
+                         "Second knot, {1 + 2}.\n"
+                         "-> third\n"
+                         "== third ==\n"
+                         "Third knot.\n"
+                         "-> END\n";
+    struct ink_story *story = ink_open();
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, source,
+                                           INK_F_GC_ENABLE | INK_F_PARALLEL),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.line_count, 3);
+    assert_int_equal(turn.length,
+                     strlen("First knot.\nSecond knot, 3.\nThird knot.\n"));
+    assert_memory_equal(turn.bytes,
+                        "First knot.\nSecond knot, 3.\nThird knot.\n",
+                        turn.length);
+    ink_close(story);
+}
+
+static struct ink_object *test_find_path(struct ink_story *story,
+                                         const char *name)
+{
+    const struct ink_table *const paths =
+        INK_OBJ_AS_TABLE(ink_story_get_paths(story));
+
+    for (size_t i = 0; i < paths->capacity; i++) {
+        const struct ink_table_kv *const entry = &paths->entries[i];
+
+        if (entry->key && strcmp((char *)entry->key->bytes, name) == 0) {
+            return entry->value;
+        }
+    }
+    return NULL;
+}
+
+static void test_recompile(void **state)
+{
+    const char *source = "-> first\n"
+                         "== first ==\n"
+                         "First knot.\n"
+                         "-> second\n"
+                         "== second ==\n"
+                         "Second knot.\n"
+                         "-> END\n";
+    const char *edited = "-> first\n"
+                         "== first ==\n"
+                         "First knot.\n"
+                         "-> second\n"
+                         "== second ==\n"
+                         "Second knot, edited.\n"
+                         "-> END\n";
+    const struct ink_load_opts opts = {
+        .flags = INK_F_GC_ENABLE,
+        .source_bytes = (uint8_t *)edited,
+        .source_length = strlen(edited),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_story *story = ink_open();
+    struct ink_object *first = NULL;
+    struct ink_object *second = NULL;
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+
+    first = test_find_path(story, "first");
+    second = test_find_path(story, "second");
+    assert_non_null(first);
+    assert_non_null(second);
+
+    assert_int_equal(ink_story_recompile(story, &opts), INK_E_OK);
+    assert_ptr_equal(test_find_path(story, "first"), first);
+    assert_ptr_not_equal(test_find_path(story, "second"), second);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.line_count, 2);
+    assert_int_equal(turn.length,
+                     strlen("First knot.\nSecond knot, edited.\n"));
+    assert_memory_equal(turn.bytes, "First knot.\nSecond knot, edited.\n",
+                        turn.length);
+    ink_close(story);
+}
+
+static void test_reset(void **state)
+{
+    const char *source = "VAR gold = 1\n"
+                         "Gold {gold}.\n"
+                         "* [Rob]\n"
+                         "  ~ gold = gold + 10\n"
+                         "  Gold {gold}.\n"
+                         "  -> END\n";
+    const struct ink_load_opts opts = {
+        .flags = INK_F_GC_ENABLE | INK_F_GC_STRESS,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    struct ink_story *story = ink_open();
+    struct ink_story *session = NULL;
+    uint8_t *initial = NULL;
+    size_t initial_length = 0;
+    const uint8_t *bytes = NULL;
+    size_t length = 0;
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_not_equal(ink_story_reset(story), INK_E_OK);
+    assert_int_equal(ink_story_load_opts(story, &opts), INK_E_OK);
+    assert_int_equal(ink_story_save_state(story, &bytes, &length), INK_E_OK);
+
+    initial = malloc(length);
+    assert_non_null(initial);
+    memcpy(initial, bytes, length);
+    initial_length = length;
+
+    for (int i = 0; i < 2; i++) {
+        assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+        assert_int_equal(turn.length, strlen("Gold 1.\n"));
+        assert_memory_equal(turn.bytes, "Gold 1.\n", turn.length);
+        assert_int_equal(ink_story_choose(story, 1), INK_E_OK);
+        assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+        assert_int_equal(turn.length, strlen("Gold 11.\n"));
+        assert_memory_equal(turn.bytes, "Gold 11.\n", turn.length);
+        assert_false(ink_story_can_continue(story));
+
+        assert_int_equal(ink_story_reset(story), INK_E_OK);
+        assert_true(ink_story_can_continue(story));
+        assert_int_equal(ink_story_instruction_count(story), 0);
+        assert_int_equal(ink_story_save_state(story, &bytes, &length),
+                         INK_E_OK);
+        assert_int_equal(length, initial_length);
+
+        /* Every full state starts a chain of its own, at bytes 56 to 59. */
+        assert_memory_equal(bytes, initial, 56);
+        assert_memory_equal(bytes + 60, initial + 60, length - 60);
+    }
+
+    free(initial);
+    ink_close(story);
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+    session = ink_session_open(program, INK_F_GC_ENABLE | INK_F_GC_STRESS);
+    assert_non_null(session);
+    assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+    assert_int_equal(ink_story_choose(session, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+    assert_int_equal(ink_story_reset(session), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Gold 1.\n"));
+    assert_memory_equal(turn.bytes, "Gold 1.\n", turn.length);
+    ink_close(session);
+    ink_program_close(program);
+}
+
+static void test_state_roundtrip(void **state)
+{
+    const char *source = "-> start\n"
+                         "== start ==\n"
+                         "~ temp x = 2\n"
+                         "Start {x}.\n"
+                         "+ [Again] -> again\n"
+                         "+ [Stop] -> stop\n"
+                         "== again ==\n"
+                         "Again.\n"
+                         "-> start\n"
+                         "== stop ==\n"
+                         "Stopped.\n"
+                         "-> END\n";
+    struct ink_story *story = ink_open();
+    const uint8_t *bytes = NULL;
+    uint8_t *saved = NULL;
+    size_t length = 0;
+    struct ink_turn turn;
+    char expected[64];
+    size_t expected_length = 0;
+    struct ink_choice choice;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(ink_story_save_state(story, &bytes, &length), INK_E_OK);
+
+    saved = malloc(length);
+    assert_non_null(saved);
+    memcpy(saved, bytes, length);
+
+    assert_int_equal(ink_story_choose(story, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_false(ink_story_can_continue(story));
+    assert_true(turn.length < sizeof(expected));
+    memcpy(expected, turn.bytes, turn.length);
+    expected_length = turn.length;
+
+    assert_int_not_equal(ink_story_load_state(story, saved, length - 1),
+                         INK_E_OK);
+
+    /* Point the current path at the caller of the innermost frame. */
+    assert_true(saved[16] > 1);
+    saved[20] ^= 1;
+    assert_int_equal(ink_story_load_state(story, saved, length),
+                     -INK_E_INVALID_STATE);
+    saved[20] ^= 1;
+
+    assert_int_equal(ink_story_load_state(story, saved, length), INK_E_OK);
+    assert_int_equal(ink_story_choose(story, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(ink_story_choice_next(story, &choice), INK_E_OK);
+    assert_memory_equal(choice.bytes, "Again", choice.length);
+
+    assert_int_equal(ink_story_load_state(story, saved, length), INK_E_OK);
+    assert_int_equal(ink_story_choose(story, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.length, expected_length);
+    assert_memory_equal(turn.bytes, expected, turn.length);
+    free(saved);
+    ink_close(story);
+}
+
+static void test_state_delta(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "VAR m = 5\n"
+                         "Start {n}.\n"
+                         "* [Left]\n"
+                         "  ~ n = 10\n"
+                         "  Left.\n"
+                         "  * * [Again] Again {n} {m}.\n"
+                         "      -> END\n"
+                         "* [Right]\n"
+                         "  Right {n}.\n"
+                         "  -> END\n";
+    struct ink_story *story = ink_open();
+    struct ink_story *restored = ink_open();
+    const uint8_t *bytes = NULL;
+    uint8_t *states[2] = {NULL, NULL};
+    size_t lengths[2] = {0, 0};
+    size_t length = 0;
+    struct ink_turn turn;
+    char expected[64];
+    size_t expected_length = 0;
+
+    assert_non_null(story);
+    assert_non_null(restored);
+    assert_int_equal(ink_story_load_string(story, source, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_load_string(restored, source, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_not_equal(ink_story_save_delta(story, &bytes, &lengths[0]),
+                         INK_E_OK);
+
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(ink_story_save_state(story, &bytes, &lengths[0]),
+                     INK_E_OK);
+    states[0] = malloc(lengths[0]);
+    assert_non_null(states[0]);
+    memcpy(states[0], bytes, lengths[0]);
+
+    assert_int_equal(ink_story_choose(story, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(ink_story_save_delta(story, &bytes, &lengths[1]),
+                     INK_E_OK);
+    states[1] = malloc(lengths[1]);
+    assert_non_null(states[1]);
+    memcpy(states[1], bytes, lengths[1]);
+
+    assert_int_equal(ink_story_choose(story, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_true(turn.length < sizeof(expected));
+    memcpy(expected, turn.bytes, turn.length);
+    expected_length = turn.length;
+
+    assert_int_not_equal(ink_story_load_state(restored, states[1], lengths[1]),
+                         INK_E_OK);
+
+    /* A checkpoint with the same sequence number from another chain. */
+    assert_int_equal(ink_story_continue_all(restored, &turn), INK_E_OK);
+    assert_int_equal(ink_story_save_state(restored, &bytes, &length),
+                     INK_E_OK);
+    assert_int_equal(ink_story_load_state(restored, states[1], lengths[1]),
+                     -INK_E_INVALID_STATE);
+
+    assert_int_equal(ink_story_load_state_chain(
+                         restored, (const uint8_t *const *)states, lengths, 2),
+                     INK_E_OK);
+    assert_int_equal(ink_story_choose(restored, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(restored, &turn), INK_E_OK);
+    assert_int_equal(turn.length, expected_length);
+    assert_memory_equal(turn.bytes, expected, turn.length);
+    free(states[0]);
+    free(states[1]);
+    ink_close(restored);
+    ink_close(story);
+}
+
+static void test_state_load_oom(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "Start {n}.\n"
+                         "* [Short]\n"
+                         "  ~ n = 10\n"
+                         "  -> short\n"
+                         "* [Long] -> long\n"
+                         "== short ==\n"
+                         "Short.\n"
+                         "* [Again] -> END\n"
+                         "== long ==\n"
+                         "Long.\n"
+                         "* [Other] -> END\n"
+                         "* [%s] -> END\n";
+    char text[2048];
+    char choice[1500];
+    struct ink_allocator *gpa = NULL;
+    struct ink_story *story = ink_open();
+    struct ink_story *restored = ink_open();
+    const uint8_t *bytes = NULL;
+    uint8_t *saved = NULL;
+    uint8_t *before = NULL;
+    size_t saved_length = 0;
+    size_t before_length = 0;
+    size_t length = 0;
+    struct ink_turn turn;
+    int rc = INK_E_OK;
+
+    /* A choice too long to fit in the choice text already held by
+     * `restored`, so that loading it needs fresh memory. */
+    memset(choice, 'x', sizeof(choice) - 1);
+    choice[sizeof(choice) - 1] = '\0';
+    rc = snprintf(text, sizeof(text), source, choice);
+    assert_true(rc > 0 && (size_t)rc < sizeof(text));
+
+    assert_non_null(story);
+    assert_non_null(restored);
+    assert_int_equal(ink_story_load_string(story, text, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_load_string(restored, text, INK_F_GC_ENABLE),
+                     INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(ink_story_choose(story, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &turn), INK_E_OK);
+    assert_int_equal(turn.choice_count, 2);
+    assert_int_equal(ink_story_save_state(story, &bytes, &saved_length),
+                     INK_E_OK);
+    saved = malloc(saved_length);
+    assert_non_null(saved);
+    memcpy(saved, bytes, saved_length);
+
+    assert_int_equal(ink_story_continue_all(restored, &turn), INK_E_OK);
+    assert_int_equal(ink_story_choose(restored, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(restored, &turn), INK_E_OK);
+    assert_int_equal(ink_story_save_state(restored, &bytes, &before_length),
+                     INK_E_OK);
+    before = malloc(before_length);
+    assert_non_null(before);
+    memcpy(before, bytes, before_length);
+
+    /* Fail each allocation of the load in turn. The story must be left as it
+     * was, apart from the checkpoint at bytes 48 to 59 of the header. */
+    ink_get_global_allocator(&gpa);
+    FAIL_GPA_NEXT = gpa;
+    for (size_t budget = 0;; budget++) {
+        FAIL_GPA_BUDGET = budget;
+        ink_set_global_allocator(&FAIL_GPA);
+        rc = ink_story_load_state(restored, saved, saved_length);
+        ink_set_global_allocator(gpa);
+        if (rc == INK_E_OK) {
+            break;
+        }
+
+        assert_int_equal(rc, -INK_E_OOM);
+        assert_int_equal(ink_story_save_state(restored, &bytes, &length),
+                         INK_E_OK);
+        assert_int_equal(length, before_length);
+        assert_memory_equal(bytes, before, 48);
+        assert_memory_equal(bytes + 60, before + 60, length - 60);
+    }
+
+    assert_int_equal(ink_story_choose(restored, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(restored, &turn), INK_E_OK);
+    assert_false(ink_story_can_continue(restored));
+    free(before);
+    free(saved);
+    ink_close(restored);
+    ink_close(story);
+}
+
+static void test_program_sessions(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "Start {n}.\n"
+                         "* [Left]\n"
+                         "  ~ n = 10\n"
+                         "  Left {n}.\n"
+                         "  -> END\n"
+                         "* [Right]\n"
+                         "  Right {n}.\n"
+                         "  -> END\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    ink_session *left = NULL;
+    ink_session *right = NULL;
+    struct ink_turn turn;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    left = ink_session_open(program, INK_F_GC_ENABLE | INK_F_GC_STRESS);
+    right = ink_session_open(program, INK_F_GC_ENABLE | INK_F_GC_STRESS);
+    assert_non_null(left);
+    assert_non_null(right);
+    assert_ptr_equal(ink_story_get_paths(left), ink_story_get_paths(right));
+    assert_int_not_equal(ink_story_recompile(left, &opts), INK_E_OK);
+
+    assert_int_equal(ink_story_continue_all(left, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Start 1.\n"));
+    assert_memory_equal(turn.bytes, "Start 1.\n", turn.length);
+    assert_int_equal(ink_story_continue_all(right, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Start 1.\n"));
+    assert_memory_equal(turn.bytes, "Start 1.\n", turn.length);
+
+    assert_int_equal(ink_story_choose(left, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(left, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Left 10.\n"));
+    assert_memory_equal(turn.bytes, "Left 10.\n", turn.length);
+    assert_int_equal(ink_story_choose(right, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(right, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Right 1.\n"));
+    assert_memory_equal(turn.bytes, "Right 1.\n", turn.length);
+
+    ink_close(left);
+    ink_close(right);
+    ink_program_close(program);
+}
+
+static void test_program_negate(void **state)
+{
+    const char *source = "{-5}\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    struct ink_turn turn;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    /* Negation must not modify the constant shared by both sessions. */
+    for (size_t i = 0; i < 2; i++) {
+        ink_session *session = ink_session_open(program, INK_F_GC_ENABLE);
+
+        assert_non_null(session);
+        assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+        assert_int_equal(turn.length, strlen("-5"));
+        assert_memory_equal(turn.bytes, "-5", turn.length);
+        ink_close(session);
+    }
+
+    ink_program_close(program);
+}
+
+static void test_story_fork(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "~ n = n + 1\n"
+                         "Start {n}.\n"
+                         "* [Left]\n"
+                         "  ~ n = n * 10\n"
+                         "  Left {n}.\n"
+                         "  -> END\n"
+                         "* [Right]\n"
+                         "  Right {n}.\n"
+                         "  -> END\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    struct ink_story *story = ink_open();
+    ink_session *session = NULL;
+    ink_session *fork = NULL;
+    struct ink_turn turn;
+
+    assert_non_null(story);
+    assert_int_equal(ink_story_load_opts(story, &opts), INK_E_OK);
+    assert_int_not_equal(ink_story_fork(story, &fork), INK_E_OK);
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    session = ink_session_open(program, INK_F_GC_ENABLE | INK_F_GC_STRESS);
+    assert_non_null(session);
+    assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+    assert_int_equal(ink_story_fork(session, &fork), INK_E_OK);
+
+    assert_int_equal(ink_story_choose(fork, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(fork, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Left 20.\n"));
+    assert_memory_equal(turn.bytes, "Left 20.\n", turn.length);
+    assert_int_equal(ink_story_choose(session, 2), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(session, &turn), INK_E_OK);
+    assert_int_equal(turn.length, strlen("Right 2.\n"));
+    assert_memory_equal(turn.bytes, "Right 2.\n", turn.length);
+
+    ink_close(fork);
+    ink_close(session);
+    ink_close(story);
+    ink_program_close(program);
+}
+
+static void test_continue_budget(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "~ n = n + 1\n"
+                         "Start {n}.\n"
+                         "Still {n * 2}.\n"
+                         "* [Left]\n"
+                         "  ~ n = n * 10\n"
+                         "  Left {n}.\n"
+                         "  -> END\n"
+                         "* [Right]\n"
+                         "  Right {n}.\n"
+                         "  -> END\n";
+    struct ink_story *story = ink_open();
+    struct ink_story *budget = ink_open();
+    const uint8_t *bytes = NULL;
+    size_t length = 0;
+    size_t yields = 0;
+    uint64_t count = 0;
+    struct ink_turn turn;
+    struct ink_turn expected;
+    int rc;
+
+    assert_non_null(story);
+    assert_non_null(budget);
+    assert_int_equal(ink_story_load_string(story, source, 0), INK_E_OK);
+    assert_int_equal(ink_story_load_string(budget, source, 0), INK_E_OK);
+    assert_int_equal(ink_story_continue_budget(budget, 0, &turn),
+                     -INK_E_INVALID_ARG);
+
+    count = ink_story_instruction_count(story);
+    assert_int_equal(ink_story_continue_all(story, &expected), INK_E_OK);
+    assert_true(ink_story_instruction_count(story) > count);
+
+    while ((rc = ink_story_continue_budget(budget, 1, &turn)) ==
+           -INK_E_YIELD) {
+        assert_int_not_equal(ink_story_save_state(budget, &bytes, &length),
+                             INK_E_OK);
+        yields++;
+    }
+
+    assert_int_equal(rc, INK_E_OK);
+    assert_true(yields > 1);
+    assert_int_equal(ink_story_instruction_count(budget),
+                     ink_story_instruction_count(story));
+    assert_int_equal(turn.length, expected.length);
+    assert_memory_equal(turn.bytes, expected.bytes, turn.length);
+    assert_int_equal(turn.line_count, expected.line_count);
+    assert_int_equal(turn.choice_count, 2);
+
+    assert_int_equal(ink_story_choose(story, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_all(story, &expected), INK_E_OK);
+    assert_int_equal(ink_story_choose(budget, 1), INK_E_OK);
+    assert_int_equal(ink_story_continue_budget(budget, 2, &turn),
+                     -INK_E_YIELD);
+    assert_int_equal(ink_story_continue_all(budget, &turn), INK_E_OK);
+    assert_int_equal(turn.length, expected.length);
+    assert_memory_equal(turn.bytes, expected.bytes, turn.length);
+    assert_int_equal(ink_story_save_state(budget, &bytes, &length), INK_E_OK);
+
+    ink_close(budget);
+    ink_close(story);
+}
+
+#define TEST_SESSIONS 8
+
+struct test_scheduler {
+    ink_session *sessions[TEST_SESSIONS];
+    size_t calls[TEST_SESSIONS];
+    char output[TEST_SESSIONS][64];
+};
+
+static void test_scheduler_callback(ink_session *session, int rc,
+                                    const struct ink_turn *turn, void *userdata)
+{
+    struct test_scheduler *t = userdata;
+
+    assert_int_equal(rc, INK_E_OK);
+
+    for (size_t i = 0; i < TEST_SESSIONS; i++) {
+        if (t->sessions[i] == session) {
+            assert_true(turn->length < sizeof(t->output[i]));
+            memcpy(t->output[i], turn->bytes, turn->length);
+            t->output[i][turn->length] = '\0';
+            t->calls[i]++;
+        }
+    }
+}
+
+static void test_scheduler(void **state)
+{
+    const char *source = "VAR n = 1\n"
+                         "~ n = n + 1\n"
+                         "Start {n}.\n"
+                         "* [Left]\n"
+                         "  ~ n = n * 10\n"
+                         "  Left {n}.\n"
+                         "  -> END\n"
+                         "* [Right]\n"
+                         "  Right {n}.\n"
+                         "  -> END\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    ink_scheduler *scheduler = NULL;
+    struct test_scheduler t;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    for (size_t threads = 0; threads < 4; threads += 3) {
+        memset(&t, 0, sizeof(t));
+        scheduler = ink_scheduler_open(threads, test_scheduler_callback, &t);
+        assert_non_null(scheduler);
+
+        for (size_t i = 0; i < TEST_SESSIONS; i++) {
+            t.sessions[i] = ink_session_open(program, INK_F_GC_ENABLE);
+            assert_non_null(t.sessions[i]);
+        }
+        for (size_t i = 0; i < TEST_SESSIONS; i++) {
+            assert_int_equal(ink_scheduler_submit(scheduler, t.sessions[i], 0),
+                             INK_E_OK);
+            assert_int_equal(
+                ink_scheduler_submit(scheduler, t.sessions[i], i % 2 + 1),
+                INK_E_OK);
+        }
+
+        ink_scheduler_wait(scheduler);
+
+        for (size_t i = 0; i < TEST_SESSIONS; i++) {
+            assert_int_equal(t.calls[i], 2);
+            assert_string_equal(t.output[i],
+                                i % 2 ? "Right 2.\n" : "Left 20.\n");
+            ink_close(t.sessions[i]);
+        }
+
+        ink_scheduler_close(scheduler);
+    }
+
+    ink_program_close(program);
+}
+
+static void test_scheduler_error_callback(ink_session *session, int rc,
+                                          const struct ink_turn *turn,
+                                          void *userdata)
+{
+    int *result = userdata;
+
+    (void)session;
+    assert_null(turn);
+    *result = rc;
+}
+
+static void test_scheduler_error(void **state)
+{
+    const char *source = "Start.\n"
+                         "{f(1)}\n"
+                         "== function f(x) ==\n"
+                         "~ return f(x)\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_program *program = NULL;
+    ink_scheduler *scheduler = NULL;
+    ink_session *session = NULL;
+    int result = INK_E_OK;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    /* A runtime error on a worker is reported instead of exiting. */
+    scheduler = ink_scheduler_open(1, test_scheduler_error_callback, &result);
+    assert_non_null(scheduler);
+    session = ink_session_open(program, INK_F_GC_ENABLE);
+    assert_non_null(session);
+    assert_int_equal(ink_scheduler_submit(scheduler, session, 0), INK_E_OK);
+    ink_scheduler_wait(scheduler);
+    assert_int_equal(result, -INK_E_STACK_OVERFLOW);
+    assert_false(ink_story_can_continue(session));
+
+    ink_scheduler_close(scheduler);
+    ink_close(session);
+    ink_program_close(program);
+}
+
+static void test_explore(void **state)
+{
+    const char *source = "Hello.\n"
+                         "* [Left] -> left\n"
+                         "* [Right] -> right\n"
+                         "== left ==\n"
+                         "Left.\n"
+                         "* [Again] -> left\n"
+                         "* [Stop] -> END\n"
+                         "+ [Spin] -> spin\n"
+                         "== right ==\n"
+                         "Right.\n"
+                         "-> END\n"
+                         "== spin ==\n"
+                         "-> spin\n"
+                         "== unused ==\n"
+                         "Unused.\n"
+                         "-> END\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_explore_opts explore_opts = {
+        .order = INK_EXPLORE_BFS,
+        .thread_count = 4,
+        .max_depth = 0,
+        .max_states = 0,
+        .max_instructions = 10000,
+    };
+    struct ink_program *program = NULL;
+    struct ink_explore_report report;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+
+    for (int order = INK_EXPLORE_BFS; order <= INK_EXPLORE_DFS; order++) {
+        explore_opts.order = (enum ink_explore_order)order;
+
+        assert_int_equal(ink_program_explore(program, &explore_opts, &report),
+                         INK_E_OK);
+        assert_int_equal(report.states, 3);
+        assert_int_equal(report.duplicates, 1);
+        assert_int_equal(report.endings, 3);
+        assert_int_equal(report.truncated, 0);
+        assert_int_equal(report.max_depth, 2);
+        assert_int_equal(report.path_count, 5);
+        assert_int_equal(report.unvisited_path_count, 1);
+        assert_string_equal(report.unvisited_paths[0], "unused");
+        assert_int_equal(report.dead_end_count, 2);
+
+        for (size_t i = 0; i < report.dead_end_count; i++) {
+            const struct ink_explore_dead_end *const dead_end =
+                &report.dead_ends[i];
+
+            assert_int_equal(dead_end->rc, -INK_E_YIELD);
+            assert_int_equal(dead_end->choices[0], 1);
+            assert_int_equal(dead_end->choices[dead_end->depth - 1], 3);
+        }
+
+        ink_explore_report_deinit(&report);
+    }
+
+    explore_opts.max_depth = 1;
+    assert_int_equal(ink_program_explore(program, &explore_opts, &report),
+                     INK_E_OK);
+    assert_int_equal(report.states, 2);
+    assert_int_equal(report.truncated, 1);
+    assert_int_equal(report.dead_end_count, 0);
+    ink_explore_report_deinit(&report);
+    ink_program_close(program);
+}
+
+static void test_simulate(void **state)
+{
+    const char *source = "VAR gold = 0\n"
+                         "Hello.\n"
+                         "* [Rob]\n"
+                         "  ~ gold = 10\n"
+                         "  -> END\n"
+                         "* [Wait] -> wait\n"
+                         "* [Leave] -> END\n"
+                         "== wait ==\n"
+                         "Waiting.\n"
+                         "-> END\n";
+    const struct ink_load_opts opts = {
+        .flags = 0,
+        .source_bytes = (uint8_t *)source,
+        .source_length = strlen(source),
+        .filename = (uint8_t *)"<STDIN>",
+    };
+    struct ink_simulate_opts simulate_opts = {
+        .policy = INK_SIMULATE_RANDOM,
+        .weight = NULL,
+        .userdata = NULL,
+        .playthrough_count = 300,
+        .thread_count = 1,
+        .seed = 42,
+        .max_turns = 0,
+        .max_instructions = 10000,
+    };
+    struct ink_program *program = NULL;
+    struct ink_simulate_report serial;
+    struct ink_simulate_report report;
+
+    assert_int_equal(ink_program_load_opts(&program, &opts), INK_E_OK);
+    assert_int_equal(ink_program_simulate(program, &simulate_opts, &serial),
+                     INK_E_OK);
+    assert_int_equal(serial.playthroughs, 300);
+    assert_int_equal(serial.endings, 300);
+    assert_int_equal(serial.turns_max, 1);
+    assert_int_equal(serial.turns[1], 300);
+    assert_int_equal(serial.path_count, 2);
+    assert_string_equal(serial.paths[0].name, "@main");
+    assert_int_equal(serial.paths[0].playthroughs, 300);
+    assert_string_equal(serial.paths[1].name, "wait");
+    assert_int_equal(serial.global_count, 1);
+    assert_string_equal(serial.globals[0].name, "gold");
+    assert_int_equal(serial.globals[0].bin_count, 2);
+    assert_int_equal(
+        serial.globals[0].bins[0].count + serial.globals[0].bins[1].count, 300);
+
+    /* Results do not depend on the number of threads. */
+    simulate_opts.thread_count = 4;
+    assert_int_equal(ink_program_simulate(program, &simulate_opts, &report),
+                     INK_E_OK);
+    assert_int_equal(report.instructions, serial.instructions);
+    assert_int_equal(report.paths[1].playthroughs,
+                     serial.paths[1].playthroughs);
+    assert_int_equal(report.global_count, serial.global_count);
+    assert_string_equal(report.globals[0].name, serial.globals[0].name);
+    assert_int_equal(report.globals[0].bins[0].count,
+                     serial.globals[0].bins[0].count);
+    ink_simulate_report_deinit(&report);
+
+    /* The first choice is the most likely one when weighted. */
+    simulate_opts.policy = INK_SIMULATE_WEIGHTED;
+    assert_int_equal(ink_program_simulate(program, &simulate_opts, &report),
+                     INK_E_OK);
+    assert_string_equal(serial.globals[0].bins[0].value, "0");
+    assert_string_equal(report.globals[0].bins[0].value, "10");
+    ink_simulate_report_deinit(&report);
+    ink_simulate_report_deinit(&serial);
+    ink_program_close(program);
+}
+
 struct test_state {
     struct ink_allocator *gpa;
 };
@@ -326,6 +1399,13 @@ static bool tht_cmp(const void *lhs, const void *rhs)
     return (key_lhs == key_rhs);
 }
 
+static uint32_t tht_ex_hash(const void *key, size_t length)
+{
+    return test_fnv32a((uint8_t *)key, length);
+}
+
+INK_HASHMAP_T_EX(tht_ex, int, int, tht_ex_hash, tht_cmp)
+
 static void test_hashmap_oom(void **state)
 {
     struct tht ht;
@@ -369,6 +1449,38 @@ static void test_hashmap_remove(void **state)
     tht_deinit(&ht);
 }
 
+static void test_hashmap_remove_lookup(void **state)
+{
+    struct tht_ex ht;
+    int entry = 0;
+
+    tht_ex_init(&ht, 80u);
+
+    for (int i = 0; i < 0x1000; i++) {
+        assert_int_equal(tht_ex_insert(&ht, i, i), INK_E_OK);
+    }
+    for (int i = 0; i < 0x1000; i += 2) {
+        assert_int_equal(tht_ex_remove(&ht, i), INK_E_OK);
+    }
+
+    assert_int_equal(ht.count, 0x800);
+    assert_int_equal(tht_ex_remove(&ht, 0), -INK_E_FAIL);
+
+    for (int i = 0; i < 0x1000; i++) {
+        if (i % 2) {
+            assert_int_equal(tht_ex_lookup(&ht, i, &entry), INK_E_OK);
+            assert_int_equal(entry, i);
+        } else {
+            assert_int_equal(tht_ex_lookup(&ht, i, &entry), -INK_E_FAIL);
+        }
+    }
+
+    assert_int_equal(tht_ex_insert(&ht, 1, 2), -INK_E_OVERWRITE);
+    assert_int_equal(tht_ex_lookup(&ht, 1, &entry), INK_E_OK);
+    assert_int_equal(entry, 2);
+    tht_ex_deinit(&ht);
+}
+
 int main(void)
 {
     test_exec();
@@ -383,6 +1495,36 @@ int main(void)
                                         t_teardown),
         cmocka_unit_test_setup_teardown(test_hashmap_remove, t_setup,
                                         t_teardown),
+        cmocka_unit_test_setup_teardown(test_hashmap_remove_lookup, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_output_sink, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_continue_all, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_bundle_roundtrip, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_bundle_bad_code, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_parallel_compile, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_recompile, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_reset, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_state_roundtrip, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_state_delta, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_state_load_oom, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_program_sessions, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_program_negate, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_story_fork, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_continue_budget, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_scheduler, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_scheduler_error, t_setup,
+                                        t_teardown),
+        cmocka_unit_test_setup_teardown(test_explore, t_setup, t_teardown),
+        cmocka_unit_test_setup_teardown(test_simulate, t_setup, t_teardown),
     };
 
     return cmocka_run_group_tests(tests, t_group_setup, t_group_teardown);